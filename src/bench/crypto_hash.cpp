@@ -12,6 +12,7 @@
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
+#include <crypto/shabal256.h>
 #include <crypto/siphash.h>
 
 /* Number of bytes to hash per iteration */
@@ -59,6 +60,29 @@ static void SHA256D64_1024(benchmark::State& state)
     }
 }
 
+static void SHABAL256(benchmark::State& state)
+{
+    uint8_t hash[CShabal256::OUTPUT_SIZE];
+    std::vector<uint8_t> in(BUFFER_SIZE,0);
+    while (state.KeepRunning())
+        CShabal256().Write(in.data(), in.size()).Finalize(hash);
+}
+
+static void SHABAL256_8way(benchmark::State& state)
+{
+    Shabal256AutoDetect();
+    uint8_t hashes[CShabal256Lanes::MAX_LANES][CShabal256Lanes::OUTPUT_SIZE];
+    std::vector<uint8_t> in(BUFFER_SIZE / CShabal256Lanes::MAX_LANES, 0);
+    const unsigned char* data[CShabal256Lanes::MAX_LANES];
+    unsigned char* out[CShabal256Lanes::MAX_LANES];
+    for (size_t i = 0; i < CShabal256Lanes::MAX_LANES; ++i) {
+        data[i] = in.data();
+        out[i] = hashes[i];
+    }
+    while (state.KeepRunning())
+        CShabal256Lanes(CShabal256Lanes::MAX_LANES).Write(data, in.size()).Finalize(out);
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -96,6 +120,8 @@ BENCHMARK(RIPEMD160, 440);
 BENCHMARK(SHA1, 570);
 BENCHMARK(SHA256, 340);
 BENCHMARK(SHA512, 330);
+BENCHMARK(SHABAL256, 400);
+BENCHMARK(SHABAL256_8way, 1000);
 
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
@@ -0,0 +1,80 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chiapos/kernel/bls_key.h>
+#include <chiapos/kernel/utils.h>
+#include <random.h>
+#include <uint256.h>
+
+#include <vector>
+
+// The number of headers in a batch, a run of headers of the initial block download is much longer
+static const int BLOCKS = 32;
+
+struct FarmerSignatures {
+    std::vector<chiapos::PubKey> vPubkeys;
+    std::vector<chiapos::Signature> vSignatures;
+    std::vector<chiapos::Bytes> vchMessages;
+};
+
+// Each block is signed by a different farmer, the message is the unsignatured hash of the block
+static FarmerSignatures MakeFarmerSignatures()
+{
+    FarmerSignatures sigs;
+    for (int i = 0; i < BLOCKS; ++i) {
+        chiapos::Bytes vchSeed(32);
+        GetRandBytes(vchSeed.data(), vchSeed.size());
+        auto key = chiapos::CKey::CreateKeyWithRandomSeed(vchSeed);
+        chiapos::Bytes vchMessage = chiapos::MakeBytes(GetRandHash());
+        sigs.vPubkeys.push_back(key.GetPubKey());
+        sigs.vSignatures.push_back(key.Sign(vchMessage));
+        sigs.vchMessages.push_back(std::move(vchMessage));
+    }
+    return sigs;
+}
+
+static void VerifyFarmerSignatures_PerBlock(benchmark::State& state)
+{
+    FarmerSignatures sigs = MakeFarmerSignatures();
+    while (state.KeepRunning()) {
+        for (int i = 0; i < BLOCKS; ++i) {
+            bool fValid = chiapos::VerifySignature(sigs.vPubkeys[i], sigs.vSignatures[i], sigs.vchMessages[i]);
+            assert(fValid);
+        }
+    }
+}
+
+static void VerifyFarmerSignatures_Batch(benchmark::State& state)
+{
+    FarmerSignatures sigs = MakeFarmerSignatures();
+    while (state.KeepRunning()) {
+        bool fValid = chiapos::BatchVerifySignatures(sigs.vPubkeys, sigs.vSignatures, sigs.vchMessages);
+        assert(fValid);
+    }
+}
+
+// The last signature is invalid, the batch fails and the signatures are verified one by one
+static void VerifyFarmerSignatures_BatchFallback(benchmark::State& state)
+{
+    FarmerSignatures sigs = MakeFarmerSignatures();
+    sigs.vchMessages.back() = chiapos::MakeBytes(GetRandHash());
+    while (state.KeepRunning()) {
+        bool fValid = chiapos::BatchVerifySignatures(sigs.vPubkeys, sigs.vSignatures, sigs.vchMessages);
+        assert(!fValid);
+        int nInvalid{0};
+        for (int i = 0; i < BLOCKS; ++i) {
+            if (!chiapos::VerifySignature(sigs.vPubkeys[i], sigs.vSignatures[i], sigs.vchMessages[i])) {
+                ++nInvalid;
+            }
+        }
+        assert(nInvalid == 1);
+    }
+}
+
+// Each iteration verifies the signatures of BLOCKS blocks
+BENCHMARK(VerifyFarmerSignatures_PerBlock, 5);
+BENCHMARK(VerifyFarmerSignatures_Batch, 5);
+BENCHMARK(VerifyFarmerSignatures_BatchFallback, 5);
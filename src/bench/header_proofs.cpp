@@ -0,0 +1,106 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chainparams.h>
+#include <checkqueue.h>
+#include <chiapos/post.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+static const int HEADERS = 64;
+
+// A valid proof of space from a k25 plot, the same one is tested by chiautils_tests. There is no VDF proof fixture,
+// so the VDF proof is left empty and only the PoS proofs are verified
+static chiapos::CBlockFields MakeBenchBlockFields()
+{
+    chiapos::CBlockFields fields;
+    fields.posProof.challenge = uint256S("cc5ac4c68e9228f2487aa3d4a0ca067e150ad19f85934f5d97f4355c8c83fdbd");
+    fields.posProof.vchPoolPkOrHash = chiapos::BytesFromHex(
+            "92f7dbd5de62bfe6c752c957d7d17af1114500670819dfb149a055edaafcc77bd376b450d43eb1c3208a424b00abe950");
+    fields.posProof.vchLocalPk = chiapos::BytesFromHex(
+            "b1578afd24055235e1a946108b84bab4c27b42f47e0a1f9562e251462b2f7564bd12991abcb9c23df5b62e77ed1f1ce7");
+    fields.posProof.vchFarmerPk = chiapos::BytesFromHex(
+            "8b17c85e49be1a2303588b6fe9a0206dc0722c83db2281bb1aee695ae7e97c098672e1609a50b86786126cca3c9c8639");
+    fields.posProof.nPlotType = static_cast<uint8_t>(chiapos::PlotPubKeyType::OGPlots);
+    fields.posProof.nPlotK = 25;
+    fields.posProof.vchProof = chiapos::BytesFromHex(
+            "407f849c3b8fa9265751f34a72b57192cca83a5d7d7d2ce935cfde94e91ffa7567dadbe0cdd36e9da11c5ffd6b790b4acbe64a91d6"
+            "e4c2f87b4e0b3f7d130222a3196fe705bbebf47817062f3deea06ea3c71dec4198ceaaa1f7fdad81e616c465bf4e8506a088ccd3ac"
+            "e16f1c0bdf9a9c73edcddc1cf0dcfacd8ef574809c442c9f8ffbd92defb3f520b27de1ae949201d63f618514af50994014f5a522bd"
+            "5b67f6430fa927bda70c39b751c0a9a4a0a864889ed8202aecb283a708378002c5a6cf5f19fe05b31c");
+    return fields;
+}
+
+/**
+ * The PoS part of CHeaderProofsCheck. A failed check makes CCheckQueue skip the remaining checks, so the check
+ * succeeds only when the PoS proof is verified.
+ */
+class CBenchPosProofCheck {
+public:
+    CBenchPosProofCheck() = default;
+
+    CBenchPosProofCheck(chiapos::CBlockFields const& fields, int nTargetHeight, Consensus::Params const& params,
+                        chiapos::CVerifiedProofs* pverified)
+            : m_check(fields, nTargetHeight, params, pverified), m_pverified(pverified) {}
+
+    bool operator()() {
+        m_check();
+        return !m_pverified->mixedQualityString.IsNull();
+    }
+
+    void swap(CBenchPosProofCheck& check) {
+        m_check.swap(check.m_check);
+        std::swap(m_pverified, check.m_pverified);
+    }
+
+private:
+    chiapos::CHeaderProofsCheck m_check;
+    chiapos::CVerifiedProofs* m_pverified{nullptr};
+};
+
+static void VerifyHeaderProofs(benchmark::State& state, int nThreads)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    auto const& params = chainParams->GetConsensus();
+    std::vector<chiapos::CBlockFields> vFields(HEADERS, MakeBenchBlockFields());
+
+    CCheckQueue<CBenchPosProofCheck> queue(1);
+    boost::thread_group tg;
+    for (int i = 0; i < nThreads - 1; ++i) {
+        tg.create_thread([&] { queue.Thread(); });
+    }
+    while (state.KeepRunning()) {
+        std::vector<chiapos::CVerifiedProofs> vVerifiedProofs(HEADERS);
+        std::vector<CBenchPosProofCheck> vChecks;
+        for (int i = 0; i < HEADERS; ++i) {
+            vChecks.emplace_back(vFields[i], params.BHDIP009Height, params, &vVerifiedProofs[i]);
+        }
+        CCheckQueueControl<CBenchPosProofCheck> control(&queue);
+        control.Add(vChecks);
+        bool fAllVerified = control.Wait();
+        assert(fAllVerified);
+        for (chiapos::CVerifiedProofs const& verified : vVerifiedProofs) {
+            assert(!verified.mixedQualityString.IsNull());
+        }
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+static void VerifyHeaderProofs_1Thread(benchmark::State& state) { VerifyHeaderProofs(state, 1); }
+static void VerifyHeaderProofs_2Threads(benchmark::State& state) { VerifyHeaderProofs(state, 2); }
+static void VerifyHeaderProofs_4Threads(benchmark::State& state) { VerifyHeaderProofs(state, 4); }
+static void VerifyHeaderProofs_8Threads(benchmark::State& state) { VerifyHeaderProofs(state, 8); }
+
+// Each iteration verifies the PoS proofs of HEADERS headers, headers/sec = HEADERS / (time per iteration)
+BENCHMARK(VerifyHeaderProofs_1Thread, 2);
+BENCHMARK(VerifyHeaderProofs_2Threads, 2);
+BENCHMARK(VerifyHeaderProofs_4Threads, 2);
+BENCHMARK(VerifyHeaderProofs_8Threads, 2);
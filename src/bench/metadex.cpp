@@ -0,0 +1,313 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <omnicore/dbtradelist.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/tally.h>
+#include <omnicore/uint256_extensions.h>
+
+#include <arith_uint256.h>
+#include <fs.h>
+#include <random.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <uint256.h>
+
+#include <boost/algorithm/string.hpp>
+
+#include <leveldb/iterator.h>
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using namespace mastercore;
+
+static constexpr int NUM_ORDERS = 2000;
+static constexpr int NUM_ADDRESSES = 64;
+static constexpr int64_t FUNDS = 1000000000000LL;
+//! The orders are traded between these properties, the fees are not activated on regtest
+static const std::vector<uint32_t> PROPERTIES = {3, 4, 5, 6};
+
+namespace {
+
+struct Order {
+    std::string addr;
+    uint32_t prop;
+    int64_t amount;
+    uint32_t desprop;
+    int64_t amount_desired;
+    int block;
+    unsigned int idx;
+    uint256 txid;
+};
+
+struct MatchedTrade {
+    uint256 txidOld;
+    uint256 txidNew;
+    //! The amount paid by the new order to the old one
+    int64_t amountOld;
+    //! The amount of the old order bought by the new one
+    int64_t amountNew;
+
+    bool operator<(const MatchedTrade& other) const
+    {
+        return std::tie(txidNew, txidOld, amountOld, amountNew) < std::tie(other.txidNew, other.txidOld, other.amountOld, other.amountNew);
+    }
+
+    bool operator==(const MatchedTrade& other) const
+    {
+        return txidOld == other.txidOld && txidNew == other.txidNew && amountOld == other.amountOld && amountNew == other.amountNew;
+    }
+};
+
+/** The trade list of the bench, the matched trades are read back to compare them with the reference */
+class BenchTradeList : public CMPTradeList
+{
+public:
+    BenchTradeList(const fs::path& path) : CMPTradeList(path, true) {}
+
+    std::vector<MatchedTrade> GetMatchedTrades() const
+    {
+        std::vector<MatchedTrade> trades;
+        std::unique_ptr<leveldb::Iterator> it(NewIterator());
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            // The matched trades are keyed by "txid1+txid2", the new trades by the txid only
+            std::string strKey = it->key().ToString();
+            if (strKey.size() != 129) continue;
+            std::vector<std::string> vstr;
+            boost::split(vstr, it->value().ToString(), boost::is_any_of(":"), boost::token_compress_on);
+            assert(vstr.size() == 8);
+            MatchedTrade trade;
+            trade.txidOld = uint256S(strKey.substr(0, 64));
+            trade.txidNew = uint256S(strKey.substr(65, 64));
+            trade.amountOld = std::stoll(vstr[4]);
+            trade.amountNew = std::stoll(vstr[5]);
+            trades.push_back(trade);
+        }
+        return trades;
+    }
+};
+
+std::string GetAddress(int n)
+{
+    return strprintf("metadex_bench_address_%d", n);
+}
+
+std::vector<Order> CreateOrderFlow()
+{
+    FastRandomContext rng(true);
+    std::vector<Order> orders;
+    for (int i = 0; i < NUM_ORDERS; ++i) {
+        Order order;
+        order.addr = GetAddress(rng.randrange(NUM_ADDRESSES));
+        order.prop = PROPERTIES[rng.randrange(PROPERTIES.size())];
+        do {
+            order.desprop = PROPERTIES[rng.randrange(PROPERTIES.size())];
+        } while (order.desprop == order.prop);
+        order.amount = 1 + rng.randrange(100000);
+        // prices around 1 with +/-5%, about half of the orders cross the opposite side of the pair
+        order.amount_desired = order.amount * (95 + rng.randrange(11)) / 100 + 1;
+        order.block = 100 + i / 10;
+        order.idx = i % 10;
+        order.txid = ArithToUint256(arith_uint256(i + 1));
+        orders.push_back(order);
+    }
+    return orders;
+}
+
+/**
+ * The order book keyed by the property for sale only, where the matching scans the price levels of all desired
+ * properties. It's the reference the books of the pairs must give the same trades as.
+ */
+class LegacyMetaDEx
+{
+public:
+    typedef std::map<uint32_t, md_PricesMap> PropertiesMap;
+    typedef std::map<std::pair<std::string, uint32_t>, int64_t> BalanceMap;
+
+    PropertiesMap book;
+    BalanceMap balance;
+    BalanceMap reserve;
+    //! The matched trades in the order they are made
+    std::vector<MatchedTrade> trades;
+
+    void Add(const Order& order)
+    {
+        CMPMetaDEx pnew(order.addr, order.block, order.prop, order.amount, order.desprop, order.amount_desired, order.txid, order.idx, CMPTransaction::ADD);
+        if (0 >= pnew.unitPrice()) return;
+        Trade(pnew);
+        if (0 < pnew.getAmountRemaining()) {
+            assert(book[pnew.getProperty()][pnew.unitPrice()].insert(pnew).second);
+            balance[std::make_pair(pnew.getAddr(), pnew.getProperty())] -= pnew.getAmountRemaining();
+            reserve[std::make_pair(pnew.getAddr(), pnew.getProperty())] += pnew.getAmountRemaining();
+        }
+    }
+
+private:
+    void Trade(CMPMetaDEx& pnew)
+    {
+        PropertiesMap::iterator propIt = book.find(pnew.getDesProperty());
+        if (propIt == book.end()) return;
+        md_PricesMap& prices = propIt->second;
+        for (md_PricesMap::iterator priceIt = prices.begin(); priceIt != prices.end(); ++priceIt) {
+            if (pnew.inversePrice() < priceIt->first) continue;
+            md_Set& offers = priceIt->second;
+            md_Set::iterator offerIt = offers.begin();
+            while (offerIt != offers.end()) {
+                const CMPMetaDEx& pold = *offerIt;
+                if (pold.getDesProperty() != pnew.getProperty()) {
+                    ++offerIt;
+                    continue;
+                }
+                arith_uint256 iCouldBuy = (ConvertTo256(pnew.getAmountRemaining()) * ConvertTo256(pold.getAmountForSale())) / ConvertTo256(pold.getAmountDesired());
+                int64_t nCouldBuy = iCouldBuy < ConvertTo256(pold.getAmountRemaining()) ? ConvertTo64(iCouldBuy) : pold.getAmountRemaining();
+                if (nCouldBuy == 0) {
+                    ++offerIt;
+                    continue;
+                }
+                arith_uint256 iWouldPay = DivideAndRoundUp((ConvertTo256(nCouldBuy) * ConvertTo256(pold.getAmountDesired())), ConvertTo256(pold.getAmountForSale()));
+                int64_t nWouldPay = ConvertTo64(iWouldPay);
+                if (rational_t(nWouldPay, nCouldBuy) > pnew.inversePrice()) {
+                    ++offerIt;
+                    continue;
+                }
+
+                trades.push_back(MatchedTrade{pold.getHash(), pnew.getHash(), nWouldPay, nCouldBuy});
+                balance[std::make_pair(pnew.getAddr(), pnew.getProperty())] -= nWouldPay;
+                balance[std::make_pair(pold.getAddr(), pold.getDesProperty())] += nWouldPay;
+                reserve[std::make_pair(pold.getAddr(), pold.getProperty())] -= nCouldBuy;
+                balance[std::make_pair(pnew.getAddr(), pnew.getDesProperty())] += nCouldBuy;
+
+                CMPMetaDEx seller_replacement = pold;
+                seller_replacement.setAmountRemaining(pold.getAmountRemaining() - nCouldBuy, "seller_replacement");
+                pnew.setAmountRemaining(pnew.getAmountRemaining() - nWouldPay, "buyer");
+
+                offers.erase(offerIt++);
+                if (0 < seller_replacement.getAmountRemaining()) offers.insert(seller_replacement);
+                if (0 == pnew.getAmountRemaining()) return;
+            }
+        }
+    }
+};
+
+void ResetOmniState() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    metadex.clear();
+    clear_tally_map();
+    for (int n = 0; n < NUM_ADDRESSES; ++n) {
+        for (uint32_t prop : PROPERTIES) {
+            assert(update_tally_map(GetAddress(n), prop, FUNDS, BALANCE));
+        }
+    }
+}
+
+void ReplayOrderFlow(const std::vector<Order>& orders) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    for (const Order& order : orders) {
+        MetaDEx_ADD(order.addr, order.prop, order.amount, order.block, order.desprop, order.amount_desired, order.txid, order.idx);
+    }
+}
+
+/**
+ * Both books must make the same trades and leave the same balances and the same open orders behind. The trade list
+ * doesn't keep the order of the matches of one new order, they are compared order by order in the flow; a different
+ * order of the matches would fill another old order partially, so it still shows in the amounts.
+ */
+void CheckSameTrades(const LegacyMetaDEx& legacy, const BenchTradeList& tradeList) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    std::vector<MatchedTrade> legacyTrades = legacy.trades;
+    std::vector<MatchedTrade> trades = tradeList.GetMatchedTrades();
+    // Sorted by the new order first, so the trades of each order in the flow are compared as a group
+    std::sort(legacyTrades.begin(), legacyTrades.end());
+    std::sort(trades.begin(), trades.end());
+    assert(!trades.empty());
+    assert(trades == legacyTrades);
+
+    for (int n = 0; n < NUM_ADDRESSES; ++n) {
+        for (uint32_t prop : PROPERTIES) {
+            std::pair<std::string, uint32_t> key(GetAddress(n), prop);
+            LegacyMetaDEx::BalanceMap::const_iterator balanceIt = legacy.balance.find(key);
+            LegacyMetaDEx::BalanceMap::const_iterator reserveIt = legacy.reserve.find(key);
+            int64_t nBalance = FUNDS + (balanceIt == legacy.balance.end() ? 0 : balanceIt->second);
+            int64_t nReserve = reserveIt == legacy.reserve.end() ? 0 : reserveIt->second;
+            assert(GetTokenBalance(key.first, prop, BALANCE) == nBalance);
+            assert(GetTokenBalance(key.first, prop, METADEX_RESERVE) == nReserve);
+        }
+    }
+
+    std::map<uint256, int64_t> legacyOpen;
+    for (const auto& prices : legacy.book) {
+        for (const auto& level : prices.second) {
+            for (const CMPMetaDEx& obj : level.second) {
+                legacyOpen[obj.getHash()] = obj.getAmountRemaining();
+            }
+        }
+    }
+    std::map<uint256, int64_t> open;
+    for (const auto& pairs : metadex) {
+        for (const auto& prices : pairs.second) {
+            for (const auto& level : prices.second) {
+                assert(!level.second.empty());
+                for (const CMPMetaDEx& obj : level.second) {
+                    open[obj.getHash()] = obj.getAmountRemaining();
+                }
+            }
+        }
+    }
+    assert(open == legacyOpen);
+}
+
+} // namespace
+
+static void MetaDExLegacyBook(benchmark::State& state)
+{
+    const std::vector<Order> orders = CreateOrderFlow();
+    while (state.KeepRunning()) {
+        LegacyMetaDEx legacy;
+        for (const Order& order : orders) {
+            legacy.Add(order);
+        }
+    }
+}
+
+static void MetaDExPairBooks(benchmark::State& state)
+{
+    const std::vector<Order> orders = CreateOrderFlow();
+    const fs::path pathTradeList = fs::temp_directory_path() / fs::unique_path();
+    {
+        BenchTradeList tradeList(pathTradeList);
+        LOCK(cs_tally);
+        pDbTradeList = &tradeList;
+
+        LegacyMetaDEx legacy;
+        for (const Order& order : orders) {
+            legacy.Add(order);
+        }
+        ResetOmniState();
+        ReplayOrderFlow(orders);
+        CheckSameTrades(legacy, tradeList);
+
+        while (state.KeepRunning()) {
+            ResetOmniState();
+            ReplayOrderFlow(orders);
+        }
+
+        metadex.clear();
+        clear_tally_map();
+        pDbTradeList = nullptr;
+    }
+    fs::remove_all(pathTradeList);
+}
+
+BENCHMARK(MetaDExLegacyBook, 5);
+BENCHMARK(MetaDExPairBooks, 5);
@@ -0,0 +1,47 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chainparams.h>
+#include <subsidy_utils.h>
+
+#include <cassert>
+
+// The total supply before the height which is used to calculate the mining requirement on mainnet
+static constexpr int SUPPLY_HEIGHT = 950000;
+
+static CAmount GetTotalSupplyBeforeHeightByLoop(int nHeight, Consensus::Params const& params)
+{
+    CAmount totalReward{0};
+    for (int i = 0; i < nHeight; ++i) {
+        totalReward += GetBlockSubsidy(i, params);
+    }
+    return totalReward;
+}
+
+static void TotalSupplyLoop(benchmark::State& state)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    auto const& params = chainParams->GetConsensus();
+    while (state.KeepRunning()) {
+        CAmount nTotal = GetTotalSupplyBeforeHeightByLoop(SUPPLY_HEIGHT, params);
+        assert(nTotal > 0);
+    }
+}
+
+static void TotalSupplySegments(benchmark::State& state)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    auto const& params = chainParams->GetConsensus();
+    // Both ways must give the same result
+    assert(GetTotalSupplyBeforeHeight(SUPPLY_HEIGHT, params) == GetTotalSupplyBeforeHeightByLoop(SUPPLY_HEIGHT, params));
+    while (state.KeepRunning()) {
+        CAmount nTotal = GetTotalSupplyBeforeHeight(SUPPLY_HEIGHT, params);
+        assert(nTotal > 0);
+    }
+}
+
+BENCHMARK(TotalSupplyLoop, 10);
+BENCHMARK(TotalSupplySegments, 10 * 1000 * 1000);
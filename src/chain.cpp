@@ -155,11 +155,9 @@ CBlockIndex* CBlockIndex::GetAncestor(int height)
     return const_cast<CBlockIndex*>(static_cast<const CBlockIndex*>(this)->GetAncestor(height));
 }
 
-void CBlockIndex::Update(const Consensus::Params& params)
+uint256 CalculateNextGenerationSignature(int nHeight, const uint256& generationSignature, const uint256& hashMerkleRoot, uint64_t nPlotterId, const Consensus::Params& params)
 {
-    // Genearation signature
-    static uint256 dummyGenerationSignature;
-    generationSignature = pprev ? &pprev->nextGenerationSignature : &dummyGenerationSignature;
+    uint256 nextGenerationSignature;
     if (nHeight + 1 <= params.BHDIP001PreMiningEndHeight) {
         //! Pre-Mining not exist generation signature
         nextGenerationSignature.SetNull();
@@ -173,13 +171,22 @@ void CBlockIndex::Update(const Consensus::Params& params)
             .Finalize(nextGenerationSignature.begin());
     } else if (nHeight + 1 < params.BHDIP009Height) {
         //! generationSignature + nPlotterId
-        assert(generationSignature != nullptr && !generationSignature->IsNull());
+        assert(!generationSignature.IsNull());
         uint64_t plotterId = htobe64(nPlotterId);
         CShabal256()
-            .Write(generationSignature->begin(), generationSignature->size())
+            .Write(generationSignature.begin(), generationSignature.size())
             .Write((const unsigned char*)&plotterId, 8)
             .Finalize(nextGenerationSignature.begin());
     }
+    return nextGenerationSignature;
+}
+
+void CBlockIndex::Update(const Consensus::Params& params)
+{
+    // Genearation signature
+    static uint256 dummyGenerationSignature;
+    generationSignature = pprev ? &pprev->nextGenerationSignature : &dummyGenerationSignature;
+    nextGenerationSignature = CalculateNextGenerationSignature(nHeight, *generationSignature, hashMerkleRoot, nPlotterId, params);
 
     // Generator
     if (!vchPubKey.empty())
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_CHAIN_H
 #define BITCOIN_CHAIN_H
 
+#include <amount.h>
 #include <arith_uint256.h>
 #include <consensus/params.h>
 #include <flatfile.h>
@@ -202,6 +203,19 @@ public:
     //! (memory only) Maximum nTime in the chain up to and including this block.
     unsigned int nTimeMax;
 
+    //! (memory only) Accumulated subsidy of the unconditional blocks ending at and including this block.
+    //! Zero when this block is not unconditional. Only valid after BHDIP008
+    CAmount nAccumulateSubsidy;
+
+    //! (memory only) Sum of the chia difficulties of the blocks in the difficulty evaluation window ending at this block
+    arith_uint256 nChiaDifficultySum;
+
+    //! (memory only) Sum of the network spaces of the blocks in the difficulty evaluation window ending at this block
+    arith_uint256 nChiaNetspaceSum;
+
+    //! (memory only) Number of the blocks counted by the window sums, -1 when the sums are not calculated
+    int nChiaWindowBlocks;
+
     //! (memory only) Generation signature. Reference previous nextGenerationSignature.
     uint256 *generationSignature;
 
@@ -227,6 +241,10 @@ public:
         generatorAccountID.SetNull();
         nSequenceId = 0;
         nTimeMax = 0;
+        nAccumulateSubsidy = 0;
+        nChiaDifficultySum = 0;
+        nChiaNetspaceSum = 0;
+        nChiaWindowBlocks = -1;
         generationSignature = nullptr;
         nextGenerationSignature.SetNull();
 
@@ -401,6 +419,8 @@ arith_uint256 GetBlockWork(const CBlockIndex& block);
 int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& from, const CBlockIndex& tip, const Consensus::Params&);
 /** Find the forking point between two chain tips. */
 const CBlockIndex* LastCommonAncestor(const CBlockIndex* pa, const CBlockIndex* pb);
+/** Calculate the generation signature for the next block of the block at nHeight, it is used by the PoC before BHDIP009. */
+uint256 CalculateNextGenerationSignature(int nHeight, const uint256& generationSignature, const uint256& hashMerkleRoot, uint64_t nPlotterId, const Consensus::Params& params);
 
 
 /** Used to marshal pointers into hashes for db storage. */
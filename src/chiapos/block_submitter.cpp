@@ -0,0 +1,326 @@
+#include "block_submitter.h"
+
+#include <chain.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <key_io.h>
+#include <logging.h>
+#include <miner.h>
+#include <primitives/block.h>
+#include <rpc/protocol.h>
+#include <rpc/request.h>
+#include <tinyformat.h>
+#include <txmempool.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <util/validation.h>
+#include <validation.h>
+
+#include <chiapos/kernel/bls_key.h>
+#include <chiapos/kernel/utils.h>
+#include <chiapos/plotter_id.h>
+#include <chiapos/post.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace chiapos {
+
+std::unique_ptr<CBlockSubmitter> g_block_submitter;
+
+CBlockSubmitter::CBlockSubmitter(int nThreads) : m_nThreads(std::max(1, std::min(nThreads, MAX_SUBMIT_PROOF_THREADS))) {}
+
+CBlockSubmitter::~CBlockSubmitter() { Stop(); }
+
+void CBlockSubmitter::Start() {
+    assert(m_threads.empty());
+    {
+        LOCK(m_cs);
+        m_fRunning = true;
+    }
+    for (int i = 0; i < m_nThreads; ++i) {
+        m_threads.emplace_back(&TraceThread<std::function<void()>>, "submitproof",
+                               std::function<void()>(std::bind(&CBlockSubmitter::ThreadVerify, this)));
+    }
+    LogPrintf("Block submitter started with %d threads\n", m_nThreads);
+}
+
+void CBlockSubmitter::Stop() {
+    if (m_threads.empty()) {
+        return;
+    }
+    {
+        LOCK(m_cs);
+        m_fRunning = false;
+    }
+    m_cond.notify_all();
+    // The workers leave after the queued verifications are done, no submission waits for them forever
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+    LogPrintf("Block submitter stopped\n");
+}
+
+bool CBlockSubmitter::Submit(SubmitProofRequest const& req, CChainParams const& params, SubmitProofTimes& times) {
+    int64_t nTimeStart = GetTimeMicros();
+    int nTargetHeight = req.nHeightOfPrevBlock + 1;
+    Consensus::Params const& consensusParams = params.GetConsensus();
+
+    Verification pos, vdf;
+    pos.check = [&req, &consensusParams, nTargetHeight](std::string& strReason) {
+        CValidationState state;
+        if (!CheckPosProof(req.posProof, state, consensusParams, nTargetHeight)) {
+            strReason = FormatStateMessage(state);
+            return false;
+        }
+        return true;
+    };
+    vdf.check = [&req](std::string& strReason) {
+        CValidationState state;
+        if (!CheckVdfProof(req.vdfProof, state)) {
+            strReason = state.IsValid() ? "cannot verify the vdf proof" : FormatStateMessage(state);
+            return false;
+        }
+        return true;
+    };
+    bool fQueued{false};
+    {
+        LOCK(m_cs);
+        ++m_nSubmitted;
+        if (m_fRunning) {
+            m_queue.push_back(&pos);
+            m_queue.push_back(&vdf);
+            fQueued = true;
+        }
+    }
+    if (fQueued) {
+        m_cond.notify_all();
+    } else {
+        RunVerification(pos);
+        RunVerification(vdf);
+        pos.fDone = vdf.fDone = true;
+    }
+
+    // Select the transactions for the block while the proofs are verified, the candidate is kept for the assembling
+    int64_t nTimeSelect = GetTimeMicros();
+    bool fFound{false};
+    try {
+        LOCK(cs_main);
+        CBlockIndex const* pindexPrev = LookupBlockIndex(req.hashPrevBlock);
+        fFound = pindexPrev != nullptr;
+        if (fFound && pindexPrev == ::ChainActive().Tip() && IsTheChainReadyForChiapos(pindexPrev, consensusParams)) {
+            GetChiaBlockCandidate(params, pindexPrev);
+        }
+    } catch (std::exception const& e) {
+        // The transactions will be selected again when the block is constructed
+        LogPrintf("%s: cannot select the transactions, %s\n", __func__, e.what());
+    }
+    int64_t nTimeWait = GetTimeMicros();
+    times.nSelectMicros = nTimeWait - nTimeSelect;
+
+    // The verifications refer to the objects on the stack, always wait for them before leaving
+    {
+        WAIT_LOCK(m_cs, lock);
+        m_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_cs) { return pos.fDone && vdf.fDone; });
+    }
+    int64_t nTimeAssemble = GetTimeMicros();
+    times.nWaitMicros = nTimeAssemble - nTimeWait;
+    times.nVerifyMicros = std::max(pos.nMicros, vdf.nMicros);
+
+    if (!fFound) {
+        LogPrintf("%s: cannot find block by hash: %s, the proof will not be submitted\n", __func__,
+                  req.hashPrevBlock.GetHex());
+        times.nTotalMicros = GetTimeMicros() - nTimeStart;
+        UpdateStats(times, false);
+        return false;
+    }
+
+    std::shared_ptr<CBlock> pblock;
+    try {
+        if (!pos.fValid) {
+            throw std::runtime_error(strprintf("invalid proof of space, %s", pos.strReason));
+        }
+        if (!vdf.fValid) {
+            throw std::runtime_error(strprintf("invalid vdf proof, %s", vdf.strReason));
+        }
+        pblock = AssembleBlock(req, params);
+    } catch (...) {
+        times.nAssembleMicros = GetTimeMicros() - nTimeAssemble;
+        times.nTotalMicros = GetTimeMicros() - nTimeStart;
+        UpdateStats(times, false);
+        throw;
+    }
+    int64_t nTimeRelease = GetTimeMicros();
+    times.nAssembleMicros = nTimeRelease - nTimeAssemble;
+
+    bool fReleased = ReleaseBlock(pblock, params);
+    int64_t nTimeEnd = GetTimeMicros();
+    times.nReleaseMicros = nTimeEnd - nTimeRelease;
+    times.nTotalMicros = nTimeEnd - nTimeStart;
+    UpdateStats(times, fReleased);
+
+    LogPrint(BCLog::BENCH,
+             "%s: block %s, verify: %.2fms, select: %.2fms, wait: %.2fms, assemble: %.2fms, release: %.2fms (total %.2fms)\n",
+             __func__, pblock->GetHash().GetHex(), 0.001 * times.nVerifyMicros, 0.001 * times.nSelectMicros,
+             0.001 * times.nWaitMicros, 0.001 * times.nAssembleMicros, 0.001 * times.nReleaseMicros,
+             0.001 * times.nTotalMicros);
+    return true;
+}
+
+SubmitProofStats CBlockSubmitter::GetStats() const {
+    LOCK(m_cs);
+    SubmitProofStats stats;
+    stats.nThreads = m_nThreads;
+    stats.nSubmitted = m_nSubmitted;
+    stats.nReleased = m_nReleased;
+    stats.nFailed = m_nFailed;
+    stats.last = m_last;
+    stats.max = m_max;
+    stats.total = m_total;
+    return stats;
+}
+
+void CBlockSubmitter::ThreadVerify() {
+    while (true) {
+        Verification* pverification;
+        {
+            WAIT_LOCK(m_cs, lock);
+            m_cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_cs) { return !m_fRunning || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            pverification = m_queue.front();
+            m_queue.pop_front();
+        }
+        RunVerification(*pverification);
+        {
+            LOCK(m_cs);
+            pverification->fDone = true;
+        }
+        m_cond.notify_all();
+    }
+}
+
+void CBlockSubmitter::RunVerification(Verification& verification) {
+    int64_t nTimeStart = GetTimeMicros();
+    std::string strReason;
+    bool fValid{false};
+    try {
+        fValid = verification.check(strReason);
+    } catch (std::exception const& e) {
+        strReason = e.what();
+    }
+    verification.fValid = fValid;
+    verification.strReason = strReason;
+    verification.nMicros = GetTimeMicros() - nTimeStart;
+}
+
+std::shared_ptr<CBlock> CBlockSubmitter::AssembleBlock(SubmitProofRequest const& req, CChainParams const& params) {
+    CKey farmerSk(MakeArray<SK_LEN>(req.vchFarmerSk));
+    Consensus::Params const& consensusParams = params.GetConsensus();
+
+    LOCK(cs_main);
+
+    CBlockIndex const* pindexPrev = LookupBlockIndex(req.hashPrevBlock);  // The previous block for the new block
+    if (pindexPrev == nullptr) {
+        throw std::runtime_error("Cannot find the block index");
+    }
+    if (pindexPrev->nHeight != req.nHeightOfPrevBlock) {
+        throw std::runtime_error("Invalid height number of the previous block");
+    }
+
+    if (!IsTheChainReadyForChiapos(pindexPrev, consensusParams)) {
+        LogPrintf("%s error: The chain is not ready for chiapos.\n", __func__);
+        throw std::runtime_error("chiapos is not ready");
+    }
+
+    CBlockIndex* pindexCurr = ::ChainActive().Tip();
+    if (pindexPrev->GetBlockHash() != pindexCurr->GetBlockHash()) {
+        // The chain has changed during the proofs generation, we need to ensure:
+        // 1. The new block is able to connect to the pevious block
+        // 2. The difficulty of the new proofs should be larger than the last block's difficulty on the chain
+
+        if (pindexCurr->pprev->GetBlockHash() != pindexPrev->GetBlockHash()) {
+            // It seems the new block is not be able to connect to previous block
+            LogPrintf("%s(drop proofs): it's not able to find the previous block of the new proofs\n", __func__);
+            throw std::runtime_error("invalid new proofs, the chain has been changed and it is not able to accept it");
+        }
+
+        int nTargetHeight = pindexPrev->nHeight + 1;
+        uint64_t nDifficulty = AdjustDifficulty(
+                GetChiaBlockDifficulty(pindexPrev, consensusParams), static_cast<int64_t>(req.vdfProof.nVdfDuration),
+                GetAdjustTargetSpacing(nTargetHeight, consensusParams),
+                QueryDurationFix(nTargetHeight, consensusParams.BHDIP009TargetDurationFixes),
+                GetDifficultyChangeMaxFactor(nTargetHeight, consensusParams), consensusParams.BHDIP009StartDifficulty,
+                GetTargetMulFactor(nTargetHeight, consensusParams));
+        if (nDifficulty < pindexCurr->chiaposFields.nDifficulty) {
+            // The quality is too low, and it will not be accepted by the chain
+            throw std::runtime_error("the quality is too low, the new block will not be accepted by the chain");
+        }
+
+        // We reset the chain states to previous block and try to release the new one after
+        {
+            CValidationState state;
+            LOCK(mempool.cs);
+            ::ChainstateActive().DisconnectTip(state, params, nullptr);
+        }
+
+        LogPrintf("%s: the chain is reset to previous block in order to release a new block\n", __func__);
+    }
+
+    // Check bind
+    const CAccountID accountID = ExtractAccountID(req.rewardDest);
+    if (accountID.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid DePINC address");
+    }
+    bool fFundAccount{false};
+    for (auto const& fundAddr : consensusParams.BHDIP009FundAddresses) {
+        auto fundAccountID = ExtractAccountID(DecodeDestination(fundAddr));
+        if (fundAccountID == accountID) {
+            fFundAccount = true;
+            break;
+        }
+    }
+    if (!fFundAccount) {
+        auto vchFarmerPk = MakeBytes(farmerSk.GetPubKey());
+        if (!::ChainstateActive().CoinsTip().HaveActiveBindPlotter(accountID, CPlotterBindData(CChiaFarmerPk(vchFarmerPk)))) {
+            throw JSONRPCError(
+                    RPC_INVALID_REQUEST,
+                    strprintf("%s with %s not active bind", BytesToHex(vchFarmerPk), EncodeDestination(req.rewardDest)));
+        }
+    }
+
+    // The transactions are taken from the candidate pre-built for the tip, only the coinbase and signature are made here
+    std::unique_ptr<CBlockTemplate> ptemplate =
+            BlockAssembler(params).CreateNewChiaBlock(pindexPrev, GetScriptForDestination(req.rewardDest), farmerSk,
+                                                      req.posProof, req.vdfProof);
+    if (ptemplate == nullptr) {
+        throw std::runtime_error("cannot generate new block, the template object is null");
+    }
+    return std::make_shared<CBlock>(ptemplate->block);
+}
+
+void CBlockSubmitter::UpdateStats(SubmitProofTimes const& times, bool fReleased) {
+    LOCK(m_cs);
+    m_last = times;
+    if (!fReleased) {
+        ++m_nFailed;
+        return;
+    }
+    ++m_nReleased;
+    m_max.nVerifyMicros = std::max(m_max.nVerifyMicros, times.nVerifyMicros);
+    m_max.nSelectMicros = std::max(m_max.nSelectMicros, times.nSelectMicros);
+    m_max.nWaitMicros = std::max(m_max.nWaitMicros, times.nWaitMicros);
+    m_max.nAssembleMicros = std::max(m_max.nAssembleMicros, times.nAssembleMicros);
+    m_max.nReleaseMicros = std::max(m_max.nReleaseMicros, times.nReleaseMicros);
+    m_max.nTotalMicros = std::max(m_max.nTotalMicros, times.nTotalMicros);
+    m_total.nVerifyMicros += times.nVerifyMicros;
+    m_total.nSelectMicros += times.nSelectMicros;
+    m_total.nWaitMicros += times.nWaitMicros;
+    m_total.nAssembleMicros += times.nAssembleMicros;
+    m_total.nReleaseMicros += times.nReleaseMicros;
+    m_total.nTotalMicros += times.nTotalMicros;
+}
+
+}  // namespace chiapos
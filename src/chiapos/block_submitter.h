@@ -0,0 +1,130 @@
+#ifndef DEPINC_CHIAPOS_BLOCK_SUBMITTER_H
+#define DEPINC_CHIAPOS_BLOCK_SUBMITTER_H
+
+#include <script/standard.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <chiapos/block_fields.h>
+#include <chiapos/kernel/chiapos_types.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+class CChainParams;
+
+//! Default for -submitproofthreads, the number of the threads to verify the submitted proofs
+static const int DEFAULT_SUBMIT_PROOF_THREADS = 2;
+//! Maximum number of the threads to verify the submitted proofs
+static const int MAX_SUBMIT_PROOF_THREADS = 16;
+
+namespace chiapos {
+
+struct SubmitProofRequest {
+    uint256 hashPrevBlock;
+    int nHeightOfPrevBlock{0};
+    CTxDestination rewardDest;
+    Bytes vchFarmerSk;
+    CPosProof posProof;
+    CVdfProof vdfProof;
+};
+
+/** Time spent on each stage of a submission in microseconds */
+struct SubmitProofTimes {
+    //! The longest of the PoS and VDF verifications, they run on the workers at the same time
+    int64_t nVerifyMicros{0};
+    //! Getting the transactions for the block, it runs on the calling thread while the proofs are verified
+    int64_t nSelectMicros{0};
+    //! Waiting for the verifications after the transactions are ready
+    int64_t nWaitMicros{0};
+    //! Constructing and signing the block, the time waiting for cs_main is included
+    int64_t nAssembleMicros{0};
+    //! Processing the new block by ProcessNewBlock
+    int64_t nReleaseMicros{0};
+    int64_t nTotalMicros{0};
+};
+
+struct SubmitProofStats {
+    int nThreads;
+    uint64_t nSubmitted;
+    uint64_t nReleased;
+    uint64_t nFailed;
+    SubmitProofTimes last;
+    SubmitProofTimes max;
+    //! The sums of the submissions released
+    SubmitProofTimes total;
+};
+
+/**
+ * Release the new blocks from the submitted proofs in stages. The stateless checks of the PoS and VDF proofs run on the
+ * workers, the transactions of the block are taken from the candidate of the tip at the same time, cs_main is only
+ * held to construct the block, the block is processed by ProcessNewBlock after that. The verified proofs are stored in
+ * the proof cache, so they won't be verified again by TestBlockValidity and ConnectBlock.
+ */
+class CBlockSubmitter {
+public:
+    explicit CBlockSubmitter(int nThreads = DEFAULT_SUBMIT_PROOF_THREADS);
+
+    ~CBlockSubmitter();
+
+    void Start();
+
+    void Stop();
+
+    /**
+     * Verify the proofs, construct the block and release it, the proofs are verified on the calling thread when the
+     * submitter isn't started
+     *
+     * @return false when the previous block cannot be found, std::runtime_error or a JSON-RPC error object is thrown
+     * when the block cannot be constructed
+     */
+    bool Submit(SubmitProofRequest const& req, CChainParams const& params, SubmitProofTimes& times);
+
+    SubmitProofStats GetStats() const;
+
+private:
+    /** A stateless check of the proofs run by the workers */
+    struct Verification {
+        std::function<bool(std::string&)> check;
+        bool fDone{false};
+        bool fValid{false};
+        std::string strReason;
+        int64_t nMicros{0};
+    };
+
+    void ThreadVerify();
+
+    static void RunVerification(Verification& verification);
+
+    std::shared_ptr<CBlock> AssembleBlock(SubmitProofRequest const& req, CChainParams const& params);
+
+    void UpdateStats(SubmitProofTimes const& times, bool fReleased);
+
+    int const m_nThreads;
+    std::vector<std::thread> m_threads;
+
+    mutable Mutex m_cs;
+    std::condition_variable m_cond;
+    bool m_fRunning GUARDED_BY(m_cs){false};
+    std::deque<Verification*> m_queue GUARDED_BY(m_cs);
+    uint64_t m_nSubmitted GUARDED_BY(m_cs){0};
+    uint64_t m_nReleased GUARDED_BY(m_cs){0};
+    uint64_t m_nFailed GUARDED_BY(m_cs){0};
+    SubmitProofTimes m_last GUARDED_BY(m_cs);
+    SubmitProofTimes m_max GUARDED_BY(m_cs);
+    SubmitProofTimes m_total GUARDED_BY(m_cs);
+};
+
+extern std::unique_ptr<CBlockSubmitter> g_block_submitter;
+
+}  // namespace chiapos
+
+#endif
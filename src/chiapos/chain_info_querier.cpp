@@ -1,11 +1,15 @@
 
 #include "chain_info_querier.h"
 
+#include <algorithm>
+
 #include <subsidy_utils.h>
 #include <validation.h>
 #include <key_io.h>
+#include <util/validation.h>
 
 #include <chiapos/kernel/calc_diff.h>
+#include <chiapos/mined_block_index.h>
 
 #include <poc/poc.h>
 #include <rpc/protocol.h>
@@ -16,35 +20,39 @@ namespace chiapos {
 
 namespace {
 
-std::vector<PointEntry> enumerate_points(CCoinsViewCursorRef pcursor) {
+PointEntry make_point_entry(COutPoint const& key, Coin const& coin, CBlockIndex const* pindexTip) {
+    assert(key.n == 0);
+    assert(!coin.IsSpent());
+    assert(coin.IsChiaPointRelated());
+    PointEntry entry;
+    entry.type = coin.GetExtraDataType();
+    entry.from = ExtractDestination(coin.out.scriptPubKey);
+    if (coin.IsPointRetarget()) {
+        auto retargetPayload = PointRetargetPayload::As(coin.extraData);
+        entry.to = CTxDestination(ScriptHash(retargetPayload->GetReceiverID()));
+        entry.originalType = retargetPayload->GetPointType();
+        entry.nOriginalHeight = retargetPayload->GetPointHeight();
+    } else {
+        entry.to = CTxDestination(ScriptHash(PointPayload::As(coin.extraData)->GetReceiverID()));
+    }
+    entry.nAmount = coin.out.nValue;
+    entry.txid = key.hash;
+    auto pindex = pindexTip->GetAncestor(coin.nHeight);
+    assert(pindex != nullptr);
+    entry.blockHash = pindex->GetBlockHash();
+    entry.blockTime = pindex->GetBlockTime();
+    entry.nHeight = coin.nHeight;
+    return entry;
+}
+
+std::vector<PointEntry> enumerate_points(CCoinsViewCursorRef pcursor, CBlockIndex const* pindexTip) {
     assert(pcursor != nullptr);
     std::vector<PointEntry> res;
-    int nCount{0};
     for (; pcursor->Valid(); pcursor->Next()) {
         COutPoint key;
         Coin coin;
         if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            assert(key.n == 0);
-            assert(!coin.IsSpent());
-            assert(coin.IsChiaPointRelated());
-            PointEntry entry;
-            entry.type = coin.GetExtraDataType();
-            entry.from = ExtractDestination(coin.out.scriptPubKey);
-            if (coin.IsPointRetarget()) {
-                auto retargetPayload = PointRetargetPayload::As(coin.extraData);
-                entry.to = CTxDestination(ScriptHash(retargetPayload->GetReceiverID()));
-                entry.originalType = retargetPayload->GetPointType();
-                entry.nOriginalHeight = retargetPayload->GetPointHeight();
-            } else {
-                entry.to = CTxDestination(ScriptHash(PointPayload::As(coin.extraData)->GetReceiverID()));
-            }
-            entry.nAmount = coin.out.nValue;
-            entry.txid = key.hash;
-            entry.blockHash = ::ChainActive()[(int)coin.nHeight]->GetBlockHash();
-            entry.blockTime = ::ChainActive()[(int)coin.nHeight]->GetBlockTime();
-            entry.nHeight = coin.nHeight;
-            res.push_back(std::move(entry));
-            ++nCount;
+            res.push_back(make_point_entry(key, coin, pindexTip));
         } else {
             throw std::runtime_error("Unable to read UTXO set");
         }
@@ -58,15 +66,58 @@ ChainInfoQuerier::ChainInfoQuerier(CCoinsViewCache* pviewCache, CCoinsViewDB* pv
                                    Consensus::Params const* pparams)
         : m_pviewCache(pviewCache), m_pviewDB(pviewDB), m_pindex(pindex), m_pparams(pparams) {}
 
+ChainInfoQuerier::ChainInfoQuerier(std::unique_ptr<CCoinsViewDB> snapshotDB, CBlockIndex* pindex, CAmount nAccumulate,
+                                   Consensus::Params const* pparams)
+        : m_snapshotDB(std::move(snapshotDB)),
+          m_snapshotCache(new CCoinsViewCache(m_snapshotDB.get())),
+          m_pviewCache(m_snapshotCache.get()),
+          m_pviewDB(m_snapshotDB.get()),
+          m_pindex(pindex),
+          m_pparams(pparams),
+          m_nSnapshotAccumulate(nAccumulate) {}
+
 ChainInfoQuerier ChainInfoQuerier::CreateQuerier() {
     return ChainInfoQuerier(&::ChainstateActive().CoinsTip(), &::ChainstateActive().CoinsDB(), ::ChainActive().Tip(),
                             &Params().GetConsensus());
 }
 
+ChainInfoQuerier ChainInfoQuerier::CreateSnapshotQuerier() {
+    std::unique_ptr<CCoinsViewDB> snapshotDB;
+    CBlockIndex* pindex;
+    CAmount nAccumulate;
+    {
+        LOCK(cs_main);
+        pindex = ::ChainActive().Tip();
+        CCoinsViewCache const& coinsTip = ::ChainstateActive().CoinsTip();
+        if (coinsTip.GetBestBlock() != pindex->GetBlockHash()) {
+            throw std::runtime_error(tinyformat::format("the coins cache is not at the tip %s, cannot make a snapshot",
+                                                        pindex->GetBlockHash().GetHex()));
+        }
+        // The cache only moves to another block when a block is connected or disconnected, so once the database is at
+        // the tip the cache has nothing dirty and the following queries of the same tip write nothing. Otherwise the
+        // coins modified since the last write go to the database, the cache stays warm.
+        CCoinsViewDB& coinsDB = ::ChainstateActive().CoinsDB();
+        if (coinsDB.GetBestBlock() != pindex->GetBlockHash()) {
+            CValidationState state;
+            if (!::ChainstateActive().FlushStateToDisk(Params(), state, FlushStateMode::SYNC) ||
+                coinsDB.GetBestBlock() != pindex->GetBlockHash()) {
+                throw std::runtime_error(tinyformat::format("cannot write the coins of the tip %s, %s",
+                                                            pindex->GetBlockHash().GetHex(), FormatStateMessage(state)));
+            }
+        }
+        snapshotDB = coinsDB.CreateSnapshot();
+        nAccumulate = GetBlockAccumulateSubsidy(pindex, Params().GetConsensus());
+    }
+    return ChainInfoQuerier(std::move(snapshotDB), pindex, nAccumulate, &Params().GetConsensus());
+}
+
+ChainInfoQuerier ChainInfoQuerier::CreateTipQuerier() {
+    CBlockIndex* pindex = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    return ChainInfoQuerier(nullptr, nullptr, pindex, &Params().GetConsensus());
+}
+
 arith_uint256 ChainInfoQuerier::GetNetSpace() const {
-    return chiapos::CalculateNetworkSpace(GetDifficultyForNextIterations(m_pindex->pprev, *m_pparams),
-                                          m_pindex->chiaposFields.GetTotalIters(),
-                                          m_pparams->BHDIP009DifficultyConstantFactorBits);
+    return chiapos::GetBlockNetworkSpace(m_pindex, *m_pparams);
 }
 
 arith_uint256 ChainInfoQuerier::GetAverageNetSpace() const {
@@ -79,23 +130,31 @@ int ChainInfoQuerier::GetPledgeCalcHeight() const {
     return GetHeightForCalculatingTotalSupply(GetTargetHeight(), *m_pparams);
 }
 
-CAmount ChainInfoQuerier::GetAccumulate() const { return GetBlockAccumulateSubsidy(m_pindex, *m_pparams); }
+CAmount ChainInfoQuerier::GetAccumulate() const {
+    if (IsSnapshot()) {
+        return m_nSnapshotAccumulate;
+    }
+    return GetBlockAccumulateSubsidy(m_pindex, *m_pparams);
+}
 
 CAmount ChainInfoQuerier::GetTotalSupplied() const {
     return GetTotalSupplyBeforeHeight(GetPledgeCalcHeight(), *m_pparams) +
            GetTotalSupplyBeforeBHDIP009(*m_pparams) * (m_pparams->BHDIP009TotalAmountUpgradeMultiply - 1);
 }
 
-CAmount ChainInfoQuerier::GetBurned() const {
+CAmount ChainInfoQuerier::GetBurned() const { return GetBurned(GetPledgeCalcHeight()); }
+
+CAmount ChainInfoQuerier::GetBurned(int nHeight) const {
     return m_pviewCache->GetAccountBalance(false, GetBurnToAccountID(), nullptr, nullptr, nullptr,
-                                           &m_pparams->BHDIP009PledgeTerms, GetPledgeCalcHeight());
+                                           &m_pparams->BHDIP009PledgeTerms, nHeight);
 }
 
 CAmount ChainInfoQuerier::GetMiningRequireBalance(CAccountID accountID, int* pmined, int* pcounted) const {
     CPlotterBindData bindData;
 
-    return poc::GetMiningRequireBalance(accountID, bindData, GetTargetHeight(), m_pviewCache, nullptr, nullptr,
-                                        GetBurned(), *m_pparams, pmined, pcounted, GetPledgeCalcHeight());
+    return poc::GetMiningRequireBalance(accountID, bindData, GetTargetHeight(), *m_pviewCache, nullptr, nullptr,
+                                        GetBurned(), *m_pparams, pmined, pcounted, GetPledgeCalcHeight(),
+                                        IsSnapshot() ? m_pindex : nullptr);
 }
 
 std::vector<CChiaFarmerPk> ChainInfoQuerier::GetBoundFarmerPkList(CAccountID accountID) const {
@@ -108,39 +167,36 @@ std::vector<CChiaFarmerPk> ChainInfoQuerier::GetBoundFarmerPkList(CAccountID acc
 }
 
 std::vector<MinedBlock> ChainInfoQuerier::GetMinedBlockList(std::vector<CChiaFarmerPk> const& fpks) const {
-    auto pcurrIndex = m_pindex;
-    int count{0}, mined{0};
     std::vector<MinedBlock> blks;
-    while (pcurrIndex && pcurrIndex->nHeight >= m_pparams->BHDIP009Height && count < m_pparams->nCapacityEvalWindow) {
-        // check fpk from the block
-        for (auto const& fpk : fpks) {
-            if (fpk.ToBytes() == pcurrIndex->chiaposFields.posProof.vchFarmerPk) {
-                // Now we export the block to UniValue and push it to array
-                MinedBlock block;
-                auto dest = CTxDestination(static_cast<ScriptHash>(pcurrIndex->generatorAccountID));
-                std::string accountIDStr = EncodeDestination(dest);
-                block.nHeight = pcurrIndex->nHeight;
-                block.hash = pcurrIndex->GetBlockHash();
-                block.vchFarmerPubkey = pcurrIndex->chiaposFields.posProof.vchFarmerPk;
-                block.accountID = pcurrIndex->generatorAccountID;
-                blks.push_back(block);
-                break;
-            }
-        }
-        // next
-        pcurrIndex = pcurrIndex->pprev;
-        ++count;
+    int nBeginHeight = std::max(m_pindex->nHeight - m_pparams->nCapacityEvalWindow + 1, m_pparams->BHDIP009Height);
+    if (nBeginHeight > m_pindex->nHeight) {
+        return blks;
+    }
+    std::set<CPlotterBindData> plotters;
+    for (auto const& fpk : fpks) {
+        plotters.insert(CPlotterBindData(fpk));
+    }
+    auto heights = g_mined_block_index.GetMinedHeights(m_pindex, plotters, nBeginHeight, m_pindex->nHeight);
+    // The newest block goes first
+    for (auto it = heights.rbegin(); it != heights.rend(); ++it) {
+        auto pcurrIndex = m_pindex->GetAncestor(*it);
+        MinedBlock block;
+        block.nHeight = pcurrIndex->nHeight;
+        block.hash = pcurrIndex->GetBlockHash();
+        block.vchFarmerPubkey = pcurrIndex->chiaposFields.posProof.vchFarmerPk;
+        block.accountID = pcurrIndex->generatorAccountID;
+        blks.push_back(block);
     }
     return blks;
 }
 
 std::tuple<CAmount, CAmount, PointEntries> ChainInfoQuerier::GetTotalPledgedAmount(CAccountID accountID) const {
     PointEntries entries;
-    auto points = enumerate_points(m_pviewDB->PointReceiveCursor(accountID, PointType::Chia));
-    auto pointT1s = enumerate_points(m_pviewDB->PointReceiveCursor(accountID, PointType::ChiaT1));
-    auto pointT2s = enumerate_points(m_pviewDB->PointReceiveCursor(accountID, PointType::ChiaT2));
-    auto pointT3s = enumerate_points(m_pviewDB->PointReceiveCursor(accountID, PointType::ChiaT3));
-    auto pointRTs = enumerate_points(m_pviewDB->PointReceiveCursor(accountID, PointType::ChiaRT));
+    auto points = enumerate_points(m_pviewDB->PointReceiveCursor(accountID, PointType::Chia), m_pindex);
+    auto pointT1s = enumerate_points(m_pviewDB->PointReceiveCursor(accountID, PointType::ChiaT1), m_pindex);
+    auto pointT2s = enumerate_points(m_pviewDB->PointReceiveCursor(accountID, PointType::ChiaT2), m_pindex);
+    auto pointT3s = enumerate_points(m_pviewDB->PointReceiveCursor(accountID, PointType::ChiaT3), m_pindex);
+    auto pointRTs = enumerate_points(m_pviewDB->PointReceiveCursor(accountID, PointType::ChiaRT), m_pindex);
 
     CAmount nPointsTotalAmount{0}, nPointsTotalT1Amount{0}, nPointsTotalT2Amount{0}, nPointsTotalT3Amount{0},
             nPointsTotalRTAmount{0};
@@ -7,6 +7,8 @@
 #include <coins.h>
 #include <txdb.h>
 
+#include <memory>
+
 #include <primitives/transaction.h>
 #include <consensus/params.h>
 
@@ -52,17 +54,49 @@ struct PointEntriesWithAmounts {
 using PointEntries = std::map<DatacarrierType, PointEntriesWithAmounts>;
 
 class ChainInfoQuerier {
+    //! The coins database and the cache on it pinned by a snapshot, both are null when the querier reads the live tip
+    std::unique_ptr<CCoinsViewDB> m_snapshotDB;
+    std::unique_ptr<CCoinsViewCache> m_snapshotCache;
     CCoinsViewCache* m_pviewCache;
     CCoinsViewDB* m_pviewDB;
     CBlockIndex* m_pindex;
     Consensus::Params const* m_pparams;
+    //! The accumulated subsidy of the tip, it is captured with the snapshot because it is updated on connecting blocks
+    CAmount m_nSnapshotAccumulate{0};
 
     ChainInfoQuerier(CCoinsViewCache* pviewCache, CCoinsViewDB* pviewDB, CBlockIndex* pindex,
                      Consensus::Params const* pparams);
 
+    ChainInfoQuerier(std::unique_ptr<CCoinsViewDB> snapshotDB, CBlockIndex* pindex, CAmount nAccumulate,
+                     Consensus::Params const* pparams);
+
 public:
+    /**
+     * Create a querier that reads the live coins views and the active tip, cs_main must be held while it is in use
+     */
     NODISCARD static ChainInfoQuerier CreateQuerier();
 
+    /**
+     * Create a querier pinned to a snapshot of the coins database and the active tip, cs_main is only taken while the
+     * coins modified since the last write are synced to the database and the snapshot is made. The tip cache keeps
+     * its coins and nothing is copied, the first query after a new block writes that block's coins and the others
+     * write nothing. The querier never sees the blocks connected afterwards, so it can run without holding cs_main
+     * and without stalling validation.
+     */
+    NODISCARD static ChainInfoQuerier CreateSnapshotQuerier();
+
+    /**
+     * Create a querier that only reads the block index from the active tip, it has no coins views. The block index
+     * never changes below the tip, so it can be used without holding cs_main.
+     */
+    NODISCARD static ChainInfoQuerier CreateTipQuerier();
+
+    NODISCARD bool IsSnapshot() const { return m_snapshotDB != nullptr; }
+
+    NODISCARD CBlockIndex const* GetTip() const { return m_pindex; }
+
+    NODISCARD CCoinsViewCache const& GetCoinsView() const { return *m_pviewCache; }
+
     NODISCARD arith_uint256 GetNetSpace() const;
 
     NODISCARD arith_uint256 GetAverageNetSpace() const;
@@ -77,6 +111,8 @@ public:
 
     NODISCARD CAmount GetBurned() const;
 
+    NODISCARD CAmount GetBurned(int nHeight) const;
+
     NODISCARD CAmount GetMiningRequireBalance(CAccountID accountID, int* pmined = nullptr,
                                               int* pcounted = nullptr) const;
 
@@ -9,6 +9,7 @@
 #include <validation.h>
 #include <subsidy_utils.h>
 #include <core_io.h>
+#include <index/pledgeindex.h>
 #include <util/moneystr.h>
 
 #include <cstdint>
@@ -31,7 +32,12 @@
 #include <uint256.h>
 #include <updatetip_log_helper.hpp>
 #include <logging.h>
+#include <chiapos/block_submitter.h>
+#include <chiapos/harvester.h>
+#include <chiapos/mined_block_index.h>
 #include <chiapos/mortgage_calculator.h>
+#include <chiapos/proof_cache.h>
+#include <chiapos/vdf_store.h>
 
 #include <poc/poc.h>
 
@@ -46,6 +52,9 @@
 
 extern std::unique_ptr<CConnman> g_connman;
 
+//! Default time in milliseconds querychallenge waits for a new challenge
+static const int64_t DEFAULT_CHALLENGE_LONGPOLL_TIMEOUT = 60000;
+
 namespace chiapos {
 
 namespace utils {
@@ -81,15 +90,55 @@ static UniValue checkChiapos(JSONRPCRequest const& request) {
 }
 
 static UniValue queryChallenge(JSONRPCRequest const& request) {
-    RPCHelpMan("querychallenge", "Query next challenge for PoST", {},
-               RPCResult{"\"challenge\" (hex) the challenge in hex string"},
-               RPCExamples{HelpExampleCli("querychallenge", "")})
+    RPCHelpMan("querychallenge", "Query next challenge for PoST, wait for the next one when the last challenge is given",
+               {
+                   {"last_challenge", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "Wait until the challenge is different from it"},
+                   {"timeout", RPCArg::Type::NUM, /* default */ strprintf("%d", DEFAULT_CHALLENGE_LONGPOLL_TIMEOUT), "Time in milliseconds to wait for, the current challenge is returned on timeout"},
+               },
+               RPCResult{"\"challenge\" (hex) the challenge in hex string, \"changed\" (bool) whether it is different from the last challenge"},
+               RPCExamples{HelpExampleCli("querychallenge", "") + HelpExampleCli("querychallenge", "\"last_challenge\" 30000")})
             .Check(request);
 
+    uint256 lastChallenge;
+    if (!request.params[0].isNull()) {
+        lastChallenge = ParseHashV(request.params[0], "last_challenge");
+    }
+    int64_t nTimeout = request.params[1].isNull() ? DEFAULT_CHALLENGE_LONGPOLL_TIMEOUT : request.params[1].get_int64();
+    if (nTimeout < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "timeout cannot be negative");
+    }
+    Consensus::Params const& params = Params().GetConsensus();
+    if (g_chia_candidate_builder) {
+        // A farmer is here, keep the transactions of the next block ready for its proofs
+        g_chia_candidate_builder->StartOnDemand();
+    }
+
+    if (!lastChallenge.IsNull()) {
+        // Wait for a new tip without holding cs_main, the challenge of the next block changes with the tip
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeout);
+        while (true) {
+            uint256 hashWatched;
+            {
+                LOCK(cs_main);
+                CBlockIndex const* pindexTip = ChainActive().Tip();
+                if (pindexTip->nHeight + 1 < params.BHDIP009Height || MakeChallenge(pindexTip, params) != lastChallenge) {
+                    break;
+                }
+                hashWatched = pindexTip->GetBlockHash();
+            }
+            bool fChanged = WaitForBestBlockChange(hashWatched, deadline, [] { return IsRPCRunning(); });
+            if (!IsRPCRunning()) {
+                throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Shutting down");
+            }
+            if (!fChanged) {
+                break;
+            }
+        }
+    }
+
     LOCK(cs_main);
 
     CBlockIndex const* pindexPrev = ChainActive().Tip();
-    Consensus::Params const& params = Params().GetConsensus();
 
     if (!IsTheChainReadyForChiapos(pindexPrev, params)) {
         throw std::runtime_error("chiapos is not ready");
@@ -113,6 +162,7 @@ static UniValue queryChallenge(JSONRPCRequest const& request) {
         res.pushKV("prev_vdf_duration", pindexPrev->chiaposFields.vdfProof.nVdfDuration);
     }
     assert(!challenge.IsNull());
+    res.pushKV("changed", challenge != lastChallenge);
     res.pushKV("prev_block_hash", pindexPrev->GetBlockHash().GetHex());
     res.pushKV("prev_block_height", pindexPrev->nHeight);
     res.pushKV("prev_block_time", pindexPrev->GetBlockTime());
@@ -125,7 +175,7 @@ static UniValue queryChallenge(JSONRPCRequest const& request) {
 
     // vdf requests
     UniValue vdf_reqs(UniValue::VARR);
-    auto iters_vec = QueryLocalVdfRequests(challenge);
+    auto iters_vec = g_vdf_store.QueryRequests(challenge);
     for (auto iters : iters_vec) {
         if (iters >= nBaseIters) {
             vdf_reqs.push_back(iters);
@@ -134,7 +184,7 @@ static UniValue queryChallenge(JSONRPCRequest const& request) {
     res.pushKV("vdf_reqs", vdf_reqs);
 
     // vdf proofs
-    auto vVdfProofs = QueryLocalVdfProof(challenge);
+    auto vVdfProofs = g_vdf_store.QueryProofs(challenge);
     UniValue vdf_proofs(UniValue::VARR);
     for (auto const& vdfProof : vVdfProofs) {
         UniValue vdf_proof(UniValue::VOBJ);
@@ -167,8 +217,7 @@ static UniValue submitVdfRequest(JSONRPCRequest const& request) {
         throw std::runtime_error(tinyformat::format("%s: invalid iters=(%d)", __func__, nIters));
     }
 
-    LOCK(cs_main);
-    AddLocalVdfRequest(challenge, nIters);
+    g_vdf_store.AddRequest(challenge, nIters);
 
     // send the request to P2P network
     g_connman->ForEachNode(
@@ -183,6 +232,31 @@ static UniValue submitVdfRequest(JSONRPCRequest const& request) {
     return true;
 }
 
+static UniValue queryVdfStoreInfo(JSONRPCRequest const& request) {
+    RPCHelpMan("queryvdfstoreinfo", "Query the statistics of the local store of VDF requests and proofs", {},
+               RPCResult{"{\n"
+                         "  \"challenges\": n,        (numeric) The number of the challenges in the store\n"
+                         "  \"requests\": n,          (numeric) The number of the VDF requests\n"
+                         "  \"proofs\": n,            (numeric) The number of the VDF proofs\n"
+                         "  \"usage\": n,             (numeric) Total memory usage for the store\n"
+                         "  \"tip_height\": n,        (numeric) The height of the tip the store has seen\n"
+                         "  \"max_depth\": n          (numeric) The challenges older than the depth are dropped\n"
+                         "}\n"},
+               RPCExamples{HelpExampleCli("queryvdfstoreinfo", "")})
+            .Check(request);
+
+    VdfStoreStats stats = g_vdf_store.GetStats();
+
+    UniValue res(UniValue::VOBJ);
+    res.pushKV("challenges", stats.nChallenges);
+    res.pushKV("requests", stats.nRequests);
+    res.pushKV("proofs", stats.nProofs);
+    res.pushKV("usage", stats.nMemoryUsage);
+    res.pushKV("tip_height", stats.nTipHeight);
+    res.pushKV("max_depth", stats.nMaxDepth);
+    return res;
+}
+
 static UniValue submitVdfProof(JSONRPCRequest const& request) {
     RPCHelpMan("submitvdfproof", "Submit vdf proof to P2P network", {
         {"challenge", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The challenge of the vdf proof"},
@@ -213,10 +287,8 @@ static UniValue submitVdfProof(JSONRPCRequest const& request) {
         throw std::runtime_error(tinyformat::format("%s: the vdf proof (challenge=%s, proof=%s) is invalid", __func__, vdfProof.challenge.GetHex(), BytesToHex(vdfProof.vchProof)));
     }
 
-    LOCK(cs_main);
-
     // save the proof
-    if (!AddLocalVdfProof(vdfProof)) {
+    if (!g_vdf_store.AddProof(vdfProof)) {
         LogPrint(BCLog::POC, "%s: warning - proof (challenge=%s, iters=%ld) does exist in local\n", __func__, vdfProof.challenge.GetHex(), vdfProof.nVdfIters);
     }
 
@@ -242,97 +314,6 @@ CVdfProof ParseVdfProof(UniValue const& val) {
     return proof;
 }
 
-void GenerateChiaBlock(uint256 const& hashPrevBlock, int nHeightOfPrevBlock, CTxDestination const& rewardDest,
-                       uint256 const& initialChallenge, chiapos::Bytes const& vchFarmerSk, CPosProof const& posProof,
-                       CVdfProof const& vdfProof, uint64_t nDifficulty) {
-    CKey farmerSk(MakeArray<SK_LEN>(vchFarmerSk));
-    auto params = Params();
-    std::shared_ptr<CBlock> pblock;
-    {
-        LOCK(cs_main);
-
-        CBlockIndex const* pindexPrev = LookupBlockIndex(hashPrevBlock);  // The previous block for the new block
-        if (pindexPrev == nullptr) {
-            throw std::runtime_error("Cannot find the block index");
-        }
-        if (pindexPrev->nHeight != nHeightOfPrevBlock) {
-            throw std::runtime_error("Invalid height number of the previous block");
-        }
-
-        if (!IsTheChainReadyForChiapos(pindexPrev, params.GetConsensus())) {
-            LogPrintf("%s error: The chain is not ready for chiapos.\n", __func__);
-            throw std::runtime_error("chiapos is not ready");
-        }
-
-        CBlockIndex* pindexCurr = ::ChainActive().Tip();
-        if (pindexPrev->GetBlockHash() != pindexCurr->GetBlockHash()) {
-            // The chain has changed during the proofs generation, we need to ensure:
-            // 1. The new block is able to connect to the pevious block
-            // 2. The difficulty of the new proofs should be larger than the last block's difficulty on the chain
-
-            if (pindexCurr->pprev->GetBlockHash() != pindexPrev->GetBlockHash()) {
-                // It seems the new block is not be able to connect to previous block
-                LogPrintf("%s(drop proofs): it's not able to find the previous block of the new proofs\n", __func__);
-                throw std::runtime_error(
-                        "invalid new proofs, the chain has been changed and it is not able to accept it");
-            }
-
-            // Quality for the block we are going to generate
-            uint256 mixed_quality_string = GenerateMixedQualityString(posProof);
-            uint64_t nDuration = vdfProof.nVdfDuration;
-            if (nDifficulty < pindexCurr->chiaposFields.nDifficulty) {
-                // The quality is too low, and it will not be accepted by the chain
-                throw std::runtime_error("the quality is too low, the new block will not be accepted by the chain");
-            }
-
-            // We reset the chain states to previous block and try to release the new one after
-            {
-                CValidationState state;
-                LOCK(mempool.cs);
-                ::ChainstateActive().DisconnectTip(state, params, nullptr);
-            }
-
-            LogPrintf("%s: the chain is reset to previous block in order to release a new block\n", __func__);
-        }
-
-        // Check bind
-        const CAccountID accountID = ExtractAccountID(rewardDest);
-        if (accountID.IsNull()) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid DePINC address");
-        }
-        bool fFundAccount { false };
-        for (auto const& fundAddr : params.GetConsensus().BHDIP009FundAddresses) {
-            auto fundAccountID = ExtractAccountID(DecodeDestination(fundAddr));
-            if (fundAccountID == accountID) {
-                fFundAccount = true;
-                break;
-            }
-        }
-        if (!fFundAccount) {
-            auto vchFarmerPk = MakeBytes(farmerSk.GetPubKey());
-            if (!::ChainstateActive().CoinsTip().HaveActiveBindPlotter(accountID, CPlotterBindData(CChiaFarmerPk(vchFarmerPk)))) {
-                throw JSONRPCError(RPC_INVALID_REQUEST,
-                    strprintf("%s with %s not active bind", BytesToHex(vchFarmerPk), EncodeDestination(rewardDest)));
-            }
-        }
-
-        // Trying to release a new block
-        PubKeyOrHash poolPkOrHash =
-                MakePubKeyOrHash(static_cast<PlotPubKeyType>(posProof.nPlotType), posProof.vchPoolPkOrHash);
-        std::unique_ptr<CBlockTemplate> ptemplate = BlockAssembler(params).CreateNewChiaBlock(
-                pindexPrev, GetScriptForDestination(rewardDest), farmerSk, posProof, vdfProof);
-        if (ptemplate == nullptr) {
-            throw std::runtime_error("cannot generate new block, the template object is null");
-        }
-        pblock.reset(new CBlock(ptemplate->block));
-    }
-
-    if (pblock == nullptr) {
-        throw std::runtime_error("pblock is null, cannot release new block");
-    }
-    ReleaseBlock(pblock, params);
-}
-
 static UniValue submitProof(JSONRPCRequest const& request) {
     RPCHelpMan("submitproof", "Submit proof to the chain and release new block",
         {
@@ -398,32 +379,92 @@ static UniValue submitProof(JSONRPCRequest const& request) {
         throw std::runtime_error("The reward destination is invalid");
     }
 
-    auto params = Params().GetConsensus();
-
-    uint64_t nDifficulty{1};
-    {
-        LOCK(cs_main);
+    SubmitProofRequest req;
+    req.hashPrevBlock = hashPrevBlock;
+    req.nHeightOfPrevBlock = nHeightOfPrevBlock;
+    req.rewardDest = rewardDest;
+    req.vchFarmerSk = vchFarmerSk;
+    req.posProof = posProof;
+    req.vdfProof = vdfProof;
 
-        CBlockIndex* pindexPrev = LookupBlockIndex(hashPrevBlock);
-        if (pindexPrev == nullptr) {
-            LogPrintf("%s: cannot find block by hash: %s, the proof will not be submitted\n", __func__,
-                      hashPrevBlock.GetHex());
-            return false;
-        }
-        int nTargetHeight = pindexPrev->nHeight + 1;
-        double targetMulFactor = GetTargetMulFactor(nTargetHeight, params);
-        int adjust_target_spacing = GetAdjustTargetSpacing(nTargetHeight, params);
-        nDifficulty = AdjustDifficulty(GetChiaBlockDifficulty(pindexPrev, params), static_cast<int64_t>(nTotalDuration),
-                                       adjust_target_spacing, QueryDurationFix(nTargetHeight, params.BHDIP009TargetDurationFixes),
-                                       GetDifficultyChangeMaxFactor(nTargetHeight, params),
-                                       params.BHDIP009StartDifficulty, targetMulFactor);
+    if (g_chia_candidate_builder) {
+        g_chia_candidate_builder->StartOnDemand();
     }
 
     // We should put it to the chain immediately
-    GenerateChiaBlock(hashPrevBlock, nHeightOfPrevBlock, rewardDest, initialChallenge, vchFarmerSk, posProof, vdfProof,
-                      nDifficulty);
+    SubmitProofTimes times;
+    if (g_block_submitter) {
+        return g_block_submitter->Submit(req, Params(), times);
+    }
+    return CBlockSubmitter().Submit(req, Params(), times);
+}
 
-    return true;
+static UniValue querySubmitProofInfo(JSONRPCRequest const& request) {
+    RPCHelpMan("querysubmitproofinfo", "Query the time spent on each stage of the submitted proofs", {},
+               RPCResult{"{\n"
+                         "  \"threads\": n,       (numeric) The number of the threads verifying the proofs\n"
+                         "  \"submitted\": n,     (numeric) The number of the proofs submitted\n"
+                         "  \"released\": n,      (numeric) The number of the blocks released\n"
+                         "  \"failed\": n,        (numeric) The number of the proofs failed to release blocks\n"
+                         "  \"last\": {           (json object) Time of the stages of the latest submission\n"
+                         "    \"verify_ms\": n,   (numeric) The longest of the PoS and VDF verifications on the workers\n"
+                         "    \"select_ms\": n,   (numeric) Getting the transactions while the proofs are verified\n"
+                         "    \"wait_ms\": n,     (numeric) Waiting for the verifications after the transactions are ready\n"
+                         "    \"assemble_ms\": n, (numeric) Constructing and signing the block with cs_main held\n"
+                         "    \"release_ms\": n,  (numeric) Processing the new block\n"
+                         "    \"total_ms\": n     (numeric) Time of the whole submission\n"
+                         "  },\n"
+                         "  \"max\": {...},       (json object) The longest time of the stages of the blocks released\n"
+                         "  \"avg\": {...},       (json object) The average time of the stages of the blocks released\n"
+                         "  \"candidate\": {      (json object) The transactions pre-selected for the next block\n"
+                         "    \"ready\": true|false, (boolean) The candidate is selected for the tip\n"
+                         "    \"stale\": true|false, (boolean) The mempool is changed, the candidate will be selected again\n"
+                         "    \"prev_block_hash\": \"xxx\", (string) The tip the candidate is selected for\n"
+                         "    \"txs\": n,          (numeric) The number of the transactions\n"
+                         "    \"fees\": n,         (numeric) The fees of the transactions\n"
+                         "    \"builds\": n,       (numeric) The number of the selections in the background\n"
+                         "    \"last_build_ms\": n, (numeric) Time of the latest selection\n"
+                         "    \"max_build_ms\": n  (numeric) The longest time of the selections\n"
+                         "  }\n"
+                         "}\n"},
+               RPCExamples{HelpExampleCli("querysubmitproofinfo", "")})
+            .Check(request);
+
+    SubmitProofStats stats = g_block_submitter ? g_block_submitter->GetStats() : CBlockSubmitter().GetStats();
+    auto makeTimes = [](SubmitProofTimes const& times, uint64_t nCount) {
+        double fFactor = nCount > 0 ? 0.001 / nCount : 0.0;
+        UniValue res(UniValue::VOBJ);
+        res.pushKV("verify_ms", fFactor * times.nVerifyMicros);
+        res.pushKV("select_ms", fFactor * times.nSelectMicros);
+        res.pushKV("wait_ms", fFactor * times.nWaitMicros);
+        res.pushKV("assemble_ms", fFactor * times.nAssembleMicros);
+        res.pushKV("release_ms", fFactor * times.nReleaseMicros);
+        res.pushKV("total_ms", fFactor * times.nTotalMicros);
+        return res;
+    };
+
+    UniValue res(UniValue::VOBJ);
+    res.pushKV("threads", stats.nThreads);
+    res.pushKV("submitted", stats.nSubmitted);
+    res.pushKV("released", stats.nReleased);
+    res.pushKV("failed", stats.nFailed);
+    res.pushKV("last", makeTimes(stats.last, 1));
+    res.pushKV("max", makeTimes(stats.max, 1));
+    res.pushKV("avg", makeTimes(stats.total, stats.nReleased));
+    if (g_chia_candidate_builder) {
+        ChiaBlockCandidateStats candidateStats = g_chia_candidate_builder->GetStats();
+        UniValue candidate(UniValue::VOBJ);
+        candidate.pushKV("ready", candidateStats.fReady);
+        candidate.pushKV("stale", candidateStats.fStale);
+        candidate.pushKV("prev_block_hash", candidateStats.hashPrevBlock.GetHex());
+        candidate.pushKV("txs", candidateStats.nTxs);
+        candidate.pushKV("fees", candidateStats.nFees);
+        candidate.pushKV("builds", candidateStats.nBuilds);
+        candidate.pushKV("last_build_ms", 0.001 * candidateStats.nLastBuildMicros);
+        candidate.pushKV("max_build_ms", 0.001 * candidateStats.nMaxBuildMicros);
+        res.pushKV("candidate", candidate);
+    }
+    return res;
 }
 
 static UniValue queryNetspace(JSONRPCRequest const& request) {
@@ -431,12 +472,8 @@ static UniValue queryNetspace(JSONRPCRequest const& request) {
                RPCExamples{HelpExampleCli("querynetspace", "")})
             .Check(request);
 
-    LOCK(cs_main);
-
-    auto querier = ChainInfoQuerier::CreateQuerier();
+    auto querier = ChainInfoQuerier::CreateTipQuerier();
 
-    CBlockIndex* pindex = ::ChainActive().Tip();
-    auto params = Params().GetConsensus();
     CAmount nTotalSupplied = querier.GetTotalSupplied();
 
     auto netspace_avg = querier.GetAverageNetSpace();
@@ -456,6 +493,169 @@ static UniValue queryNetspace(JSONRPCRequest const& request) {
     return res;
 }
 
+static UniValue queryProofCacheInfo(JSONRPCRequest const& request) {
+    RPCHelpMan("queryproofcacheinfo", "Query the statistics of the caches of the verified VDF and PoS proofs and farmer signatures", {},
+               RPCResult{"{\n"
+                         "  \"vdf\": {                (json object) The cache of the verified VDF proofs\n"
+                         "    \"hits\": n,            (numeric) The number of proofs found in the cache\n"
+                         "    \"misses\": n,          (numeric) The number of proofs need to be verified\n"
+                         "    \"capacity\": n         (numeric) The maximum number of the entries\n"
+                         "  },\n"
+                         "  \"pos\": {                (json object) The cache of the verified PoS proofs\n"
+                         "    \"hits\": n,            (numeric) The number of proofs found in the cache\n"
+                         "    \"misses\": n,          (numeric) The number of proofs need to be verified\n"
+                         "    \"size\": n,            (numeric) The number of the entries\n"
+                         "    \"capacity\": n         (numeric) The maximum number of the entries\n"
+                         "  },\n"
+                         "  \"signature\": {          (json object) The cache of the verified farmer signatures\n"
+                         "    \"hits\": n,            (numeric) The number of signatures found in the cache\n"
+                         "    \"misses\": n,          (numeric) The number of signatures need to be verified\n"
+                         "    \"capacity\": n         (numeric) The maximum number of the entries\n"
+                         "  }\n"
+                         "}\n"},
+               RPCExamples{HelpExampleCli("queryproofcacheinfo", "")})
+            .Check(request);
+
+    ProofCacheStats stats = GetProofCacheStats();
+
+    UniValue vdf(UniValue::VOBJ);
+    vdf.pushKV("hits", stats.nVdfHits);
+    vdf.pushKV("misses", stats.nVdfMisses);
+    vdf.pushKV("capacity", static_cast<uint64_t>(stats.nVdfCapacity));
+
+    UniValue pos(UniValue::VOBJ);
+    pos.pushKV("hits", stats.nPosHits);
+    pos.pushKV("misses", stats.nPosMisses);
+    pos.pushKV("size", stats.nPosEntries);
+    pos.pushKV("capacity", stats.nPosCapacity);
+
+    UniValue sig(UniValue::VOBJ);
+    sig.pushKV("hits", stats.nSigHits);
+    sig.pushKV("misses", stats.nSigMisses);
+    sig.pushKV("capacity", static_cast<uint64_t>(stats.nSigCapacity));
+
+    UniValue res(UniValue::VOBJ);
+    res.pushKV("vdf", vdf);
+    res.pushKV("pos", pos);
+    res.pushKV("signature", sig);
+    return res;
+}
+
+static UniValue queryHarvesterInfo(JSONRPCRequest const& request) {
+    RPCHelpMan("queryharvesterinfo", "Query the statistics of the local harvester and the lookup latency of each plot", {},
+               RPCResult{"{\n"
+                         "  \"threads\": n,            (numeric) The number of the lookup threads\n"
+                         "  \"challenges\": n,         (numeric) The number of the challenges looked up\n"
+                         "  \"last_challenge_ms\": n,  (numeric) The time from the latest challenge is queued to all plots are done\n"
+                         "  \"plots\": [               (json array) The plots\n"
+                         "    {\n"
+                         "      \"path\": \"xxx\",       (string) The path of the plot file\n"
+                         "      \"plot_id\": \"xxx\",    (string) The plot id in hex\n"
+                         "      \"k\": n,              (numeric) The size of the plot\n"
+                         "      \"lookups\": n,        (numeric) The number of the challenges passed the filter\n"
+                         "      \"qualities\": n,      (numeric) The number of the qualities found\n"
+                         "      \"last_ms\": n,        (numeric) Time of the latest lookup\n"
+                         "      \"max_ms\": n,         (numeric) The longest time of the lookups\n"
+                         "      \"avg_ms\": n          (numeric) The average time of the lookups\n"
+                         "    }, ...\n"
+                         "  ]\n"
+                         "}\n"},
+               RPCExamples{HelpExampleCli("queryharvesterinfo", "")})
+            .Check(request);
+
+    if (!g_harvester) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The harvester is not enabled, use -plotdir to enable it");
+    }
+
+    HarvesterStats stats = g_harvester->GetStats();
+    UniValue plots(UniValue::VARR);
+    for (auto const& plotStats : g_harvester->GetPlotStats()) {
+        UniValue plot(UniValue::VOBJ);
+        plot.pushKV("path", plotStats.path);
+        plot.pushKV("plot_id", plotStats.plotId.GetHex());
+        plot.pushKV("k", plotStats.k);
+        plot.pushKV("lookups", plotStats.nLookups);
+        plot.pushKV("qualities", plotStats.nQualities);
+        plot.pushKV("last_ms", 0.001 * plotStats.nLastLookupMicros);
+        plot.pushKV("max_ms", 0.001 * plotStats.nMaxLookupMicros);
+        plot.pushKV("avg_ms", plotStats.nLookups > 0 ? 0.001 * plotStats.nTotalLookupMicros / plotStats.nLookups : 0.0);
+        plots.push_back(std::move(plot));
+    }
+
+    UniValue res(UniValue::VOBJ);
+    res.pushKV("threads", stats.nThreads);
+    res.pushKV("challenges", stats.nChallenges);
+    res.pushKV("last_challenge_ms", 0.001 * stats.nLastChallengeMicros);
+    res.pushKV("plots", plots);
+    return res;
+}
+
+static UniValue queryHarvesterQualities(JSONRPCRequest const& request) {
+    RPCHelpMan("queryharvesterqualities", "Query the qualities found by the local harvester for the latest challenge",
+               {
+                   {"count", RPCArg::Type::NUM, /* default */ "1", "The number of the best qualities to return with their full proofs"},
+               },
+               RPCResult{"{\n"
+                         "  \"challenge\": \"xxx\",          (string) The challenge\n"
+                         "  \"prev_block_hash\": \"xxx\",    (string) The hash of the block before the target\n"
+                         "  \"target_height\": n,          (numeric) The height of the target block\n"
+                         "  \"total\": n,                  (numeric) The number of the qualities found\n"
+                         "  \"qualities\": [               (json array) The best qualities ordered by iters\n"
+                         "    {\n"
+                         "      \"plot_id\": \"xxx\",        (string) The plot id\n"
+                         "      \"path\": \"xxx\",           (string) The path of the plot file\n"
+                         "      \"k\": n,                  (numeric) The size of the plot\n"
+                         "      \"index\": n,              (numeric) The index of the quality in the plot\n"
+                         "      \"mixed_quality_string\": \"xxx\", (string) The mixed quality string\n"
+                         "      \"iters\": n,              (numeric) The VDF iters required by the quality\n"
+                         "      \"proof\": \"xxx\"           (string) The full proof of space\n"
+                         "    }, ...\n"
+                         "  ]\n"
+                         "}\n"},
+               RPCExamples{HelpExampleCli("queryharvesterqualities", "3")})
+            .Check(request);
+
+    if (!g_harvester) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The harvester is not enabled, use -plotdir to enable it");
+    }
+    int nCount = request.params[0].isNull() ? 1 : request.params[0].get_int();
+    if (nCount < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "count cannot be negative");
+    }
+
+    HarvesterChallenge challenge;
+    std::vector<HarvestedQuality> vQualities;
+    if (!g_harvester->GetQualities(challenge, vQualities)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "No challenge has been looked up");
+    }
+
+    // Only the full proofs of the returned qualities are read from the plots
+    UniValue qualities(UniValue::VARR);
+    for (int i = 0; i < nCount && i < static_cast<int>(vQualities.size()); ++i) {
+        auto const& quality = vQualities[i];
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("plot_id", quality.plotId.GetHex());
+        entry.pushKV("path", quality.path);
+        entry.pushKV("k", quality.k);
+        entry.pushKV("index", quality.index);
+        entry.pushKV("mixed_quality_string", quality.mixedQualityString.GetHex());
+        entry.pushKV("iters", quality.nIters);
+        Bytes vchProof;
+        if (g_harvester->GetFullProof(quality.plotId, challenge.challenge, quality.index, vchProof)) {
+            entry.pushKV("proof", BytesToHex(vchProof));
+        }
+        qualities.push_back(std::move(entry));
+    }
+
+    UniValue res(UniValue::VOBJ);
+    res.pushKV("challenge", challenge.challenge.GetHex());
+    res.pushKV("prev_block_hash", challenge.hashPrevBlock.GetHex());
+    res.pushKV("target_height", challenge.nTargetHeight);
+    res.pushKV("total", static_cast<uint64_t>(vQualities.size()));
+    res.pushKV("qualities", qualities);
+    return res;
+}
+
 static UniValue queryMiningRequirement(JSONRPCRequest const& request) {
     RPCHelpMan("queryminingrequirement", "Query the pledge requirement for the miner",
                {
@@ -471,14 +671,15 @@ static UniValue queryMiningRequirement(JSONRPCRequest const& request) {
 
     TimeElapsed te_init("initialize");
 
-    LOCK(cs_main);
-    CBlockIndex* pindex = ::ChainActive().Tip();
+    // Pin the coins and the tip, the requirement is calculated without holding cs_main
+    auto querier = ChainInfoQuerier::CreateSnapshotQuerier();
+    CBlockIndex const* pindex = querier.GetTip();
     auto params = Params().GetConsensus();
     if (pindex->nHeight < params.BHDIP009Height) {
         throw std::runtime_error("BHDIP009 is required");
     }
 
-    CCoinsViewCache const& view = ::ChainstateActive().CoinsTip();
+    CCoinsViewCache const& view = querier.GetCoinsView();
 
     debug.pushKV("te_init", te_init.PrintAndRecordElapsedTime());
 
@@ -492,7 +693,7 @@ static UniValue queryMiningRequirement(JSONRPCRequest const& request) {
     debug.pushKV("te_get_height_for_calculating_total_supply", te_get_height_for_calculating_total_supply.PrintAndRecordElapsedTime());
 
     TimeElapsed te_get_accumulate("get_accumulate");
-    CAmount nAccumulate = GetBlockAccumulateSubsidy(pindex, params);
+    CAmount nAccumulate = querier.GetAccumulate();
     debug.pushKV("te_get_accumulate", te_get_accumulate.PrintAndRecordElapsedTime());
 
     TimeElapsed te_get_total_supply("get_total_supply");
@@ -501,8 +702,7 @@ static UniValue queryMiningRequirement(JSONRPCRequest const& request) {
     debug.pushKV("te_get_total_supply", te_get_total_supply.PrintAndRecordElapsedTime());
 
     TimeElapsed te_get_burned("get_burned");
-    CAmount nBurned = view.GetAccountBalance(false, GetBurnToAccountID(), nullptr, nullptr, nullptr,
-                                             &params.BHDIP009PledgeTerms, nHeightForCalculatingTotalSupply);
+    CAmount nBurned = querier.GetBurned(nHeightForCalculatingTotalSupply);
     debug.pushKV("te_get_burned", te_get_burned.PrintAndRecordElapsedTime());
 
     bool summaryForAddress { false };
@@ -529,7 +729,8 @@ static UniValue queryMiningRequirement(JSONRPCRequest const& request) {
         TimeElapsed te_get_mining_require("get_mining_require");
         int nMinedCount, nTotalCount;
         CAmount nReq = poc::GetMiningRequireBalance(accountID, bindData, nTargetHeight, view, nullptr, nullptr, nBurned,
-                                                    params, &nMinedCount, &nTotalCount, nHeightForCalculatingTotalSupply);
+                                                    params, &nMinedCount, &nTotalCount, nHeightForCalculatingTotalSupply,
+                                                    pindex);
         summary.pushKV("address", address);
         summary.pushKV("require", nReq);
         summary.pushKV("require-human", FormatMoney(nReq));
@@ -547,27 +748,21 @@ static UniValue queryMiningRequirement(JSONRPCRequest const& request) {
         // List mined blocks which are related to this account
         TimeElapsed te_get_blks("get_blks");
         UniValue blks(UniValue::VARR);
-        auto pcurrIndex = pindex;
-        int count{0}, mined{0};
-        while (pcurrIndex && pcurrIndex->nHeight >= params.BHDIP009Height && count < params.nCapacityEvalWindow) {
-            // check fpk from the block
-            for (auto const& fpk : fpks) {
-                if (fpk.GetChiaFarmerPk().ToBytes() == pcurrIndex->chiaposFields.posProof.vchFarmerPk) {
-                    // Now we export the block to UniValue and push it to array
-                    UniValue blkVal(UniValue::VOBJ);
-                    auto dest = CTxDestination(static_cast<ScriptHash>(pcurrIndex->generatorAccountID));
-                    std::string accountIDStr = EncodeDestination(dest);
-                    blkVal.pushKV("height", pcurrIndex->nHeight);
-                    blkVal.pushKV("hash", pcurrIndex->GetBlockHash().GetHex());
-                    blkVal.pushKV("fpk", chiapos::BytesToHex(pcurrIndex->chiaposFields.posProof.vchFarmerPk));
-                    blkVal.pushKV("accountID", accountIDStr);
-                    blks.push_back(blkVal);
-                    break;
-                }
+        int nBeginHeight = std::max(pindex->nHeight - params.nCapacityEvalWindow + 1, params.BHDIP009Height);
+        if (nBeginHeight <= pindex->nHeight) {
+            auto heights = g_mined_block_index.GetMinedHeights(pindex, fpks, nBeginHeight, pindex->nHeight);
+            for (auto it = heights.rbegin(); it != heights.rend(); ++it) {
+                // Now we export the block to UniValue and push it to array
+                auto pcurrIndex = pindex->GetAncestor(*it);
+                UniValue blkVal(UniValue::VOBJ);
+                auto dest = CTxDestination(static_cast<ScriptHash>(pcurrIndex->generatorAccountID));
+                std::string accountIDStr = EncodeDestination(dest);
+                blkVal.pushKV("height", pcurrIndex->nHeight);
+                blkVal.pushKV("hash", pcurrIndex->GetBlockHash().GetHex());
+                blkVal.pushKV("fpk", chiapos::BytesToHex(pcurrIndex->chiaposFields.posProof.vchFarmerPk));
+                blkVal.pushKV("accountID", accountIDStr);
+                blks.push_back(blkVal);
             }
-            // next
-            pcurrIndex = pcurrIndex->pprev;
-            ++count;
         }
         debug.pushKV("te_get_blks", te_get_blks.PrintAndRecordElapsedTime());
 
@@ -804,11 +999,10 @@ static UniValue querySupply(JSONRPCRequest const& request) {
                RPCExamples{HelpExampleCli("querysupply", "200000")})
             .Check(request);
 
-    LOCK(cs_main);
+    auto querier = ChainInfoQuerier::CreateSnapshotQuerier();
 
     // calculate from last height
-    auto pindex = ::ChainActive().Tip();
-    int nLastHeight = pindex->nHeight;
+    int nLastHeight = querier.GetTip()->nHeight;
 
     int nRequestedHeight = atoi(request.params[0].get_str());
     if (nRequestedHeight == 0) {
@@ -819,10 +1013,8 @@ static UniValue querySupply(JSONRPCRequest const& request) {
 
     // calculate from the calculation height
     int nHeightForCalculatingTotalSupply = GetHeightForCalculatingTotalSupply(nRequestedHeight, params);
-    CCoinsViewCache const& view = ::ChainstateActive().CoinsTip();
 
-    CAmount nBurned = view.GetAccountBalance(false, GetBurnToAccountID(), nullptr, nullptr, nullptr,
-                                             &params.BHDIP009PledgeTerms, nHeightForCalculatingTotalSupply);
+    CAmount nBurned = querier.GetBurned(nHeightForCalculatingTotalSupply);
     CAmount nTotalSupplied = GetTotalSupplyBeforeHeight(nHeightForCalculatingTotalSupply, params) +
                              GetTotalSupplyBeforeBHDIP009(params) * (params.BHDIP009TotalAmountUpgradeMultiply - 1);
     CAmount nActualAmount = nTotalSupplied - nBurned;
@@ -834,8 +1026,7 @@ static UniValue querySupply(JSONRPCRequest const& request) {
     calcValue.pushKV("burned", ValueFromAmount(nBurned));
     calcValue.pushKV("actual_supplied", ValueFromAmount(nActualAmount));
 
-    CAmount nLastBurned = view.GetAccountBalance(false, GetBurnToAccountID(), nullptr, nullptr, nullptr,
-                                                 &params.BHDIP009PledgeTerms, nLastHeight);
+    CAmount nLastBurned = querier.GetBurned(nLastHeight);
     CAmount nLastTotalSupplied = GetTotalSupplyBeforeHeight(nLastHeight, params) +
                                  GetTotalSupplyBeforeBHDIP009(params) * (params.BHDIP009TotalAmountUpgradeMultiply - 1);
     CAmount nLastActualAmount = nLastTotalSupplied - nLastBurned;
@@ -1026,6 +1217,42 @@ bool GetPledgeTx(PledgeTxSet const& txs, uint256 const& txHash, PledgeTx& outPle
     return true;
 }
 
+static void UpdatePledgeTxTerm(PledgeTx& pledgeTx, int nHeight, Consensus::Params const& params) {
+    if (pledgeTx.pledgeType == DATACARRIER_TYPE_BINDCHIAFARMER) {
+        pledgeTx.nActualAmount = 0;
+        pledgeTx.nExpiresOnHeight = 99999999;
+        pledgeTx.fInTerm = false;
+        return;
+    }
+    // check if it's state is in-term
+    int nTermIndex = static_cast<int>(pledgeTx.pointType - DATACARRIER_TYPE_CHIA_POINT);
+    auto const& term = params.BHDIP009PledgeTerms.at(nTermIndex);
+    int nExpiresOnHeight = pledgeTx.nPointHeight + term.nLockHeight;
+    pledgeTx.fInTerm = nHeight < nExpiresOnHeight;
+    if (pledgeTx.fInTerm) {
+        pledgeTx.nActualAmount = term.nWeightPercent * pledgeTx.nReceivedAmount / 100;
+    } else {
+        pledgeTx.nActualAmount = params.BHDIP009PledgeTerms[0].nWeightPercent * pledgeTx.nReceivedAmount / 100;
+    }
+    pledgeTx.nExpiresOnHeight = nExpiresOnHeight;
+}
+
+static PledgeTx PledgeTxFromIndexEntry(PledgeIndexEntry const& entry, Consensus::Params const& params) {
+    PledgeTx pledgeTx;
+    pledgeTx.blockHash = entry.blockHash;
+    pledgeTx.nHeight = entry.nHeight;
+    pledgeTx.txHash = entry.txid;
+    pledgeTx.sender = entry.sender;
+    pledgeTx.receiver = entry.receiver;
+    pledgeTx.nReceivedAmount = entry.nAmount;
+    pledgeTx.pledgeType = entry.pledgeType;
+    pledgeTx.pointType = entry.pointType;
+    pledgeTx.nPointHeight = entry.nPointHeight;
+    pledgeTx.fAvailable = entry.IsAvailable();
+    UpdatePledgeTxTerm(pledgeTx, entry.nHeight, params);
+    return pledgeTx;
+}
+
 static void StripPledgeTx(PledgeTxSet& pledgeTxs, CBlock const& block, int nHeight, Consensus::Params const& params) {
     for (auto const& tx : block.vtx) {
         if (tx->IsCoinBase() || !tx->IsUniform()) {
@@ -1059,6 +1286,7 @@ static void StripPledgeTx(PledgeTxSet& pledgeTxs, CBlock const& block, int nHeig
                 if (ppayload->type == DATACARRIER_TYPE_CHIA_POINT_RETARGET) {
                     // TODO find the previous tx and mark it to unavailable
                     auto retargetPayload = PointRetargetPayload::As(ppayload);
+                    pledgeTx.receiver = retargetPayload->GetReceiverID();
                     pledgeTx.pointType = retargetPayload->GetPointType();
                     pledgeTx.nPointHeight = retargetPayload->nPointHeight;
                     auto txHash = tx->vin[0].prevout.hash;
@@ -1076,17 +1304,7 @@ static void StripPledgeTx(PledgeTxSet& pledgeTxs, CBlock const& block, int nHeig
                     pledgeTx.pointType = pledgeTx.pledgeType;
                     pledgeTx.nPointHeight = nHeight;
                 }
-                // check if it's state is in-term
-                int nTermIndex = static_cast<int>(pledgeTx.pointType - DATACARRIER_TYPE_CHIA_POINT);
-                auto const& term = params.BHDIP009PledgeTerms.at(nTermIndex);
-                int nExpiresOnHeight = pledgeTx.nPointHeight + term.nLockHeight;
-                pledgeTx.fInTerm = nHeight < nExpiresOnHeight;
-                if (pledgeTx.fInTerm) {
-                    pledgeTx.nActualAmount = term.nWeightPercent * pledgeTx.nReceivedAmount / 100;
-                } else {
-                    pledgeTx.nActualAmount = params.BHDIP009PledgeTerms[0].nWeightPercent * pledgeTx.nReceivedAmount / 100;
-                }
-                pledgeTx.nExpiresOnHeight = nExpiresOnHeight;
+                UpdatePledgeTxTerm(pledgeTx, nHeight, params);
             }
             // save
             pledgeTxs[pledgeTx.txHash] = std::move(pledgeTx);
@@ -1100,22 +1318,49 @@ struct Amounts {
 };
 
 static UniValue queryChainPledgeInfo(JSONRPCRequest const& request) {
-    RPCHelpMan("querychainpledgeinfo", "Get the chain pledge information",
-        { },
+    RPCHelpMan("querychainpledgeinfo", "Get the chain pledge information, the pledges are read from the pledge index when -pledgeindex is enabled",
+        {
+            {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "Only list the pledges sent or received by the address, requires -pledgeindex"},
+        },
         RPCResult("info"),
-        RPCExamples("depinc-cli querychainpledgeinfo")).Check(request);
+        RPCExamples(HelpExampleCli("querychainpledgeinfo", "") + HelpExampleCli("querychainpledgeinfo", "\"3MxfK2hP6G3ZWa8ZLW1ZZmURf5SGrmSQLn\""))).Check(request);
 
     auto params = ::Params().GetConsensus();
-    LOCK(cs_main);
 
     PledgeTxSet pledgeTxs;
-    for (int nHeight = params.BHDIP009Height; nHeight < ::ChainActive().Height(); ++nHeight) {
-        auto pindex = ::ChainActive()[nHeight];
-        CBlock block;
-        if (!ReadBlockFromDisk(block, pindex, params)) {
-            throw std::runtime_error(tinyformat::format("cannot read block(%s) from disk", pindex->GetBlockHash().GetHex()));
+    if (g_pledgeindex) {
+        g_pledgeindex->BlockUntilSyncedToCurrentChain();
+        if (!request.params[0].isNull()) {
+            CAccountID accountID = ExtractAccountID(DecodeDestination(request.params[0].get_str()));
+            if (accountID.IsNull()) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+            }
+            std::vector<PledgeIndexEntry> entries;
+            if (!g_pledgeindex->GetAccountPledges(accountID, entries)) {
+                throw JSONRPCError(RPC_DATABASE_ERROR, "Cannot read the pledges from the pledge index");
+            }
+            for (auto const& entry : entries) {
+                pledgeTxs[entry.txid] = PledgeTxFromIndexEntry(entry, params);
+            }
+        } else if (!g_pledgeindex->ForEachPledge([&pledgeTxs, &params](PledgeIndexEntry const& entry) {
+                pledgeTxs[entry.txid] = PledgeTxFromIndexEntry(entry, params);
+                return true;
+            })) {
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Cannot read the pledges from the pledge index");
+        }
+    } else {
+        if (!request.params[0].isNull()) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Querying the pledges of an address requires -pledgeindex");
+        }
+        LOCK(cs_main);
+        for (int nHeight = params.BHDIP009Height; nHeight < ::ChainActive().Height(); ++nHeight) {
+            auto pindex = ::ChainActive()[nHeight];
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, params)) {
+                throw std::runtime_error(tinyformat::format("cannot read block(%s) from disk", pindex->GetBlockHash().GetHex()));
+            }
+            StripPledgeTx(pledgeTxs, block, nHeight, params);
         }
-        StripPledgeTx(pledgeTxs, block, nHeight, params);
     }
 
     std::map<CAccountID, Amounts> accountIDAmount;
@@ -1888,12 +2133,10 @@ static UniValue querypledgeamount(JSONRPCRequest const& request)
     CTxDestination dest = DecodeDestination(address);
     CAccountID accountID = ExtractAccountID(dest);
 
-    LOCK(cs_main);
-    ::ChainstateActive().ForceFlushStateToDisk();
-
-    CBlockIndex* pindex = ::ChainActive().Tip();
+    // The pledges are read from the coins database, the snapshot layers the coins of the latest blocks on it
+    auto querier = ChainInfoQuerier::CreateSnapshotQuerier();
+    CBlockIndex const* pindex = querier.GetTip();
 
-    auto querier = ChainInfoQuerier::CreateQuerier();
     CAmount nTotalSupplied = querier.GetTotalSupplied();
     int nMined, nCounted;
     CAmount nPledgeRequiredAmount = querier.GetMiningRequireBalance(accountID, &nMined, &nCounted);
@@ -2012,6 +2255,14 @@ UniValue queryFullMortgageInfo(JSONRPCRequest const& request)
             fullMortgageVal.pushKV("numOfDistributed", std::min(numOfDistributions, numOfDistributed));
             fullMortgageVal.pushKV("noMoreDistribution", numOfDistributions <= numOfDistributed);
 
+            CMortgageLedger::Distribution distribution;
+            if (calculator.GetDistribution(pcurr->nHeight, distribution)) {
+                fullMortgageVal.pushKV("distributedAmount", distribution.nDistributedAmount);
+                fullMortgageVal.pushKV("distributedAmount(human)", FormatMoney(distribution.nDistributedAmount));
+                fullMortgageVal.pushKV("remainingAmount", distribution.nRemainingAmount);
+                fullMortgageVal.pushKV("remainingAmount(human)", FormatMoney(distribution.nRemainingAmount));
+            }
+
             CAmount nBlockSubsidy = GetBlockSubsidy(pcurr->nHeight, params);
             fullMortgageVal.pushKV("subsidy", nBlockSubsidy);
             fullMortgageVal.pushKV("subsidy(human)", FormatMoney(nBlockSubsidy));
@@ -2078,14 +2329,7 @@ UniValue queryNumOfFullMortgageBlocks(JSONRPCRequest const& request)
     auto pindex = ::ChainActive().Tip();
     auto params = Params().GetConsensus();
 
-    int nCount{0};
-    for (; pindex->nHeight >= params.BHDIP009Height; pindex = pindex->pprev) {
-        if (CMortgageCalculator::IsFullMortgageBlock(pindex, params)) {
-            ++nCount;
-        }
-    }
-
-    return nCount;
+    return g_mortgage_ledger.CountFullMortgageBlocks(pindex, params.BHDIP009Height, pindex->nHeight, params);
 }
 
 UniValue queryprofit(JSONRPCRequest const& request)
@@ -2159,18 +2403,8 @@ UniValue queryprofit(JSONRPCRequest const& request)
     // the functor query the number of mined blocks within the capacity eval window in order to find the netspace
     auto calc_netspace_blks = [&params, &query_bind_farmer_pks](CBlockIndex* pindex_from, CAccountID const& account_id) -> int {
         auto farmer_pks = query_bind_farmer_pks(account_id);
-        int num_blocks{0};
         int target_height = pindex_from->nHeight - params.nCapacityEvalWindow + 1;
-        for (auto pindex = pindex_from; pindex->nHeight >= target_height; pindex = pindex->pprev) {
-            // find by farmer-pk
-            CChiaFarmerPk block_farmer_pk(pindex->chiaposFields.posProof.vchFarmerPk);
-            if (find_if(std::cbegin(farmer_pks), std::cend(farmer_pks), [&block_farmer_pk](CPlotterBindData const& bind_data) -> bool {
-                return bind_data.GetType() == CPlotterBindData::Type::CHIA && bind_data.GetChiaFarmerPk() == block_farmer_pk;
-            }) != std::cend(farmer_pks)) {
-                ++num_blocks;
-            }
-        }
-        return num_blocks;
+        return g_mined_block_index.CountMinedBlocks(pindex_from, farmer_pks, target_height, pindex_from->nHeight);
     };
 
     // loop until meet the required height
@@ -2201,12 +2435,12 @@ UniValue queryprofit(JSONRPCRequest const& request)
                 if (tx->IsCoinBase()) {
                     total_fullmortgage_profit += tx->GetValueOut();
                     CAccountID account_id = ExtractAccountID(tx->vout[0].scriptPubKey);
-                    int blks{0};
-                    if (calc_miner_netspace) {
-                        calc_netspace_blks(::ChainActive().Tip(), account_id);
-                    }
                     if (fullmortgage_prod_blks.find(account_id) == std::cend(fullmortgage_prod_blks)) {
-                        fullmortgage_prod_blks[account_id] = { 0, pindex->nHeight };
+                        int blks{0};
+                        if (calc_miner_netspace) {
+                            blks = calc_netspace_blks(::ChainActive().Tip(), account_id);
+                        }
+                        fullmortgage_prod_blks[account_id] = { blks, pindex->nHeight };
                     }
                     break;
                 }
@@ -2256,10 +2490,14 @@ UniValue queryprofit(JSONRPCRequest const& request)
 
 static std::vector<CRPCCommand> commands = {
         {"chia", "checkchiapos", &checkChiapos, {}},
-        {"chia", "querychallenge", &queryChallenge, {}},
+        {"chia", "querychallenge", &queryChallenge, {"last_challenge", "timeout"}},
         {"chia", "querynetspace", &queryNetspace, {}},
+        {"chia", "queryproofcacheinfo", &queryProofCacheInfo, {}},
+        {"chia", "queryharvesterinfo", &queryHarvesterInfo, {}},
+        {"chia", "queryharvesterqualities", &queryHarvesterQualities, {"count"}},
         {"chia", "querychainvdfinfo", &queryChainVdfInfo, {"height"}},
         {"chia", "queryminingrequirement", &queryMiningRequirement, {"address", "farmer-pk"}},
+        {"chia", "querysubmitproofinfo", &querySubmitProofInfo, {}},
         {"chia", "submitproof", &submitProof, {"challenge", "quality_string", "pos_proof", "k", "pool_pk", "local_pk", "farmer_pk", "farmer_sk", "plot_id", "vdf_proof_vec", "reward_dest"}},
         {"chia", "generateburstblocks", &generateBurstBlocks, {"count"}},
         {"chia", "queryupdatetiphistory", &queryUpdateTipHistory, {"count"}},
@@ -2268,8 +2506,9 @@ static std::vector<CRPCCommand> commands = {
         {"chia", "dumpburstcheckpoints", &dumpBurstCheckpoints, {}},
         {"chia", "submitvdfrequest", &submitVdfRequest, {"challenge", "iters"}},
         {"chia", "submitvdfproof", &submitVdfProof, {"challenge", "y", "proof", "witness_type", "iters", "duration"}},
+        {"chia", "queryvdfstoreinfo", &queryVdfStoreInfo, {}},
         {"chia", "dumpposproofs", &dumpPosProofs, {"count"}},
-        {"chia", "querychainpledgeinfo", &queryChainPledgeInfo, {}},
+        {"chia", "querychainpledgeinfo", &queryChainPledgeInfo, {"address"}},
         {"chia", "burntxout", &burntxout, {"txid","n"} },
         {"chia", "testtargetspacing", &testtargetspacing, {"numblocks"} },
         {"chia", "queryhalvings", &queryhalvings, {}},
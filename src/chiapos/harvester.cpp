@@ -0,0 +1,317 @@
+#include "harvester.h"
+
+#include <chain.h>
+#include <chainparams.h>
+#include <logging.h>
+#include <util/system.h>
+#include <util/time.h>
+
+#include <chiapos/kernel/calc_diff.h>
+#include <chiapos/post.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iterator>
+
+namespace chiapos {
+
+std::unique_ptr<CHarvester> g_harvester;
+
+namespace {
+
+class CPlotFileHarvesterPlot final : public CHarvesterPlot {
+public:
+    explicit CPlotFileHarvesterPlot(std::string const& path) : m_file(path) {}
+
+    bool IsReady() const { return m_file.IsReady(); }
+
+    std::string GetPath() const override { return m_file.GetPath(); }
+
+    PlotId GetPlotId() const override { return m_file.GetPlotId(); }
+
+    uint8_t GetK() const override { return m_file.GetK(); }
+
+    bool GetQualityString(uint256 const& challenge, std::vector<QualityStringPack>& vPacks) const override {
+        return m_file.GetQualityString(challenge, vPacks);
+    }
+
+    bool GetFullProof(uint256 const& challenge, int index, Bytes& vchProof) const override {
+        return m_file.GetFullProof(challenge, index, vchProof);
+    }
+
+    bool ReadMemo(PlotMemo& memo) const override { return m_file.ReadMemo(memo); }
+
+private:
+    CPlotFile m_file;
+};
+
+}  // namespace
+
+bool CHarvester::CLookupCheck::operator()() {
+    // Only the plots passed the filter are read from the disk
+    if (!PassesFilter(m_plot->plotId, m_challenge->challenge, m_challenge->nBitsOfFilter)) {
+        return true;
+    }
+    int64_t nTimeStart = GetTimeMicros();
+    std::vector<QualityStringPack> vPacks;
+    bool fRead;
+    {
+        LOCK(m_plot->cs);
+        fRead = m_plot->file->GetQualityString(m_challenge->challenge, vPacks);
+    }
+    m_result->fLookedUp = true;
+    m_result->nMicros = GetTimeMicros() - nTimeStart;
+    if (!fRead) {
+        LogPrintf("%s: cannot read the qualities from plot %s\n", __func__, m_plot->file->GetPath());
+        return true;
+    }
+    for (auto const& pack : vPacks) {
+        HarvestedQuality quality;
+        quality.plotId = m_plot->plotId;
+        quality.path = m_plot->file->GetPath();
+        quality.k = pack.k;
+        quality.index = pack.index;
+        quality.mixedQualityString = GetMixedQualityString(pack.quality_str.ToBytes(), m_challenge->challenge);
+        quality.nIters = CalculateIterationsQuality(quality.mixedQualityString, m_challenge->nDifficulty,
+                                                    m_challenge->nBitsOfFilter,
+                                                    m_challenge->nDifficultyConstantFactorBits, quality.k,
+                                                    m_challenge->nBaseIters);
+        m_result->vQualities.push_back(std::move(quality));
+    }
+    // Always true, a plot which cannot be read shouldn't stop the lookups of the others
+    return true;
+}
+
+CHarvester::CHarvester(int nThreads) : m_nThreads(std::max(1, std::min(nThreads, MAX_HARVESTER_THREADS))), m_queue(1) {}
+
+CHarvester::~CHarvester() { Stop(); }
+
+int CHarvester::LoadPlots(std::vector<fs::path> const& vDirs) {
+    assert(!m_thread.joinable());
+    int nLoaded{0};
+    for (auto const& dir : vDirs) {
+        if (!fs::is_directory(dir)) {
+            LogPrintf("%s: %s is not a directory\n", __func__, dir.string());
+            continue;
+        }
+        for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it) {
+            if (!fs::is_regular_file(it->path()) || it->path().extension() != ".plot") {
+                continue;
+            }
+            std::unique_ptr<CPlotFileHarvesterPlot> plot(new CPlotFileHarvesterPlot(it->path().string()));
+            if (!plot->IsReady()) {
+                LogPrintf("%s: cannot open plot %s\n", __func__, it->path().string());
+                continue;
+            }
+            if (!AddPlot(std::move(plot))) {
+                LogPrintf("%s: plot %s is duplicated, skipped\n", __func__, it->path().string());
+                continue;
+            }
+            ++nLoaded;
+        }
+    }
+    LogPrintf("%s: %d plots loaded, %d plots in total\n", __func__, nLoaded, m_plots.size());
+    return nLoaded;
+}
+
+bool CHarvester::AddPlot(std::unique_ptr<CHarvesterPlot> file) {
+    assert(!m_thread.joinable());
+    std::unique_ptr<Plot> plot(new Plot(std::move(file)));
+    if (FindPlot(plot->plotId) != nullptr) {
+        return false;
+    }
+    HarvesterPlotStats stats{};
+    stats.path = plot->file->GetPath();
+    stats.plotId = plot->plotId;
+    stats.k = plot->file->GetK();
+    {
+        LOCK(m_cs);
+        m_vPlotStats.push_back(std::move(stats));
+    }
+    m_plots.push_back(std::move(plot));
+    return true;
+}
+
+void CHarvester::Start() {
+    assert(!m_thread.joinable());
+    {
+        LOCK(m_cs);
+        m_fStop = false;
+    }
+    // The harvest thread looks up the plots as well when it waits for the checks
+    for (int i = 0; i < m_nThreads - 1; ++i) {
+        m_workers.create_thread([this] { TraceThread("harvestercheck", [this] { m_queue.Thread(); }); });
+    }
+    m_thread = std::thread(&TraceThread<std::function<void()>>, "harvester", std::function<void()>(std::bind(&CHarvester::ThreadHarvest, this)));
+    RegisterValidationInterface(this);
+    LogPrintf("Harvester started with %d plots and %d threads\n", m_plots.size(), m_nThreads);
+}
+
+void CHarvester::Stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    UnregisterValidationInterface(this);
+    {
+        LOCK(m_cs);
+        m_fStop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+    m_workers.interrupt_all();
+    m_workers.join_all();
+    LogPrintf("Harvester stopped\n");
+}
+
+void CHarvester::NewChallenge(HarvesterChallenge const& challenge) {
+    {
+        LOCK(m_cs);
+        m_pending = challenge;
+        m_fPending = true;
+        m_nQueuedTime = GetTimeMicros();
+    }
+    m_cond.notify_all();
+}
+
+bool CHarvester::WaitForLookups(uint256 const& challenge, int64_t nTimeoutMillis) {
+    WAIT_LOCK(m_cs, lock);
+    return m_cond.wait_for(lock, std::chrono::milliseconds(nTimeoutMillis), [&]() EXCLUSIVE_LOCKS_REQUIRED(m_cs) {
+        return m_fStop || (m_fLatestDone && m_latest.challenge == challenge);
+    }) && !m_fStop;
+}
+
+bool CHarvester::GetQualities(HarvesterChallenge& challenge, std::vector<HarvestedQuality>& vQualities) const {
+    LOCK(m_cs);
+    if (!m_fLatestDone) {
+        return false;
+    }
+    challenge = m_latest;
+    vQualities = m_vQualities;
+    return true;
+}
+
+bool CHarvester::GetFullProof(PlotId const& plotId, uint256 const& challenge, int index, Bytes& vchProof) const {
+    Plot const* plot = FindPlot(plotId);
+    if (plot == nullptr) {
+        return false;
+    }
+    LOCK(plot->cs);
+    return plot->file->GetFullProof(challenge, index, vchProof);
+}
+
+bool CHarvester::GetPlotMemo(PlotId const& plotId, PlotMemo& memo) const {
+    Plot const* plot = FindPlot(plotId);
+    if (plot == nullptr) {
+        return false;
+    }
+    LOCK(plot->cs);
+    return plot->file->ReadMemo(memo);
+}
+
+std::vector<HarvesterPlotStats> CHarvester::GetPlotStats() const {
+    LOCK(m_cs);
+    return m_vPlotStats;
+}
+
+HarvesterStats CHarvester::GetStats() const {
+    LOCK(m_cs);
+    HarvesterStats stats;
+    stats.nPlots = m_plots.size();
+    stats.nChallenges = m_nChallenges;
+    stats.nLastChallengeMicros = m_nLastChallengeMicros;
+    stats.nThreads = m_nThreads;
+    return stats;
+}
+
+void CHarvester::UpdatedBlockTip(CBlockIndex const* pindexNew, CBlockIndex const* pindexFork, bool fInitialDownload) {
+    if (fInitialDownload || pindexNew == nullptr) {
+        return;
+    }
+    auto const& params = Params().GetConsensus();
+    int nTargetHeight = pindexNew->nHeight + 1;
+    if (nTargetHeight < params.BHDIP009Height) {
+        return;
+    }
+    HarvesterChallenge challenge;
+    challenge.challenge = MakeChallenge(pindexNew, params);
+    challenge.hashPrevBlock = pindexNew->GetBlockHash();
+    challenge.nTargetHeight = nTargetHeight;
+    challenge.nDifficulty = GetDifficultyForNextIterations(pindexNew, params);
+    challenge.nBitsOfFilter = GetBitsOfFilter(nTargetHeight, params);
+    challenge.nBaseIters = GetBaseIters(nTargetHeight, params, pindexNew->chiaposFields.GetItersPerSec());
+    challenge.nDifficultyConstantFactorBits = params.BHDIP009DifficultyConstantFactorBits;
+    NewChallenge(challenge);
+}
+
+void CHarvester::ThreadHarvest() {
+    while (true) {
+        HarvesterChallenge challenge;
+        int64_t nQueuedTime;
+        {
+            WAIT_LOCK(m_cs, lock);
+            m_cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_cs) { return m_fStop || m_fPending; });
+            if (m_fStop) {
+                return;
+            }
+            challenge = m_pending;
+            nQueuedTime = m_nQueuedTime;
+            m_fPending = false;
+        }
+        LookupChallenge(challenge, nQueuedTime);
+    }
+}
+
+void CHarvester::LookupChallenge(HarvesterChallenge const& challenge, int64_t nQueuedTime) {
+    int64_t nTimeStart = GetTimeMicros();
+    std::vector<LookupResult> vResults(m_plots.size());
+    std::vector<CLookupCheck> vChecks;
+    vChecks.reserve(m_plots.size());
+    for (std::size_t i = 0; i < m_plots.size(); ++i) {
+        vChecks.emplace_back(m_plots[i].get(), &challenge, &vResults[i]);
+    }
+    if (!vChecks.empty()) {
+        CCheckQueueControl<CLookupCheck> control(&m_queue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    std::vector<HarvestedQuality> vQualities;
+    int nLookedUp{0};
+    {
+        LOCK(m_cs);
+        for (std::size_t i = 0; i < vResults.size(); ++i) {
+            auto const& result = vResults[i];
+            if (!result.fLookedUp) {
+                continue;
+            }
+            ++nLookedUp;
+            auto& stats = m_vPlotStats[i];
+            ++stats.nLookups;
+            stats.nQualities += result.vQualities.size();
+            stats.nLastLookupMicros = result.nMicros;
+            stats.nMaxLookupMicros = std::max(stats.nMaxLookupMicros, result.nMicros);
+            stats.nTotalLookupMicros += result.nMicros;
+            std::copy(std::begin(result.vQualities), std::end(result.vQualities), std::back_inserter(vQualities));
+        }
+        std::sort(std::begin(vQualities), std::end(vQualities),
+                  [](HarvestedQuality const& lhs, HarvestedQuality const& rhs) { return lhs.nIters < rhs.nIters; });
+        m_latest = challenge;
+        m_vQualities = vQualities;
+        m_fLatestDone = true;
+        ++m_nChallenges;
+        m_nLastChallengeMicros = GetTimeMicros() - nQueuedTime;
+    }
+    m_cond.notify_all();
+    LogPrint(BCLog::POC, "%s: challenge %s (height=%d), %d/%d plots passed the filter, %d qualities, best iters=%s, %.2fms\n",
+             __func__, challenge.challenge.GetHex(), challenge.nTargetHeight, nLookedUp, m_plots.size(), vQualities.size(),
+             vQualities.empty() ? "n/a" : std::to_string(vQualities.front().nIters), 0.001 * (GetTimeMicros() - nTimeStart));
+}
+
+CHarvester::Plot const* CHarvester::FindPlot(PlotId const& plotId) const {
+    auto it = std::find_if(std::cbegin(m_plots), std::cend(m_plots),
+                           [&plotId](std::unique_ptr<Plot> const& plot) { return plot->plotId == plotId; });
+    return it != std::cend(m_plots) ? it->get() : nullptr;
+}
+
+}  // namespace chiapos
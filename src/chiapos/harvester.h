@@ -0,0 +1,201 @@
+#ifndef DEPINC_CHIAPOS_HARVESTER_H
+#define DEPINC_CHIAPOS_HARVESTER_H
+
+#include <checkqueue.h>
+#include <fs.h>
+#include <sync.h>
+#include <uint256.h>
+#include <validationinterface.h>
+
+#include <chiapos/kernel/chiapos_types.h>
+#include <chiapos/kernel/pos.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! Default for -harvesterthreads, the number of the threads to look up the qualities from the plots
+static const int DEFAULT_HARVESTER_THREADS = 4;
+//! Maximum number of the harvester threads
+static const int MAX_HARVESTER_THREADS = 64;
+
+namespace chiapos {
+
+/** The challenge of the next block and the arguments to calculate the iters from the qualities */
+struct HarvesterChallenge {
+    uint256 challenge;
+    uint256 hashPrevBlock;
+    int nTargetHeight{0};
+    uint64_t nDifficulty{0};
+    int nBitsOfFilter{0};
+    int nBaseIters{0};
+    int nDifficultyConstantFactorBits{0};
+};
+
+struct HarvestedQuality {
+    PlotId plotId;
+    std::string path;
+    uint8_t k;
+    int index;
+    uint256 mixedQualityString;
+    //! The VDF iters required by the quality
+    uint64_t nIters;
+};
+
+struct HarvesterPlotStats {
+    std::string path;
+    PlotId plotId;
+    uint8_t k;
+    //! The number of the challenges passed the filter, the qualities are read from the plot for them
+    uint64_t nLookups;
+    uint64_t nQualities;
+    int64_t nLastLookupMicros;
+    int64_t nMaxLookupMicros;
+    int64_t nTotalLookupMicros;
+};
+
+struct HarvesterStats {
+    uint64_t nPlots;
+    uint64_t nChallenges;
+    //! Time spent on the lookups of the latest challenge, from the challenge is queued to all plots are done
+    int64_t nLastChallengeMicros;
+    int nThreads;
+};
+
+/** A plot the harvester looks up, the plots are the files on the disk unless they are given by AddPlot */
+class CHarvesterPlot {
+public:
+    virtual ~CHarvesterPlot() = default;
+
+    virtual std::string GetPath() const = 0;
+
+    virtual PlotId GetPlotId() const = 0;
+
+    virtual uint8_t GetK() const = 0;
+
+    virtual bool GetQualityString(uint256 const& challenge, std::vector<QualityStringPack>& vPacks) const = 0;
+
+    virtual bool GetFullProof(uint256 const& challenge, int index, Bytes& vchProof) const = 0;
+
+    virtual bool ReadMemo(PlotMemo& memo) const = 0;
+};
+
+/**
+ * Look up the qualities from the local plot files for the challenges of the new tips. The plot files are opened once
+ * with their DiskProver kept, the plot ids are checked against the filter before the plots are read. The lookups of a
+ * challenge run on the workers of a check queue, the qualities of the latest challenge and the latency of each plot are
+ * kept for the RPC calls.
+ */
+class CHarvester final : public CValidationInterface {
+public:
+    explicit CHarvester(int nThreads = DEFAULT_HARVESTER_THREADS);
+
+    ~CHarvester();
+
+    /** Open the plot files (*.plot) in the directories, returns the number of the plots loaded */
+    int LoadPlots(std::vector<fs::path> const& vDirs);
+
+    /** Add a plot before the harvester starts, false when a plot with the same id is already added */
+    bool AddPlot(std::unique_ptr<CHarvesterPlot> plot);
+
+    void Start();
+
+    void Stop();
+
+    /** Queue the challenge, a challenge which is still in the queue is replaced */
+    void NewChallenge(HarvesterChallenge const& challenge);
+
+    /** Wait until the lookups of the latest challenge are done, returns false on timeout */
+    bool WaitForLookups(uint256 const& challenge, int64_t nTimeoutMillis);
+
+    /** The qualities of the latest challenge ordered by iters, false when there is no challenge looked up */
+    bool GetQualities(HarvesterChallenge& challenge, std::vector<HarvestedQuality>& vQualities) const;
+
+    bool GetFullProof(PlotId const& plotId, uint256 const& challenge, int index, Bytes& vchProof) const;
+
+    bool GetPlotMemo(PlotId const& plotId, PlotMemo& memo) const;
+
+    std::vector<HarvesterPlotStats> GetPlotStats() const;
+
+    HarvesterStats GetStats() const;
+
+protected:
+    void UpdatedBlockTip(CBlockIndex const* pindexNew, CBlockIndex const* pindexFork, bool fInitialDownload) override;
+
+private:
+    struct Plot {
+        explicit Plot(std::unique_ptr<CHarvesterPlot> fileIn) : file(std::move(fileIn)), plotId(file->GetPlotId()) {}
+
+        std::unique_ptr<CHarvesterPlot> file;
+        PlotId plotId;
+        //! DiskProver isn't thread safe, the lookups and the full proofs of a plot are read one by one
+        mutable Mutex cs;
+    };
+
+    struct LookupResult {
+        std::vector<HarvestedQuality> vQualities;
+        bool fLookedUp{false};
+        int64_t nMicros{0};
+    };
+
+    /** Look up the qualities of one plot for a challenge */
+    class CLookupCheck {
+    public:
+        CLookupCheck() = default;
+
+        CLookupCheck(Plot const* plot, HarvesterChallenge const* challenge, LookupResult* result)
+                : m_plot(plot), m_challenge(challenge), m_result(result) {}
+
+        bool operator()();
+
+        void swap(CLookupCheck& check) {
+            std::swap(m_plot, check.m_plot);
+            std::swap(m_challenge, check.m_challenge);
+            std::swap(m_result, check.m_result);
+        }
+
+    private:
+        Plot const* m_plot{nullptr};
+        HarvesterChallenge const* m_challenge{nullptr};
+        LookupResult* m_result{nullptr};
+    };
+
+    void ThreadHarvest();
+
+    void LookupChallenge(HarvesterChallenge const& challenge, int64_t nQueuedTime);
+
+    Plot const* FindPlot(PlotId const& plotId) const;
+
+    int const m_nThreads;
+    CCheckQueue<CLookupCheck> m_queue;
+    boost::thread_group m_workers;
+    std::thread m_thread;
+
+    //! The plots are loaded before the harvester starts and never changed after that
+    std::vector<std::unique_ptr<Plot>> m_plots;
+
+    mutable Mutex m_cs;
+    std::condition_variable m_cond;
+    bool m_fStop GUARDED_BY(m_cs){false};
+    bool m_fPending GUARDED_BY(m_cs){false};
+    HarvesterChallenge m_pending GUARDED_BY(m_cs);
+    HarvesterChallenge m_latest GUARDED_BY(m_cs);
+    bool m_fLatestDone GUARDED_BY(m_cs){false};
+    int64_t m_nQueuedTime GUARDED_BY(m_cs){0};
+    std::vector<HarvestedQuality> m_vQualities GUARDED_BY(m_cs);
+    std::vector<HarvesterPlotStats> m_vPlotStats GUARDED_BY(m_cs);
+    uint64_t m_nChallenges GUARDED_BY(m_cs){0};
+    int64_t m_nLastChallengeMicros GUARDED_BY(m_cs){0};
+};
+
+extern std::unique_ptr<CHarvester> g_harvester;
+
+}  // namespace chiapos
+
+#endif
@@ -5,6 +5,7 @@
 #endif
 
 #include <openssl/evp.h>
+#include <openssl/rand.h>
 
 #include <chiabls/elements.hpp>
 #include <chiabls/schemes.hpp>
@@ -107,6 +108,49 @@ bool VerifySignature(PubKey const& pk, Signature const& signature, Bytes const&
     return bls::AugSchemeMPL().Verify(g1, vchMessage, s);
 }
 
+bool BatchVerifySignatures(std::vector<PubKey> const& pubkeys, std::vector<Signature> const& signatures,
+                           std::vector<Bytes> const& vchMessages) {
+    if (pubkeys.size() != signatures.size() || pubkeys.size() != vchMessages.size()) {
+        throw std::runtime_error("the numbers of public-keys, signatures and messages do not match");
+    }
+    if (pubkeys.empty()) {
+        return true;
+    }
+    try {
+        std::vector<bls::G1Element> scaledPks;
+        std::vector<std::vector<uint8_t>> augMessages;
+        scaledPks.reserve(pubkeys.size());
+        augMessages.reserve(pubkeys.size());
+        bls::G2Element aggSig;
+        for (std::size_t i = 0; i < pubkeys.size(); ++i) {
+            auto g1 = bls::G1Element::FromByteVector(MakeBytes(pubkeys[i]));
+            auto g2 = bls::G2Element::FromByteVector(MakeBytes(signatures[i]));
+            if (g1 == bls::G1Element()) {
+                // Leave the public-key at infinity to the individual verification
+                return false;
+            }
+            // A non-zero factor below 2^128, it is always less than the group order
+            std::vector<uint8_t> vchFactor(SK_LEN, 0);
+            if (RAND_bytes(vchFactor.data() + SK_LEN / 2, SK_LEN / 2) != 1) {
+                throw std::runtime_error("cannot generate the random factors for the batch verification");
+            }
+            vchFactor.back() |= 1;
+            auto factor = bls::PrivateKey::FromByteVector(vchFactor);
+            scaledPks.push_back(g1 * factor);
+            aggSig += g2 * factor;
+            // The augmented scheme signs the public-key with the message
+            std::vector<uint8_t> augMessage = g1.Serialize();
+            augMessage.insert(std::end(augMessage), std::begin(vchMessages[i]), std::end(vchMessages[i]));
+            augMessages.push_back(std::move(augMessage));
+        }
+        // e(g1, sum(r_i * sig_i)) == prod(e(r_i * pk_i, H(pk_i || msg_i))), the messages are already augmented
+        bls::AugSchemeMPL scheme;
+        return scheme.CoreMPL::AggregateVerify(scaledPks, augMessages, aggSig);
+    } catch (std::exception const&) {
+        return false;
+    }
+}
+
 PubKey AggregatePubkeys(std::vector<PubKey> const& pks) {
     std::vector<bls::G1Element> elements;
     for (auto const& pk : pks) {
@@ -53,6 +53,14 @@ private:
 
 bool VerifySignature(PubKey const& pubkey, Signature const& signature, Bytes const& vchMessage);
 
+/**
+ * Verify the signatures with one multi-pairing. Each signature and its public-key are multiplied by a random 128-bit
+ * factor, invalid signatures cannot cancel each other out. Returns false when any of the signatures is invalid, the
+ * signatures need to be verified one by one to find out which.
+ */
+bool BatchVerifySignatures(std::vector<PubKey> const& pubkeys, std::vector<Signature> const& signatures,
+                           std::vector<Bytes> const& vchMessages);
+
 PubKey AggregatePubkeys(std::vector<PubKey> const& pks);
 
 class CWallet {
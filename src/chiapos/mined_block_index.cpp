@@ -0,0 +1,150 @@
+#include "mined_block_index.h"
+
+#include <chain.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace chiapos {
+
+namespace {
+
+std::pair<std::vector<int>::const_iterator, std::vector<int>::const_iterator> FindRange(std::vector<int> const& heights,
+                                                                                          int nBeginHeight,
+                                                                                          int nEndHeight) {
+    auto itBegin = std::lower_bound(std::cbegin(heights), std::cend(heights), nBeginHeight);
+    auto itEnd = std::upper_bound(itBegin, std::cend(heights), nEndHeight);
+    return std::make_pair(itBegin, itEnd);
+}
+
+}  // namespace
+
+CMinedBlockIndex g_mined_block_index;
+
+void CMinedBlockIndex::SetTip(CBlockIndex const* pindexTip) {
+    LOCK(m_cs);
+    SetTipInternal(pindexTip);
+}
+
+void CMinedBlockIndex::Reset() {
+    LOCK(m_cs);
+    m_farmerPkHeights.clear();
+    m_plotterIdHeights.clear();
+    m_pindexTip = nullptr;
+}
+
+int CMinedBlockIndex::CountMinedBlocks(CBlockIndex const* pindexTip, std::set<CPlotterBindData> const& plotters,
+                                       int nBeginHeight, int nEndHeight) {
+    assert(nEndHeight <= pindexTip->nHeight);
+    LOCK(m_cs);
+    SetTipInternal(pindexTip);
+    int nCount{0};
+    for (auto const& plotter : plotters) {
+        auto pheights = FindHeights(plotter);
+        if (pheights == nullptr) {
+            continue;
+        }
+        auto range = FindRange(*pheights, nBeginHeight, nEndHeight);
+        nCount += std::distance(range.first, range.second);
+    }
+    return nCount;
+}
+
+std::vector<int> CMinedBlockIndex::GetMinedHeights(CBlockIndex const* pindexTip,
+                                                   std::set<CPlotterBindData> const& plotters, int nBeginHeight,
+                                                   int nEndHeight) {
+    assert(nEndHeight <= pindexTip->nHeight);
+    LOCK(m_cs);
+    SetTipInternal(pindexTip);
+    std::vector<int> res;
+    for (auto const& plotter : plotters) {
+        auto pheights = FindHeights(plotter);
+        if (pheights == nullptr) {
+            continue;
+        }
+        auto range = FindRange(*pheights, nBeginHeight, nEndHeight);
+        std::vector<int> merged;
+        merged.reserve(res.size() + std::distance(range.first, range.second));
+        std::merge(std::cbegin(res), std::cend(res), range.first, range.second, std::back_inserter(merged));
+        res = std::move(merged);
+    }
+    return res;
+}
+
+MinedBlockIndexStats CMinedBlockIndex::GetStats() const {
+    LOCK(m_cs);
+    MinedBlockIndexStats stats;
+    stats.nFarmerPks = m_farmerPkHeights.size();
+    stats.nPlotterIds = m_plotterIdHeights.size();
+    stats.nBlocks = 0;
+    for (auto const& entry : m_farmerPkHeights) {
+        stats.nBlocks += entry.second.size();
+    }
+    for (auto const& entry : m_plotterIdHeights) {
+        stats.nBlocks += entry.second.size();
+    }
+    stats.nTipHeight = m_pindexTip ? m_pindexTip->nHeight : -1;
+    return stats;
+}
+
+void CMinedBlockIndex::SetTipInternal(CBlockIndex const* pindexTip) {
+    if (m_pindexTip == pindexTip) {
+        return;
+    }
+    // Remove the blocks which are not on the new chain
+    while (m_pindexTip != nullptr &&
+           (pindexTip == nullptr || pindexTip->GetAncestor(m_pindexTip->nHeight) != m_pindexTip)) {
+        Disconnect(m_pindexTip);
+        m_pindexTip = m_pindexTip->pprev;
+    }
+    if (pindexTip == nullptr) {
+        return;
+    }
+    // Append the new blocks in ascending order of the heights
+    std::vector<CBlockIndex const*> vConnect;
+    for (auto pindex = pindexTip; pindex != m_pindexTip; pindex = pindex->pprev) {
+        vConnect.push_back(pindex);
+    }
+    for (auto it = vConnect.rbegin(); it != vConnect.rend(); ++it) {
+        GetOrCreateHeights(*it).push_back((*it)->nHeight);
+    }
+    m_pindexTip = pindexTip;
+}
+
+CMinedBlockIndex::Heights& CMinedBlockIndex::GetOrCreateHeights(CBlockIndex const* pindex) {
+    if (pindex->IsChiaBlock()) {
+        return m_farmerPkHeights[pindex->chiaposFields.posProof.vchFarmerPk];
+    }
+    return m_plotterIdHeights[pindex->nPlotterId];
+}
+
+CMinedBlockIndex::Heights const* CMinedBlockIndex::FindHeights(CPlotterBindData const& plotter) const {
+    if (plotter.GetType() == CPlotterBindData::Type::CHIA) {
+        auto it = m_farmerPkHeights.find(plotter.GetChiaFarmerPk().ToBytes());
+        return it != std::cend(m_farmerPkHeights) ? &it->second : nullptr;
+    } else if (plotter.GetType() == CPlotterBindData::Type::BURST) {
+        auto it = m_plotterIdHeights.find(plotter.GetBurstPlotterId());
+        return it != std::cend(m_plotterIdHeights) ? &it->second : nullptr;
+    }
+    return nullptr;
+}
+
+void CMinedBlockIndex::Disconnect(CBlockIndex const* pindex) {
+    if (pindex->IsChiaBlock()) {
+        auto it = m_farmerPkHeights.find(pindex->chiaposFields.posProof.vchFarmerPk);
+        assert(it != std::cend(m_farmerPkHeights) && !it->second.empty() && it->second.back() == pindex->nHeight);
+        it->second.pop_back();
+        if (it->second.empty()) {
+            m_farmerPkHeights.erase(it);
+        }
+    } else {
+        auto it = m_plotterIdHeights.find(pindex->nPlotterId);
+        assert(it != std::cend(m_plotterIdHeights) && !it->second.empty() && it->second.back() == pindex->nHeight);
+        it->second.pop_back();
+        if (it->second.empty()) {
+            m_plotterIdHeights.erase(it);
+        }
+    }
+}
+
+}  // namespace chiapos
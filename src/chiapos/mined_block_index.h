@@ -0,0 +1,73 @@
+#ifndef DEPINC_CHIAPOS_MINED_BLOCK_INDEX_H
+#define DEPINC_CHIAPOS_MINED_BLOCK_INDEX_H
+
+#include <chiapos/kernel/chiapos_types.h>
+#include <chiapos/plotter_id.h>
+#include <sync.h>
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+class CBlockIndex;
+
+namespace chiapos {
+
+struct MinedBlockIndexStats {
+    uint64_t nFarmerPks;
+    uint64_t nPlotterIds;
+    uint64_t nBlocks;
+    int nTipHeight;
+};
+
+/**
+ * The heights of the blocks mined by each farmer-pk (chia blocks) and burst plotter-id (the blocks before BHDIP009)
+ * on a chain. The heights are kept in ascending order so the blocks mined by a set of bound plotters within a range
+ * can be counted by binary searches instead of walking the block indexes.
+ *
+ * The index follows the chain given by the tip, the blocks which are not on the chain anymore are removed and the new
+ * blocks are appended. It is moved to the active tip on connecting and disconnecting blocks, the queries also move it
+ * to the tip they are asked for, so a query never reads the heights from another chain. The ancestors of a block
+ * index never change, the queries can be made on a pinned tip without holding cs_main.
+ */
+class CMinedBlockIndex {
+public:
+    /** Follow the chain ends with pindexTip, the caller must hold cs_main so the block indexes stay valid */
+    void SetTip(CBlockIndex const* pindexTip);
+
+    /** Forget the tip and the heights without touching the block indexes, they may have been freed */
+    void Reset();
+
+    /** The number of blocks mined by the plotters with heights in [nBeginHeight, nEndHeight] on the chain */
+    int CountMinedBlocks(CBlockIndex const* pindexTip, std::set<CPlotterBindData> const& plotters, int nBeginHeight,
+                         int nEndHeight);
+
+    /** The heights of the blocks mined by the plotters in [nBeginHeight, nEndHeight] on the chain, ascending */
+    std::vector<int> GetMinedHeights(CBlockIndex const* pindexTip, std::set<CPlotterBindData> const& plotters,
+                                     int nBeginHeight, int nEndHeight);
+
+    MinedBlockIndexStats GetStats() const;
+
+private:
+    using Heights = std::vector<int>;
+
+    void SetTipInternal(CBlockIndex const* pindexTip) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+
+    Heights& GetOrCreateHeights(CBlockIndex const* pindex) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+
+    Heights const* FindHeights(CPlotterBindData const& plotter) const EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+
+    void Disconnect(CBlockIndex const* pindex) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+
+    mutable Mutex m_cs;
+    std::map<Bytes, Heights> m_farmerPkHeights GUARDED_BY(m_cs);
+    std::map<uint64_t, Heights> m_plotterIdHeights GUARDED_BY(m_cs);
+    CBlockIndex const* m_pindexTip GUARDED_BY(m_cs){nullptr};
+};
+
+extern CMinedBlockIndex g_mined_block_index;
+
+}  // namespace chiapos
+
+#endif
@@ -4,95 +4,38 @@
 #include <validation.h>
 #include <subsidy_utils.h>
 
-#include <util/moneystr.h>
-
-class IndexRangeControl {
-public:
-    static IndexRangeControl& GetInstance() {
-        static IndexRangeControl instance;
-        return instance;
-    }
-
-    int GetLowestHeight() const {
-        if (m_mortgage_heights.empty()) {
-            LogPrint(BCLog::BENCH, "%s: cached 0 heights\n", __func__);
-            return 0;
-        }
-        int nLowestHeight = *m_mortgage_heights.begin();
-        LogPrint(BCLog::BENCH, "%s: cached %d heights, lowest height %d\n", __func__, m_mortgage_heights.size(), nLowestHeight);
-        return nLowestHeight;
-    }
+#include <chiapos/mortgage_ledger.h>
 
-    void InsertHeight(int nHeight) { m_mortgage_heights.insert(nHeight); }
-
-    void RemoveHeight(int nHeight) { m_mortgage_heights.erase(nHeight); }
-
-private:
-    std::set<int> m_mortgage_heights;
-};
-
-CBlockIndex const* FindPrevIndex(int nHeight, CBlockIndex const* pindex) {
-    while (pindex->nHeight >= nHeight) {
-        pindex = pindex->pprev;
-    }
-    return pindex;
-}
+#include <util/moneystr.h>
 
 CMortgageCalculator::CMortgageCalculator(CBlockIndex const* pindexTip, Consensus::Params params)
         : m_pindexTip(pindexTip), m_params(std::move(params)) {}
 
 std::tuple<CAmount, CMortgageCalculator::FullMortgageAccumulatedInfoMap> CMortgageCalculator::CalcAccumulatedAmount(
         int nTargetHeight) const {
-    CAmount nTotalAmount{0};
-    int nLowestHeight = std::max(m_params.BHDIP011Height, IndexRangeControl::GetInstance().GetLowestHeight());
+    std::map<int, CAmount> mapContributions;
+    CAmount nTotalAmount =
+            g_mortgage_ledger.GetAccumulatedAmount(m_pindexTip, nTargetHeight, m_params, &mapContributions);
     FullMortgageAccumulatedInfoMap mapFullMortgageAccumulatedInfo;
-    for (auto pindex = FindPrevIndex(nTargetHeight, m_pindexTip); pindex->nHeight >= nLowestHeight;
-         pindex = pindex->pprev) {
-        if (IsFullMortgageBlock(pindex, m_params)) {
-            CAmount nAccumulatedAmount = CalcDistributeAmountToTargetHeight(pindex->nHeight, nTargetHeight);
-            if (nAccumulatedAmount > 0) {
-                IndexRangeControl::GetInstance().InsertHeight(pindex->nHeight);
-                nTotalAmount += nAccumulatedAmount;
-                FullMortgageAccumulatedInfo entry;
-                entry.nHeight = pindex->nHeight;
-                entry.nAccumulatedAmount = nAccumulatedAmount;
-                mapFullMortgageAccumulatedInfo.insert_or_assign(pindex->nHeight, std::move(entry));
-            } else {
-                IndexRangeControl::GetInstance().RemoveHeight(pindex->nHeight);
-            }
-        }
+    for (auto const& contribution : mapContributions) {
+        FullMortgageAccumulatedInfo entry;
+        entry.nHeight = contribution.first;
+        entry.nAccumulatedAmount = contribution.second;
+        mapFullMortgageAccumulatedInfo.insert_or_assign(contribution.first, std::move(entry));
     }
-    // don't forget to calculate the accumulate amount from current block
-    CAmount nOriginalAccumulated = GetBlockAccumulateSubsidy(FindPrevIndex(nTargetHeight, m_pindexTip), m_params);
-    CAmount nDistributions = CalcNumOfDistributions(nTargetHeight);
-    return std::make_tuple(nTotalAmount + nOriginalAccumulated / nDistributions, mapFullMortgageAccumulatedInfo);
+    return std::make_tuple(nTotalAmount, mapFullMortgageAccumulatedInfo);
+}
+
+CAmount CMortgageCalculator::CalcAccumulatedTotal(int nTargetHeight) const {
+    return g_mortgage_ledger.GetAccumulatedAmount(m_pindexTip, nTargetHeight, m_params);
 }
 
 int CMortgageCalculator::CalcNumOfDistributions(int nHeight) const {
-    CBlockIndex const* pcurr = m_pindexTip;
-    while (pcurr->nHeight >= nHeight) {
-        pcurr = pcurr->pprev;
-    }
-    int nNumOfFullMortgageBlocks{0};
-    int nLowestHeight = std::max(m_params.BHDIP009Height,
-                                 nHeight - m_params.BHDIP011NumHeightsToCalcDistributionPercentageOfFullMortgage);
-    for (auto pindex = pcurr; pindex->nHeight >= nLowestHeight; pindex = pindex->pprev) {
-        if (IsFullMortgageBlock(pindex, m_params)) {
-            ++nNumOfFullMortgageBlocks;
-        }
-    }
-    return std::max(m_params.BHDIP011MinFullMortgageBlocksToDistribute, nNumOfFullMortgageBlocks);
+    return g_mortgage_ledger.CalcNumOfDistributions(m_pindexTip, nHeight, m_params);
 }
 
 int CMortgageCalculator::CalcNumOfDistributedForTargetHeight(int nDistributeFromHeight, int nTargetHeight) const {
-    int nNumOfDistributed{0};
-    for (auto pindex = FindPrevIndex(nTargetHeight, m_pindexTip); pindex->nHeight >= nDistributeFromHeight;
-         pindex = pindex->pprev) {
-        if (IsFullMortgageBlock(pindex, m_params)) {
-            ++nNumOfDistributed;
-        }
-    }
-    return nNumOfDistributed;
+    return g_mortgage_ledger.CountFullMortgageBlocks(m_pindexTip, nDistributeFromHeight, nTargetHeight - 1, m_params);
 }
 
 std::tuple<CAmount, CAmount> CMortgageCalculator::GetDistrInfo(int nDistributeFromHeight, int nTargetHeight) const {
@@ -109,10 +52,14 @@ CAmount CMortgageCalculator::CalcDistributeAmountToTargetHeight(int nDistributeF
     }
 
     CAmount nOriginalAccumulatedAmount =
-            GetBlockAccumulateSubsidy(FindPrevIndex(nDistributeFromHeight, m_pindexTip), m_params);
+            GetBlockAccumulateSubsidy(m_pindexTip->GetAncestor(nDistributeFromHeight - 1), m_params);
     return nOriginalAccumulatedAmount / nDistributions;
 }
 
+bool CMortgageCalculator::GetDistribution(int nHeight, CMortgageLedger::Distribution& distribution) const {
+    return g_mortgage_ledger.GetDistribution(m_pindexTip, nHeight, m_params, distribution);
+}
+
 bool CMortgageCalculator::IsFullMortgageBlock(CBlockIndex const* pindex, Consensus::Params const& params) {
     if (pindex->nHeight < params.BHDIP009Height) {
         return false;
@@ -2,12 +2,14 @@
 #define BITCOIN_MORTGAGE_CALCULATOR_H
 
 #include <map>
-#include <unordered_map>
+#include <tuple>
 
 #include <attributes.h>
 
 #include <consensus/params.h>
 
+#include <chiapos/mortgage_ledger.h>
+
 #include <univalue.h>
 
 class CBlockIndex;
@@ -25,6 +27,9 @@ public:
 
     NODISCARD std::tuple<CAmount, FullMortgageAccumulatedInfoMap> CalcAccumulatedAmount(int nTargetHeight) const;
 
+    /** The same total as CalcAccumulatedAmount, it is read from the ledger without listing the previous blocks */
+    NODISCARD CAmount CalcAccumulatedTotal(int nTargetHeight) const;
+
     NODISCARD int CalcNumOfDistributions(int nHeight) const;
 
     NODISCARD int CalcNumOfDistributedForTargetHeight(int nDistributeFromHeight, int nTargetHeight) const;
@@ -33,12 +38,13 @@ public:
 
     NODISCARD CAmount CalcDistributeAmountToTargetHeight(int nDistributeFromHeight, int nTargetHeight) const;
 
+    NODISCARD bool GetDistribution(int nHeight, CMortgageLedger::Distribution& distribution) const;
+
     NODISCARD static bool IsFullMortgageBlock(CBlockIndex const* pindex, Consensus::Params const& params);
 
 private:
     CBlockIndex const* m_pindexTip;
     Consensus::Params m_params;
-    mutable std::unordered_map<int, int> m_cached_n_distr;
 };
 
 #endif
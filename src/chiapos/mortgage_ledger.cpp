@@ -0,0 +1,168 @@
+#include "mortgage_ledger.h"
+
+#include <chain.h>
+#include <validation.h>
+
+#include <chiapos/mortgage_calculator.h>
+
+#include <algorithm>
+#include <iterator>
+
+CMortgageLedger g_mortgage_ledger;
+
+void CMortgageLedger::SetTip(CBlockIndex const* pindexTip, Consensus::Params const& params) {
+    AssertLockHeld(cs_main);
+    if (m_pindexTip == pindexTip) {
+        return;
+    }
+    // Remove the blocks which are not on the new chain
+    while (m_pindexTip != nullptr &&
+           (pindexTip == nullptr || pindexTip->GetAncestor(m_pindexTip->nHeight) != m_pindexTip)) {
+        Disconnect(m_pindexTip, params);
+        m_pindexTip = m_pindexTip->pprev;
+    }
+    if (pindexTip == nullptr) {
+        return;
+    }
+    // Append the new blocks in ascending order of the heights
+    std::vector<CBlockIndex const*> vConnect;
+    for (auto pindex = pindexTip; pindex != m_pindexTip; pindex = pindex->pprev) {
+        vConnect.push_back(pindex);
+    }
+    for (auto it = vConnect.rbegin(); it != vConnect.rend(); ++it) {
+        Connect(*it, params);
+        m_pindexTip = *it;
+    }
+}
+
+void CMortgageLedger::Reset() {
+    AssertLockHeld(cs_main);
+    m_entries.clear();
+    m_nDistributing = 0;
+    m_mapCompleting.clear();
+    m_pindexTip = nullptr;
+}
+
+int CMortgageLedger::CountFullMortgageBlocks(CBlockIndex const* pindexTip, int nBeginHeight, int nEndHeight,
+                                             Consensus::Params const& params) {
+    assert(nEndHeight <= pindexTip->nHeight);
+    SetTip(pindexTip, params);
+    if (nBeginHeight > nEndHeight) {
+        return 0;
+    }
+    return CountEntriesTo(nEndHeight) - CountEntriesTo(nBeginHeight - 1);
+}
+
+int CMortgageLedger::CalcNumOfDistributions(CBlockIndex const* pindexTip, int nHeight,
+                                            Consensus::Params const& params) {
+    assert(nHeight - 1 <= pindexTip->nHeight);
+    SetTip(pindexTip, params);
+    return CalcNumOfDistributionsInternal(nHeight, params);
+}
+
+CAmount CMortgageLedger::GetAccumulatedAmount(CBlockIndex const* pindexTip, int nTargetHeight,
+                                              Consensus::Params const& params,
+                                              std::map<int, CAmount>* pmapContributions) {
+    assert(nTargetHeight - 1 <= pindexTip->nHeight);
+    SetTip(pindexTip, params);
+    CBlockIndex const* pindexPrev = pindexTip->GetAncestor(nTargetHeight - 1);
+    assert(pindexPrev != nullptr);
+    // The accumulated subsidy before the target goes to the target block as its first distribution
+    CAmount nCurrent =
+            GetBlockAccumulateSubsidy(pindexPrev, params) / CalcNumOfDistributionsInternal(nTargetHeight, params);
+    if (pindexPrev == m_pindexTip && pmapContributions == nullptr) {
+        return m_nDistributing + nCurrent;
+    }
+    // A distribution never lasts more blocks than the largest number of distributions, only the latest entries can
+    // still be running at the target
+    int nCount = CountEntriesTo(nTargetHeight - 1);
+    int nMaxDistributions = std::max(params.BHDIP011MinFullMortgageBlocksToDistribute,
+                                     params.BHDIP011NumHeightsToCalcDistributionPercentageOfFullMortgage);
+    CAmount nTotal{0};
+    for (int i = nCount - 1; i >= 0 && i >= nCount - nMaxDistributions; --i) {
+        auto const& entry = m_entries[i];
+        if (entry.nHeight < params.BHDIP011Height) {
+            break;
+        }
+        if (entry.nCompleteCount > nCount && entry.nAmount > 0) {
+            nTotal += entry.nAmount;
+            if (pmapContributions != nullptr) {
+                pmapContributions->emplace(entry.nHeight, entry.nAmount);
+            }
+        }
+    }
+    return nTotal + nCurrent;
+}
+
+bool CMortgageLedger::GetDistribution(CBlockIndex const* pindexTip, int nHeight, Consensus::Params const& params,
+                                      Distribution& distribution) {
+    assert(nHeight <= pindexTip->nHeight);
+    SetTip(pindexTip, params);
+    int nIndex = CountEntriesTo(nHeight) - 1;
+    if (nIndex < 0 || m_entries[nIndex].nHeight != nHeight) {
+        return false;
+    }
+    distribution.entry = m_entries[nIndex];
+    distribution.nDistributed = std::min<int>(m_entries.size() - nIndex, distribution.entry.nDistributions);
+    distribution.nDistributedAmount = distribution.entry.nAmount * distribution.nDistributed;
+    distribution.nRemainingAmount =
+            distribution.entry.nAmount * (distribution.entry.nDistributions - distribution.nDistributed);
+    return true;
+}
+
+void CMortgageLedger::Connect(CBlockIndex const* pindex, Consensus::Params const& params) {
+    if (!CMortgageCalculator::IsFullMortgageBlock(pindex, params)) {
+        return;
+    }
+    int nCount = m_entries.size();
+    Entry entry;
+    entry.nHeight = pindex->nHeight;
+    entry.nDistributions = CalcNumOfDistributionsInternal(pindex->nHeight, params);
+    entry.nOriginalAccumulated = GetBlockAccumulateSubsidy(pindex->pprev, params);
+    entry.nAmount = entry.nOriginalAccumulated / entry.nDistributions;
+    // The block itself takes the first distribution
+    entry.nCompleteCount = nCount + entry.nDistributions;
+    m_entries.push_back(entry);
+    if (entry.nHeight >= params.BHDIP011Height && entry.nAmount > 0) {
+        m_nDistributing += entry.nAmount;
+        m_mapCompleting[entry.nCompleteCount] += entry.nAmount;
+    }
+    auto it = m_mapCompleting.find(nCount + 1);
+    if (it != std::end(m_mapCompleting)) {
+        m_nDistributing -= it->second;
+    }
+}
+
+void CMortgageLedger::Disconnect(CBlockIndex const* pindex, Consensus::Params const& params) {
+    if (m_entries.empty() || m_entries.back().nHeight != pindex->nHeight) {
+        return;
+    }
+    auto const& entry = m_entries.back();
+    auto it = m_mapCompleting.find(m_entries.size());
+    if (it != std::end(m_mapCompleting)) {
+        m_nDistributing += it->second;
+    }
+    if (entry.nHeight >= params.BHDIP011Height && entry.nAmount > 0) {
+        m_nDistributing -= entry.nAmount;
+        it = m_mapCompleting.find(entry.nCompleteCount);
+        assert(it != std::end(m_mapCompleting));
+        it->second -= entry.nAmount;
+        if (it->second == 0) {
+            m_mapCompleting.erase(it);
+        }
+    }
+    m_entries.pop_back();
+}
+
+int CMortgageLedger::CountEntriesTo(int nHeight) const {
+    auto it = std::upper_bound(std::cbegin(m_entries), std::cend(m_entries), nHeight,
+                               [](int nHeight, Entry const& entry) { return nHeight < entry.nHeight; });
+    return std::distance(std::cbegin(m_entries), it);
+}
+
+int CMortgageLedger::CalcNumOfDistributionsInternal(int nHeight, Consensus::Params const& params) const {
+    int nLowestHeight = std::max(params.BHDIP009Height,
+                                 nHeight - params.BHDIP011NumHeightsToCalcDistributionPercentageOfFullMortgage);
+    int nNumOfFullMortgageBlocks = std::max(0, CountEntriesTo(nHeight - 1) - CountEntriesTo(nLowestHeight - 1));
+    return std::max(params.BHDIP011MinFullMortgageBlocksToDistribute, nNumOfFullMortgageBlocks);
+}
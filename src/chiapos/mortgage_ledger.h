@@ -0,0 +1,99 @@
+#ifndef BITCOIN_MORTGAGE_LEDGER_H
+#define BITCOIN_MORTGAGE_LEDGER_H
+
+#include <amount.h>
+#include <attributes.h>
+#include <consensus/params.h>
+#include <sync.h>
+
+#include <map>
+#include <vector>
+
+class CBlockIndex;
+
+extern RecursiveMutex cs_main;
+
+/**
+ * The distribution of the accumulated subsidy of the full mortgage blocks on a chain (BHDIP011).
+ *
+ * Each full mortgage block since BHDIP009 has an entry. The accumulated subsidy before the block is split into a
+ * number of distributions, one of them goes to the block itself and the others go to the following full mortgage
+ * blocks. The ledger keeps the sum of the distributions still running, so the accumulated amount of the next block is
+ * read without walking back through the distribution window.
+ *
+ * The ledger follows the chain given by the tip, the entries of the blocks which are not on the chain anymore are
+ * removed and the new blocks are appended. It is moved to the active tip on connecting and disconnecting blocks, the
+ * queries also move it to the tip they are asked for.
+ */
+class CMortgageLedger {
+public:
+    struct Entry {
+        int nHeight;
+        //! The number of the full mortgage blocks the accumulated subsidy is distributed to
+        int nDistributions;
+        //! The accumulated subsidy before the block
+        CAmount nOriginalAccumulated;
+        //! The amount goes to each distribution
+        CAmount nAmount;
+        //! The distribution completes when the number of the full mortgage blocks reaches this value
+        int nCompleteCount;
+    };
+
+    struct Distribution {
+        Entry entry;
+        //! The number of the distributions have been made on the chain, including the block itself
+        int nDistributed;
+        CAmount nDistributedAmount;
+        CAmount nRemainingAmount;
+    };
+
+    /** Follow the chain ends with pindexTip */
+    void SetTip(CBlockIndex const* pindexTip, Consensus::Params const& params) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** Forget the tip and the entries without touching the block indexes, they may have been freed */
+    void Reset() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** The number of the full mortgage blocks with heights in [nBeginHeight, nEndHeight] on the chain */
+    NODISCARD int CountFullMortgageBlocks(CBlockIndex const* pindexTip, int nBeginHeight, int nEndHeight,
+                                          Consensus::Params const& params) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** The number of the distributions for the accumulated subsidy before nHeight */
+    NODISCARD int CalcNumOfDistributions(CBlockIndex const* pindexTip, int nHeight, Consensus::Params const& params)
+            EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /**
+     * The accumulated amount goes to a full mortgage block at nTargetHeight, the block before it must be on the chain.
+     * The amounts from the previous full mortgage blocks are returned by pmapContributions (height -> amount) when it
+     * isn't null.
+     */
+    NODISCARD CAmount GetAccumulatedAmount(CBlockIndex const* pindexTip, int nTargetHeight,
+                                           Consensus::Params const& params,
+                                           std::map<int, CAmount>* pmapContributions = nullptr)
+            EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** The distribution of the full mortgage block at nHeight on the chain, false if it isn't a full mortgage block */
+    bool GetDistribution(CBlockIndex const* pindexTip, int nHeight, Consensus::Params const& params,
+                         Distribution& distribution) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+private:
+    void Connect(CBlockIndex const* pindex, Consensus::Params const& params) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    void Disconnect(CBlockIndex const* pindex, Consensus::Params const& params) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    //! The number of the entries with heights not greater than nHeight
+    int CountEntriesTo(int nHeight) const EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    int CalcNumOfDistributionsInternal(int nHeight, Consensus::Params const& params) const
+            EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    std::vector<Entry> m_entries GUARDED_BY(cs_main);
+    //! The sum of the amounts of the running distributions since BHDIP011
+    CAmount m_nDistributing GUARDED_BY(cs_main){0};
+    //! The amounts will be completed when the number of the full mortgage blocks reaches the key
+    std::map<int, CAmount> m_mapCompleting GUARDED_BY(cs_main);
+    CBlockIndex const* m_pindexTip GUARDED_BY(cs_main){nullptr};
+};
+
+extern CMortgageLedger g_mortgage_ledger;
+
+#endif
@@ -3,6 +3,7 @@
 #include <chainparams.h>
 #include <chiapos/block_fields.h>
 #include <chiapos/kernel/bls_key.h>
+#include <chiapos/proof_cache.h>
 
 #include <consensus/validation.h>
 #include <logging.h>
@@ -21,10 +22,6 @@
 
 namespace chiapos {
 
-std::map<uint256, std::set<uint64_t>> g_vdf_requests;
-
-std::map<uint256, std::vector<CVdfProof>> g_vdf_proofs;
-
 uint256 MakeChallenge(CBlockIndex const* pindex, Consensus::Params const& params) {
     assert(pindex);
     int nTargetHeight = pindex->nHeight + 1;
@@ -37,7 +34,41 @@ uint256 MakeChallenge(CBlockIndex const* pindex, Consensus::Params const& params
     }
 }
 
-bool CheckPosProof(CPosProof const& proof, CValidationState& state, Consensus::Params const& params, int nTargetHeight) {
+int GetBitsOfFilter(int nTargetHeight, Consensus::Params const& params) {
+    return nTargetHeight < params.BHDIP009PlotIdBitsOfFilterEnableOnHeight ? 0 : params.BHDIP009PlotIdBitsOfFilter;
+}
+
+bool CHeaderProofsCheck::operator()() {
+    return VerifyBlockProofs(*m_pfields, m_nTargetHeight, *m_pparams, *m_pverified);
+}
+
+bool VerifyBlockProofs(CBlockFields const& fields, int nTargetHeight, Consensus::Params const& params,
+                       CVerifiedProofs& verified) {
+    try {
+        CPosProof const& posProof = fields.posProof;
+        uint256 mixed_quality_string;
+        if (VerifyPosWithCache(posProof.challenge, MakeArray<PK_LEN>(posProof.vchLocalPk),
+                               MakeArray<PK_LEN>(posProof.vchFarmerPk),
+                               MakePubKeyOrHash(static_cast<PlotPubKeyType>(posProof.nPlotType), posProof.vchPoolPkOrHash),
+                               posProof.nPlotK, posProof.vchProof, &mixed_quality_string,
+                               GetBitsOfFilter(nTargetHeight, params))) {
+            verified.mixedQualityString = mixed_quality_string;
+        }
+        CVdfProof const& vdfProof = fields.vdfProof;
+        if (vdfProof.vchY.size() == VDF_FORM_SIZE && !vdfProof.vchProof.empty() && vdfProof.nVdfIters > 0) {
+            verified.fVdfVerified = VerifyVdfWithCache(vdfProof.challenge, MakeZeroForm(), vdfProof.nVdfIters,
+                                                       MakeVDFForm(vdfProof.vchY), vdfProof.vchProof,
+                                                       vdfProof.nWitnessType);
+        }
+    } catch (std::exception const& e) {
+        // The proofs will be checked again by CheckBlockFields and the error will be reported there
+        LogPrint(BCLog::POC, "%s: failed to verify the proofs, %s\n", __func__, e.what());
+    }
+    return !verified.mixedQualityString.IsNull() && verified.fVdfVerified;
+}
+
+bool CheckPosProof(CPosProof const& proof, CValidationState& state, Consensus::Params const& params, int nTargetHeight,
+                   uint256 const* pverifiedQualityString) {
     static char const* SZ_BAD_WHAT = "bad-chia-pos";
 
     if (proof.challenge.IsNull()) {
@@ -90,11 +121,15 @@ bool CheckPosProof(CPosProof const& proof, CValidationState& state, Consensus::P
              __func__, proof.challenge.GetHex(), BytesToHex(proof.vchLocalPk), BytesToHex(proof.vchFarmerPk),
              BytesToHex(proof.vchPoolPkOrHash), proof.nPlotK, BytesToHex(proof.vchProof));
 
-    int nBitsOfFilter = nTargetHeight < params.BHDIP009PlotIdBitsOfFilterEnableOnHeight ? 0 : params.BHDIP009PlotIdBitsOfFilter;
+    if (pverifiedQualityString != nullptr && !pverifiedQualityString->IsNull()) {
+        // The proof has been verified ahead
+        return true;
+    }
+
     bool verified =
-            VerifyPos(proof.challenge, MakeArray<PK_LEN>(proof.vchLocalPk), MakeArray<PK_LEN>(proof.vchFarmerPk),
-                      MakePubKeyOrHash(static_cast<PlotPubKeyType>(proof.nPlotType), proof.vchPoolPkOrHash),
-                      proof.nPlotK, proof.vchProof, nullptr, nBitsOfFilter);
+            VerifyPosWithCache(proof.challenge, MakeArray<PK_LEN>(proof.vchLocalPk), MakeArray<PK_LEN>(proof.vchFarmerPk),
+                               MakePubKeyOrHash(static_cast<PlotPubKeyType>(proof.nPlotType), proof.vchPoolPkOrHash),
+                               proof.nPlotK, proof.vchProof, nullptr, GetBitsOfFilter(nTargetHeight, params));
     if (!verified) {
         return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, SZ_BAD_WHAT,
                              "cannot verify proof");
@@ -102,7 +137,7 @@ bool CheckPosProof(CPosProof const& proof, CValidationState& state, Consensus::P
     return true;
 }
 
-bool CheckVdfProof(CVdfProof const& proof, CValidationState& state) {
+bool CheckVdfProof(CVdfProof const& proof, CValidationState& state, bool fVerified) {
     static char const* SZ_BAD_WHAT = "bad-chia-vdf";
 
     if (proof.challenge.IsNull()) {
@@ -130,12 +165,16 @@ bool CheckVdfProof(CVdfProof const& proof, CValidationState& state) {
                              "zero duration");
     }
 
-    return VerifyVdf(proof.challenge, MakeZeroForm(), proof.nVdfIters, MakeVDFForm(proof.vchY), proof.vchProof,
-                     proof.nWitnessType);
+    if (fVerified) {
+        return true;
+    }
+
+    return VerifyVdfWithCache(proof.challenge, MakeZeroForm(), proof.nVdfIters, MakeVDFForm(proof.vchY), proof.vchProof,
+                              proof.nWitnessType);
 }
 
 bool CheckBlockFields(CBlockFields const& fields, int64_t nTimeOfTheBlock, CBlockIndex const* pindexPrev,
-                      CValidationState& state, Consensus::Params const& params) {
+                      CValidationState& state, Consensus::Params const& params, CVerifiedProofs const* pverified) {
     static char const* SZ_BAD_WHAT = "bad-chia-fields";
     // Initial challenge should be calculated from previous block
     int nTargetHeight = pindexPrev->nHeight + 1;
@@ -214,7 +253,8 @@ bool CheckBlockFields(CBlockFields const& fields, int64_t nTimeOfTheBlock, CBloc
         return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, SZ_BAD_WHAT,
                              "invalid pos challenge");
     }
-    if (!CheckPosProof(fields.posProof, state, params, nTargetHeight)) {
+    uint256 const* pverifiedQualityString = pverified ? &pverified->mixedQualityString : nullptr;
+    if (!CheckPosProof(fields.posProof, state, params, nTargetHeight, pverifiedQualityString)) {
         return false;
     }
 
@@ -223,16 +263,20 @@ bool CheckBlockFields(CBlockFields const& fields, int64_t nTimeOfTheBlock, CBloc
              fields.posProof.nPlotType, fields.posProof.nPlotK);
     PubKeyOrHash poolPkOrHash = chiapos::MakePubKeyOrHash(static_cast<PlotPubKeyType>(fields.posProof.nPlotType),
                                                           fields.posProof.vchPoolPkOrHash);
-    uint256 mixed_quality_string = MakeMixedQualityString(
-            MakeArray<PK_LEN>(fields.posProof.vchLocalPk), MakeArray<PK_LEN>(fields.posProof.vchFarmerPk), poolPkOrHash,
-            fields.posProof.nPlotK, fields.posProof.challenge, fields.posProof.vchProof);
+    uint256 mixed_quality_string;
+    if (pverifiedQualityString != nullptr && !pverifiedQualityString->IsNull()) {
+        mixed_quality_string = *pverifiedQualityString;
+    } else {
+        mixed_quality_string = MakeMixedQualityString(
+                MakeArray<PK_LEN>(fields.posProof.vchLocalPk), MakeArray<PK_LEN>(fields.posProof.vchFarmerPk), poolPkOrHash,
+                fields.posProof.nPlotK, fields.posProof.challenge, fields.posProof.vchProof);
+    }
     if (mixed_quality_string.IsNull()) {
         return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, SZ_BAD_WHAT,
                              "mixed quality-string is null(wrong PoS)\n");
     }
     uint64_t nBaseIters = GetBaseIters(nTargetHeight, params, pindexPrev->chiaposFields.GetItersPerSec());
-    int nBitsFilter =
-            nTargetHeight < params.BHDIP009PlotIdBitsOfFilterEnableOnHeight ? 0 : params.BHDIP009PlotIdBitsOfFilter;
+    int nBitsFilter = GetBitsOfFilter(nTargetHeight, params);
     uint64_t nItersRequired = CalculateIterationsQuality(
             mixed_quality_string, GetDifficultyForNextIterations(pindexPrev, params), nBitsFilter,
             params.BHDIP009DifficultyConstantFactorBits, fields.posProof.nPlotK, nBaseIters);
@@ -245,7 +289,7 @@ bool CheckBlockFields(CBlockFields const& fields, int64_t nTimeOfTheBlock, CBloc
     // Check vdf-proof
     LogPrint(BCLog::POC, "%s: checking VDF proof\n", __func__);
     try {
-        if (!CheckVdfProof(fields.vdfProof, state)) {
+        if (!CheckVdfProof(fields.vdfProof, state, pverified && pverified->fVdfVerified)) {
             return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, SZ_BAD_WHAT,
                     "vdf proof cannot be verified");
         }
@@ -300,6 +344,13 @@ uint64_t GetDifficultyForNextIterations(CBlockIndex const* pindex, Consensus::Pa
     if (nTargetHeight == params.BHDIP009Height) {
         return params.BHDIP009StartDifficulty;
     }
+    if (pindex->nChiaWindowBlocks >= 0) {
+        if (pindex->nChiaWindowBlocks == 0) {
+            return params.BHDIP009StartDifficulty;
+        }
+        return (pindex->nChiaDifficultySum / pindex->nChiaWindowBlocks).GetLow64();
+    }
+    // The sums are not ready, calculate it from the ancestors
     arith_uint256 totalDifficulty{0};
     int nCount = params.BHDIP009DifficultyEvalWindow;
     while (nCount > 0 && pindex != nullptr && pindex->nHeight >= params.BHDIP009Height) {
@@ -315,6 +366,35 @@ uint64_t GetDifficultyForNextIterations(CBlockIndex const* pindex, Consensus::Pa
     return (totalDifficulty / nBlocksCalc).GetLow64();
 }
 
+arith_uint256 GetBlockNetworkSpace(CBlockIndex const* pindex, Consensus::Params const& params) {
+    return CalculateNetworkSpace(GetDifficultyForNextIterations(pindex->pprev, params),
+                                 pindex->chiaposFields.GetTotalIters(), params.BHDIP009DifficultyConstantFactorBits);
+}
+
+void UpdateWindowSums(CBlockIndex* pindex, Consensus::Params const& params) {
+    if (pindex->nHeight < params.BHDIP009Height) {
+        pindex->nChiaDifficultySum = 0;
+        pindex->nChiaNetspaceSum = 0;
+        pindex->nChiaWindowBlocks = 0;
+        return;
+    }
+    if (pindex->pprev == nullptr || pindex->pprev->nChiaWindowBlocks < 0) {
+        // The sums cannot be calculated without the predecessor
+        pindex->nChiaWindowBlocks = -1;
+        return;
+    }
+    pindex->nChiaDifficultySum = pindex->pprev->nChiaDifficultySum + GetChiaBlockDifficulty(pindex, params);
+    pindex->nChiaNetspaceSum = pindex->pprev->nChiaNetspaceSum + GetBlockNetworkSpace(pindex, params);
+    int nLeaveHeight = pindex->nHeight - params.BHDIP009DifficultyEvalWindow;
+    if (nLeaveHeight >= params.BHDIP009Height) {
+        // The block is moved out from the window
+        CBlockIndex const* pindexLeave = pindex->GetAncestor(nLeaveHeight);
+        pindex->nChiaDifficultySum -= GetChiaBlockDifficulty(pindexLeave, params);
+        pindex->nChiaNetspaceSum -= GetBlockNetworkSpace(pindexLeave, params);
+    }
+    pindex->nChiaWindowBlocks = std::min(pindex->nHeight - params.BHDIP009Height + 1, params.BHDIP009DifficultyEvalWindow);
+}
+
 int GetBaseIters(int nTargetHeight, Consensus::Params const& params, int iters_sec) {
     for (auto i = std::crbegin(params.BHDIP009BaseItersVec); i != std::crend(params.BHDIP009BaseItersVec); ++i) {
         if (nTargetHeight >= i->first) {
@@ -371,71 +451,4 @@ double GetDifficultyChangeMaxFactor(int nTargetHeight, Consensus::Params const&
     return params.BHDIP009DifficultyChangeMaxFactor;
 }
 
-bool AddLocalVdfRequest(uint256 const& challenge, uint64_t nIters) {
-    AssertLockHeld(cs_main);
-    auto it = g_vdf_requests.find(challenge);
-    if (it == std::cend(g_vdf_requests)) {
-        g_vdf_requests.insert(std::make_pair(challenge, std::set<uint64_t>{nIters}));
-        return true;
-    }
-    if (it->second.find(nIters) == std::cend(it->second)) {
-        it->second.insert(nIters);
-        return true;
-    }
-    return false;
-}
-
-std::set<uint64_t> QueryLocalVdfRequests(uint256 const& challenge) {
-    AssertLockHeld(cs_main);
-    auto it = g_vdf_requests.find(challenge);
-    if (it == std::cend(g_vdf_requests)) {
-        return {};
-    }
-    return it->second;
-}
-
-bool AddLocalVdfProof(CVdfProof vdfProof) {
-    AssertLockHeld(cs_main);
-    auto it = g_vdf_proofs.find(vdfProof.challenge);
-    if (it == std::cend(g_vdf_proofs)) {
-        g_vdf_proofs.insert(std::make_pair(vdfProof.challenge, std::vector<CVdfProof>{std::move(vdfProof)}));
-        return true;
-    }
-    auto it_vdfProof = std::find_if(std::cbegin(it->second), std::cend(it->second), [&vdfProof](CVdfProof const& vdfProofItem) {
-        return vdfProof.Equals(vdfProofItem);
-    });
-    if (it_vdfProof == std::cend(it->second)) {
-        it->second.push_back(std::move(vdfProof));
-        return true;
-    }
-    return false;
-}
-
-bool FindLocalVdfProof(uint256 const& challenge, uint64_t nIters, CVdfProof* pvdfProof) {
-    AssertLockHeld(cs_main);
-    auto it = g_vdf_proofs.find(challenge);
-    if (it == std::cend(g_vdf_proofs)) {
-        return false;
-    }
-    auto it_vdfProof = std::find_if(std::cbegin(it->second), std::cend(it->second), [nIters](CVdfProof const& vdfProof) {
-        return vdfProof.nVdfIters >= nIters;
-    });
-    if (it_vdfProof == std::cend(it->second)) {
-        return false;
-    }
-    if (pvdfProof) {
-        *pvdfProof = *it_vdfProof;
-    }
-    return true;
-}
-
-std::vector<CVdfProof> QueryLocalVdfProof(uint256 const& challenge) {
-    AssertLockHeld(cs_main);
-    auto it = g_vdf_proofs.find(challenge);
-    if (it == std::cend(g_vdf_proofs)) {
-        return {};
-    }
-    return it->second;
-}
-
 }  // namespace chiapos
@@ -23,14 +23,61 @@ namespace chiapos {
 
 class NewBlockWatcher;
 
+/** The results of the proofs which are verified ahead without the context of the chain */
+struct CVerifiedProofs {
+    //! The mixed quality string of the verified PoS proof, null when the PoS proof isn't verified
+    uint256 mixedQualityString;
+    bool fVdfVerified{false};
+    //! The unformatted deadline of the header before BHDIP009 and the generation signature it is calculated from
+    bool fDeadlineCalculated{false};
+    uint256 generationSignature;
+    uint64_t nUnformattedDeadline{0};
+};
+
+/** A check for the proofs of a header, it can be run by the workers of CCheckQueue */
+class CHeaderProofsCheck {
+public:
+    CHeaderProofsCheck() = default;
+
+    CHeaderProofsCheck(CBlockFields const& fields, int nTargetHeight, Consensus::Params const& params,
+                       CVerifiedProofs* pverified)
+            : m_pfields(&fields), m_nTargetHeight(nTargetHeight), m_pparams(&params), m_pverified(pverified) {}
+
+    bool operator()();
+
+    void swap(CHeaderProofsCheck& check) {
+        std::swap(m_pfields, check.m_pfields);
+        std::swap(m_nTargetHeight, check.m_nTargetHeight);
+        std::swap(m_pparams, check.m_pparams);
+        std::swap(m_pverified, check.m_pverified);
+    }
+
+private:
+    CBlockFields const* m_pfields{nullptr};
+    int m_nTargetHeight{0};
+    Consensus::Params const* m_pparams{nullptr};
+    CVerifiedProofs* m_pverified{nullptr};
+};
+
 uint256 MakeChallenge(CBlockIndex const* pindex, Consensus::Params const& params);
 
-bool CheckPosProof(CPosProof const& proof, CValidationState& state, Consensus::Params const& params, int nTargetHeight);
+/**
+ * Verify the PoS and VDF proofs with the challenges from the fields, the challenges aren't checked here, they will be
+ * checked by CheckBlockFields
+ *
+ * @return true when both proofs are verified
+ */
+bool VerifyBlockProofs(CBlockFields const& fields, int nTargetHeight, Consensus::Params const& params,
+                       CVerifiedProofs& verified);
+
+bool CheckPosProof(CPosProof const& proof, CValidationState& state, Consensus::Params const& params, int nTargetHeight,
+                   uint256 const* pverifiedQualityString = nullptr);
 
-bool CheckVdfProof(CVdfProof const& proof, CValidationState& state);
+bool CheckVdfProof(CVdfProof const& proof, CValidationState& state, bool fVerified = false);
 
 bool CheckBlockFields(CBlockFields const& fields, int64_t nTimeOfTheBlock, CBlockIndex const* pindexPrev,
-                      CValidationState& state, Consensus::Params const& params);
+                      CValidationState& state, Consensus::Params const& params,
+                      CVerifiedProofs const* pverified = nullptr);
 
 bool ReleaseBlock(std::shared_ptr<CBlock> pblock, CChainParams const& params);
 
@@ -40,24 +87,24 @@ uint64_t GetChiaBlockDifficulty(CBlockIndex const* pindex, Consensus::Params con
 
 uint64_t GetDifficultyForNextIterations(CBlockIndex const* pindex, Consensus::Params const& params);
 
+arith_uint256 GetBlockNetworkSpace(CBlockIndex const* pindex, Consensus::Params const& params);
+
+/**
+ * Calculate the sums of difficulty and netspace over the evaluation window ending at the block from the sums of its
+ * predecessor, it should be called by height ascent
+ */
+void UpdateWindowSums(CBlockIndex* pindex, Consensus::Params const& params);
+
 int GetBaseIters(int nTargetHeight, Consensus::Params const& params, int iters_sec);
 
+int GetBitsOfFilter(int nTargetHeight, Consensus::Params const& params);
+
 int GetAdjustTargetSpacing(int nTargetHeight, Consensus::Params const& params);
 
 double GetTargetMulFactor(int nTargetHeight, Consensus::Params const& params);
 
 double GetDifficultyChangeMaxFactor(int nTargetHeight, Consensus::Params const& params);
 
-bool AddLocalVdfRequest(uint256 const& challenge, uint64_t nIters);
-
-std::set<uint64_t> QueryLocalVdfRequests(uint256 const& challenge);
-
-bool AddLocalVdfProof(CVdfProof vdfProof);
-
-bool FindLocalVdfProof(uint256 const& challenge, uint64_t nIters, CVdfProof* pvdfProof = nullptr);
-
-std::vector<CVdfProof> QueryLocalVdfProof(uint256 const& challenge);
-
 }  // namespace chiapos
 
 #endif
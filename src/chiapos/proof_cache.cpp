@@ -0,0 +1,295 @@
+#include "proof_cache.h"
+
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
+#include <logging.h>
+#include <random.h>
+#include <script/sigcache.h>
+#include <sync.h>
+#include <util/system.h>
+
+#include <chiapos/kernel/utils.h>
+
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+
+namespace chiapos {
+
+namespace {
+
+//! Approximate memory used by one entry of the PoS cache, the key, the value and the overhead of the containers
+constexpr std::size_t POS_CACHE_ENTRY_BYTES = 32 * 3 + 64;
+
+class SaltedEntryHasher {
+public:
+    std::size_t operator()(uint256 const& entry) const { return static_cast<std::size_t>(entry.GetUint64(0)); }
+};
+
+/**
+ * Caches for the verified proofs, to avoid verifying the same VDF or PoS proof or farmer signature twice. The entries
+ * are SHA256(nonce || data of the proof).
+ */
+class CProofCache {
+public:
+    CProofCache() { GetRandBytes(m_nonce.begin(), 32); }
+
+    void Setup(std::size_t nBytes) {
+        {
+            boost::unique_lock<boost::shared_mutex> lock(m_cs_vdf);
+            m_nVdfCapacity = m_vdf_valid.setup_bytes(nBytes / 3);
+        }
+        {
+            boost::unique_lock<boost::shared_mutex> lock(m_cs_sig);
+            m_nSigCapacity = m_sig_valid.setup_bytes(nBytes / 3);
+        }
+        LOCK(m_cs_pos);
+        m_nPosCapacity = std::max<std::size_t>(1, nBytes / 3 / POS_CACHE_ENTRY_BYTES);
+        m_pos_valid.clear();
+        m_pos_order.clear();
+    }
+
+    CSHA256 MakeHasher() const {
+        CSHA256 hasher;
+        hasher.Write(m_nonce.begin(), 32);
+        return hasher;
+    }
+
+    bool GetVdf(uint256 const& entry) {
+        boost::shared_lock<boost::shared_mutex> lock(m_cs_vdf);
+        bool fHit = m_nVdfCapacity > 0 && m_vdf_valid.contains(entry, false);
+        ++(fHit ? m_nVdfHits : m_nVdfMisses);
+        return fHit;
+    }
+
+    void SetVdf(uint256 const& entry) {
+        boost::unique_lock<boost::shared_mutex> lock(m_cs_vdf);
+        if (m_nVdfCapacity > 0) {
+            m_vdf_valid.insert(entry);
+        }
+    }
+
+    bool GetSig(uint256 const& entry) {
+        boost::shared_lock<boost::shared_mutex> lock(m_cs_sig);
+        bool fHit = m_nSigCapacity > 0 && m_sig_valid.contains(entry, false);
+        ++(fHit ? m_nSigHits : m_nSigMisses);
+        return fHit;
+    }
+
+    void SetSig(uint256 const& entry) {
+        boost::unique_lock<boost::shared_mutex> lock(m_cs_sig);
+        if (m_nSigCapacity > 0) {
+            m_sig_valid.insert(entry);
+        }
+    }
+
+    bool GetPos(uint256 const& entry, uint256& mixed_quality_string) {
+        LOCK(m_cs_pos);
+        auto it = m_pos_valid.find(entry);
+        if (it == std::end(m_pos_valid)) {
+            ++m_nPosMisses;
+            return false;
+        }
+        ++m_nPosHits;
+        mixed_quality_string = it->second;
+        return true;
+    }
+
+    void SetPos(uint256 const& entry, uint256 const& mixed_quality_string) {
+        LOCK(m_cs_pos);
+        if (m_nPosCapacity == 0 || !m_pos_valid.emplace(entry, mixed_quality_string).second) {
+            return;
+        }
+        m_pos_order.push_back(entry);
+        // Drop the oldest entries
+        while (m_pos_order.size() > m_nPosCapacity) {
+            m_pos_valid.erase(m_pos_order.front());
+            m_pos_order.pop_front();
+        }
+    }
+
+    ProofCacheStats GetStats() {
+        ProofCacheStats stats;
+        stats.nVdfHits = m_nVdfHits;
+        stats.nVdfMisses = m_nVdfMisses;
+        stats.nPosHits = m_nPosHits;
+        stats.nPosMisses = m_nPosMisses;
+        stats.nSigHits = m_nSigHits;
+        stats.nSigMisses = m_nSigMisses;
+        {
+            boost::shared_lock<boost::shared_mutex> lock(m_cs_vdf);
+            stats.nVdfCapacity = m_nVdfCapacity;
+        }
+        {
+            boost::shared_lock<boost::shared_mutex> lock(m_cs_sig);
+            stats.nSigCapacity = m_nSigCapacity;
+        }
+        LOCK(m_cs_pos);
+        stats.nPosEntries = m_pos_valid.size();
+        stats.nPosCapacity = m_nPosCapacity;
+        return stats;
+    }
+
+private:
+    uint256 m_nonce;
+
+    boost::shared_mutex m_cs_vdf;
+    CuckooCache::cache<uint256, SignatureCacheHasher> m_vdf_valid;
+    uint32_t m_nVdfCapacity{0};
+
+    boost::shared_mutex m_cs_sig;
+    CuckooCache::cache<uint256, SignatureCacheHasher> m_sig_valid;
+    uint32_t m_nSigCapacity{0};
+
+    //! The cuckoo cache can only tell whether the entry exists, PoS entries need to carry the mixed quality strings
+    Mutex m_cs_pos;
+    std::unordered_map<uint256, uint256, SaltedEntryHasher> m_pos_valid GUARDED_BY(m_cs_pos);
+    std::deque<uint256> m_pos_order GUARDED_BY(m_cs_pos);
+    std::size_t m_nPosCapacity GUARDED_BY(m_cs_pos){0};
+
+    std::atomic<uint64_t> m_nVdfHits{0};
+    std::atomic<uint64_t> m_nVdfMisses{0};
+    std::atomic<uint64_t> m_nPosHits{0};
+    std::atomic<uint64_t> m_nPosMisses{0};
+    std::atomic<uint64_t> m_nSigHits{0};
+    std::atomic<uint64_t> m_nSigMisses{0};
+};
+
+CProofCache g_proof_cache;
+
+uint256 MakeSignatureEntry(PubKey const& pubkey, Signature const& signature, Bytes const& vchMessage) {
+    uint256 entry;
+    g_proof_cache.MakeHasher()
+            .Write(pubkey.data(), pubkey.size())
+            .Write(signature.data(), signature.size())
+            .Write(vchMessage.data(), vchMessage.size())
+            .Finalize(entry.begin());
+    return entry;
+}
+
+}  // namespace
+
+void InitProofCache() {
+    std::size_t nMaxCacheSize =
+            std::min(std::max<int64_t>(0, gArgs.GetArg("-maxproofcachesize", DEFAULT_MAX_PROOF_CACHE_SIZE)),
+                     MAX_MAX_PROOF_CACHE_SIZE) *
+            (static_cast<std::size_t>(1) << 20);
+    g_proof_cache.Setup(nMaxCacheSize);
+    ProofCacheStats stats = g_proof_cache.GetStats();
+    LogPrintf("Using %zu MiB for proof cache, able to store %u VDF proofs, %u PoS proofs and %u farmer signatures\n",
+              nMaxCacheSize >> 20, stats.nVdfCapacity, stats.nPosCapacity, stats.nSigCapacity);
+}
+
+bool VerifyVdfWithCache(uint256 const& challenge, VdfForm const& x, uint64_t nIters, VdfForm const& y,
+                        Bytes const& proof, uint8_t nWitnessType) {
+    uint8_t vchIters[8];
+    WriteLE64(vchIters, nIters);
+    uint256 entry;
+    g_proof_cache.MakeHasher()
+            .Write(challenge.begin(), challenge.size())
+            .Write(x.data(), x.size())
+            .Write(vchIters, sizeof(vchIters))
+            .Write(y.data(), y.size())
+            .Write(proof.data(), proof.size())
+            .Write(&nWitnessType, 1)
+            .Finalize(entry.begin());
+    if (g_proof_cache.GetVdf(entry)) {
+        return true;
+    }
+    if (!VerifyVdf(challenge, x, nIters, y, proof, nWitnessType)) {
+        return false;
+    }
+    g_proof_cache.SetVdf(entry);
+    return true;
+}
+
+bool VerifyPosWithCache(uint256 const& challenge, PubKey const& localPk, PubKey const& farmerPk,
+                        PubKeyOrHash const& poolPkOrHash, uint8_t k, Bytes const& vchProof,
+                        uint256* out_mixed_quality_string, int bits_of_filter) {
+    Bytes vchPoolPkOrHash = ToBytes(poolPkOrHash);
+    uint8_t nType = static_cast<uint8_t>(GetType(poolPkOrHash));
+    uint8_t vchBits[4];
+    WriteLE32(vchBits, static_cast<uint32_t>(bits_of_filter));
+    uint256 entry;
+    g_proof_cache.MakeHasher()
+            .Write(challenge.begin(), challenge.size())
+            .Write(localPk.data(), localPk.size())
+            .Write(farmerPk.data(), farmerPk.size())
+            .Write(&nType, 1)
+            .Write(vchPoolPkOrHash.data(), vchPoolPkOrHash.size())
+            .Write(&k, 1)
+            .Write(vchProof.data(), vchProof.size())
+            .Write(vchBits, sizeof(vchBits))
+            .Finalize(entry.begin());
+    uint256 mixed_quality_string;
+    if (!g_proof_cache.GetPos(entry, mixed_quality_string)) {
+        if (!VerifyPos(challenge, localPk, farmerPk, poolPkOrHash, k, vchProof, &mixed_quality_string,
+                       bits_of_filter)) {
+            return false;
+        }
+        g_proof_cache.SetPos(entry, mixed_quality_string);
+    }
+    if (out_mixed_quality_string != nullptr) {
+        *out_mixed_quality_string = mixed_quality_string;
+    }
+    return true;
+}
+
+bool VerifySignatureWithCache(PubKey const& pubkey, Signature const& signature, Bytes const& vchMessage) {
+    uint256 entry = MakeSignatureEntry(pubkey, signature, vchMessage);
+    if (g_proof_cache.GetSig(entry)) {
+        return true;
+    }
+    if (!VerifySignature(pubkey, signature, vchMessage)) {
+        return false;
+    }
+    g_proof_cache.SetSig(entry);
+    return true;
+}
+
+void CSignatureBatch::Add(PubKey const& pubkey, Signature const& signature, Bytes const& vchMessage) {
+    uint256 entry = MakeSignatureEntry(pubkey, signature, vchMessage);
+    if (g_proof_cache.GetSig(entry)) {
+        return;
+    }
+    m_pubkeys.push_back(pubkey);
+    m_signatures.push_back(signature);
+    m_vchMessages.push_back(vchMessage);
+    m_entries.push_back(entry);
+}
+
+bool CSignatureBatch::Verify() {
+    bool fValid{true};
+    if (BatchVerifySignatures(m_pubkeys, m_signatures, m_vchMessages)) {
+        for (auto const& entry : m_entries) {
+            g_proof_cache.SetSig(entry);
+        }
+    } else {
+        // Find out the invalid signatures, the valid ones still go to the cache
+        LogPrint(BCLog::BENCH, "%s: batch of %u signatures failed, verifying them one by one\n", __func__,
+                 (unsigned int) m_entries.size());
+        for (std::size_t i = 0; i < m_entries.size(); ++i) {
+            bool fSigValid{false};
+            try {
+                fSigValid = VerifySignature(m_pubkeys[i], m_signatures[i], m_vchMessages[i]);
+            } catch (std::exception const&) {
+            }
+            if (fSigValid) {
+                g_proof_cache.SetSig(m_entries[i]);
+            } else {
+                fValid = false;
+            }
+        }
+    }
+    m_pubkeys.clear();
+    m_signatures.clear();
+    m_vchMessages.clear();
+    m_entries.clear();
+    return fValid;
+}
+
+ProofCacheStats GetProofCacheStats() { return g_proof_cache.GetStats(); }
+
+}  // namespace chiapos
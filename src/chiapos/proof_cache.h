@@ -0,0 +1,76 @@
+#ifndef DEPINC_CHIAPOS_PROOF_CACHE_H
+#define DEPINC_CHIAPOS_PROOF_CACHE_H
+
+#include <chiapos/kernel/bls_key.h>
+#include <chiapos/kernel/chiapos_types.h>
+#include <chiapos/kernel/pos.h>
+#include <chiapos/kernel/vdf.h>
+#include <uint256.h>
+
+#include <cstdint>
+#include <vector>
+
+//! Limit the size of the caches for the verified VDF and PoS proofs and farmer signatures to <n> MiB
+static const int64_t DEFAULT_MAX_PROOF_CACHE_SIZE = 8;
+//! Maximum proof cache size allowed
+static const int64_t MAX_MAX_PROOF_CACHE_SIZE = 1024;
+
+namespace chiapos {
+
+struct ProofCacheStats {
+    uint64_t nVdfHits;
+    uint64_t nVdfMisses;
+    uint64_t nPosHits;
+    uint64_t nPosMisses;
+    uint32_t nVdfCapacity;
+    uint64_t nPosEntries;
+    uint64_t nPosCapacity;
+    uint64_t nSigHits;
+    uint64_t nSigMisses;
+    uint32_t nSigCapacity;
+};
+
+/** To be called once in AppInitMain/BasicTestingSetup to initialize the caches of the verified proofs */
+void InitProofCache();
+
+/**
+ * The same as VerifyVdf, the proofs passed the verification are stored in the cache, the proof which is relayed over
+ * the network won't be verified again when the block arrives
+ */
+bool VerifyVdfWithCache(uint256 const& challenge, VdfForm const& x, uint64_t nIters, VdfForm const& y,
+                        Bytes const& proof, uint8_t nWitnessType);
+
+/** The same as VerifyPos, the mixed quality string is stored in the cache with the proof */
+bool VerifyPosWithCache(uint256 const& challenge, PubKey const& localPk, PubKey const& farmerPk,
+                        PubKeyOrHash const& poolPkOrHash, uint8_t k, Bytes const& vchProof,
+                        uint256* out_mixed_quality_string, int bits_of_filter);
+
+/** The same as VerifySignature, the signatures passed the verification or a batch are stored in the cache */
+bool VerifySignatureWithCache(PubKey const& pubkey, Signature const& signature, Bytes const& vchMessage);
+
+/**
+ * Queue the farmer signatures of a run of blocks and verify them in one multi-pairing. The signatures which are
+ * already in the cache are skipped. When the batch fails the signatures are verified one by one, the valid ones are
+ * stored in the cache either way, so CheckBlock won't verify them again.
+ */
+class CSignatureBatch {
+public:
+    void Add(PubKey const& pubkey, Signature const& signature, Bytes const& vchMessage);
+
+    std::size_t Size() const { return m_pubkeys.size(); }
+
+    /** Verify the queued signatures and clear the batch, returns false when any of them is invalid */
+    bool Verify();
+
+private:
+    std::vector<PubKey> m_pubkeys;
+    std::vector<Signature> m_signatures;
+    std::vector<Bytes> m_vchMessages;
+    std::vector<uint256> m_entries;
+};
+
+ProofCacheStats GetProofCacheStats();
+
+}  // namespace chiapos
+
+#endif
@@ -66,6 +66,10 @@ void FrontEndClient::Connect(std::string const& host, unsigned short port, Conne
         });
     } catch (std::exception const& e) {
         PLOGE << tinyformat::format("error on connecting, %s", e.what());
+        st_ = Status::CLOSED;
+        asio::post(ioc_, [self = shared_from_this(), errs = std::string(e.what())]() {
+            self->err_handler_(FrontEndClient::ErrorType::CONN, errs);
+        });
     }
 }
 
@@ -154,6 +158,10 @@ std::shared_ptr<TimelordClient> TimelordClient::CreateTimelordClient(asio::io_co
             error_code ignored_ec;
             self->ptimer_waitpong_->cancel(ignored_ec);
         }
+        if (self->pong_handler_) {
+            self->pong_handler_(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - self->ping_time_));
+        }
     }));
     pinstance->msg_handlers_.insert(std::make_pair(static_cast<int>(TimelordMsgs::PROOF), [wp](UniValue const& msg) {
         auto self = wp.lock();
@@ -210,6 +218,8 @@ void TimelordClient::SetErrorHandler(ErrorHandler err_handler) { err_handler_ =
 
 void TimelordClient::SetProofReceiver(ProofReceiver proof_receiver) { proof_receiver_ = std::move(proof_receiver); }
 
+void TimelordClient::SetPongHandler(PongHandler pong_handler) { pong_handler_ = std::move(pong_handler); }
+
 void TimelordClient::Calc(uint256 const& challenge, uint64_t iters, uint256 const& group_hash, uint64_t total_size,
                           int interval_secs) {
     UniValue msg(UniValue::VOBJ);
@@ -278,19 +288,33 @@ void TimelordClient::Exit() {
 
     error_code ignored_ec;
     timer_pingpong_.cancel(ignored_ec);
+    if (ptimer_sender_) {
+        ptimer_sender_->cancel(ignored_ec);
+    }
+    if (ptimer_waitpong_) {
+        ptimer_waitpong_->cancel(ignored_ec);
+    }
     pclient_->Exit();
 }
 
+bool TimelordClient::Ping() {
+    UniValue msg(UniValue::VOBJ);
+    msg.pushKV("id", static_cast<int>(TimelordClientMsgs::PING));
+    if (!pclient_->SendMessage(msg)) {
+        return false;
+    }
+    ping_time_ = std::chrono::steady_clock::now();
+    DoWaitPong();
+    return true;
+}
+
 void TimelordClient::DoWriteNextPing() {
     timer_pingpong_.expires_after(std::chrono::seconds(SECONDS_TO_PING));
     timer_pingpong_.async_wait([self = shared_from_this()](error_code const& ec) {
         if (ec) {
             return;
         }
-        UniValue msg(UniValue::VOBJ);
-        msg.pushKV("id", static_cast<int>(TimelordClientMsgs::PING));
-        if (self->pclient_->SendMessage(msg)) {
-            self->DoWaitPong();
+        if (self->Ping()) {
             self->DoWriteNextPing();
         }
     });
@@ -1,6 +1,7 @@
 #ifndef TIMELORD_CLIENT_H
 #define TIMELORD_CLIENT_H
 
+#include <chrono>
 #include <functional>
 
 #include <vector>
@@ -76,6 +77,7 @@ public:
     using ConnectionHandler = std::function<void()>;
     using ErrorHandler = std::function<void(FrontEndClient::ErrorType type, std::string const& errs)>;
     using MessageHandler = std::function<void(UniValue const& msg)>;
+    using PongHandler = std::function<void(std::chrono::milliseconds rtt)>;
 
     static std::shared_ptr<TimelordClient> CreateTimelordClient(asio::io_context& ioc);
 
@@ -93,11 +95,17 @@ public:
 
     void SetProofReceiver(ProofReceiver proof_receiver);
 
+    /** The handler is called with the round trip time when PONG arrives */
+    void SetPongHandler(PongHandler pong_handler);
+
     void Calc(uint256 const& challenge, uint64_t iters, uint256 const& group_hash, uint64_t total_size,
               int interval_secs);
 
     void Connect(std::string const& host, unsigned short port);
 
+    /** Send PING immediately, it's also sent every minute after the connection is established */
+    bool Ping();
+
     void Exit();
 
 private:
@@ -113,9 +121,11 @@ private:
     std::shared_ptr<asio::steady_timer> ptimer_sender_;
     asio::steady_timer timer_pingpong_;
     std::unique_ptr<asio::steady_timer> ptimer_waitpong_;
+    std::chrono::steady_clock::time_point ping_time_;
     ConnectionHandler conn_handler_;
     ErrorHandler err_handler_;
     ProofReceiver proof_receiver_;
+    PongHandler pong_handler_;
 };
 
 #endif
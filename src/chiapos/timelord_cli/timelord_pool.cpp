@@ -0,0 +1,251 @@
+#include "timelord_pool.h"
+
+#include <tinyformat.h>
+#include <plog/Log.h>
+
+#include <algorithm>
+
+//! The requests of the challenges which are older than the latest ones are forgotten
+static int const MAX_CHALLENGES = 8;
+static int const MIN_BACKOFF_SECS = 1;
+static int const MAX_BACKOFF_SECS = 64;
+
+std::shared_ptr<TimelordClientPool> TimelordClientPool::CreateTimelordClientPool(
+        asio::io_context& ioc, std::vector<TimelordEndpoint> endpoints) {
+    return std::shared_ptr<TimelordClientPool>(new TimelordClientPool(ioc, std::move(endpoints)));
+}
+
+TimelordClientPool::TimelordClientPool(asio::io_context& ioc, std::vector<TimelordEndpoint> endpoints) : ioc_(ioc) {
+    for (auto& endpoint : endpoints) {
+        std::unique_ptr<Connection> pconn(new Connection(ioc, std::move(endpoint)));
+        pconn->stats.host = pconn->endpoint.host;
+        pconn->stats.port = pconn->endpoint.port;
+        pconn->stats.connected = false;
+        pconn->stats.rtt_ms = -1;
+        pconn->stats.num_proofs = 0;
+        pconn->stats.num_best_proofs = 0;
+        pconn->stats.last_proof_latency_ms = 0;
+        pconn->stats.total_proof_latency_ms = 0;
+        pconn->stats.num_reconnects = 0;
+        pconn->stats.backoff_secs = 0;
+        conns_.push_back(std::move(pconn));
+    }
+}
+
+TimelordClientPool::~TimelordClientPool() {}
+
+void TimelordClientPool::SetProofReceiver(ProofReceiver proof_receiver) { proof_receiver_ = std::move(proof_receiver); }
+
+void TimelordClientPool::Start() {
+    for (std::size_t i = 0; i < conns_.size(); ++i) {
+        asio::post(ioc_, [self = shared_from_this(), i]() { self->DoConnect(i); });
+    }
+}
+
+void TimelordClientPool::Calc(uint256 const& challenge, uint64_t iters, uint256 const& group_hash,
+                              uint64_t total_size, int interval_secs) {
+    asio::post(ioc_, [self = shared_from_this(), challenge, iters, group_hash, total_size, interval_secs]() {
+        std::lock_guard<std::mutex> lg(self->mtx_);
+        if (self->exited_) {
+            return;
+        }
+        CalcRequest* preq = self->FindRequest(challenge);
+        if (preq == nullptr) {
+            self->reqs_.emplace_back();
+            while (self->reqs_.size() > static_cast<std::size_t>(MAX_CHALLENGES)) {
+                self->reqs_.pop_front();
+            }
+            preq = &self->reqs_.back();
+            preq->challenge = challenge;
+        }
+        preq->iters = iters;
+        preq->group_hash = group_hash;
+        preq->total_size = total_size;
+        preq->interval_secs = interval_secs;
+        for (std::size_t i = 0; i < self->conns_.size(); ++i) {
+            if (self->conns_[i]->connected) {
+                self->SendCalc(i, *preq);
+            }
+        }
+    });
+}
+
+bool TimelordClientPool::GetBestProof(uint256 const& challenge, ProofDetail& detail) const {
+    std::lock_guard<std::mutex> lg(mtx_);
+    auto it = std::find_if(std::begin(reqs_), std::end(reqs_),
+                           [&challenge](CalcRequest const& req) { return req.challenge == challenge; });
+    if (it == std::end(reqs_) || !it->has_best_proof) {
+        return false;
+    }
+    detail = it->best_proof;
+    return true;
+}
+
+std::vector<TimelordStats> TimelordClientPool::GetStats() const {
+    std::lock_guard<std::mutex> lg(mtx_);
+    std::vector<TimelordStats> res;
+    for (auto const& pconn : conns_) {
+        res.push_back(pconn->stats);
+    }
+    return res;
+}
+
+void TimelordClientPool::Exit() {
+    std::lock_guard<std::mutex> lg(mtx_);
+    exited_ = true;
+    for (auto& pconn : conns_) {
+        error_code ignored_ec;
+        pconn->timer_reconnect.cancel(ignored_ec);
+        if (pconn->pclient) {
+            pconn->pclient->Exit();
+            pconn->pclient.reset();
+        }
+        pconn->connected = false;
+        pconn->stats.connected = false;
+    }
+}
+
+void TimelordClientPool::DoConnect(std::size_t index) {
+    std::shared_ptr<TimelordClient> pclient;
+    TimelordEndpoint endpoint;
+    {
+        std::lock_guard<std::mutex> lg(mtx_);
+        if (exited_) {
+            return;
+        }
+        auto& conn = *conns_[index];
+        uint64_t generation = ++conn.generation;
+        pclient = TimelordClient::CreateTimelordClient(ioc_);
+        auto weak_self = std::weak_ptr<TimelordClientPool>(shared_from_this());
+        pclient->SetConnectionHandler([weak_self, index, generation]() {
+            auto self = weak_self.lock();
+            if (self) {
+                self->HandleConnected(index, generation);
+            }
+        });
+        pclient->SetErrorHandler([weak_self, index, generation](FrontEndClient::ErrorType type, std::string const& errs) {
+            auto self = weak_self.lock();
+            if (self) {
+                self->HandleError(index, generation, errs);
+            }
+        });
+        pclient->SetProofReceiver([weak_self, index, generation](uint256 const& challenge, ProofDetail const& detail) {
+            auto self = weak_self.lock();
+            if (self) {
+                self->HandleProof(index, generation, challenge, detail);
+            }
+        });
+        pclient->SetPongHandler([weak_self, index, generation](std::chrono::milliseconds rtt) {
+            auto self = weak_self.lock();
+            if (!self) {
+                return;
+            }
+            std::lock_guard<std::mutex> lg(self->mtx_);
+            auto& conn = *self->conns_[index];
+            if (conn.generation == generation) {
+                conn.stats.rtt_ms = rtt.count();
+            }
+        });
+        conn.pclient = pclient;
+        endpoint = conn.endpoint;
+    }
+    PLOGI << tinyformat::format("connecting to timelord %s:%d", endpoint.host, endpoint.port);
+    pclient->Connect(endpoint.host, endpoint.port);
+}
+
+void TimelordClientPool::HandleConnected(std::size_t index, uint64_t generation) {
+    std::lock_guard<std::mutex> lg(mtx_);
+    auto& conn = *conns_[index];
+    if (exited_ || conn.generation != generation) {
+        return;
+    }
+    PLOGI << tinyformat::format("timelord %s:%d is connected", conn.endpoint.host, conn.endpoint.port);
+    conn.connected = true;
+    conn.backoff_secs = 0;
+    conn.stats.connected = true;
+    conn.stats.backoff_secs = 0;
+    conn.pclient->Ping();
+    // Fail over the requests which are still waiting for their proofs, the challenges with a proof aren't calculated again
+    for (auto& req : reqs_) {
+        if (!req.has_best_proof) {
+            SendCalc(index, req);
+        }
+    }
+}
+
+void TimelordClientPool::HandleError(std::size_t index, uint64_t generation, std::string const& errs) {
+    std::lock_guard<std::mutex> lg(mtx_);
+    auto& conn = *conns_[index];
+    if (exited_ || conn.generation != generation) {
+        return;
+    }
+    // Ignore the errors reported later by the same connection
+    ++conn.generation;
+    if (conn.pclient) {
+        conn.pclient->Exit();
+        conn.pclient.reset();
+    }
+    conn.connected = false;
+    conn.backoff_secs = conn.backoff_secs == 0 ? MIN_BACKOFF_SECS : std::min(conn.backoff_secs * 2, MAX_BACKOFF_SECS);
+    conn.stats.connected = false;
+    conn.stats.backoff_secs = conn.backoff_secs;
+    ++conn.stats.num_reconnects;
+    PLOGE << tinyformat::format("timelord %s:%d error: %s, reconnect in %d seconds", conn.endpoint.host,
+                                conn.endpoint.port, errs, conn.backoff_secs);
+    conn.timer_reconnect.expires_after(std::chrono::seconds(conn.backoff_secs));
+    conn.timer_reconnect.async_wait([self = shared_from_this(), index](error_code const& ec) {
+        if (ec) {
+            return;
+        }
+        self->DoConnect(index);
+    });
+}
+
+void TimelordClientPool::HandleProof(std::size_t index, uint64_t generation, uint256 const& challenge,
+                                     ProofDetail const& detail) {
+    {
+        std::lock_guard<std::mutex> lg(mtx_);
+        auto& conn = *conns_[index];
+        if (exited_ || conn.generation != generation) {
+            return;
+        }
+        ++conn.stats.num_proofs;
+        CalcRequest* preq = FindRequest(challenge);
+        if (preq == nullptr) {
+            // The challenge is too old or it isn't requested by the pool
+            return;
+        }
+        auto it = preq->sent_times.find(index);
+        if (it != std::end(preq->sent_times)) {
+            int64_t latency_ms =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - it->second)
+                            .count();
+            conn.stats.last_proof_latency_ms = latency_ms;
+            conn.stats.total_proof_latency_ms += latency_ms;
+        }
+        if (preq->has_best_proof && preq->best_proof.iters <= detail.iters) {
+            PLOGD << tinyformat::format("drop proof from timelord %s:%d, challenge=%s, iters=%d, best iters=%d",
+                                        conn.endpoint.host, conn.endpoint.port, challenge.GetHex(), detail.iters,
+                                        preq->best_proof.iters);
+            return;
+        }
+        preq->has_best_proof = true;
+        preq->best_proof = detail;
+        ++conn.stats.num_best_proofs;
+    }
+    if (proof_receiver_) {
+        proof_receiver_(challenge, detail);
+    }
+}
+
+void TimelordClientPool::SendCalc(std::size_t index, CalcRequest& req) {
+    auto& conn = *conns_[index];
+    req.sent_times[index] = std::chrono::steady_clock::now();
+    conn.pclient->Calc(req.challenge, req.iters, req.group_hash, req.total_size, req.interval_secs);
+}
+
+TimelordClientPool::CalcRequest* TimelordClientPool::FindRequest(uint256 const& challenge) {
+    auto it = std::find_if(std::begin(reqs_), std::end(reqs_),
+                           [&challenge](CalcRequest const& req) { return req.challenge == challenge; });
+    return it == std::end(reqs_) ? nullptr : &*it;
+}
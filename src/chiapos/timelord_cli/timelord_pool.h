@@ -0,0 +1,124 @@
+#ifndef TIMELORD_POOL_H
+#define TIMELORD_POOL_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "timelord_client.h"
+
+struct TimelordEndpoint {
+    std::string host;
+    unsigned short port;
+};
+
+struct TimelordStats {
+    std::string host;
+    unsigned short port;
+    bool connected;
+    //! Round trip time of the latest PING/PONG, -1 when it isn't measured yet
+    int64_t rtt_ms;
+    //! The number of the proofs received from the timelord
+    uint64_t num_proofs;
+    //! The number of the proofs which were the best ones for their challenges when they arrived
+    uint64_t num_best_proofs;
+    //! Time from the challenge is sent to the proof arrives
+    int64_t last_proof_latency_ms;
+    int64_t total_proof_latency_ms;
+    uint64_t num_reconnects;
+    //! The delay of the next reconnection, 0 when the timelord is connected
+    int64_t backoff_secs;
+};
+
+/**
+ * Keep the connections to a number of timelords. The Calc requests are sent to all the connected timelords, the ones
+ * without a proof yet are sent again to the timelords connected later, so one timelord is enough to get the proof.
+ * Only the best proof (the lowest iters) of each challenge is passed to the proof receiver, the duplicated and the
+ * worse proofs from the other timelords are dropped. A timelord which is disconnected is reconnected with exponential
+ * backoff.
+ */
+class TimelordClientPool : public std::enable_shared_from_this<TimelordClientPool> {
+public:
+    static std::shared_ptr<TimelordClientPool> CreateTimelordClientPool(asio::io_context& ioc,
+                                                                        std::vector<TimelordEndpoint> endpoints);
+
+    TimelordClientPool(TimelordClientPool const&) = delete;
+    TimelordClientPool& operator=(TimelordClientPool const&) = delete;
+
+    TimelordClientPool(TimelordClientPool&&) noexcept = delete;
+    TimelordClientPool& operator=(TimelordClientPool&&) noexcept = delete;
+
+    ~TimelordClientPool();
+
+    void SetProofReceiver(ProofReceiver proof_receiver);
+
+    /** Connect to all the timelords */
+    void Start();
+
+    /** Send the request to all the connected timelords, it's kept for the timelords connected later until it's proven */
+    void Calc(uint256 const& challenge, uint64_t iters, uint256 const& group_hash, uint64_t total_size,
+              int interval_secs);
+
+    /** Get the best proof received for the challenge */
+    bool GetBestProof(uint256 const& challenge, ProofDetail& detail) const;
+
+    std::vector<TimelordStats> GetStats() const;
+
+    void Exit();
+
+private:
+    struct CalcRequest {
+        uint256 challenge;
+        uint64_t iters;
+        uint256 group_hash;
+        uint64_t total_size;
+        int interval_secs;
+        bool has_best_proof{false};
+        ProofDetail best_proof;
+        //! The time the request is sent to each timelord
+        std::map<std::size_t, std::chrono::steady_clock::time_point> sent_times;
+    };
+
+    struct Connection {
+        explicit Connection(asio::io_context& ioc, TimelordEndpoint endpoint_in)
+                : endpoint(std::move(endpoint_in)), timer_reconnect(ioc) {}
+
+        TimelordEndpoint endpoint;
+        std::shared_ptr<TimelordClient> pclient;
+        //! Increased on every new connection, the callbacks of the previous connections are ignored
+        uint64_t generation{0};
+        bool connected{false};
+        int backoff_secs{0};
+        asio::steady_timer timer_reconnect;
+        TimelordStats stats;
+    };
+
+    TimelordClientPool(asio::io_context& ioc, std::vector<TimelordEndpoint> endpoints);
+
+    void DoConnect(std::size_t index);
+
+    void HandleConnected(std::size_t index, uint64_t generation);
+
+    void HandleError(std::size_t index, uint64_t generation, std::string const& errs);
+
+    void HandleProof(std::size_t index, uint64_t generation, uint256 const& challenge, ProofDetail const& detail);
+
+    void SendCalc(std::size_t index, CalcRequest& req);
+
+    CalcRequest* FindRequest(uint256 const& challenge);
+
+    asio::io_context& ioc_;
+    bool exited_{false};
+    ProofReceiver proof_receiver_;
+    //! The connections and the requests are accessed by the thread of ioc_ and the readers of the stats
+    mutable std::mutex mtx_;
+    std::vector<std::unique_ptr<Connection>> conns_;
+    std::deque<CalcRequest> reqs_;
+};
+
+#endif
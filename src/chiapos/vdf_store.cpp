@@ -0,0 +1,205 @@
+#include "vdf_store.h"
+
+#include <hash.h>
+#include <logging.h>
+#include <memusage.h>
+
+#include <algorithm>
+#include <limits>
+#include <iterator>
+
+namespace chiapos {
+
+namespace {
+
+uint256 GetVdfProofId(CVdfProof const& vdfProof) {
+    // The duration is not a part of the proof, see CVdfProof::Equals
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << vdfProof.challenge << vdfProof.vchY << vdfProof.vchProof << vdfProof.nWitnessType << vdfProof.nVdfIters;
+    return ss.GetHash();
+}
+
+}  // namespace
+
+CVdfStore g_vdf_store;
+
+CVdfStore::CVdfStore(int nMaxDepth) : m_nMaxDepth(nMaxDepth) {}
+
+void CVdfStore::SetMaxDepth(int nMaxDepth) {
+    LOCK(m_cs);
+    m_nMaxDepth = std::max(nMaxDepth, 1);
+    Expire();
+}
+
+void CVdfStore::SetTip(int nTipHeight) {
+    LOCK(m_cs);
+    m_nTipHeight = nTipHeight;
+    Expire();
+}
+
+bool CVdfStore::AddRequest(uint256 const& challenge, uint64_t nIters) {
+    LOCK(m_cs);
+    return GetOrCreateEntry(challenge).requests.insert(nIters).second;
+}
+
+std::set<uint64_t> CVdfStore::QueryRequests(uint256 const& challenge) const {
+    LOCK(m_cs);
+    auto it = m_entries.find(challenge);
+    if (it == std::cend(m_entries)) {
+        return {};
+    }
+    return it->second.requests;
+}
+
+bool CVdfStore::AddProof(CVdfProof const& vdfProof) {
+    LOCK(m_cs);
+    Entry& entry = GetOrCreateEntry(vdfProof.challenge);
+    auto it_proofs = entry.proofs.find(vdfProof.nVdfIters);
+    if (it_proofs != std::cend(entry.proofs)) {
+        std::vector<CVdfProof> const& proofs = it_proofs->second;
+        auto it = std::find_if(std::cbegin(proofs), std::cend(proofs),
+                               [&vdfProof](CVdfProof const& vdfProofItem) { return vdfProof.Equals(vdfProofItem); });
+        if (it != std::cend(proofs)) {
+            return false;
+        }
+    }
+    if (entry.nProofs >= MAX_VDF_PROOFS_PER_CHALLENGE) {
+        LogPrint(BCLog::POC, "%s: too many proofs for challenge %s, the proof with iters=%d is dropped\n", __func__,
+                 vdfProof.challenge.GetHex(), vdfProof.nVdfIters);
+        return false;
+    }
+    entry.proofs[vdfProof.nVdfIters].push_back(vdfProof);
+    ++entry.nProofs;
+    return true;
+}
+
+bool CVdfStore::FindProof(uint256 const& challenge, uint64_t nIters, CVdfProof* pvdfProof) const {
+    LOCK(m_cs);
+    auto it = m_entries.find(challenge);
+    if (it == std::cend(m_entries)) {
+        return false;
+    }
+    auto it_proofs = it->second.proofs.lower_bound(nIters);
+    if (it_proofs == std::cend(it->second.proofs)) {
+        return false;
+    }
+    assert(!it_proofs->second.empty());
+    if (pvdfProof) {
+        *pvdfProof = it_proofs->second.front();
+    }
+    return true;
+}
+
+std::vector<CVdfProof> CVdfStore::QueryProofs(uint256 const& challenge) const {
+    LOCK(m_cs);
+    auto it = m_entries.find(challenge);
+    if (it == std::cend(m_entries)) {
+        return {};
+    }
+    std::vector<CVdfProof> res;
+    for (auto const& entry : it->second.proofs) {
+        res.insert(std::end(res), std::cbegin(entry.second), std::cend(entry.second));
+    }
+    return res;
+}
+
+bool CVdfStore::AddPeerRequest(NodeId nodeid, uint256 const& challenge, uint64_t nIters) {
+    LOCK(m_cs);
+    auto it = m_entries.find(challenge);
+    if (it != std::cend(m_entries) && it->second.peerRequests.count(std::make_pair(nodeid, nIters))) {
+        return false;
+    }
+    std::size_t& nRequests = m_peerRequestCounts[nodeid];
+    if (nRequests >= MAX_VDF_REQUESTS_PER_PEER) {
+        LogPrint(BCLog::POC, "%s: too many requests for peer=%d, the request of challenge %s is dropped\n", __func__,
+                 nodeid, challenge.GetHex());
+        return false;
+    }
+    GetOrCreateEntry(challenge).peerRequests.emplace(nodeid, nIters);
+    ++nRequests;
+    return true;
+}
+
+bool CVdfStore::AddPeerProof(NodeId nodeid, CVdfProof const& vdfProof) {
+    LOCK(m_cs);
+    return GetOrCreateEntry(vdfProof.challenge).peerProofs.emplace(nodeid, GetVdfProofId(vdfProof)).second;
+}
+
+void CVdfStore::RemovePeer(NodeId nodeid) {
+    LOCK(m_cs);
+    m_peerRequestCounts.erase(nodeid);
+    for (auto& entry : m_entries) {
+        Entry& e = entry.second;
+        e.peerRequests.erase(e.peerRequests.lower_bound(std::make_pair(nodeid, std::numeric_limits<uint64_t>::min())),
+                             e.peerRequests.upper_bound(std::make_pair(nodeid, std::numeric_limits<uint64_t>::max())));
+        e.peerProofs.erase(e.peerProofs.lower_bound(std::make_pair(nodeid, uint256())),
+                           e.peerProofs.lower_bound(std::make_pair(nodeid + 1, uint256())));
+    }
+}
+
+VdfStoreStats CVdfStore::GetStats() const {
+    LOCK(m_cs);
+    VdfStoreStats stats;
+    stats.nChallenges = m_entries.size();
+    stats.nRequests = 0;
+    stats.nProofs = 0;
+    stats.nMemoryUsage = memusage::DynamicUsage(m_entries) + memusage::DynamicUsage(m_peerRequestCounts);
+    for (auto const& entry : m_entries) {
+        stats.nRequests += entry.second.requests.size();
+        for (auto const& proofs : entry.second.proofs) {
+            stats.nProofs += proofs.second.size();
+        }
+        stats.nMemoryUsage += DynamicUsage(entry.second);
+    }
+    stats.nTipHeight = m_nTipHeight;
+    stats.nMaxDepth = m_nMaxDepth;
+    return stats;
+}
+
+CVdfStore::Entry& CVdfStore::GetOrCreateEntry(uint256 const& challenge) {
+    AssertLockHeld(m_cs);
+    auto it = m_entries.find(challenge);
+    if (it == std::end(m_entries)) {
+        Entry entry;
+        entry.nHeight = m_nTipHeight;
+        it = m_entries.emplace(challenge, std::move(entry)).first;
+    }
+    return it->second;
+}
+
+void CVdfStore::Expire() {
+    AssertLockHeld(m_cs);
+    std::size_t nExpired{0};
+    for (auto it = std::begin(m_entries); it != std::end(m_entries);) {
+        if (m_nTipHeight - it->second.nHeight > m_nMaxDepth) {
+            for (auto const& peerRequest : it->second.peerRequests) {
+                auto it_count = m_peerRequestCounts.find(peerRequest.first);
+                if (it_count != std::end(m_peerRequestCounts) && --it_count->second == 0) {
+                    m_peerRequestCounts.erase(it_count);
+                }
+            }
+            it = m_entries.erase(it);
+            ++nExpired;
+        } else {
+            ++it;
+        }
+    }
+    if (nExpired > 0) {
+        LogPrint(BCLog::POC, "%s: %d challenges are expired, tip height=%d, %d challenges remain\n", __func__,
+                 nExpired, m_nTipHeight, m_entries.size());
+    }
+}
+
+std::size_t CVdfStore::DynamicUsage(Entry const& entry) {
+    std::size_t nUsage = memusage::DynamicUsage(entry.requests) + memusage::DynamicUsage(entry.proofs) +
+                         memusage::DynamicUsage(entry.peerRequests) + memusage::DynamicUsage(entry.peerProofs);
+    for (auto const& proofs : entry.proofs) {
+        nUsage += memusage::DynamicUsage(proofs.second);
+        for (auto const& vdfProof : proofs.second) {
+            nUsage += memusage::DynamicUsage(vdfProof.vchY) + memusage::DynamicUsage(vdfProof.vchProof);
+        }
+    }
+    return nUsage;
+}
+
+}  // namespace chiapos
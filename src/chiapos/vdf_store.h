@@ -0,0 +1,104 @@
+#ifndef DEPINC_CHIAPOS_VDF_STORE_H
+#define DEPINC_CHIAPOS_VDF_STORE_H
+
+#include <chiapos/block_fields.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+typedef int64_t NodeId;
+
+//! Default for -vdfstoredepth, the requests and proofs are dropped when their challenges are older than the depth
+static const int DEFAULT_VDF_STORE_DEPTH = 10;
+
+//! The new proofs of a challenge are dropped once it has this many proofs
+static const std::size_t MAX_VDF_PROOFS_PER_CHALLENGE = 64;
+
+//! The new requests are not marked known by a peer once it has this many requests in the store
+static const std::size_t MAX_VDF_REQUESTS_PER_PEER = 1024;
+
+namespace chiapos {
+
+struct VdfStoreStats {
+    uint64_t nChallenges;
+    uint64_t nRequests;
+    uint64_t nProofs;
+    uint64_t nMemoryUsage;
+    int nTipHeight;
+    int nMaxDepth;
+};
+
+/**
+ * The VDF requests and proofs received from RPC and P2P network, and which of them have been exchanged with
+ * each peer. The store has its own lock, the entries are grouped by challenges and a challenge is dropped
+ * when the tip is more than the max depth ahead of the tip where the challenge is found. The proofs of a
+ * challenge and the requests known by a peer are also limited, see MAX_VDF_PROOFS_PER_CHALLENGE and
+ * MAX_VDF_REQUESTS_PER_PEER.
+ */
+class CVdfStore {
+public:
+    explicit CVdfStore(int nMaxDepth = DEFAULT_VDF_STORE_DEPTH);
+
+    void SetMaxDepth(int nMaxDepth);
+
+    /** Update the height of the tip and drop the expired challenges */
+    void SetTip(int nTipHeight);
+
+    bool AddRequest(uint256 const& challenge, uint64_t nIters);
+
+    std::set<uint64_t> QueryRequests(uint256 const& challenge) const;
+
+    /** Add the proof, returns false when it exists already or the challenge has too many proofs */
+    bool AddProof(CVdfProof const& vdfProof);
+
+    /** Find the proof with the smallest iters which are not less than nIters */
+    bool FindProof(uint256 const& challenge, uint64_t nIters, CVdfProof* pvdfProof = nullptr) const;
+
+    /** All proofs of the challenge ordered by iters */
+    std::vector<CVdfProof> QueryProofs(uint256 const& challenge) const;
+
+    /** Mark the request known by the peer, returns false when the peer has already known it or too many requests */
+    bool AddPeerRequest(NodeId nodeid, uint256 const& challenge, uint64_t nIters);
+
+    /** Mark the proof known by the peer, returns false when the peer has already known it */
+    bool AddPeerProof(NodeId nodeid, CVdfProof const& vdfProof);
+
+    void RemovePeer(NodeId nodeid);
+
+    VdfStoreStats GetStats() const;
+
+private:
+    struct Entry {
+        int nHeight;
+        std::set<uint64_t> requests;
+        std::map<uint64_t, std::vector<CVdfProof>> proofs;
+        std::size_t nProofs{0};
+        std::set<std::pair<NodeId, uint64_t>> peerRequests;
+        std::set<std::pair<NodeId, uint256>> peerProofs;
+    };
+
+    Entry& GetOrCreateEntry(uint256 const& challenge) EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+
+    void Expire() EXCLUSIVE_LOCKS_REQUIRED(m_cs);
+
+    static std::size_t DynamicUsage(Entry const& entry);
+
+    mutable Mutex m_cs;
+    std::map<uint256, Entry> m_entries GUARDED_BY(m_cs);
+    //! Number of the requests of each peer in the entries
+    std::map<NodeId, std::size_t> m_peerRequestCounts GUARDED_BY(m_cs);
+    int m_nTipHeight GUARDED_BY(m_cs){-1};
+    int m_nMaxDepth GUARDED_BY(m_cs);
+};
+
+extern CVdfStore g_vdf_store;
+
+}  // namespace chiapos
+
+#endif
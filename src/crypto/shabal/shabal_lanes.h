@@ -0,0 +1,107 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_SHABAL_SHABAL_LANES_H
+#define BITCOIN_CRYPTO_SHABAL_SHABAL_LANES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The compression function of SHABAL-256 written once for the scalar and SIMD lanes. The state of the lanes is
+ * interleaved, word w of lane l is stored at [w * SHABAL256_MAX_LANES + l], so a SIMD register loads the same word
+ * of consecutive lanes. The words 0-11 are A, 12-27 are B and 28-43 are C.
+ *
+ * Ops provides the type V and the operations on it, it is instantiated by the translation units which are compiled
+ * with the flags for the instruction set, so everything here stays in an anonymous namespace.
+ */
+namespace {
+namespace shabal_lanes {
+
+static const size_t MAX_LANES = 8;
+static const int WORDS_A = 12;
+static const int WORDS_B = 16;
+static const int WORDS_M = 16;
+static const int OFFSET_B = WORDS_A;
+static const int OFFSET_C = WORDS_A + WORDS_B;
+
+template <typename Ops>
+inline __attribute__((always_inline)) void ApplyP(typename Ops::V* A, typename Ops::V* B, const typename Ops::V* C, const typename Ops::V* M)
+{
+    for (int i = 0; i < WORDS_B; ++i) {
+        B[i] = Ops::RotL(B[i], 17);
+    }
+#pragma GCC unroll 3
+    for (int j = 0; j < 3; ++j) {
+#pragma GCC unroll 16
+        for (int i = 0; i < WORDS_B; ++i) {
+            typename Ops::V& a0 = A[(WORDS_B * j + i) % WORDS_A];
+            const typename Ops::V a1 = A[(WORDS_B * j + i + WORDS_A - 1) % WORDS_A];
+            a0 = Ops::Xor(Ops::Xor(Ops::Mul3(Ops::Xor(Ops::Xor(a0, Ops::Mul5(Ops::RotL(a1, 15))), C[(24 - i) % 16])),
+                                   B[(i + 13) % 16]),
+                          Ops::Xor(Ops::AndNot(B[(i + 6) % 16], B[(i + 9) % 16]), M[i]));
+            B[i] = Ops::Not(Ops::Xor(Ops::RotL(B[i], 1), a0));
+        }
+    }
+#pragma GCC unroll 36
+    for (int k = 0; k < 36; ++k) {
+        A[(WORDS_A * 3 + 11 - k) % WORDS_A] = Ops::Add(A[(WORDS_A * 3 + 11 - k) % WORDS_A], C[(48 + 6 - k) % 16]);
+    }
+}
+
+/** Process one block of the lanes [offset, offset + Ops::LANES), the final block is followed by the three extra rounds */
+template <typename Ops>
+void Compress(uint32_t* s, const uint32_t* m, uint32_t Wlow, uint32_t Whigh, bool fFinal, size_t offset)
+{
+    typedef typename Ops::V V;
+    V A[WORDS_A], B[WORDS_B], C[WORDS_B], M[WORDS_M];
+    for (int i = 0; i < WORDS_A; ++i) {
+        A[i] = Ops::Load(s + i * MAX_LANES + offset);
+    }
+    for (int i = 0; i < WORDS_B; ++i) {
+        B[i] = Ops::Load(s + (OFFSET_B + i) * MAX_LANES + offset);
+        C[i] = Ops::Load(s + (OFFSET_C + i) * MAX_LANES + offset);
+        M[i] = Ops::Load(m + i * MAX_LANES + offset);
+    }
+    const V vWlow = Ops::Set1(Wlow);
+    const V vWhigh = Ops::Set1(Whigh);
+
+    for (int i = 0; i < WORDS_B; ++i) {
+        B[i] = Ops::Add(B[i], M[i]);
+    }
+    A[0] = Ops::Xor(A[0], vWlow);
+    A[1] = Ops::Xor(A[1], vWhigh);
+    ApplyP<Ops>(A, B, C, M);
+    if (!fFinal) {
+        for (int i = 0; i < WORDS_B; ++i) {
+            V tmp = Ops::Sub(C[i], M[i]);
+            C[i] = B[i];
+            B[i] = tmp;
+        }
+    } else {
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < WORDS_B; ++i) {
+                V tmp = C[i];
+                C[i] = B[i];
+                B[i] = tmp;
+            }
+            A[0] = Ops::Xor(A[0], vWlow);
+            A[1] = Ops::Xor(A[1], vWhigh);
+            ApplyP<Ops>(A, B, C, M);
+        }
+    }
+
+    for (int i = 0; i < WORDS_A; ++i) {
+        Ops::Store(s + i * MAX_LANES + offset, A[i]);
+    }
+    for (int i = 0; i < WORDS_B; ++i) {
+        Ops::Store(s + (OFFSET_B + i) * MAX_LANES + offset, B[i]);
+        Ops::Store(s + (OFFSET_C + i) * MAX_LANES + offset, C[i]);
+    }
+}
+
+} // namespace shabal_lanes
+} // namespace
+
+#endif // BITCOIN_CRYPTO_SHABAL_SHABAL_LANES_H
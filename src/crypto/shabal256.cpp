@@ -4,8 +4,18 @@
 
 #include <crypto/shabal256.h>
 
+#include <crypto/common.h>
+#include <crypto/shabal/shabal_lanes.h>
 #include <crypto/shabal/sph_shabal.h>
 
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
 CShabal256::CShabal256()
 {
     cc = new sph_shabal256_context;
@@ -33,3 +43,222 @@ CShabal256& CShabal256::Reset()
     ::sph_shabal256_init(cc);
     return *this;
 }
+
+namespace shabal256_sse2
+{
+void Compress_4way(uint32_t* s, const uint32_t* m, uint32_t Wlow, uint32_t Whigh, bool fFinal, size_t offset);
+}
+
+namespace shabal256_avx2
+{
+void Compress_8way(uint32_t* s, const uint32_t* m, uint32_t Wlow, uint32_t Whigh, bool fFinal, size_t offset);
+}
+
+namespace
+{
+struct ScalarOps {
+    typedef uint32_t V;
+    static const size_t LANES = 1;
+    static V Load(const uint32_t* p) { return *p; }
+    static void Store(uint32_t* p, V v) { *p = v; }
+    static V Set1(uint32_t x) { return x; }
+    static V Add(V x, V y) { return x + y; }
+    static V Sub(V x, V y) { return x - y; }
+    static V Xor(V x, V y) { return x ^ y; }
+    static V AndNot(V x, V y) { return ~x & y; }
+    static V Not(V x) { return ~x; }
+    static V RotL(V x, int n) { return (x << n) | (x >> (32 - n)); }
+    static V Mul3(V x) { return x * 3U; }
+    static V Mul5(V x) { return x * 5U; }
+};
+
+typedef void (*CompressFn)(uint32_t* s, const uint32_t* m, uint32_t Wlow, uint32_t Whigh, bool fFinal, size_t offset);
+
+CompressFn Compress_4way = nullptr;
+CompressFn Compress_8way = nullptr;
+
+bool SelfTest()
+{
+    // Hash messages of different lengths on all the lanes and compare with the scalar implementation.
+    static const size_t LENGTHS[] = {0, 1, 32, 63, 64, 65, 96, 4096};
+    unsigned char data[CShabal256Lanes::MAX_LANES][4096];
+    for (size_t lane = 0; lane < CShabal256Lanes::MAX_LANES; ++lane) {
+        for (size_t i = 0; i < sizeof(data[lane]); ++i) {
+            data[lane][i] = (unsigned char)(i * 31 + lane * 7);
+        }
+    }
+    for (size_t lanes = 1; lanes <= CShabal256Lanes::MAX_LANES; ++lanes) {
+        for (size_t len : LENGTHS) {
+            const unsigned char* in[CShabal256Lanes::MAX_LANES];
+            unsigned char out[CShabal256Lanes::MAX_LANES][CShabal256Lanes::OUTPUT_SIZE];
+            unsigned char* outs[CShabal256Lanes::MAX_LANES];
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                in[lane] = data[lane];
+                outs[lane] = out[lane];
+            }
+            // Split the write to test the partial blocks
+            CShabal256Lanes hasher(lanes);
+            hasher.Write(in, len / 3);
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                in[lane] += len / 3;
+            }
+            hasher.Write(in, len - len / 3).Finalize(outs);
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                unsigned char expected[CShabal256::OUTPUT_SIZE];
+                CShabal256().Write(data[lane], len).Finalize(expected);
+                if (!std::equal(expected, expected + CShabal256::OUTPUT_SIZE, out[lane])) return false;
+            }
+        }
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+CShabal256Lanes::CShabal256Lanes(size_t lanesIn) : lanes(lanesIn)
+{
+    assert(lanes > 0 && lanes <= MAX_LANES);
+    memset(m, 0, sizeof(m));
+    Reset();
+}
+
+void CShabal256Lanes::Compress(bool fFinal)
+{
+    for (int w = 0; w < 16; ++w) {
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            m[w * MAX_LANES + lane] = ReadLE32(buf[lane] + w * 4);
+        }
+    }
+    size_t offset = 0;
+    if (Compress_8way && lanes > 4) {
+        Compress_8way(s, m, Wlow, Whigh, fFinal, offset);
+        offset += 8;
+    }
+    for (; Compress_4way && offset + 4 <= lanes; offset += 4) {
+        Compress_4way(s, m, Wlow, Whigh, fFinal, offset);
+    }
+    for (; offset < lanes; ++offset) {
+        shabal_lanes::Compress<ScalarOps>(s, m, Wlow, Whigh, fFinal, offset);
+    }
+}
+
+CShabal256Lanes& CShabal256Lanes::Write(const unsigned char* const data[], size_t len)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        size_t clen = std::min(sizeof(buf[0]) - ptr, len - pos);
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            memcpy(buf[lane] + ptr, data[lane] + pos, clen);
+        }
+        ptr += clen;
+        pos += clen;
+        if (ptr == sizeof(buf[0])) {
+            Compress(false);
+            if (++Wlow == 0) {
+                ++Whigh;
+            }
+            ptr = 0;
+        }
+    }
+    return *this;
+}
+
+void CShabal256Lanes::Finalize(unsigned char* const hashes[])
+{
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        buf[lane][ptr] = 0x80;
+        memset(buf[lane] + ptr + 1, 0, sizeof(buf[lane]) - (ptr + 1));
+    }
+    Compress(true);
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        for (int i = 0; i < 8; ++i) {
+            WriteLE32(hashes[lane] + i * 4, s[(shabal_lanes::OFFSET_B + 8 + i) * MAX_LANES + lane]);
+        }
+    }
+    Reset();
+}
+
+CShabal256Lanes& CShabal256Lanes::Reset()
+{
+    sph_shabal256_context cc;
+    ::sph_shabal256_init(&cc);
+    for (size_t lane = 0; lane < MAX_LANES; ++lane) {
+        for (int i = 0; i < 12; ++i) {
+            s[i * MAX_LANES + lane] = cc.A[i];
+        }
+        for (int i = 0; i < 16; ++i) {
+            s[(shabal_lanes::OFFSET_B + i) * MAX_LANES + lane] = cc.B[i];
+            s[(shabal_lanes::OFFSET_C + i) * MAX_LANES + lane] = cc.C[i];
+        }
+    }
+    Wlow = cc.Wlow;
+    Whigh = cc.Whigh;
+    ptr = 0;
+    return *this;
+}
+
+std::string Shabal256AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_sse2 = false;
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)AVXEnabled;
+    (void)have_sse2;
+    (void)have_avx;
+    (void)have_xsave;
+    (void)have_avx2;
+    (void)enabled_avx;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    have_sse2 = (edx >> 26) & 1;
+    have_xsave = (ecx >> 27) & 1;
+    have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+    }
+    cpuid(7, 0, eax, ebx, ecx, edx);
+    have_avx2 = (ebx >> 5) & 1;
+
+#if defined(__SSE2__)
+    if (have_sse2) {
+        Compress_4way = shabal256_sse2::Compress_4way;
+        ret = "sse2(4way)";
+    }
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && have_avx && enabled_avx) {
+        Compress_8way = shabal256_avx2::Compress_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
@@ -6,6 +6,8 @@
 #define BITCOIN_CRYPTO_SHABAL256_H
 
 #include <cstddef>
+#include <cstdint>
+#include <string>
 
 /** A hasher class for SHABAL-256. */
 class CShabal256
@@ -23,4 +25,38 @@ public:
     CShabal256& Reset();
 };
 
-#endif // BITCOIN_CRYPTO_SHABAL256_H
\ No newline at end of file
+/**
+ * A hasher class for SHABAL-256 of up to MAX_LANES messages at once. The messages must have the same length, every
+ * call writes len bytes from data[i] to the lane i, and the lanes are computed together by SSE2 or AVX2 when available.
+ */
+class CShabal256Lanes
+{
+public:
+    static const size_t OUTPUT_SIZE = 32;
+    static const size_t MAX_LANES = 8;
+
+private:
+    uint32_t s[44 * MAX_LANES];
+    uint32_t m[16 * MAX_LANES];
+    unsigned char buf[MAX_LANES][64];
+    size_t ptr;
+    uint32_t Wlow;
+    uint32_t Whigh;
+    size_t lanes;
+
+    void Compress(bool fFinal);
+
+public:
+    explicit CShabal256Lanes(size_t lanesIn);
+    CShabal256Lanes& Write(const unsigned char* const data[], size_t len);
+    void Finalize(unsigned char* const hashes[]);
+    CShabal256Lanes& Reset();
+    size_t Lanes() const { return lanes; }
+};
+
+/** Autodetect the best available SHABAL-256 lanes implementation.
+ *  Returns the name of the implementation.
+ */
+std::string Shabal256AutoDetect();
+
+#endif // BITCOIN_CRYPTO_SHABAL256_H
@@ -0,0 +1,40 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/shabal/shabal_lanes.h>
+
+namespace shabal256_avx2 {
+namespace {
+
+struct Ops {
+    typedef __m256i V;
+    static const size_t LANES = 8;
+    static V Load(const uint32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+    static void Store(uint32_t* p, V v) { _mm256_storeu_si256((__m256i*)p, v); }
+    static V Set1(uint32_t x) { return _mm256_set1_epi32(x); }
+    static V Add(V x, V y) { return _mm256_add_epi32(x, y); }
+    static V Sub(V x, V y) { return _mm256_sub_epi32(x, y); }
+    static V Xor(V x, V y) { return _mm256_xor_si256(x, y); }
+    static V AndNot(V x, V y) { return _mm256_andnot_si256(x, y); }
+    static V Not(V x) { return _mm256_xor_si256(x, _mm256_set1_epi32(-1)); }
+    static V RotL(V x, int n) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+    static V Mul3(V x) { return _mm256_add_epi32(x, _mm256_slli_epi32(x, 1)); }
+    static V Mul5(V x) { return _mm256_add_epi32(x, _mm256_slli_epi32(x, 2)); }
+};
+
+}
+
+void Compress_8way(uint32_t* s, const uint32_t* m, uint32_t Wlow, uint32_t Whigh, bool fFinal, size_t offset)
+{
+    shabal_lanes::Compress<Ops>(s, m, Wlow, Whigh, fFinal, offset);
+}
+
+}
+
+#endif
@@ -0,0 +1,40 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(__SSE2__)
+
+#include <stdint.h>
+#include <emmintrin.h>
+
+#include <crypto/shabal/shabal_lanes.h>
+
+namespace shabal256_sse2 {
+namespace {
+
+struct Ops {
+    typedef __m128i V;
+    static const size_t LANES = 4;
+    static V Load(const uint32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+    static void Store(uint32_t* p, V v) { _mm_storeu_si128((__m128i*)p, v); }
+    static V Set1(uint32_t x) { return _mm_set1_epi32(x); }
+    static V Add(V x, V y) { return _mm_add_epi32(x, y); }
+    static V Sub(V x, V y) { return _mm_sub_epi32(x, y); }
+    static V Xor(V x, V y) { return _mm_xor_si128(x, y); }
+    static V AndNot(V x, V y) { return _mm_andnot_si128(x, y); }
+    static V Not(V x) { return _mm_xor_si128(x, _mm_set1_epi32(-1)); }
+    static V RotL(V x, int n) { return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n)); }
+    static V Mul3(V x) { return _mm_add_epi32(x, _mm_slli_epi32(x, 1)); }
+    static V Mul5(V x) { return _mm_add_epi32(x, _mm_slli_epi32(x, 2)); }
+};
+
+}
+
+void Compress_4way(uint32_t* s, const uint32_t* m, uint32_t Wlow, uint32_t Whigh, bool fFinal, size_t offset)
+{
+    shabal_lanes::Compress<Ops>(s, m, Wlow, Whigh, fFinal, offset);
+}
+
+}
+
+#endif
@@ -166,8 +166,25 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
 }
 
+CDBWrapper::CDBWrapper(const CDBWrapper& parent, SnapshotTag)
+    : penv(nullptr), options(parent.options), readoptions(parent.readoptions), iteroptions(parent.iteroptions),
+      writeoptions(parent.writeoptions), syncoptions(parent.syncoptions), pdb(parent.pdb), m_name{parent.m_name},
+      obfuscate_key(parent.obfuscate_key)
+{
+    assert(!parent.IsSnapshot());
+    m_snapshot = pdb->GetSnapshot();
+    readoptions.snapshot = m_snapshot;
+    iteroptions.snapshot = m_snapshot;
+}
+
 CDBWrapper::~CDBWrapper()
 {
+    if (m_snapshot != nullptr) {
+        // The database and the options belong to the parent
+        pdb->ReleaseSnapshot(m_snapshot);
+        m_snapshot = nullptr;
+        return;
+    }
     delete pdb;
     pdb = nullptr;
     delete options.filter_policy;
@@ -187,6 +204,7 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
     if (log_memory) {
         mem_before = DynamicMemoryUsage() / 1024.0 / 1024;
     }
+    assert(m_snapshot == nullptr);
     leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
     dbwrapper_private::HandleError(status);
     if (log_memory) {
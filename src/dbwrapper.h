@@ -210,6 +210,9 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
+    //! the state of the database pinned by a read-only snapshot, nullptr when this instance owns the database
+    const leveldb::Snapshot* m_snapshot{nullptr};
+
     //! the name of this database
     std::string m_name;
 
@@ -234,8 +237,20 @@ public:
      *                        with a zero'd byte array.
      */
     CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+
+    //! Tag to construct a read-only snapshot of another database
+    struct SnapshotTag {};
+
+    /**
+     * Construct a read-only view of the database of `parent` pinned to its current state. Reads and iterators of the
+     * view never see the writes made to the parent afterwards. The database is shared, the parent must outlive it.
+     */
+    CDBWrapper(const CDBWrapper& parent, SnapshotTag);
+
     ~CDBWrapper();
 
+    bool IsSnapshot() const { return m_snapshot != nullptr; }
+
     CDBWrapper(const CDBWrapper&) = delete;
     CDBWrapper& operator=(const CDBWrapper&) = delete;
 
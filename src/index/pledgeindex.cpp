@@ -0,0 +1,376 @@
+// Copyright (c) 2017-2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/pledgeindex.h>
+
+#include <chainparams.h>
+#include <script/standard.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <map>
+#include <set>
+
+/* The index database stores each pledge under [DB_PLEDGE, txid]. For every pledge the keys
+ * [DB_PLEDGE_ACCOUNT, sender, txid] and [DB_PLEDGE_ACCOUNT, receiver, txid] reference it so that the
+ * pledges of an account can be found with a prefix seek. The events that created or revoked the
+ * pledges are stored under [DB_PLEDGE_EVENT, uint32 (BE), txid] so they can be undone in height
+ * order on a reorg.
+ */
+constexpr char DB_PLEDGE = 'p';
+constexpr char DB_PLEDGE_ACCOUNT = 'a';
+constexpr char DB_PLEDGE_EVENT = 'e';
+
+std::unique_ptr<PledgeIndex> g_pledgeindex;
+
+std::string PledgeEventTypeToString(PledgeEventType type)
+{
+    switch (type) {
+    case PledgeEventType::PLEDGE:
+        return "pledge";
+    case PledgeEventType::RETARGET:
+        return "retarget";
+    case PledgeEventType::WITHDRAW:
+        return "withdraw";
+    }
+    return "unknown";
+}
+
+namespace {
+
+struct DBAccountKey {
+    CAccountID accountID;
+    uint256 txid;
+
+    DBAccountKey() {}
+    DBAccountKey(const CAccountID& accountID_in, const uint256& txid_in) : accountID(accountID_in), txid(txid_in) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        char prefix = DB_PLEDGE_ACCOUNT;
+        READWRITE(prefix);
+        if (prefix != DB_PLEDGE_ACCOUNT) {
+            throw std::ios_base::failure("Invalid format for pledge index DB account key");
+        }
+        READWRITE(accountID);
+        READWRITE(txid);
+    }
+};
+
+struct DBEventKey {
+    int height;
+    uint256 txid;
+
+    DBEventKey() : height(0) {}
+    DBEventKey(int height_in, const uint256& txid_in) : height(height_in), txid(txid_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_PLEDGE_EVENT);
+        ser_writedata32be(s, height);
+        s << txid;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_PLEDGE_EVENT) {
+            throw std::ios_base::failure("Invalid format for pledge index DB event key");
+        }
+        height = ser_readdata32be(s);
+        s >> txid;
+    }
+};
+
+} // namespace
+
+/**
+ * Access to the pledge index database (indexes/pledgeindex/)
+ */
+class PledgeIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ReadPledge(const uint256& txid, PledgeIndexEntry& entry) const;
+
+    void WritePledge(CDBBatch& batch, const PledgeIndexEntry& entry);
+
+    void ErasePledge(CDBBatch& batch, const PledgeIndexEntry& entry);
+};
+
+PledgeIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "pledgeindex", n_cache_size, f_memory, f_wipe)
+{}
+
+bool PledgeIndex::DB::ReadPledge(const uint256& txid, PledgeIndexEntry& entry) const
+{
+    return Read(std::make_pair(DB_PLEDGE, txid), entry);
+}
+
+void PledgeIndex::DB::WritePledge(CDBBatch& batch, const PledgeIndexEntry& entry)
+{
+    batch.Write(std::make_pair(DB_PLEDGE, entry.txid), entry);
+    batch.Write(DBAccountKey(entry.sender, entry.txid), '\0');
+    if (entry.receiver != entry.sender) {
+        batch.Write(DBAccountKey(entry.receiver, entry.txid), '\0');
+    }
+}
+
+void PledgeIndex::DB::ErasePledge(CDBBatch& batch, const PledgeIndexEntry& entry)
+{
+    batch.Erase(std::make_pair(DB_PLEDGE, entry.txid));
+    batch.Erase(DBAccountKey(entry.sender, entry.txid));
+    batch.Erase(DBAccountKey(entry.receiver, entry.txid));
+}
+
+PledgeIndex::PledgeIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<PledgeIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+PledgeIndex::~PledgeIndex() {}
+
+bool PledgeIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex, int nVersionMask)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    if (pindex->nHeight < params.BHDIP009Height) {
+        return true;
+    }
+
+    // Pledges touched by this block, they are written with the events in one batch
+    std::map<uint256, PledgeIndexEntry> pledges;
+    std::vector<PledgeIndexEvent> events;
+
+    auto findPledge = [&](const uint256& txid) -> PledgeIndexEntry* {
+        auto it = pledges.find(txid);
+        if (it == pledges.end()) {
+            PledgeIndexEntry entry;
+            if (!m_db->ReadPledge(txid, entry)) {
+                return nullptr;
+            }
+            it = pledges.emplace(txid, std::move(entry)).first;
+        }
+        return &it->second;
+    };
+
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase() || !tx->IsUniform()) {
+            continue;
+        }
+        const uint256 txid = tx->GetHash();
+        auto payload = ExtractTransactionDatacarrier(*tx, pindex->nHeight, {DATACARRIER_TYPE_BINDCHIAFARMER, DATACARRIER_TYPE_CHIA_POINT, DATACARRIER_TYPE_CHIA_POINT_TERM_1, DATACARRIER_TYPE_CHIA_POINT_TERM_2, DATACARRIER_TYPE_CHIA_POINT_TERM_3, DATACARRIER_TYPE_CHIA_POINT_RETARGET});
+        if (payload == nullptr) {
+            // Spending the coin of a pledge withdraws it
+            const uint256& prevTxid = tx->vin[0].prevout.hash;
+            PledgeIndexEntry* prev = findPledge(prevTxid);
+            if (prev == nullptr || !prev->IsAvailable()) {
+                continue;
+            }
+            prev->revokedTxid = txid;
+            prev->nRevokedHeight = pindex->nHeight;
+
+            PledgeIndexEvent event;
+            event.type = PledgeEventType::WITHDRAW;
+            event.txid = txid;
+            event.prevTxid = prevTxid;
+            event.nHeight = pindex->nHeight;
+            event.sender = prev->sender;
+            event.receiver = prev->receiver;
+            event.pointType = prev->pointType;
+            event.nAmount = prev->nAmount;
+            events.push_back(std::move(event));
+            continue;
+        }
+
+        assert(tx->vout.size() >= 2);
+        PledgeIndexEntry entry;
+        entry.txid = txid;
+        entry.blockHash = pindex->GetBlockHash();
+        entry.nHeight = pindex->nHeight;
+        entry.sender = ExtractAccountID(tx->vout[0].scriptPubKey);
+        entry.pledgeType = payload->type;
+
+        PledgeIndexEvent event;
+        event.type = PledgeEventType::PLEDGE;
+        event.txid = txid;
+        event.nHeight = pindex->nHeight;
+
+        if (payload->type == DATACARRIER_TYPE_BINDCHIAFARMER) {
+            entry.receiver = entry.sender;
+            entry.nAmount = tx->vout[0].nValue;
+            entry.pointType = DATACARRIER_TYPE_BINDCHIAFARMER;
+            entry.nPointHeight = 0;
+        } else if (payload->type == DATACARRIER_TYPE_CHIA_POINT_RETARGET) {
+            auto retargetPayload = PointRetargetPayload::As(payload);
+            const uint256& prevTxid = tx->vin[0].prevout.hash;
+            PledgeIndexEntry* prev = findPledge(prevTxid);
+            if (prev == nullptr) {
+                return error("%s: cannot find original pledge-tx(%s) of retarget tx(%s)", __func__, prevTxid.GetHex(), txid.GetHex());
+            }
+            prev->revokedTxid = txid;
+            prev->nRevokedHeight = pindex->nHeight;
+            entry.receiver = retargetPayload->GetReceiverID();
+            entry.nAmount = prev->nAmount;
+            entry.pointType = retargetPayload->GetPointType();
+            entry.nPointHeight = retargetPayload->GetPointHeight();
+            event.type = PledgeEventType::RETARGET;
+            event.prevTxid = prevTxid;
+        } else {
+            auto pointPayload = PointPayload::As(payload);
+            entry.receiver = pointPayload->GetReceiverID();
+            entry.nAmount = tx->vout[0].nValue;
+            entry.pointType = entry.pledgeType;
+            entry.nPointHeight = pindex->nHeight;
+        }
+
+        event.sender = entry.sender;
+        event.receiver = entry.receiver;
+        event.pointType = entry.pointType;
+        event.nAmount = entry.nAmount;
+        events.push_back(std::move(event));
+        pledges[txid] = std::move(entry);
+    }
+
+    if (events.empty()) {
+        return true;
+    }
+
+    CDBBatch batch(*m_db);
+    for (const auto& pledge : pledges) {
+        m_db->WritePledge(batch, pledge.second);
+    }
+    for (const auto& event : events) {
+        batch.Write(DBEventKey(event.nHeight, event.txid), event);
+    }
+    return m_db->WriteBatch(batch);
+}
+
+bool PledgeIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    if (!UndoBlocks(current_tip, new_tip)) {
+        return false;
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+bool PledgeIndex::UndoBlocks(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    std::vector<PledgeIndexEvent> events;
+    if (!GetEvents(new_tip->nHeight + 1, current_tip->nHeight, events)) {
+        return false;
+    }
+
+    // A pledge may be made and revoked by the same block, the events of a block are not kept in
+    // transaction order so the pledges erased here must not be written back by a later undo
+    CDBBatch batch(*m_db);
+    std::map<uint256, PledgeIndexEntry> pledges;
+    std::set<uint256> erased;
+    for (auto it = events.rbegin(); it != events.rend(); ++it) {
+        const PledgeIndexEvent& event = *it;
+        if (event.type != PledgeEventType::PLEDGE && erased.count(event.prevTxid) == 0) {
+            auto itPrev = pledges.find(event.prevTxid);
+            if (itPrev == pledges.end()) {
+                PledgeIndexEntry prev;
+                if (!m_db->ReadPledge(event.prevTxid, prev)) {
+                    return error("%s: cannot find pledge(%s) revoked by tx(%s)", __func__, event.prevTxid.GetHex(), event.txid.GetHex());
+                }
+                itPrev = pledges.emplace(event.prevTxid, std::move(prev)).first;
+            }
+            itPrev->second.revokedTxid.SetNull();
+            itPrev->second.nRevokedHeight = 0;
+        }
+        if (event.type != PledgeEventType::WITHDRAW) {
+            PledgeIndexEntry entry;
+            auto itEntry = pledges.find(event.txid);
+            if (itEntry != pledges.end()) {
+                entry = std::move(itEntry->second);
+                pledges.erase(itEntry);
+            } else if (!m_db->ReadPledge(event.txid, entry)) {
+                return error("%s: cannot find pledge(%s)", __func__, event.txid.GetHex());
+            }
+            m_db->ErasePledge(batch, entry);
+            erased.insert(event.txid);
+        }
+        batch.Erase(DBEventKey(event.nHeight, event.txid));
+    }
+    for (const auto& pledge : pledges) {
+        if (erased.count(pledge.first) == 0) {
+            m_db->WritePledge(batch, pledge.second);
+        }
+    }
+    return m_db->WriteBatch(batch);
+}
+
+BaseIndex::DB& PledgeIndex::GetDB() const { return *m_db; }
+
+bool PledgeIndex::FindPledge(const uint256& txid, PledgeIndexEntry& entry) const
+{
+    return m_db->ReadPledge(txid, entry);
+}
+
+bool PledgeIndex::ForEachPledge(const std::function<bool(const PledgeIndexEntry&)>& visitor) const
+{
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    pcursor->Seek(std::make_pair(DB_PLEDGE, uint256()));
+    while (pcursor->Valid()) {
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_PLEDGE) {
+            break;
+        }
+        PledgeIndexEntry entry;
+        if (!pcursor->GetValue(entry)) {
+            return error("%s: unable to read pledge(%s)", __func__, key.second.GetHex());
+        }
+        if (!visitor(entry)) {
+            break;
+        }
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool PledgeIndex::GetAccountPledges(const CAccountID& accountID, std::vector<PledgeIndexEntry>& entries) const
+{
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    pcursor->Seek(DBAccountKey(accountID, uint256()));
+    while (pcursor->Valid()) {
+        DBAccountKey key;
+        if (!pcursor->GetKey(key) || key.accountID != accountID) {
+            break;
+        }
+        PledgeIndexEntry entry;
+        if (!m_db->ReadPledge(key.txid, entry)) {
+            return error("%s: unable to read pledge(%s)", __func__, key.txid.GetHex());
+        }
+        entries.push_back(std::move(entry));
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool PledgeIndex::GetEvents(int nBeginHeight, int nEndHeight, std::vector<PledgeIndexEvent>& events) const
+{
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    pcursor->Seek(DBEventKey(nBeginHeight, uint256()));
+    while (pcursor->Valid()) {
+        DBEventKey key;
+        if (!pcursor->GetKey(key) || key.height > nEndHeight) {
+            break;
+        }
+        PledgeIndexEvent event;
+        if (!pcursor->GetValue(event)) {
+            return error("%s: unable to read pledge event at height %d", __func__, key.height);
+        }
+        events.push_back(std::move(event));
+        pcursor->Next();
+    }
+    return true;
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2017-2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_PLEDGEINDEX_H
+#define BITCOIN_INDEX_PLEDGEINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <script/standard.h>
+
+#include <functional>
+#include <vector>
+
+static const bool DEFAULT_PLEDGEINDEX = false;
+
+/** The kind of change a transaction made to the pledge set */
+enum class PledgeEventType : uint8_t {
+    PLEDGE = 0,   //!< A new chia point or farmer binding
+    RETARGET = 1, //!< A point moved to another receiver, the previous one is revoked
+    WITHDRAW = 2, //!< The pledge coin is spent without a new payload
+};
+
+std::string PledgeEventTypeToString(PledgeEventType type);
+
+/** A pledge (chia point, retarget or farmer binding) recorded by the pledge index */
+struct PledgeIndexEntry {
+    uint256 txid;
+    uint256 blockHash;
+    int nHeight{0};
+    CAccountID sender;
+    CAccountID receiver;
+    CAmount nAmount{0};
+    DatacarrierType pledgeType{DATACARRIER_TYPE_UNKNOWN};
+    DatacarrierType pointType{DATACARRIER_TYPE_UNKNOWN};
+    int nPointHeight{0};
+    //! The transaction revoking this pledge (retarget or withdraw), null while it is still available
+    uint256 revokedTxid;
+    int nRevokedHeight{0};
+
+    bool IsAvailable() const { return revokedTxid.IsNull(); }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(blockHash);
+        READWRITE(VARINT(nHeight, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(sender);
+        READWRITE(receiver);
+        READWRITE(VARINT(nAmount, VarIntMode::NONNEGATIVE_SIGNED));
+        uint32_t nPledgeType = pledgeType, nPointType = pointType;
+        READWRITE(nPledgeType);
+        READWRITE(nPointType);
+        pledgeType = static_cast<DatacarrierType>(nPledgeType);
+        pointType = static_cast<DatacarrierType>(nPointType);
+        READWRITE(VARINT(nPointHeight, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(revokedTxid);
+        READWRITE(VARINT(nRevokedHeight, VarIntMode::NONNEGATIVE_SIGNED));
+    }
+};
+
+/** A pledge, retarget or withdraw event, keyed by the height of the block it belongs to */
+struct PledgeIndexEvent {
+    PledgeEventType type{PledgeEventType::PLEDGE};
+    uint256 txid;
+    //! The pledge revoked by a retarget or withdraw
+    uint256 prevTxid;
+    int nHeight{0};
+    CAccountID sender;
+    CAccountID receiver;
+    DatacarrierType pointType{DATACARRIER_TYPE_UNKNOWN};
+    CAmount nAmount{0};
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        uint8_t nType = static_cast<uint8_t>(type);
+        READWRITE(nType);
+        type = static_cast<PledgeEventType>(nType);
+        READWRITE(txid);
+        READWRITE(prevTxid);
+        READWRITE(VARINT(nHeight, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(sender);
+        READWRITE(receiver);
+        uint32_t nPointType = pointType;
+        READWRITE(nPointType);
+        pointType = static_cast<DatacarrierType>(nPointType);
+        READWRITE(VARINT(nAmount, VarIntMode::NONNEGATIVE_SIGNED));
+    }
+};
+
+/**
+ * PledgeIndex keeps every pledge, retarget and withdraw since BHDIP009 so the
+ * pledge RPCs can answer without reading blocks from disk. The index is
+ * written to a LevelDB database, pledges are stored by txid and referenced by
+ * sender and receiver, and the events are stored by height so that they can
+ * be undone when the chain reorganizes.
+ */
+class PledgeIndex : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, int nVersionMask) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    /// Undo the pledges and events of the blocks after new_tip, the part of Rewind kept by this index.
+    bool UndoBlocks(const CBlockIndex* current_tip, const CBlockIndex* new_tip);
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "pledgeindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit PledgeIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~PledgeIndex() override;
+
+    /// Look up a pledge by the hash of the transaction that made it.
+    bool FindPledge(const uint256& txid, PledgeIndexEntry& entry) const;
+
+    /// Visit all pledges in txid order, stop when the visitor returns false.
+    bool ForEachPledge(const std::function<bool(const PledgeIndexEntry&)>& visitor) const;
+
+    /// Get all pledges sent or received by the account.
+    bool GetAccountPledges(const CAccountID& accountID, std::vector<PledgeIndexEntry>& entries) const;
+
+    /// Get the events of the blocks in the height range [nBeginHeight, nEndHeight].
+    bool GetEvents(int nBeginHeight, int nEndHeight, std::vector<PledgeIndexEvent>& events) const;
+};
+
+/// The global pledge index, used by the pledge RPCs. May be null.
+extern std::unique_ptr<PledgeIndex> g_pledgeindex;
+
+#endif // BITCOIN_INDEX_PLEDGEINDEX_H
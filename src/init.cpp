@@ -17,10 +17,12 @@
 #include <chainparams.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <crypto/shabal256.h>
 #include <fs.h>
 #include <httprpc.h>
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/pledgeindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <key.h>
@@ -30,7 +32,11 @@
 #include <net_processing.h>
 #include <netbase.h>
 #include <poc/poc.h>
+#include <chiapos/block_submitter.h>
+#include <chiapos/harvester.h>
 #include <chiapos/post.h>
+#include <chiapos/proof_cache.h>
+#include <chiapos/vdf_store.h>
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
@@ -185,6 +191,9 @@ void Interrupt()
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_pledgeindex) {
+        g_pledgeindex->Interrupt();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); });
 }
 
@@ -204,10 +213,22 @@ void Shutdown(InitInterfaces& interfaces)
     mempool.AddTransactionsUpdated(1);
 
     StopPOC();
+    if (chiapos::g_harvester) {
+        chiapos::g_harvester->Stop();
+        chiapos::g_harvester.reset();
+    }
     StopHTTPRPC();
     StopREST();
     StopRPC();
     StopHTTPServer();
+    if (chiapos::g_block_submitter) {
+        chiapos::g_block_submitter->Stop();
+        chiapos::g_block_submitter.reset();
+    }
+    if (g_chia_candidate_builder) {
+        g_chia_candidate_builder->Stop();
+        g_chia_candidate_builder.reset();
+    }
     for (const auto& client : interfaces.chain_clients) {
         client->flush();
     }
@@ -267,6 +288,10 @@ void Shutdown(InitInterfaces& interfaces)
         g_txindex->Stop();
         g_txindex.reset();
     }
+    if (g_pledgeindex) {
+        g_pledgeindex->Stop();
+        g_pledgeindex.reset();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
     DestroyAllBlockFilterIndexes();
 
@@ -424,6 +449,7 @@ void SetupServerArgs()
     hidden_args.emplace_back("-sysperms");
 #endif
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-pledgeindex", strprintf("Maintain an index of the chia pledges, used by the querychainpledgeinfo rpc call (default: %u)", DEFAULT_PLEDGEINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockfilterindex=<type>",
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
                  " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
@@ -487,19 +513,23 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubhashtx=<address>", "Enable publish hash transaction in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblock=<address>", "Enable publish raw block in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtx=<address>", "Enable publish raw transaction in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubchallenge=<address>", "Enable publish the challenge of the next block in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashblockhwm=<n>", strprintf("Set publish hash block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtxhwm=<n>", strprintf("Set publish hash transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubchallengehwm=<n>", strprintf("Set publish challenge outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
 #else
     hidden_args.emplace_back("-zmqpubhashblock=<address>");
     hidden_args.emplace_back("-zmqpubhashtx=<address>");
     hidden_args.emplace_back("-zmqpubrawblock=<address>");
     hidden_args.emplace_back("-zmqpubrawtx=<address>");
+    hidden_args.emplace_back("-zmqpubchallenge=<address>");
     hidden_args.emplace_back("-zmqpubhashblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubhashtxhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawtxhwm=<n>");
+    hidden_args.emplace_back("-zmqpubchallengehwm=<n>");
 #endif
 
     gArgs.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -531,6 +561,7 @@ void SetupServerArgs()
     gArgs.AddArg("-logthreadnames", strprintf("Prepend debug output with name of the originating thread (only available on platforms supporting thread_local) (default: %u)", DEFAULT_LOGTHREADNAMES), ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-maxproofcachesize=<n>", strprintf("Limit sum of the caches of verified VDF and PoS proofs and farmer signatures to <n> MiB (default: %u)", DEFAULT_MAX_PROOF_CACHE_SIZE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-printpriority", strprintf("Log transaction fee per kB when mining blocks (default: %u)", DEFAULT_PRINTPRIORITY), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -574,6 +605,11 @@ void SetupServerArgs()
     gArgs.AddArg("-forcecheckdeadline", strprintf("Force check every block work (default: %u)", DEFAULT_CHECKWORK_ENABLED), ArgsManager::ALLOW_ANY, OptionsCategory::POC);
     gArgs.AddArg("-signprivkey", "Import private key for block signature", ArgsManager::ALLOW_ANY, OptionsCategory::POC);
     gArgs.AddArg("-skip-ibd", "Skip the checking procedure for `Initial block download`", ArgsManager::ALLOW_BOOL, OptionsCategory::POC);
+    gArgs.AddArg("-plotdir=<dir>", "Look up the qualities from the plot files (*.plot) in <dir> for the new challenges. This option can be specified multiple times to add multiple directories", ArgsManager::ALLOW_ANY, OptionsCategory::POC);
+    gArgs.AddArg("-harvesterthreads=<n>", strprintf("Set the number of threads to look up the qualities from the plot files (1 to %d, default: %d)", MAX_HARVESTER_THREADS, DEFAULT_HARVESTER_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::POC);
+    gArgs.AddArg("-chiacandidateinterval=<n>", strprintf("Set the minimum interval in milliseconds to select the transactions of the next block again on the mempool changes (default: %d)", DEFAULT_CHIA_CANDIDATE_INTERVAL), ArgsManager::ALLOW_ANY, OptionsCategory::POC);
+    gArgs.AddArg("-submitproofthreads=<n>", strprintf("Set the number of threads to verify the proofs submitted by submitproof (1 to %d, default: %d)", MAX_SUBMIT_PROOF_THREADS, DEFAULT_SUBMIT_PROOF_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::POC);
+    gArgs.AddArg("-vdfstoredepth=<n>", strprintf("Drop the VDF requests and proofs of the challenges which are <n> blocks behind the tip (default: %d)", DEFAULT_VDF_STORE_DEPTH), ArgsManager::ALLOW_ANY, OptionsCategory::POC);
 
 #ifdef ENABLE_OMNICORE
     gArgs.AddArg("-omni", strprintf("Enable omnicore (default: %u)", DEFAULT_OMNICORE), ArgsManager::ALLOW_ANY, OptionsCategory::OMNI);
@@ -581,6 +617,7 @@ void SetupServerArgs()
     gArgs.AddArg("-omnitxcache", "The maximum number of transactions in the input transaction cache (default: 500000)", ArgsManager::ALLOW_ANY, OptionsCategory::OMNI);
     gArgs.AddArg("-omniprogressfrequency", "Time in seconds after which the initial scanning progress is reported (default: 30)", ArgsManager::ALLOW_ANY, OptionsCategory::OMNI);
     gArgs.AddArg("-omniseedblockfilter", "Set skipping of blocks without Omni transactions during initial scan (default: 1)", ArgsManager::ALLOW_ANY, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniscanthreads", "Number of threads reading the blocks ahead of the initial scan, 0 reads them in the scanning thread (0 to 16, default: 2)", ArgsManager::ALLOW_ANY, OptionsCategory::OMNI);
     gArgs.AddArg("-omnilogfile", "The path of the log file (default: omnicore.log)", ArgsManager::ALLOW_ANY, OptionsCategory::OMNI);
     gArgs.AddArg("-omnidebug=<category>", "Enable or disable log categories, can be \"all\" or \"none\"", ArgsManager::ALLOW_ANY, OptionsCategory::OMNI);
     gArgs.AddArg("-omniautocommit", "Enable or disable broadcasting of transactions, when creating transactions (default: 1)", ArgsManager::ALLOW_ANY, OptionsCategory::OMNI);
@@ -597,6 +634,7 @@ void SetupServerArgs()
     hidden_args.emplace_back("-omnitxcache");
     hidden_args.emplace_back("-omniprogressfrequency");
     hidden_args.emplace_back("-omniseedblockfilter");
+    hidden_args.emplace_back("-omniscanthreads");
     hidden_args.emplace_back("-omnilogfile");
     hidden_args.emplace_back("-omnidebug");
     hidden_args.emplace_back("-omniautocommit");
@@ -1035,6 +1073,8 @@ bool AppInitParameterInteraction()
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex.").translated);
+        if (gArgs.GetBoolArg("-pledgeindex", DEFAULT_PLEDGEINDEX))
+            return InitError(_("Prune mode is incompatible with -pledgeindex.").translated);
         if (!g_enabled_filter_types.empty()) {
             return InitError(_("Prune mode is incompatible with -blockfilterindex.").translated);
         }
@@ -1258,6 +1298,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string shabal256_algo = Shabal256AutoDetect();
+    LogPrintf("Using the '%s' SHABAL256 implementation\n", shabal256_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1338,11 +1380,17 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    chiapos::InitProofCache();
+    chiapos::g_vdf_store.SetMaxDepth(gArgs.GetArg("-vdfstoredepth", DEFAULT_VDF_STORE_DEPTH));
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread([i]() { return ThreadHeaderProofsCheck(i); });
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread([i]() { return ThreadDeadlineCheck(i); });
     }
 
     // Start the lightweight task scheduler thread
@@ -1520,6 +1568,8 @@ bool AppInitMain(InitInterfaces& interfaces)
     nTotalCache -= nBlockTreeDBCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
+    int64_t nPledgeIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-pledgeindex", DEFAULT_PLEDGEINDEX) ? nMaxPledgeIndexCache << 20 : 0);
+    nTotalCache -= nPledgeIndexCache;
     int64_t filter_index_cache = 0;
     if (!g_enabled_filter_types.empty()) {
         size_t n_indexes = g_enabled_filter_types.size();
@@ -1537,6 +1587,9 @@ bool AppInitMain(InitInterfaces& interfaces)
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         LogPrintf("* Using %.1f MiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    if (gArgs.GetBoolArg("-pledgeindex", DEFAULT_PLEDGEINDEX)) {
+        LogPrintf("* Using %.1f MiB for pledge index database\n", nPledgeIndexCache * (1.0 / 1024 / 1024));
+    }
     for (BlockFilterType filter_type : g_enabled_filter_types) {
         LogPrintf("* Using %.1f MiB for %s block filter index database\n",
                   filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
@@ -1844,6 +1897,11 @@ bool AppInitMain(InitInterfaces& interfaces)
         g_txindex->Start();
     }
 
+    if (gArgs.GetBoolArg("-pledgeindex", DEFAULT_PLEDGEINDEX)) {
+        g_pledgeindex = MakeUnique<PledgeIndex>(nPledgeIndexCache, false, fReindex);
+        g_pledgeindex->Start();
+    }
+
     for (const auto& filter_type : g_enabled_filter_types) {
         InitBlockFilterIndex(filter_type, filter_index_cache, false, fReindex);
         GetBlockFilterIndex(filter_type)->Start();
@@ -2024,6 +2082,21 @@ bool AppInitMain(InitInterfaces& interfaces)
     if (!StartPOC())
         return false;
 
+    // The candidate builder is started by the first request from a farmer
+    g_chia_candidate_builder = MakeUnique<CChiaBlockCandidateBuilder>(chainparams, gArgs.GetArg("-chiacandidateinterval", DEFAULT_CHIA_CANDIDATE_INTERVAL));
+    chiapos::g_block_submitter = MakeUnique<chiapos::CBlockSubmitter>(gArgs.GetArg("-submitproofthreads", DEFAULT_SUBMIT_PROOF_THREADS));
+    chiapos::g_block_submitter->Start();
+
+    if (gArgs.IsArgSet("-plotdir")) {
+        std::vector<fs::path> vPlotDirs;
+        for (const std::string& strDir : gArgs.GetArgs("-plotdir")) {
+            vPlotDirs.push_back(fs::absolute(strDir));
+        }
+        chiapos::g_harvester = MakeUnique<chiapos::CHarvester>(gArgs.GetArg("-harvesterthreads", DEFAULT_HARVESTER_THREADS));
+        chiapos::g_harvester->LoadPlots(vPlotDirs);
+        chiapos::g_harvester->Start();
+    }
+
     // ********************************************************* Step 13: finished
 
     SetRPCWarmupFinished();
@@ -26,7 +26,9 @@
 #include <util/validation.h>
 
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <utility>
 
 #include <logging.h>
@@ -222,14 +224,69 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript &sc
     return std::move(pblocktemplate);
 }
 
+std::shared_ptr<const CChiaBlockCandidate> BlockAssembler::SelectChiaBlockTxs(const CBlockIndex *pindexPrev)
+{
+    int64_t nTimeStart = GetTimeMicros();
+
+    AssertLockHeld(cs_main);
+    assert(pindexPrev != nullptr);
+
+    resetBlock();
+
+    pblocktemplate.reset(new CBlockTemplate());
+    pblock = &pblocktemplate->block; // pointer for convenience
+
+    LOCK(mempool.cs);
+    nHeight = pindexPrev->nHeight + 1;
+    nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST) ? pindexPrev->GetMedianTimePast() : GetAdjustedTime();
+
+    // Decide whether to include witness transactions
+    // This is only needed in case the witness softfork activation is reverted
+    // (which would require a very deep reorganization).
+    // Note that the mempool would accept transactions with witness data before
+    // IsWitnessEnabled, but we would only ever mine blocks after IsWitnessEnabled
+    // unless there is a massive block reorganization with the witness softfork
+    // not activated.
+    // TODO: replace this with a call to main to assess validity of a mempool
+    // transaction (which in most cases can be a no-op).
+    fIncludeWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus());
+
+    int nPackagesSelected = 0;
+    int nDescendantsUpdated = 0;
+    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+
+    std::shared_ptr<CChiaBlockCandidate> candidate = std::make_shared<CChiaBlockCandidate>();
+    candidate->hashPrevBlock = pindexPrev->GetBlockHash();
+    candidate->nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    candidate->vtx = std::move(pblock->vtx);
+    candidate->vTxFees = std::move(pblocktemplate->vTxFees);
+    candidate->vTxSigOpsCost = std::move(pblocktemplate->vTxSigOpsCost);
+    candidate->nBlockWeight = nBlockWeight;
+    candidate->nBlockSigOpsCost = nBlockSigOpsCost;
+    candidate->nFees = nFees;
+
+    LogPrint(BCLog::BENCH, "SelectChiaBlockTxs() packages: %.2fms (%d packages, %d updated descendants), %u txs\n",
+        0.001 * (GetTimeMicros() - nTimeStart), nPackagesSelected, nDescendantsUpdated, nBlockTx);
+
+    return candidate;
+}
+
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewChiaBlock(const CBlockIndex *pindexPrev,
     const CScript &scriptPubKeyIn,
     const chiapos::CKey &farmerSk,
     const chiapos::CPosProof &posProof,
-    const chiapos::CVdfProof &vdfProof)
+    const chiapos::CVdfProof &vdfProof,
+    std::shared_ptr<const CChiaBlockCandidate> candidate)
 {
     int64_t nTimeStart = GetTimeMicros();
 
+    AssertLockHeld(cs_main);
+    assert(pindexPrev != nullptr);
+
+    if (candidate == nullptr || candidate->hashPrevBlock != pindexPrev->GetBlockHash()) {
+        candidate = GetChiaBlockCandidate(chainparams, pindexPrev);
+    }
+
     resetBlock();
 
     pblocktemplate.reset(new CBlockTemplate());
@@ -245,10 +302,15 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewChiaBlock(const CBlockI
     pblocktemplate->vTxFees.push_back(-1);       // updated at end
     pblocktemplate->vTxSigOpsCost.push_back(-1); // updated at end
 
-    AssertLockHeld(cs_main);
-    assert(pindexPrev != nullptr);
+    // The transactions from the candidate
+    pblock->vtx.insert(pblock->vtx.end(), candidate->vtx.begin(), candidate->vtx.end());
+    pblocktemplate->vTxFees.insert(pblocktemplate->vTxFees.end(), candidate->vTxFees.begin(), candidate->vTxFees.end());
+    pblocktemplate->vTxSigOpsCost.insert(pblocktemplate->vTxSigOpsCost.end(), candidate->vTxSigOpsCost.begin(), candidate->vTxSigOpsCost.end());
+    nBlockWeight = candidate->nBlockWeight;
+    nBlockSigOpsCost = candidate->nBlockSigOpsCost;
+    nBlockTx = candidate->vtx.size();
+    nFees = candidate->nFees;
 
-    LOCK(mempool.cs);
     nHeight = pindexPrev->nHeight + 1;
 
     const Consensus::Params &params = chainparams.GetConsensus();
@@ -259,21 +321,6 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewChiaBlock(const CBlockI
 
     pblock->nTime = GetAdjustedTime();
 
-    // Decide whether to include witness transactions
-    // This is only needed in case the witness softfork activation is reverted
-    // (which would require a very deep reorganization).
-    // Note that the mempool would accept transactions with witness data before
-    // IsWitnessEnabled, but we would only ever mine blocks after IsWitnessEnabled
-    // unless there is a massive block reorganization with the witness softfork
-    // not activated.
-    // TODO: replace this with a call to main to assess validity of a mempool
-    // transaction (which in most cases can be a no-op).
-    fIncludeWitness = IsWitnessEnabled(pindexPrev, params);
-
-    int nPackagesSelected = 0;
-    int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
-
     int64_t nTime1 = GetTimeMicros();
 
     m_last_block_num_txs = nBlockTx;
@@ -346,8 +393,8 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewChiaBlock(const CBlockI
     int64_t nTime2 = GetTimeMicros();
 
     LogPrint(BCLog::BENCH,
-        "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n",
-        0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1),
+        "CreateNewChiaBlock() transactions: %.2fms (%u txs), coinbase and signature: %.2fms (total %.2fms)\n",
+        0.001 * (nTime1 - nTimeStart), nBlockTx, 0.001 * (nTime2 - nTime1),
         0.001 * (nTime2 - nTimeStart));
 
     CValidationState state;
@@ -653,3 +700,175 @@ bool BlockAssembler::sign(CBlock &block, const CKey &privKey)
 
     return true;
 }
+
+std::unique_ptr<CChiaBlockCandidateBuilder> g_chia_candidate_builder;
+
+CChiaBlockCandidateBuilder::CChiaBlockCandidateBuilder(const CChainParams& params, int64_t nIntervalMillis)
+    : chainparams(params), m_nIntervalMicros(std::max<int64_t>(0, nIntervalMillis) * 1000) {}
+
+CChiaBlockCandidateBuilder::~CChiaBlockCandidateBuilder() { Stop(); }
+
+void CChiaBlockCandidateBuilder::Start()
+{
+    assert(!m_thread.joinable());
+    {
+        LOCK(m_cs);
+        m_fStop = false;
+        // Select the transactions for the current tip
+        m_fStale = true;
+        m_fNewTip = true;
+    }
+    m_thread = std::thread(&TraceThread<std::function<void()>>, "chiacandidate", std::function<void()>(std::bind(&CChiaBlockCandidateBuilder::ThreadBuild, this)));
+    RegisterValidationInterface(this);
+}
+
+void CChiaBlockCandidateBuilder::Stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    UnregisterValidationInterface(this);
+    {
+        LOCK(m_cs);
+        m_fStop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+void CChiaBlockCandidateBuilder::StartOnDemand()
+{
+    std::call_once(m_startOnce, [this]() { Start(); });
+}
+
+std::shared_ptr<const CChiaBlockCandidate> CChiaBlockCandidateBuilder::Get(const CBlockIndex* pindexPrev) const
+{
+    LOCK(m_cs);
+    if (m_candidate == nullptr || m_candidate->hashPrevBlock != pindexPrev->GetBlockHash()) {
+        return nullptr;
+    }
+    return m_candidate;
+}
+
+void CChiaBlockCandidateBuilder::Put(std::shared_ptr<const CChiaBlockCandidate> candidate)
+{
+    LOCK(m_cs);
+    if (m_candidate == nullptr || m_candidate->hashPrevBlock != candidate->hashPrevBlock) {
+        m_candidate = std::move(candidate);
+    }
+}
+
+ChiaBlockCandidateStats CChiaBlockCandidateBuilder::GetStats() const
+{
+    LOCK(m_cs);
+    ChiaBlockCandidateStats stats;
+    stats.nBuilds = m_nBuilds;
+    stats.nLastBuildMicros = m_nLastBuildMicros;
+    stats.nMaxBuildMicros = m_nMaxBuildMicros;
+    stats.fReady = m_candidate != nullptr;
+    stats.hashPrevBlock = m_candidate ? m_candidate->hashPrevBlock : uint256();
+    stats.nTxs = m_candidate ? m_candidate->vtx.size() : 0;
+    stats.nFees = m_candidate ? m_candidate->nFees : 0;
+    stats.fStale = m_fStale;
+    return stats;
+}
+
+void CChiaBlockCandidateBuilder::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload) {
+        return;
+    }
+    MarkStale(true);
+}
+
+void CChiaBlockCandidateBuilder::TransactionAddedToMempool(const CTransactionRef &ptxn)
+{
+    MarkStale(false);
+}
+
+void CChiaBlockCandidateBuilder::TransactionRemovedFromMempool(const CTransactionRef &ptx)
+{
+    MarkStale(false);
+}
+
+void CChiaBlockCandidateBuilder::MarkStale(bool fNewTip)
+{
+    {
+        LOCK(m_cs);
+        if (fNewTip) {
+            // The candidate of the previous tip is useless, drop it to release the transactions
+            m_candidate.reset();
+            m_fNewTip = true;
+        }
+        m_fStale = true;
+    }
+    m_cond.notify_all();
+}
+
+void CChiaBlockCandidateBuilder::ThreadBuild()
+{
+    while (true) {
+        {
+            WAIT_LOCK(m_cs, lock);
+            while (true) {
+                if (m_fStop) {
+                    return;
+                }
+                if (m_fStale) {
+                    // A new tip is selected immediately, the mempool changes are merged over the interval
+                    int64_t nWait = m_fNewTip ? 0 : m_nLastBuildTime + m_nIntervalMicros - GetTimeMicros();
+                    if (nWait <= 0) {
+                        break;
+                    }
+                    m_cond.wait_for(lock, std::chrono::microseconds(nWait));
+                } else {
+                    m_cond.wait(lock);
+                }
+            }
+            m_fStale = false;
+            m_fNewTip = false;
+        }
+
+        int64_t nTimeStart = GetTimeMicros();
+        std::shared_ptr<const CChiaBlockCandidate> candidate;
+        try {
+            LOCK(cs_main);
+            const CBlockIndex* pindexTip = ::ChainActive().Tip();
+            if (pindexTip != nullptr && pindexTip->nHeight + 1 >= chainparams.GetConsensus().BHDIP009Height) {
+                candidate = BlockAssembler(chainparams).SelectChiaBlockTxs(pindexTip);
+            }
+        } catch (const std::exception& e) {
+            LogPrintf("%s: cannot select the transactions, %s\n", __func__, e.what());
+        }
+        int64_t nTimeEnd = GetTimeMicros();
+
+        LOCK(m_cs);
+        m_nLastBuildTime = nTimeEnd;
+        if (candidate == nullptr) {
+            continue;
+        }
+        // The tip may be changed after the selection, a candidate is only used on the tip it is built on
+        m_candidate = std::move(candidate);
+        ++m_nBuilds;
+        m_nLastBuildMicros = nTimeEnd - nTimeStart;
+        m_nMaxBuildMicros = std::max(m_nMaxBuildMicros, m_nLastBuildMicros);
+    }
+}
+
+std::shared_ptr<const CChiaBlockCandidate> GetChiaBlockCandidate(const CChainParams& params, const CBlockIndex* pindexPrev)
+{
+    AssertLockHeld(cs_main);
+    assert(pindexPrev != nullptr);
+
+    if (g_chia_candidate_builder) {
+        std::shared_ptr<const CChiaBlockCandidate> candidate = g_chia_candidate_builder->Get(pindexPrev);
+        if (candidate != nullptr) {
+            return candidate;
+        }
+    }
+    std::shared_ptr<const CChiaBlockCandidate> candidate = BlockAssembler(params).SelectChiaBlockTxs(pindexPrev);
+    if (g_chia_candidate_builder) {
+        g_chia_candidate_builder->Put(candidate);
+    }
+    return candidate;
+}
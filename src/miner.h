@@ -8,11 +8,16 @@
 
 #include <optional.h>
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
 #include <validation.h>
+#include <validationinterface.h>
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <stdint.h>
+#include <thread>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -32,6 +37,8 @@ class CVdfProof;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+//! Default for -chiacandidateinterval, the minimum interval in milliseconds to select the transactions again on mempool changes
+static const int64_t DEFAULT_CHIA_CANDIDATE_INTERVAL = 500;
 
 struct CBlockTemplate
 {
@@ -41,6 +48,21 @@ struct CBlockTemplate
     std::vector<unsigned char> vchCoinbaseCommitment;
 };
 
+/** The transactions selected from the mempool for a chia block on top of a tip, the coinbase isn't included */
+struct CChiaBlockCandidate
+{
+    uint256 hashPrevBlock;
+    //! The value of mempool.GetTransactionsUpdated() when the transactions were selected
+    unsigned int nTransactionsUpdated{0};
+    std::vector<CTransactionRef> vtx;
+    std::vector<CAmount> vTxFees;
+    std::vector<int64_t> vTxSigOpsCost;
+    //! The weight and the sigops cost include the space reserved for the coinbase
+    uint64_t nBlockWeight{0};
+    uint64_t nBlockSigOpsCost{0};
+    CAmount nFees{0};
+};
+
 // Container for tracking updates to ancestor feerate as we include (parent)
 // transactions in a block
 struct CTxMemPoolModifiedEntry {
@@ -176,11 +198,19 @@ public:
         uint64_t deadline = 0,
         const std::shared_ptr<CKey> privKey = nullptr);
 
+    /** Select the transactions from the mempool for a chia block on top of pindexPrev */
+    std::shared_ptr<const CChiaBlockCandidate> SelectChiaBlockTxs(const CBlockIndex *pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /**
+     * Construct a chia block on top of pindexPrev, the transactions are taken from the candidate, they are taken from
+     * GetChiaBlockCandidate when the candidate is null or it isn't built on pindexPrev
+     */
     std::unique_ptr<CBlockTemplate> CreateNewChiaBlock(const CBlockIndex *pindexPrev,
         const CScript &scriptPubKeyIn,
         const chiapos::CKey &farmerSk,
         const chiapos::CPosProof &posProof,
-        const chiapos::CVdfProof &vdfProof);
+        const chiapos::CVdfProof &vdfProof,
+        std::shared_ptr<const CChiaBlockCandidate> candidate = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     static Optional<int64_t> m_last_block_num_txs;
     static Optional<int64_t> m_last_block_weight;
@@ -222,4 +252,83 @@ private:
     bool sign(CBlock &block, const CKey &privKey);
 };
 
+struct ChiaBlockCandidateStats
+{
+    uint64_t nBuilds;
+    int64_t nLastBuildMicros;
+    int64_t nMaxBuildMicros;
+    //! The transactions of the latest candidate, the candidate is dropped when the tip is changed
+    bool fReady;
+    uint256 hashPrevBlock;
+    uint64_t nTxs;
+    CAmount nFees;
+    //! The candidate is selected before the latest mempool change, it will be selected again soon
+    bool fStale;
+};
+
+/**
+ * Keep the transactions for a chia block on top of the tip selected by a background thread, so the block can be
+ * constructed with the coinbase, reward and signature only when the proofs arrive. The candidate is dropped on a new
+ * tip and selected immediately, it is selected again on the mempool changes no more often than the interval. A
+ * candidate selected before the latest mempool changes is still valid on the same tip, it's used until the new one is
+ * ready. The builder is started by the first querychallenge or submitproof, a node without farmers never selects the
+ * transactions in the background.
+ */
+class CChiaBlockCandidateBuilder final : public CValidationInterface
+{
+public:
+    CChiaBlockCandidateBuilder(const CChainParams& params, int64_t nIntervalMillis = DEFAULT_CHIA_CANDIDATE_INTERVAL);
+
+    ~CChiaBlockCandidateBuilder();
+
+    void Start();
+
+    void Stop();
+
+    /** Start the builder when it's requested the first time, the later calls do nothing */
+    void StartOnDemand();
+
+    /** The candidate on top of pindexPrev, null when it isn't ready */
+    std::shared_ptr<const CChiaBlockCandidate> Get(const CBlockIndex* pindexPrev) const;
+
+    /** Keep a candidate selected by the caller when the builder hasn't one for the same tip */
+    void Put(std::shared_ptr<const CChiaBlockCandidate> candidate);
+
+    ChiaBlockCandidateStats GetStats() const;
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef &ptxn) override;
+    void TransactionRemovedFromMempool(const CTransactionRef &ptx) override;
+
+private:
+    void ThreadBuild();
+
+    void MarkStale(bool fNewTip);
+
+    const CChainParams& chainparams;
+    const int64_t m_nIntervalMicros;
+    std::once_flag m_startOnce;
+    std::thread m_thread;
+
+    mutable Mutex m_cs;
+    std::condition_variable m_cond;
+    bool m_fStop GUARDED_BY(m_cs){false};
+    bool m_fStale GUARDED_BY(m_cs){false};
+    bool m_fNewTip GUARDED_BY(m_cs){false};
+    int64_t m_nLastBuildTime GUARDED_BY(m_cs){0};
+    std::shared_ptr<const CChiaBlockCandidate> m_candidate GUARDED_BY(m_cs);
+    uint64_t m_nBuilds GUARDED_BY(m_cs){0};
+    int64_t m_nLastBuildMicros GUARDED_BY(m_cs){0};
+    int64_t m_nMaxBuildMicros GUARDED_BY(m_cs){0};
+};
+
+extern std::unique_ptr<CChiaBlockCandidateBuilder> g_chia_candidate_builder;
+
+/**
+ * Get the transactions for a chia block on top of pindexPrev, the candidate of the builder is used when it's ready,
+ * otherwise the transactions are selected on the calling thread and handed to the builder
+ */
+std::shared_ptr<const CChiaBlockCandidate> GetChiaBlockCandidate(const CChainParams& params, const CBlockIndex* pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 #endif // BITCOIN_MINER_H
@@ -30,6 +30,7 @@
 #include <util/validation.h>
 
 #include <chiapos/post.h>
+#include <chiapos/vdf_store.h>
 
 #include <memory>
 #include <typeinfo>
@@ -365,41 +366,6 @@ struct CNodeState {
     //! Whether this peer is a manual connection
     bool m_is_manual_connection;
 
-    //! vdf requests, the requests from the node we've received, key is the challenge
-    std::map<uint256, std::set<int>> m_vdf_requests;
-    bool add_vdf_request(uint256 const& challenge, int nReqIters) {
-        auto it = m_vdf_requests.find(challenge);
-        if (it == std::cend(m_vdf_requests)) {
-            m_vdf_requests.insert(std::make_pair(challenge, std::set<int>{nReqIters}));
-        } else {
-            if (it->second.find(nReqIters) != std::cend(it->second)) {
-                // the request is sent from the node more than one time
-                return false;
-            }
-            it->second.insert(nReqIters);
-        }
-        return true;
-    }
-
-    //! vdf proofs, all the proofs from the node we've learned, key is the challenge
-    std::map<uint256, std::vector<chiapos::CVdfProof>> m_vdf_proofs;
-    bool add_vdf_proof(chiapos::CVdfProof const& vdfProof) {
-        auto it = m_vdf_proofs.find(vdfProof.challenge);
-        if (it == std::cend(m_vdf_proofs)) {
-            m_vdf_proofs.insert(std::make_pair(vdfProof.challenge, std::vector<chiapos::CVdfProof>{vdfProof}));
-        } else {
-            auto it2 = std::find_if(std::cbegin(it->second), std::cend(it->second), [&vdfProof](chiapos::CVdfProof const& vdf) {
-                return vdfProof.Equals(vdf);
-            });
-            if (it2 != std::cend(it->second)) {
-                return false;
-            }
-            // save vdf proof
-            it->second.push_back(vdfProof);
-        }
-        return true;
-    }
-
     CNodeState(CAddress addrIn, std::string addrNameIn, bool is_inbound, bool is_manual) :
         address(addrIn), name(std::move(addrNameIn)), m_is_inbound(is_inbound),
         m_is_manual_connection (is_manual)
@@ -827,6 +793,8 @@ void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTim
     if (state->fSyncStarted)
         nSyncStarted--;
 
+    chiapos::g_vdf_store.RemovePeer(nodeid);
+
     if (state->nMisbehavior == 0 && state->fCurrentlyConnected) {
         fUpdateConnectionTime = true;
     }
@@ -1257,6 +1225,7 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 void PeerLogicValidation::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
     const int nNewHeight = pindexNew->nHeight;
     connman->SetBestHeight(nNewHeight);
+    chiapos::g_vdf_store.SetTip(nNewHeight);
 
     SetServiceFlagsIBDCache(!fInitialDownload);
     if (!fInitialDownload) {
@@ -3300,11 +3269,6 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
     if (strCommand == NetMsgType::VDFREQ || strCommand == NetMsgType::VDFREQ64) {
-        LOCK(cs_main);
-        auto pindex = ::ChainActive().Tip();
-        int nTargetHeight = pindex->nHeight + 1;
-        auto const& params = Params().GetConsensus();
-
         // parse the packet
         uint256 challenge;
         uint64_t nReqIters;
@@ -3320,14 +3284,19 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             }
             nReqIters = nReqIters32;
         }
-        int nBaseIters = chiapos::GetBaseIters(nTargetHeight, params, pindex->chiaposFields.GetItersPerSec());
+        int nBaseIters;
+        {
+            LOCK(cs_main);
+            auto pindex = ::ChainActive().Tip();
+            int nTargetHeight = pindex->nHeight + 1;
+            nBaseIters = chiapos::GetBaseIters(nTargetHeight, Params().GetConsensus(), pindex->chiaposFields.GetItersPerSec());
+        }
         if (nReqIters < nBaseIters) {
             // invalid iters required, ignore
             return true;
         }
 
-        CNodeState *state = State(pfrom->GetId());
-        if (!state->add_vdf_request(challenge, nReqIters)) {
+        if (!chiapos::g_vdf_store.AddPeerRequest(pfrom->GetId(), challenge, nReqIters)) {
             // TODO double sent
         }
 
@@ -3336,23 +3305,21 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 return;
             }
             if (pnode->nVersion >= VDF_P2P_VERSION) {
-                CNodeState *state = State(pnode->GetId());
-                if (state->add_vdf_request(challenge, nReqIters)) {
+                if (chiapos::g_vdf_store.AddPeerRequest(pnode->GetId(), challenge, nReqIters)) {
                     connman->PushMessage(pnode, msgMaker.Make(NetMsgType::VDFREQ64, challenge, nReqIters));
                 }
             }
         });
 
-        if (!chiapos::AddLocalVdfRequest(challenge, nReqIters)) {
+        if (!chiapos::g_vdf_store.AddRequest(challenge, nReqIters)) {
             // TODO the request already exists
         }
 
         // check the proof of the challenge and send it back to the node
         chiapos::CVdfProof vdfProof;
-        if (chiapos::FindLocalVdfProof(challenge, nReqIters, &vdfProof)) {
+        if (chiapos::g_vdf_store.FindProof(challenge, nReqIters, &vdfProof)) {
             // The proof does already exist, we send the proof back
-            CNodeState *state = State(pfrom->GetId());
-            if (!state->add_vdf_proof(vdfProof)) {
+            if (!chiapos::g_vdf_store.AddPeerProof(pfrom->GetId(), vdfProof)) {
                 // the node already has the vdf proof, but send it anyway
             }
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::VDF, vdfProof));
@@ -3367,13 +3334,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // check the proof and ensure it is valid
         CValidationState validState;
         if (!chiapos::CheckVdfProof(vdfProof, validState)) {
+            LOCK(cs_main);
             Misbehaving(pfrom->GetId(), 100);
             LogPrint(BCLog::POC, "%s: invalid vdf proof has been received, challenge=%s, proof=%s, iters=%d\n", __func__, vdfProof.challenge.GetHex(), chiapos::BytesToHex(vdfProof.vchProof), vdfProof.nVdfIters);
             return true;
         }
 
-        CNodeState *state = State(pfrom->GetId());
-        if (!state->add_vdf_proof(vdfProof)) {
+        if (!chiapos::g_vdf_store.AddPeerProof(pfrom->GetId(), vdfProof)) {
             // TODO double sent
         }
 
@@ -3382,15 +3349,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 return;
             }
             if (pnode->nVersion >= VDF_P2P_VERSION) {
-                CNodeState *state = State(pnode->GetId());
-                if (state->add_vdf_proof(vdfProof)) {
+                if (chiapos::g_vdf_store.AddPeerProof(pnode->GetId(), vdfProof)) {
                     connman->PushMessage(pnode, msgMaker.Make(NetMsgType::VDF, vdfProof));
                 }
             }
         });
 
-        LOCK(cs_main);
-        if (!chiapos::AddLocalVdfProof(vdfProof)) {
+        if (!chiapos::g_vdf_store.AddProof(vdfProof)) {
             // TODO the vdf proof already exists
         }
         return true;
@@ -17,7 +17,10 @@
 
 #include <stdint.h>
 #include <algorithm>
+#include <map>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <openssl/sha.h>
@@ -98,6 +101,132 @@ std::string GenerateConsensusString(const uint32_t propertyId, const std::string
     return strprintf("%d|%s", propertyId, address);
 }
 
+namespace {
+//! The number of balance records between two saved states of the balances hash
+const int BALANCES_HASH_STATE_INTERVAL = 256;
+
+//! Balance records are hashed ordered by address and then by property
+typedef std::pair<std::string, uint32_t> BalanceKey;
+
+/**
+ * Keeps the consensus strings of the balances sorted, so the balances of the consensus hash aren't generated from the
+ * whole tally map each time.
+ *
+ * The cache is built by the first consensus hash and update_tally_map marks the changed records from then on. The
+ * changed records are generated again and the hashing resumes from the saved SHA256 state before the first changed
+ * record, so the unchanged records in front of it aren't hashed again.
+ */
+class CBalancesHashCache
+{
+private:
+    bool fBuilt = false;
+    //! Non-empty consensus strings of the balances
+    std::map<BalanceKey, std::string> records;
+    //! Records changed since the last hash
+    std::set<BalanceKey> changed;
+    //! The SHA256 state before hashing the record
+    std::map<BalanceKey, SHA256_CTX> states;
+    //! The SHA256 state after hashing all records, valid if no record has changed since
+    SHA256_CTX stateFinal;
+
+    void Build() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+    {
+        Clear();
+        for (std::unordered_map<std::string, CMPTally>::const_iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
+            CMPTally tally = it->second;
+            tally.init();
+            uint32_t propertyId = 0;
+            while (0 != (propertyId = (tally.next()))) {
+                std::string dataStr = GenerateConsensusString(tally, it->first, propertyId);
+                if (dataStr.empty()) continue; // skip empty balances
+                records.insert(std::make_pair(BalanceKey(it->first, propertyId), dataStr));
+            }
+        }
+        fBuilt = true;
+    }
+
+    void Refresh() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+    {
+        for (std::set<BalanceKey>::const_iterator it = changed.begin(); it != changed.end(); ++it) {
+            const CMPTally* tally = getTally(it->first);
+            std::string dataStr = tally ? GenerateConsensusString(*tally, it->first, it->second) : "";
+            if (dataStr.empty()) {
+                records.erase(*it);
+            } else {
+                records[*it] = dataStr;
+            }
+        }
+    }
+
+public:
+    void MarkChanged(const std::string& address, uint32_t propertyId)
+    {
+        if (fBuilt) changed.insert(BalanceKey(address, propertyId));
+    }
+
+    void Clear()
+    {
+        fBuilt = false;
+        records.clear();
+        changed.clear();
+        states.clear();
+    }
+
+    /** Adds the balances to the SHA256 context, which must not contain other data yet. */
+    void Hash(SHA256_CTX& shaCtx) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+    {
+        // hash all records, if they are logged
+        bool fFull = msc_debug_consensus_hash || !fBuilt;
+        if (!fBuilt) {
+            Build();
+        } else if (!fFull && changed.empty() && !states.empty()) {
+            shaCtx = stateFinal;
+            return;
+        }
+
+        // resume from the last saved state before the first changed record
+        std::map<BalanceKey, SHA256_CTX>::iterator itState = states.begin();
+        BalanceKey resumeKey;
+        if (!fFull && !changed.empty()) {
+            itState = states.upper_bound(*changed.begin());
+            if (itState != states.begin()) {
+                --itState;
+                resumeKey = itState->first;
+                shaCtx = itState->second;
+            }
+        }
+        states.erase(itState, states.end());
+
+        Refresh();
+        changed.clear();
+
+        std::map<BalanceKey, std::string>::const_iterator it = records.lower_bound(resumeKey);
+        for (int n = 0; it != records.end(); ++it, ++n) {
+            if (n % BALANCES_HASH_STATE_INTERVAL == 0) states[it->first] = shaCtx;
+            const std::string& dataStr = it->second;
+            if (msc_debug_consensus_hash) PrintToLog("Adding balance data to consensus hash: %s\n", dataStr);
+            SHA256_Update(&shaCtx, dataStr.c_str(), dataStr.length());
+        }
+        if (states.empty()) states[BalanceKey()] = shaCtx;
+        stateFinal = shaCtx;
+    }
+};
+
+CBalancesHashCache balancesHashCache GUARDED_BY(cs_tally);
+} // namespace
+
+void MarkBalanceChanged(const std::string& address, uint32_t propertyId)
+{
+    AssertLockHeld(cs_tally);
+    balancesHashCache.MarkChanged(address, propertyId);
+}
+
+void ClearBalancesHashCache()
+{
+    AssertLockHeld(cs_tally);
+    balancesHashCache.Clear();
+}
+
 /**
  * Obtains a hash of the active state to use for consensus verification and checkpointing.
  *
@@ -157,25 +286,10 @@ uint256 GetConsensusHash()
 
     if (msc_debug_consensus_hash) PrintToLog("Beginning generation of current consensus hash...\n");
 
-    // Balances - loop through the tally map, updating the sha context with the data from each balance and tally type
+    // Balances - add the balance records of the tally map to the sha context, sorted by address and then by property
     // Placeholders:  "address|propertyid|balance|selloffer_reserve|accept_reserve|metadex_reserve"
-    // Sort alphabetically first
-    std::map<std::string, CMPTally> tallyMapSorted;
-    for (std::unordered_map<std::string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
-        tallyMapSorted.insert(std::make_pair(uoit->first,uoit->second));
-    }
-    for (std::map<std::string, CMPTally>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
-        const std::string& address = my_it->first;
-        CMPTally& tally = my_it->second;
-        tally.init();
-        uint32_t propertyId = 0;
-        while (0 != (propertyId = (tally.next()))) {
-            std::string dataStr = GenerateConsensusString(tally, address, propertyId);
-            if (dataStr.empty()) continue; // skip empty balances
-            if (msc_debug_consensus_hash) PrintToLog("Adding balance data to consensus hash: %s\n", dataStr);
-            SHA256_Update(&shaCtx, dataStr.c_str(), dataStr.length());
-        }
-    }
+    // The records changed since the last hash are updated in the cache, the unchanged ones in front of them aren't hashed again
+    balancesHashCache.Hash(shaCtx);
 
     // DEx sell offers - loop through the DEx and add each sell offer to the consensus hash (ordered by txid)
     // Placeholders: "txid|address|propertyid|offeramount|btcdesired|minfee|timelimit"
@@ -216,13 +330,16 @@ uint256 GetConsensusHash()
     // Placeholders: "txid|address|propertyidforsale|amountforsale|propertyiddesired|amountdesired|amountremaining"
     std::vector<std::pair<arith_uint256, std::string> > vecMetaDExTrades;
     for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        const md_PricesMap& prices = my_it->second;
-        for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
-            const md_Set& indexes = it->second;
-            for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                const CMPMetaDEx& obj = *it;
-                std::string dataStr = GenerateConsensusString(obj);
-                vecMetaDExTrades.push_back(std::make_pair(arith_uint256(obj.getHash().ToString()), dataStr));
+        const md_PairsMap& pairs = my_it->second;
+        for (md_PairsMap::const_iterator pair_it = pairs.begin(); pair_it != pairs.end(); ++pair_it) {
+            const md_PricesMap& prices = pair_it->second;
+            for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+                const md_Set& indexes = it->second;
+                for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                    const CMPMetaDEx& obj = *it;
+                    std::string dataStr = GenerateConsensusString(obj);
+                    vecMetaDExTrades.push_back(std::make_pair(arith_uint256(obj.getHash().ToString()), dataStr));
+                }
             }
         }
     }
@@ -287,13 +404,16 @@ uint256 GetMetaDExHash(const uint32_t propertyId)
     std::vector<std::pair<arith_uint256, std::string> > vecMetaDExTrades;
     for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
         if (propertyId == 0 || propertyId == my_it->first) {
-            const md_PricesMap& prices = my_it->second;
-            for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
-                const md_Set& indexes = it->second;
-                for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                    const CMPMetaDEx& obj = *it;
-                    std::string dataStr = GenerateConsensusString(obj);
-                    vecMetaDExTrades.push_back(std::make_pair(arith_uint256(obj.getHash().ToString()), dataStr));
+            const md_PairsMap& pairs = my_it->second;
+            for (md_PairsMap::const_iterator pair_it = pairs.begin(); pair_it != pairs.end(); ++pair_it) {
+                const md_PricesMap& prices = pair_it->second;
+                for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+                    const md_Set& indexes = it->second;
+                    for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                        const CMPMetaDEx& obj = *it;
+                        std::string dataStr = GenerateConsensusString(obj);
+                        vecMetaDExTrades.push_back(std::make_pair(arith_uint256(obj.getHash().ToString()), dataStr));
+                    }
                 }
             }
         }
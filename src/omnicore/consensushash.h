@@ -3,6 +3,9 @@
 
 #include <uint256.h>
 
+#include <stdint.h>
+#include <string>
+
 namespace mastercore
 {
 /** Checks if a given block should be consensus hashed. */
@@ -17,6 +20,12 @@ uint256 GetMetaDExHash(const uint32_t propertyId = 0);
 /** Obtains a hash of the balances for a specific property. */
 uint256 GetBalancesHash(const uint32_t hashPropertyId);
 
+/** Marks a balance record as changed for the next consensus hash, called by update_tally_map. */
+void MarkBalanceChanged(const std::string& address, uint32_t propertyId);
+
+/** Drops the cached balance records of the consensus hash, when the tally map is cleared. */
+void ClearBalancesHashCache();
+
 }
 
 #endif // BITCOIN_OMNICORE_CONSENSUSHASH_H
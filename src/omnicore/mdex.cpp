@@ -24,11 +24,14 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <fstream>
 #include <limits>
 #include <map>
 #include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 typedef boost::multiprecision::cpp_dec_float_100 dec_float;
 typedef boost::multiprecision::checked_int128_t int128_t;
@@ -41,7 +44,7 @@ using namespace mastercore;
 //! Global map for price and order data
 md_PropertiesMap mastercore::metadex;
 
-md_PricesMap* mastercore::get_Prices(uint32_t prop)
+md_PairsMap* mastercore::get_Pairs(uint32_t prop)
 {
     AssertLockHeld(cs_tally);
 
@@ -49,6 +52,19 @@ md_PricesMap* mastercore::get_Prices(uint32_t prop)
 
     if (it != metadex.end()) return &(it->second);
 
+    return static_cast<md_PairsMap*>(nullptr);
+}
+
+md_PricesMap* mastercore::get_Prices(uint32_t prop, uint32_t desprop)
+{
+    md_PairsMap* p_pairs = get_Pairs(prop);
+
+    if (!p_pairs) return static_cast<md_PricesMap*>(nullptr);
+
+    md_PairsMap::iterator it = p_pairs->find(desprop);
+
+    if (it != p_pairs->end()) return &(it->second);
+
     return static_cast<md_PricesMap*>(nullptr);
 }
 
@@ -61,6 +77,30 @@ md_Set* mastercore::get_Indexes(md_PricesMap* p, rational_t price)
     return static_cast<md_Set*>(nullptr);
 }
 
+/**
+ * Removes the empty price levels of the pair, and the pair itself, once there are no orders left.
+ */
+static void prune_Pair(uint32_t prop, uint32_t desprop)
+{
+    AssertLockHeld(cs_tally);
+
+    md_PropertiesMap::iterator propIt = metadex.find(prop);
+    if (propIt == metadex.end()) return;
+
+    md_PairsMap& pairs = propIt->second;
+    md_PairsMap::iterator pairIt = pairs.find(desprop);
+    if (pairIt != pairs.end()) {
+        md_PricesMap& prices = pairIt->second;
+        for (md_PricesMap::iterator it = prices.begin(); it != prices.end();) {
+            if (it->second.empty()) prices.erase(it++);
+            else ++it;
+        }
+        if (prices.empty()) pairs.erase(pairIt);
+    }
+
+    if (pairs.empty()) metadex.erase(propIt);
+}
+
 enum MatchReturnType
 {
     NOTHING = 0,
@@ -143,7 +183,8 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
     if (msc_debug_metadex1) PrintToLog("%s(%s: prop=%d, desprop=%d, desprice= %s);newo: %s\n",
         __FUNCTION__, pnew->getAddr(), propertyForSale, propertyDesired, xToString(pnew->inversePrice()), pnew->ToString());
 
-    md_PricesMap* const ppriceMap = get_Prices(propertyDesired);
+    // the book of the sellers of the desired property, who want the property for sale of the new order
+    md_PricesMap* const ppriceMap = get_Prices(propertyDesired, propertyForSale);
 
     // nothing for the desired property exists in the market, sorry!
     if (!ppriceMap) {
@@ -151,16 +192,18 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
         return NewReturn;
     }
 
-    // within the desired property map (given one property) iterate over the items looking at prices
-    for (md_PricesMap::iterator priceIt = ppriceMap->begin(); priceIt != ppriceMap->end(); ++priceIt) { // check all prices
+    // within the book of the pair iterate over the price levels, starting with the lowest price
+    md_PricesMap::iterator priceIt = ppriceMap->begin();
+    while (priceIt != ppriceMap->end()) { // check the crossing prices
         const rational_t sellersPrice = priceIt->first;
 
         if (msc_debug_metadex2) PrintToLog("comparing prices: desprice %s needs to be GREATER THAN OR EQUAL TO %s\n",
             xToString(pnew->inversePrice()), xToString(sellersPrice));
 
         // Is the desired price check satisfied? The buyer's inverse price must be larger than that of the seller.
+        // The levels are sorted by price, so none of the remaining levels crosses either.
         if (pnew->inversePrice() < sellersPrice) {
-            continue;
+            break;
         }
 
         md_Set* const pofferSet = &(priceIt->second);
@@ -174,11 +217,8 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             if (msc_debug_metadex1) PrintToLog("Looking at existing: %s (its prop= %d, its des prop= %d) = %s\n",
                 xToString(sellersPrice), pold->getProperty(), pold->getDesProperty(), pold->ToString());
 
-            // does the desired property match?
-            if (pold->getDesProperty() != propertyForSale) {
-                ++offerIt;
-                continue;
-            }
+            // all orders of the book desire the property for sale
+            assert(pold->getDesProperty() == propertyForSale);
 
             if (msc_debug_metadex1) PrintToLog("MATCH FOUND, Trade: %s = %s\n", xToString(sellersPrice), pold->ToString());
 
@@ -332,8 +372,19 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             }
         } // specific price, check all properties
 
+        // drop the price level, if all orders were filled
+        if (pofferSet->empty()) {
+            ppriceMap->erase(priceIt++);
+        } else {
+            ++priceIt;
+        }
+
         if (bBuyerSatisfied) break;
-    } // check all prices
+    } // check the crossing prices
+
+    if (ppriceMap->empty()) {
+        prune_Pair(propertyDesired, propertyForSale);
+    }
 
     PrintToLog("%s()=%d:%s\n", __FUNCTION__, NewReturn, getTradeReturnType(NewReturn));
 
@@ -429,28 +480,6 @@ std::string CMPMetaDEx::ToString() const
         property, FormatMP(property, amount_forsale), desired_property, FormatMP(desired_property, amount_desired));
 }
 
-void CMPMetaDEx::saveOffer(std::ofstream& file, SHA256_CTX* shaCtx) const
-{
-    std::string lineOut = strprintf("%s,%d,%d,%d,%d,%d,%d,%d,%s,%d",
-        addr,
-        block,
-        amount_forsale,
-        property,
-        amount_desired,
-        desired_property,
-        subaction,
-        idx,
-        txid.ToString(),
-        amount_remaining
-    );
-
-    // add the line to the hash
-    SHA256_Update(shaCtx, lineOut.c_str(), lineOut.length());
-
-    // write the line
-    file << lineOut << std::endl;
-}
-
 bool MetaDEx_compare::operator()(const CMPMetaDEx &lhs, const CMPMetaDEx &rhs) const
 {
     if (lhs.getBlock() == rhs.getBlock()) return lhs.getIdx() < rhs.getIdx();
@@ -459,38 +488,16 @@ bool MetaDEx_compare::operator()(const CMPMetaDEx &lhs, const CMPMetaDEx &rhs) c
 
 bool mastercore::MetaDEx_INSERT(const CMPMetaDEx& objMetaDEx)
 {
-    // Create an empty price map (to use in case price map for this property does not already exist)
-    md_PricesMap temp_prices;
-    // Attempt to obtain the price map for the property
-    md_PricesMap *p_prices = get_Prices(objMetaDEx.getProperty());
-
-    // Create an empty set of metadex objects (to use in case no set currently exists at this price)
-    md_Set temp_indexes;
-    md_Set *p_indexes = nullptr;
-
-    // Prepare for return code
-    std::pair <md_Set::iterator, bool> ret;
+    AssertLockHeld(cs_tally);
 
-    // Attempt to obtain a set of metadex objects for this price from the price map
-    if (p_prices) p_indexes = get_Indexes(p_prices, objMetaDEx.unitPrice());
-    // See if the set was populated, if not no set exists at this price level, use the empty set that we created earlier
-    if (!p_indexes) p_indexes = &temp_indexes;
+    // Obtain the set of metadex objects at this price in the book of the pair, the book and the price level are
+    // created, if they don't exist yet
+    md_Set& indexes = metadex[objMetaDEx.getProperty()][objMetaDEx.getDesProperty()][objMetaDEx.unitPrice()];
 
     // Attempt to insert the metadex object into the set
-    ret = p_indexes->insert(objMetaDEx);
-    if (false == ret.second) return false;
-
-    // If a prices map did not exist for this property, set p_prices to the temp empty price map
-    if (!p_prices) p_prices = &temp_prices;
+    std::pair<md_Set::iterator, bool> ret = indexes.insert(objMetaDEx);
 
-    // Update the prices map with the new set at this price
-    (*p_prices)[objMetaDEx.unitPrice()] = *p_indexes;
-
-    // Set the metadex map for the property to the updated (or new if it didn't exist) price map
-    AssertLockHeld(cs_tally);
-    metadex[objMetaDEx.getProperty()] = *p_prices;
-
-    return true;
+    return ret.second;
 }
 
 // pretty much directly linked to the ADD TX21 command off the wire
@@ -533,7 +540,7 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
 {
     int rc = METADEX_ERROR -20;
     CMPMetaDEx mdex(sender_addr, 0, prop, amount, property_desired, amount_desired, uint256(), 0, CMPTransaction::CANCEL_AT_PRICE);
-    md_PricesMap* prices = get_Prices(prop);
+    md_PricesMap* prices = get_Prices(prop, property_desired);
     const CMPMetaDEx* p_mdex = nullptr;
 
     if (msc_debug_metadex1) PrintToLog("%s():%s\n", __FUNCTION__, mdex.ToString());
@@ -545,20 +552,16 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
         return rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
-    for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
-        rational_t sellers_price = my_it->first;
-
-        if (mdex.unitPrice() != sellers_price) continue;
-
-        md_Set* indexes = &(my_it->second);
+    // within the book of the pair look up the price level
+    md_Set* indexes = get_Indexes(prices, mdex.unitPrice());
 
+    if (indexes) {
         for (md_Set::iterator iitt = indexes->begin(); iitt != indexes->end();) {
             p_mdex = &(*iitt);
 
             if (msc_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
 
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
+            if (p_mdex->getAddr() != sender_addr) {
                 ++iitt;
                 continue;
             }
@@ -577,6 +580,8 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
 
             indexes->erase(iitt++);
         }
+
+        prune_Pair(prop, property_desired);
     }
 
     if (msc_debug_metadex2) MetaDEx_debug_print();
@@ -587,7 +592,7 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
 int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int block, const std::string& sender_addr, uint32_t prop, uint32_t property_desired)
 {
     int rc = METADEX_ERROR -30;
-    md_PricesMap* prices = get_Prices(prop);
+    md_PricesMap* prices = get_Prices(prop, property_desired);
     const CMPMetaDEx* p_mdex = nullptr;
 
     PrintToLog("%s(%d,%d)\n", __FUNCTION__, prop, property_desired);
@@ -599,7 +604,7 @@ int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int bl
         return rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
+    // within the book of the pair iterate over the items
     for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
         md_Set* indexes = &(my_it->second);
 
@@ -608,7 +613,7 @@ int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int bl
 
             if (msc_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
 
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
+            if (p_mdex->getAddr() != sender_addr) {
                 ++iitt;
                 continue;
             }
@@ -630,6 +635,8 @@ int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int bl
         }
     }
 
+    prune_Pair(prop, property_desired);
+
     if (msc_debug_metadex3) MetaDEx_debug_print();
 
     return rc;
@@ -649,43 +656,61 @@ int mastercore::MetaDEx_CANCEL_EVERYTHING(const uint256& txid, unsigned int bloc
     PrintToLog("<<<<<<\n");
 
     AssertLockHeld(cs_tally);
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end();) {
         unsigned int prop = my_it->first;
 
         // skip property, if it is not in the expected ecosystem
-        if (isMainEcosystemProperty(ecosystem) && !isMainEcosystemProperty(prop)) continue;
-        if (isTestEcosystemProperty(ecosystem) && !isTestEcosystemProperty(prop)) continue;
+        if ((isMainEcosystemProperty(ecosystem) && !isMainEcosystemProperty(prop)) ||
+                (isTestEcosystemProperty(ecosystem) && !isTestEcosystemProperty(prop))) {
+            ++my_it;
+            continue;
+        }
 
         PrintToLog(" ## property: %u\n", prop);
-        md_PricesMap& prices = my_it->second;
-
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            rational_t price = it->first;
-            md_Set& indexes = it->second;
-
-            PrintToLog("  # Price Level: %s\n", xToString(price));
+        md_PairsMap& pairs = my_it->second;
+
+        // collect the orders of the address, the cancellations are recorded ordered by price and then by
+        // block+idx, regardless of the desired property of the orders
+        std::vector<std::pair<rational_t, CMPMetaDEx> > vecCancels;
+        for (md_PairsMap::iterator pair_it = pairs.begin(); pair_it != pairs.end(); ++pair_it) {
+            md_PricesMap& prices = pair_it->second;
+            for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
+                md_Set& indexes = it->second;
+                for (md_Set::iterator it_obj = indexes.begin(); it_obj != indexes.end(); ++it_obj) {
+                    if (it_obj->getAddr() == sender_addr) vecCancels.push_back(std::make_pair(it->first, *it_obj));
+                }
+            }
+        }
+        std::sort(vecCancels.begin(), vecCancels.end(),
+                [](const std::pair<rational_t, CMPMetaDEx>& lhs, const std::pair<rational_t, CMPMetaDEx>& rhs) {
+                    if (lhs.first != rhs.first) return lhs.first < rhs.first;
+                    return MetaDEx_compare()(lhs.second, rhs.second);
+                });
 
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                PrintToLog("%s= %s\n", xToString(price), it->ToString());
+        for (std::vector<std::pair<rational_t, CMPMetaDEx> >::const_iterator it = vecCancels.begin(); it != vecCancels.end(); ++it) {
+            const CMPMetaDEx& obj = it->second;
 
-                if (it->getAddr() != sender_addr) {
-                    ++it;
-                    continue;
-                }
+            rc = 0;
+            PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, obj.ToString());
 
-                rc = 0;
-                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
+            // move from reserve to balance
+            assert(update_tally_map(obj.getAddr(), obj.getProperty(), -obj.getAmountRemaining(), METADEX_RESERVE));
+            assert(update_tally_map(obj.getAddr(), obj.getProperty(), obj.getAmountRemaining(), BALANCE));
 
-                // move from reserve to balance
-                assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
+            // record the cancellation
+            bool bValid = true;
+            pDbTransactionList->recordMetaDExCancelTX(txid, obj.getHash(), bValid, block, obj.getProperty(), obj.getAmountRemaining());
 
-                // record the cancellation
-                bool bValid = true;
-                pDbTransactionList->recordMetaDExCancelTX(txid, it->getHash(), bValid, block, it->getProperty(), it->getAmountRemaining());
+            md_PricesMap& prices = pairs[obj.getDesProperty()];
+            prices[it->first].erase(obj);
+            if (prices[it->first].empty()) prices.erase(it->first);
+            if (prices.empty()) pairs.erase(obj.getDesProperty());
+        }
 
-                indexes.erase(it++);
-            }
+        if (pairs.empty()) {
+            metadex.erase(my_it++);
+        } else {
+            ++my_it;
         }
     }
     PrintToLog(">>>>>>\n");
@@ -704,19 +729,29 @@ int mastercore::MetaDEx_SHUTDOWN_ALLPAIR()
 
     int rc = 0;
     PrintToLog("%s()\n", __FUNCTION__);
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        md_PricesMap& prices = my_it->second;
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            md_Set& indexes = it->second;
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                if (it->getDesProperty() > OMNI_PROPERTY_TMSC && it->getProperty() > OMNI_PROPERTY_TMSC) { // no OMN/TOMN side to the trade
+    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end();) {
+        md_PairsMap& pairs = my_it->second;
+        for (md_PairsMap::iterator pair_it = pairs.begin(); pair_it != pairs.end();) {
+            if (my_it->first <= OMNI_PROPERTY_TMSC || pair_it->first <= OMNI_PROPERTY_TMSC) { // OMN/TOMN side to the trade
+                ++pair_it;
+                continue;
+            }
+            md_PricesMap& prices = pair_it->second;
+            for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
+                md_Set& indexes = it->second;
+                for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
                     PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
                     // move from reserve to balance
                     assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
                     assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-                    indexes.erase(it++);
                 }
             }
+            pairs.erase(pair_it++);
+        }
+        if (pairs.empty()) {
+            metadex.erase(my_it++);
+        } else {
+            ++my_it;
         }
     }
     return rc;
@@ -732,18 +767,21 @@ int mastercore::MetaDEx_SHUTDOWN()
     int rc = 0;
     PrintToLog("%s()\n", __FUNCTION__);
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        md_PricesMap& prices = my_it->second;
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            md_Set& indexes = it->second;
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
-                // move from reserve to balance
-                assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-                indexes.erase(it++);
+        md_PairsMap& pairs = my_it->second;
+        for (md_PairsMap::iterator pair_it = pairs.begin(); pair_it != pairs.end(); ++pair_it) {
+            md_PricesMap& prices = pair_it->second;
+            for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
+                md_Set& indexes = it->second;
+                for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                    PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
+                    // move from reserve to balance
+                    assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
+                    assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
+                }
             }
         }
     }
+    metadex.clear();
     return rc;
 }
 
@@ -755,12 +793,14 @@ bool mastercore::MetaDEx_isOpen(const uint256& txid, uint32_t propertyIdForSale)
 
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
         if (propertyIdForSale != 0 && propertyIdForSale != my_it->first) continue;
-        md_PricesMap & prices = my_it->second;
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            md_Set & indexes = (it->second);
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                CMPMetaDEx obj = *it;
-                if( obj.getHash().GetHex() == txid.GetHex() ) return true;
+        md_PairsMap & pairs = my_it->second;
+        for (md_PairsMap::iterator pair_it = pairs.begin(); pair_it != pairs.end(); ++pair_it) {
+            md_PricesMap & prices = pair_it->second;
+            for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
+                md_Set & indexes = (it->second);
+                for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                    if (it->getHash() == txid) return true;
+                }
             }
         }
     }
@@ -828,21 +868,26 @@ void mastercore::MetaDEx_debug_print(bool bShowPriceLevel, bool bDisplay)
     PrintToLog("<<<\n");
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
         uint32_t prop = my_it->first;
+        md_PairsMap& pairs = my_it->second;
 
-        PrintToLog(" ## property: %u\n", prop);
-        md_PricesMap& prices = my_it->second;
+        for (md_PairsMap::iterator pair_it = pairs.begin(); pair_it != pairs.end(); ++pair_it) {
+            uint32_t desprop = pair_it->first;
+
+            PrintToLog(" ## property: %u, desired property: %u\n", prop, desprop);
+            md_PricesMap& prices = pair_it->second;
 
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            rational_t price = it->first;
-            md_Set& indexes = it->second;
+            for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
+                rational_t price = it->first;
+                md_Set& indexes = it->second;
 
-            if (bShowPriceLevel) PrintToLog("  # Price Level: %s\n", xToString(price));
+                if (bShowPriceLevel) PrintToLog("  # Price Level: %s\n", xToString(price));
 
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                const CMPMetaDEx& obj = *it;
+                for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                    const CMPMetaDEx& obj = *it;
 
-                if (bDisplay) PrintToConsole("%s= %s\n", xToString(price), obj.ToString());
-                else PrintToLog("%s= %s\n", xToString(price), obj.ToString());
+                    if (bDisplay) PrintToConsole("%s= %s\n", xToString(price), obj.ToString());
+                    else PrintToLog("%s= %s\n", xToString(price), obj.ToString());
+                }
             }
         }
     }
@@ -858,11 +903,14 @@ const CMPMetaDEx* mastercore::MetaDEx_RetrieveTrade(const uint256& txid)
     AssertLockHeld(cs_tally);
 
     for (md_PropertiesMap::iterator propIter = metadex.begin(); propIter != metadex.end(); ++propIter) {
-        md_PricesMap & prices = propIter->second;
-        for (md_PricesMap::iterator pricesIter = prices.begin(); pricesIter != prices.end(); ++pricesIter) {
-            md_Set & indexes = pricesIter->second;
-            for (md_Set::iterator tradesIter = indexes.begin(); tradesIter != indexes.end(); ++tradesIter) {
-                if (txid == (*tradesIter).getHash()) return &(*tradesIter);
+        md_PairsMap & pairs = propIter->second;
+        for (md_PairsMap::iterator pairsIter = pairs.begin(); pairsIter != pairs.end(); ++pairsIter) {
+            md_PricesMap & prices = pairsIter->second;
+            for (md_PricesMap::iterator pricesIter = prices.begin(); pricesIter != prices.end(); ++pricesIter) {
+                md_Set & indexes = pricesIter->second;
+                for (md_Set::iterator tradesIter = indexes.begin(); tradesIter != indexes.end(); ++tradesIter) {
+                    if (txid == (*tradesIter).getHash()) return &(*tradesIter);
+                }
             }
         }
     }
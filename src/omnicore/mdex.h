@@ -4,6 +4,7 @@
 #include <omnicore/sync.h>
 #include <omnicore/tx.h>
 
+#include <serialize.h>
 #include <uint256.h>
 
 #include <boost/lexical_cast.hpp>
@@ -11,11 +12,8 @@
 #include <boost/multiprecision/cpp_int.hpp>
 #include <boost/rational.hpp>
 
-#include <openssl/sha.h>
-
 #include <stdint.h>
 
-#include <fstream>
 #include <map>
 #include <set>
 #include <string>
@@ -100,7 +98,22 @@ public:
     /** Used for display of unit prices with 50 decimal places at RPC layer. */
     std::string displayFullUnitPrice() const;
 
-    void saveOffer(std::ofstream& file, SHA256_CTX* shaCtx) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(addr);
+        READWRITE(block);
+        READWRITE(amount_forsale);
+        READWRITE(property);
+        READWRITE(amount_desired);
+        READWRITE(desired_property);
+        READWRITE(subaction);
+        READWRITE(idx);
+        READWRITE(txid);
+        READWRITE(amount_remaining);
+    }
 };
 
 namespace mastercore
@@ -113,16 +126,18 @@ struct MetaDEx_compare
 // ---------------
 //! Set of objects sorted by block+idx
 typedef std::set<CMPMetaDEx, MetaDEx_compare> md_Set; 
-//! Map of prices; there is a set of sorted objects for each price
+//! Map of prices; there is a set of sorted objects for each price, it's the order book of a pair
 typedef std::map<rational_t, md_Set> md_PricesMap;
-//! Map of properties; there is a map of prices for each property
-typedef std::map<uint32_t, md_PricesMap> md_PropertiesMap;
+//! Map of desired properties; there is a map of prices for each desired property
+typedef std::map<uint32_t, md_PricesMap> md_PairsMap;
+//! Map of properties for sale; there is a map of pairs for each property
+typedef std::map<uint32_t, md_PairsMap> md_PropertiesMap;
 
 //! Global map for price and order data
 extern md_PropertiesMap metadex GUARDED_BY(cs_tally);
 
-// TODO: explore a property-pair, instead of a single property as map's key........
-md_PricesMap* get_Prices(uint32_t prop);
+md_PairsMap* get_Pairs(uint32_t prop);
+md_PricesMap* get_Prices(uint32_t prop, uint32_t desprop);
 md_Set* get_Indexes(md_PricesMap* p, rational_t price);
 // ---------------
 
@@ -40,6 +40,7 @@
 #include <coins.h>
 #include <core_io.h>
 #include <fs.h>
+#include <index/txindex.h>
 #include <key_io.h>
 #include <init.h>
 #include <validation.h>
@@ -67,8 +68,15 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -137,6 +145,7 @@ std::set<std::pair<std::string,uint32_t> > setFrozenAddresses;
 
 //! In-memory collection of all amounts for all addresses for all properties
 std::unordered_map<std::string, CMPTally> mastercore::mp_tally_map;
+std::unordered_map<uint32_t, CMPPropertyIndex> mastercore::mp_property_index;
 
 // Only needed for GUI:
 
@@ -414,11 +423,41 @@ std::string mastercore::getTokenLabel(uint32_t propertyId)
     return tokenStr;
 }
 
+/**
+ * Returns the number of tokens of the tally which count to the supply, that is the balance and the reserves, but
+ * not the pending amount.
+ */
+static int64_t GetTalliedTokens(const CMPTally& tally, uint32_t propertyId)
+{
+    return tally.getMoney(propertyId, BALANCE) + tally.getMoney(propertyId, SELLOFFER_RESERVE) +
+           tally.getMoney(propertyId, ACCEPT_RESERVE) + tally.getMoney(propertyId, METADEX_RESERVE);
+}
+
+const CMPPropertyIndex* mastercore::getPropertyIndex(uint32_t propertyId)
+{
+    AssertLockHeld(cs_tally);
+
+    std::unordered_map<uint32_t, CMPPropertyIndex>::const_iterator it = mp_property_index.find(propertyId);
+
+    if (it != mp_property_index.end()) return &(it->second);
+
+    return static_cast<CMPPropertyIndex*>(nullptr);
+}
+
+void mastercore::clear_tally_map()
+{
+    AssertLockHeld(cs_tally);
+
+    mp_tally_map.clear();
+    mp_property_index.clear();
+    ClearBalancesHashCache();
+    ResetSnapshotDelta();
+}
+
 // get total tokens for a property
 // optionally counts the number of addresses who own that property: n_owners_total
 int64_t mastercore::getTotalTokens(uint32_t propertyId, int64_t* n_owners_total)
 {
-    int64_t prev = 0;
     int64_t owners = 0;
     int64_t totalTokens = 0;
 
@@ -430,18 +469,10 @@ int64_t mastercore::getTotalTokens(uint32_t propertyId, int64_t* n_owners_total)
     }
 
     if (!property.fixed || n_owners_total) {
-        for (std::unordered_map<std::string, CMPTally>::const_iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-            const CMPTally& tally = it->second;
-
-            totalTokens += tally.getMoney(propertyId, BALANCE);
-            totalTokens += tally.getMoney(propertyId, SELLOFFER_RESERVE);
-            totalTokens += tally.getMoney(propertyId, ACCEPT_RESERVE);
-            totalTokens += tally.getMoney(propertyId, METADEX_RESERVE);
-
-            if (prev != totalTokens) {
-                prev = totalTokens;
-                owners++;
-            }
+        const CMPPropertyIndex* index = getPropertyIndex(propertyId);
+        if (index) {
+            totalTokens = index->totalTokens;
+            owners = index->numHolders;
         }
         int64_t cachedFee = pDbFeeCache->GetCachedAmount(propertyId);
         totalTokens += cachedFee;
@@ -487,12 +518,27 @@ bool mastercore::update_tally_map(const std::string& who, uint32_t propertyId, i
     }
 
     CMPTally& tally = my_it->second;
+    const int64_t tokensBefore = GetTalliedTokens(tally, propertyId);
     bRet = tally.updateMoney(propertyId, amount, ttype);
 
+    // the balance record is created, even if the update fails
+    CMPPropertyIndex& index = mp_property_index[propertyId];
+    index.addresses.insert(who);
+    if (bRet && ttype != PENDING) {
+        const int64_t tokensAfter = tokensBefore + amount;
+        index.totalTokens += amount;
+        if (tokensBefore == 0 && tokensAfter != 0) ++index.numHolders;
+        if (tokensBefore != 0 && tokensAfter == 0) --index.numHolders;
+    }
+
     after = GetTokenBalance(who, propertyId, ttype);
     if (!bRet) {
         assert(before == after);
         PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: insufficient balance (=%d)\n", __func__, who, propertyId, propertyId, amount, ttype, before);
+    } else if (ttype != PENDING) {
+        // the pending tally isn't part of the consensus hash, nor the state snapshots
+        MarkBalanceChanged(who, propertyId);
+        MarkSnapshotBalanceChanged(who, propertyId);
     }
     if (msc_debug_tally && (exodus_address != who || msc_debug_exo)) {
         PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d): before=%d, after=%d\n", __func__, who, propertyId, propertyId, amount, ttype, before, after);
@@ -700,6 +746,21 @@ bool IsInMarkerCache(const uint256& txHash)
     return (setMarkerCache.find(txHash) != setMarkerCache.end());
 }
 
+/**
+ * Checks, if the first pushed element of the script equals, or starts with the "omni" marker.
+ */
+static bool HasOmniMarker(const CScript& scriptPubKey)
+{
+    std::vector<std::string> scriptPushes;
+    if (GetScriptPushes(scriptPubKey, scriptPushes) && !scriptPushes.empty()) {
+        std::vector<unsigned char> vchMarker = GetOmMarker();
+        std::vector<unsigned char> vchPushed = ParseHex(scriptPushes[0]);
+        return vchPushed.size() >= vchMarker.size() && std::equal(vchMarker.begin(), vchMarker.end(), vchPushed.begin());
+    }
+
+    return false;
+}
+
 /**
  * Returns the encoding class, used to embed a payload.
  *
@@ -727,17 +788,7 @@ int mastercore::GetEncodingClass(const CTransaction& tx, int nBlock)
             break;
         }
         if (outType == TX_NULL_DATA) {
-            // Ensure there is a payload, and the first pushed element equals,
-            // or starts with the "omni" marker
-            std::vector<std::string> scriptPushes;
-            if (GetScriptPushes(out.scriptPubKey, scriptPushes) && !scriptPushes.empty()) {
-                std::vector<unsigned char> vchMarker = GetOmMarker();
-                std::vector<unsigned char> vchPushed = ParseHex(scriptPushes[0]);
-                if (vchPushed.size() >= vchMarker.size() && std::equal(vchMarker.begin(), vchMarker.end(), vchPushed.begin())) {
-                    hasOpReturn = true;
-                }
-            }
-
+            hasOpReturn = HasOmniMarker(out.scriptPubKey);
             break;
         }
     }
@@ -749,6 +800,27 @@ int mastercore::GetEncodingClass(const CTransaction& tx, int nBlock)
     return NO_MARKER;
 }
 
+/**
+ * Checks, if the transaction may have an encoding class, without the consensus parameters.
+ *
+ * It's true for every transaction GetEncodingClass() finds a marker in, and it can be
+ * used by other threads, while the consensus parameters are changed by activations.
+ */
+static bool MayHaveOmniMarker(const CTransaction& tx)
+{
+    for (const CTxOut& out : tx.vout) {
+        if (out.scriptPubKey.size() < 2 || out.scriptPubKey[0] != OP_RETURN)
+            continue;
+
+        txnouttype outType;
+        if (GetOutputType(out.scriptPubKey, outType) && outType == TX_NULL_DATA) {
+            return HasOmniMarker(out.scriptPubKey);
+        }
+    }
+
+    return false;
+}
+
 //! Guards coins view cache
 static CCriticalSection cs_viewcache;
 
@@ -1106,6 +1178,9 @@ private:
     const CBlockIndex* m_pblockFirst;
     const CBlockIndex* m_pblockLast;
     const int64_t m_timeStart;
+    //! Height and time of the previous report, to measure the blocks per second since then
+    int m_nHeightReported;
+    int64_t m_timeReported;
 
     /** Returns the estimated remaining time in milliseconds. */
     int64_t estimateRemainingTime(double progress) const
@@ -1139,12 +1214,21 @@ private:
 
 public:
     ProgressReporter(const CBlockIndex* pblockFirst, const CBlockIndex* pblockLast)
-    : m_pblockFirst(pblockFirst), m_pblockLast(pblockLast), m_timeStart(GetTimeMillis())
+    : m_pblockFirst(pblockFirst), m_pblockLast(pblockLast), m_timeStart(GetTimeMillis()),
+      m_nHeightReported(pblockFirst->nHeight), m_timeReported(m_timeStart)
     {
     }
 
+    /** Returns the number of blocks scanned per second since the given time. */
+    static double blocksPerSecond(int nBlocks, int64_t timeSince)
+    {
+        int64_t timeSpan = GetTimeMillis() - timeSince;
+
+        return (timeSpan > 0) ? 1000.0 * nBlocks / timeSpan : 0.0;
+    }
+
     /** Prints the current progress to the console and notifies the UI. */
-    void update(const CBlockIndex* pblockNow) const
+    void update(const CBlockIndex* pblockNow)
     {
         int nLastBlock = m_pblockLast->nHeight;
         int nCurrentBlock = pblockNow->nHeight;
@@ -1154,25 +1238,247 @@ public:
 
         double dProgress = 100.0 * (nCurrent - nFirst) / (nLast - nFirst);
         int64_t nRemainingTime = estimateRemainingTime(dProgress);
+        double dBlocksPerSecond = blocksPerSecond(nCurrentBlock - m_nHeightReported, m_timeReported);
 
         std::string strProgress = strprintf(
-                "Still scanning.. at block %d of %d. Progress: %.2f %%, about %s remaining..\n",
-                nCurrentBlock, nLastBlock, dProgress, remainingTimeAsString(nRemainingTime));
+                "Still scanning.. at block %d of %d (%.1f blocks/s). Progress: %.2f %%, about %s remaining..\n",
+                nCurrentBlock, nLastBlock, dBlocksPerSecond, dProgress, remainingTimeAsString(nRemainingTime));
         std::string strProgressUI = strprintf(
-                "Still scanning.. at block %d of %d.\nProgress: %.2f %% (about %s remaining)",
-                nCurrentBlock, nLastBlock, dProgress, remainingTimeAsString(nRemainingTime));
+                "Still scanning.. at block %d of %d (%.1f blocks/s).\nProgress: %.2f %% (about %s remaining)",
+                nCurrentBlock, nLastBlock, dBlocksPerSecond, dProgress, remainingTimeAsString(nRemainingTime));
 
         PrintToConsole(strProgress);
         uiInterface.InitMessage(strProgressUI);
+
+        m_nHeightReported = nCurrentBlock;
+        m_timeReported = GetTimeMillis();
+    }
+
+    /** Returns the number of blocks scanned per second since the start. */
+    double averageBlocksPerSecond(int nBlocks) const
+    {
+        return blocksPerSecond(nBlocks, m_timeStart);
     }
 };
 
+//! Default for -omniscanthreads, the number of threads reading the blocks of the initial scan
+static const int DEFAULT_OMNI_SCAN_THREADS = 2;
+//! Maximum for -omniscanthreads
+static const int MAX_OMNI_SCAN_THREADS = 16;
+//! Number of blocks, which are read ahead of the scanned block per reader thread
+static const int OMNI_SCAN_BLOCKS_PER_THREAD = 16;
+
+/**
+ * Reads the blocks of the initial scan ahead of their processing.
+ *
+ * The reader threads only do the I/O: they read and deserialize the blocks, and fetch
+ * the inputs of the transactions, which may have an Omni marker, from the transaction
+ * index. Decoding the payloads and applying the transactions stays in the scanning
+ * thread, which takes the blocks in order and is the only one to change the state.
+ *
+ * The scanning thread holds cs_main during the whole scan, so the readers must not
+ * take it. The positions of the blocks on disk are looked up by the scanning thread.
+ * Without reader threads the blocks are read by the scanning thread on demand.
+ *
+ * @see msc_initial_scan()
+ */
+class ScanPrefetcher
+{
+public:
+    struct Block
+    {
+        const CBlockIndex* pblockindex;
+        uint256 hash;
+        int nHeight;
+        FlatFilePos pos;
+        //! Skipped by the seed block filter, the block is not read
+        bool fSkip;
+        bool fRead{false};
+        bool fDone{false};
+        CBlock block;
+        //! Outputs spent by the transactions with a marker, with the hashes of their blocks
+        std::map<COutPoint, std::pair<CTxOut, uint256> > inputs;
+    };
+
+    ScanPrefetcher(int nFirstBlock, int nLastBlock, bool fSeedBlockFilter, int nThreads)
+    : m_nNextBlock(nFirstBlock), m_nLastBlock(nLastBlock), m_fSeedBlockFilter(fSeedBlockFilter),
+      m_nMaxBlocks(std::max(1, nThreads) * OMNI_SCAN_BLOCKS_PER_THREAD)
+    {
+        for (int i = 0; i < nThreads; ++i) {
+            m_threads.emplace_back(&TraceThread<std::function<void()>>, "omniscan",
+                    std::function<void()>(std::bind(&ScanPrefetcher::ThreadRead, this)));
+        }
+    }
+
+    ~ScanPrefetcher()
+    {
+        {
+            LOCK(m_cs);
+            m_fRunning = false;
+        }
+        m_cond.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    /** Returns the next block of the scan, or nullptr, if there are no more blocks. */
+    std::shared_ptr<Block> Next() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        Schedule();
+
+        std::shared_ptr<Block> pblock;
+        {
+            WAIT_LOCK(m_cs, lock);
+            if (m_blocks.empty()) return nullptr;
+            pblock = m_blocks.front();
+            if (!m_threads.empty()) {
+                m_cond.wait(lock, [&pblock]() EXCLUSIVE_LOCKS_REQUIRED(m_cs) { return pblock->fDone; });
+                --m_nClaimed;
+            }
+            m_blocks.pop_front();
+        }
+        if (m_threads.empty()) {
+            Read(*pblock);
+        }
+
+        return pblock;
+    }
+
+private:
+    /** Adds the blocks up to the read ahead limit for the readers. */
+    void Schedule() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        {
+            LOCK(m_cs);
+            while (m_nNextBlock <= m_nLastBlock && m_blocks.size() < m_nMaxBlocks) {
+                const CBlockIndex* pblockindex = ::ChainActive()[m_nNextBlock];
+                if (nullptr == pblockindex) {
+                    m_nLastBlock = m_nNextBlock - 1;
+                    break;
+                }
+                std::shared_ptr<Block> pblock = std::make_shared<Block>();
+                pblock->pblockindex = pblockindex;
+                pblock->hash = pblockindex->GetBlockHash();
+                pblock->nHeight = pblockindex->nHeight;
+                pblock->pos = pblockindex->GetBlockPos();
+                pblock->fSkip = m_fSeedBlockFilter && SkipBlock(m_nNextBlock);
+                m_blocks.push_back(pblock);
+                ++m_nNextBlock;
+            }
+        }
+        m_cond.notify_all();
+    }
+
+    void ThreadRead()
+    {
+        while (true) {
+            std::shared_ptr<Block> pblock;
+            {
+                WAIT_LOCK(m_cs, lock);
+                m_cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_cs) { return !m_fRunning || m_nClaimed < m_blocks.size(); });
+                if (!m_fRunning) return;
+                pblock = m_blocks[m_nClaimed++];
+            }
+            Read(*pblock);
+            {
+                LOCK(m_cs);
+                pblock->fDone = true;
+            }
+            m_cond.notify_all();
+        }
+    }
+
+    /**
+     * Reads the block and fetches the inputs, it doesn't depend on the state.
+     *
+     * It doesn't throw, a block, which couldn't be read, is left unread and stops the scan.
+     */
+    static void Read(Block& scan)
+    {
+        if (scan.fSkip) return;
+
+        try {
+            ReadBlockAndInputs(scan);
+        } catch (const std::exception& e) {
+            PrintToLog("%s(): failed to read block %d: %s\n", __func__, scan.nHeight, e.what());
+            scan.fRead = false;
+        } catch (...) {
+            PrintToLog("%s(): failed to read block %d: unknown exception\n", __func__, scan.nHeight);
+            scan.fRead = false;
+        }
+    }
+
+    static void ReadBlockAndInputs(Block& scan)
+    {
+        if (!ReadBlockFromDisk(scan.block, scan.pos, Params().GetConsensus(), scan.nHeight)) return;
+        if (scan.block.GetHash() != scan.hash) {
+            PrintToLog("%s(): block %d doesn't match the block index\n", __func__, scan.nHeight);
+            return;
+        }
+        scan.fRead = true;
+
+        if (!g_txindex) return;
+
+        for (const auto& tx : scan.block.vtx) {
+            if (tx->IsCoinBase() || !MayHaveOmniMarker(*tx)) continue;
+
+            for (const CTxIn& txIn : tx->vin) {
+                if (scan.inputs.count(txIn.prevout)) continue;
+
+                CTransactionRef txPrev;
+                uint256 hashBlock;
+                if (g_txindex->FindTx(txIn.prevout.hash, hashBlock, txPrev) && txIn.prevout.n < txPrev->vout.size()) {
+                    scan.inputs.emplace(txIn.prevout, std::make_pair(txPrev->vout[txIn.prevout.n], hashBlock));
+                }
+            }
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    //! Next block to be scheduled
+    int m_nNextBlock;
+    int m_nLastBlock;
+    const bool m_fSeedBlockFilter;
+    const size_t m_nMaxBlocks;
+
+    Mutex m_cs;
+    std::condition_variable m_cond;
+    bool m_fRunning GUARDED_BY(m_cs){true};
+    //! Scheduled blocks in order, the first m_nClaimed blocks are taken by the readers
+    std::deque<std::shared_ptr<Block> > m_blocks GUARDED_BY(m_cs);
+    size_t m_nClaimed GUARDED_BY(m_cs){0};
+};
+
+/**
+ * Converts the prefetched inputs of a block, so they can be added to the coins view cache.
+ */
+static std::shared_ptr<std::map<COutPoint, Coin> > GetPrefetchedCoins(const ScanPrefetcher::Block& scan) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (scan.inputs.empty()) return nullptr;
+
+    std::shared_ptr<std::map<COutPoint, Coin> > coins = std::make_shared<std::map<COutPoint, Coin> >();
+    for (const auto& input : scan.inputs) {
+        Coin coin;
+        coin.out = input.second.first;
+        coin.nHeight = 1;
+        if (CBlockIndex *pindex = LookupBlockIndex(input.second.second))
+            coin.nHeight = pindex->nHeight;
+        coins->emplace(input.first, std::move(coin));
+    }
+
+    return coins;
+}
+
 /**
  * Scans the blockchain for meta transactions.
  *
  * It scans the blockchain, starting at the given block index, to the current
  * tip, much like as if new block were arriving and being processed on the fly.
  *
+ * The blocks are read ahead by the threads of the ScanPrefetcher, while the
+ * transactions are processed in order by this thread.
+ *
  * Every 30 seconds the progress of the scan is reported.
  *
  * In case the current block being processed is not part of the active chain, or
@@ -1209,6 +1515,9 @@ static int msc_initial_scan(int nFirstBlock)
     // check if using seed block filter should be disabled
     bool seedBlockFilterEnabled = gArgs.GetBoolArg("-omniseedblockfilter", true);
 
+    int nScanThreads = std::max(0, std::min<int>(gArgs.GetArg("-omniscanthreads", DEFAULT_OMNI_SCAN_THREADS), MAX_OMNI_SCAN_THREADS));
+    ScanPrefetcher prefetcher(nFirstBlock, nLastBlock, seedBlockFilterEnabled, nScanThreads);
+
     for (nBlock = nFirstBlock; nBlock <= nLastBlock; ++nBlock)
     {
         if (ShutdownRequested()) {
@@ -1216,9 +1525,10 @@ static int msc_initial_scan(int nFirstBlock)
             break;
         }
 
-        CBlockIndex* pblockindex = ::ChainActive()[nBlock];
+        std::shared_ptr<ScanPrefetcher::Block> pscan = prefetcher.Next();
 
-        if (nullptr == pblockindex) break;
+        if (nullptr == pscan) break;
+        const CBlockIndex* pblockindex = pscan->pblockindex;
         std::string strBlockHash = pblockindex->GetBlockHash().GetHex();
 
         if (msc_debug_exo) PrintToLog("%s(%d; max=%d):%s, line %d, file: %s\n",
@@ -1233,12 +1543,14 @@ static int msc_initial_scan(int nFirstBlock)
         unsigned int nTxsFoundInBlock = 0;
         mastercore_handler_block_begin(nBlock, pblockindex);
 
-        if (!seedBlockFilterEnabled || !SkipBlock(nBlock)) {
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) break;
+        if (!pscan->fSkip) {
+            if (!pscan->fRead) break;
 
-            for(const auto& tx : block.vtx) {
-                if (mastercore_handler_tx(*tx, nBlock, nTxNum, pblockindex, nullptr)) ++nTxsFoundInBlock;
+            // the inputs fetched by the readers are used like the coins spent by a connected block
+            std::shared_ptr<std::map<COutPoint, Coin> > prefetchedCoins = GetPrefetchedCoins(*pscan);
+
+            for(const auto& tx : pscan->block.vtx) {
+                if (mastercore_handler_tx(*tx, nBlock, nTxNum, pblockindex, prefetchedCoins)) ++nTxsFoundInBlock;
                 ++nTxNum;
             }
         }
@@ -1255,7 +1567,8 @@ static int msc_initial_scan(int nFirstBlock)
         PrintToConsole("Scan stopped early at block %d of block %d\n", nBlock, nLastBlock);
     }
 
-    PrintToConsole("%d new transactions processed, %d meta transactions found\n", nTxsTotal, nTxsFoundTotal);
+    PrintToConsole("%d new transactions processed, %d meta transactions found, %.1f blocks/s\n", nTxsTotal, nTxsFoundTotal,
+            progressReporter.averageBlocksPerSecond(nBlock - nFirstBlock));
 
     return 0;
 }
@@ -1269,7 +1582,7 @@ void clear_all_state()
     LOCK2(cs_tally, cs_pending);
 
     // Memory based storage
-    mp_tally_map.clear();
+    clear_tally_map();
     my_offers.clear();
     my_accepts.clear();
     my_crowds.clear();
@@ -182,6 +182,20 @@ namespace mastercore
 //! In-memory collection of all amounts for all addresses for all properties
 extern std::unordered_map<std::string, CMPTally> mp_tally_map GUARDED_BY(cs_tally);
 
+/** Holders and running totals of a property, maintained by update_tally_map. */
+struct CMPPropertyIndex
+{
+    //! Addresses with a balance record of the property, sorted by address
+    std::set<std::string> addresses;
+    //! Sum of the balances and the sell offer, accept and MetaDEx reserves of all addresses
+    int64_t totalTokens = 0;
+    //! Number of addresses with a non-zero sum of the balance and the reserves
+    int64_t numHolders = 0;
+};
+
+//! Index of the tally map by property
+extern std::unordered_map<uint32_t, CMPPropertyIndex> mp_property_index GUARDED_BY(cs_tally);
+
 /** Returns the encoding class, used to embed a payload. */
 int GetEncodingClass(const CTransaction& tx, int nBlock);
 
@@ -193,7 +207,11 @@ bool isMainEcosystemProperty(uint32_t propertyId);
 uint32_t GetNextPropertyId(bool maineco); // maybe move into sp
 
 CMPTally* getTally(const std::string& address);
+/** Returns the index of the property, or nullptr, if no address has a balance record of the property. */
+const CMPPropertyIndex* getPropertyIndex(uint32_t propertyId);
 bool update_tally_map(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype);
+/** Clears the tally map together with the property index and the cached balances of the consensus hash. */
+void clear_tally_map();
 int64_t getTotalTokens(uint32_t propertyId, int64_t* n_owners_total = nullptr);
 
 std::string strMPProperty(uint32_t propertyId);
@@ -2,6 +2,11 @@
  * @file persistence.cpp
  *
  * This file contains file based persistence related functions.
+ *
+ * The state is stored in binary snapshot files, which end with the double SHA256 hash of their content. Most
+ * snapshots are deltas, which only hold the balances changed since the previous snapshot, and a base with all
+ * balances is written every MAX_SNAPSHOT_DELTAS snapshots. The text files of previous versions are read once, to
+ * migrate their state to a base snapshot.
  */
 
 #include <omnicore/persistence.h>
@@ -9,13 +14,19 @@
 #include <omnicore/dex.h>
 #include <omnicore/log.h>
 #include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
 #include <omnicore/rules.h>
 #include <omnicore/sp.h>
 #include <omnicore/tally.h>
 #include <omnicore/utilsbitcoin.h>
 
 #include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
 #include <fs.h>
+#include <hash.h>
+#include <serialize.h>
+#include <streams.h>
 #include <validation.h>
 #include <tinyformat.h>
 #include <uint256.h>
@@ -25,11 +36,12 @@
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 
-#include <openssl/sha.h>
-
 #include <stdint.h>
+#include <string.h>
 
+#include <algorithm>
 #include <fstream>
+#include <map>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -44,17 +56,19 @@ extern int64_t exodus_prev;
 //! Path for file based persistence
 extern fs::path pathStateFiles;
 
-enum FILETYPES {
-  FILETYPE_BALANCES = 0,
-  FILETYPE_OFFERS,
-  FILETYPE_ACCEPTS,
-  FILETYPE_GLOBALS,
-  FILETYPE_CROWDSALES,
-  FILETYPE_MDEXORDERS,
-  NUM_FILETYPES
+//! Types of the text state files written by previous versions
+enum LegacyFileType {
+    LEGACY_FILETYPE_BALANCES = 0,
+    LEGACY_FILETYPE_OFFERS,
+    LEGACY_FILETYPE_ACCEPTS,
+    LEGACY_FILETYPE_GLOBALS,
+    LEGACY_FILETYPE_CROWDSALES,
+    LEGACY_FILETYPE_MDEXORDERS,
+    NUM_LEGACY_FILETYPES
 };
 
-static char const * const statePrefix[NUM_FILETYPES] = {
+//! Prefixes of the text state files written by previous versions, they are migrated to a base snapshot once
+static char const * const legacyStatePrefix[NUM_LEGACY_FILETYPES] = {
     "balances",
     "offers",
     "accepts",
@@ -63,145 +77,130 @@ static char const * const statePrefix[NUM_FILETYPES] = {
     "mdexorders",
 };
 
-static bool is_state_prefix(std::string const &str)
-{
-    for (int i = 0; i < NUM_FILETYPES; ++i) {
-        if (boost::equals(str, statePrefix[i])) {
-            return true;
-        }
-    }
-
-    return false;
-}
-
-static int write_msc_balances(std::ofstream& file, SHA256_CTX* shaCtx)
-{
-    AssertLockHeld(cs_tally);
+//! Prefix of the state snapshot files
+static const std::string SNAPSHOT_PREFIX = "snapshot";
+//! Version of the state snapshot files, snapshots of other versions are not loaded
+static const int SNAPSHOT_VERSION = 1;
+//! Number of deltas after which a base snapshot is written, it limits the files read to restore a state
+static const int MAX_SNAPSHOT_DELTAS = 50;
 
-    std::unordered_map<std::string, CMPTally>::iterator iter;
-    for (iter = mp_tally_map.begin(); iter != mp_tally_map.end(); ++iter) {
-        bool emptyWallet = true;
+enum SnapshotType : uint8_t {
+    SNAPSHOT_BASE = 0,
+    SNAPSHOT_DELTA = 1,
+};
 
-        std::string lineOut = (*iter).first;
-        lineOut.append("=");
-        CMPTally& curAddr = (*iter).second;
-        curAddr.init();
-        uint32_t propertyId = 0;
-        while (0 != (propertyId = curAddr.next())) {
-            int64_t balance = (*iter).second.getMoney(propertyId, BALANCE);
-            int64_t sellReserved = (*iter).second.getMoney(propertyId, SELLOFFER_RESERVE);
-            int64_t acceptReserved = (*iter).second.getMoney(propertyId, ACCEPT_RESERVE);
-            int64_t metadexReserved = (*iter).second.getMoney(propertyId, METADEX_RESERVE);
-
-            // we don't allow 0 balances to read in, so if we don't write them
-            // it makes things match up better between persisted state and processed state
-            if (0 == balance && 0 == sellReserved && 0 == acceptReserved && 0 == metadexReserved) {
-                continue;
-            }
+//! Tally types stored in the snapshots, pending amounts are not persisted
+static const TallyType snapshotTallyTypes[] = {BALANCE, SELLOFFER_RESERVE, ACCEPT_RESERVE, METADEX_RESERVE};
+static const size_t NUM_SNAPSHOT_TALLY_TYPES = sizeof(snapshotTallyTypes) / sizeof(snapshotTallyTypes[0]);
 
-            emptyWallet = false;
+//! The latest snapshot the in-memory state is based on, null if the next snapshot must be a base
+static uint256 hashLastSnapshot GUARDED_BY(cs_tally);
+//! Number of deltas written since the latest base snapshot
+static int nSnapshotDeltas GUARDED_BY(cs_tally) = 0;
+//! Balances changed since the latest snapshot
+static std::set<std::pair<std::string, uint32_t> > setChangedBalances GUARDED_BY(cs_tally);
 
-            lineOut.append(strprintf("%d:%d,%d,%d,%d;",
-                    propertyId,
-                    balance,
-                    sellReserved,
-                    acceptReserved,
-                    metadexReserved));
-        }
+/** The amounts of one property of an address. */
+struct SnapshotRecord
+{
+    uint32_t propertyId;
+    int64_t amounts[NUM_SNAPSHOT_TALLY_TYPES];
 
-        if (false == emptyWallet) {
-            // add the line to the hash
-            SHA256_Update(shaCtx, lineOut.c_str(), lineOut.length());
+    ADD_SERIALIZE_METHODS;
 
-            // write the line
-            file << lineOut << std::endl;
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(VARINT(propertyId));
+        for (size_t i = 0; i < NUM_SNAPSHOT_TALLY_TYPES; ++i) {
+            READWRITE(VARINT(amounts[i], VarIntMode::NONNEGATIVE_SIGNED));
         }
     }
+};
 
-    return 0;
-}
-
-static int write_mp_offers(std::ofstream& file, SHA256_CTX* shaCtx)
+/** Header of a snapshot file, which is also read alone to find the parents of the deltas. */
+struct SnapshotHeader
 {
-    AssertLockHeld(cs_tally);
-
-    OfferMap::const_iterator iter;
-    for (iter = my_offers.begin(); iter != my_offers.end(); ++iter) {
-        // decompose the key for address
-        std::vector<std::string> vstr;
-        boost::split(vstr, iter->first, boost::is_any_of("-"), boost::token_compress_on);
-        const CMPOffer& offer = iter->second;
-        offer.saveOffer(file, shaCtx, vstr[0]);
+    int nVersion;
+    uint8_t nType;
+    uint256 hashBlock;
+    //! The snapshot the delta is applied to, null for a base
+    uint256 hashParent;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nVersion);
+        READWRITE(nType);
+        READWRITE(hashBlock);
+        READWRITE(hashParent);
     }
+};
 
-    return 0;
-}
-
-static int write_mp_accepts(std::ofstream& file, SHA256_CTX* shaCtx)
+/**
+ * The state as of a block. A base holds all balances and a delta only holds the balances changed since its parent,
+ * where a balance of zero amounts is removed. The other state is small and it's always stored in full.
+ */
+struct StateSnapshot
 {
-    AssertLockHeld(cs_tally);
-
-    AcceptMap::const_iterator iter;
-    for (iter = my_accepts.begin(); iter != my_accepts.end(); ++iter) {
-        // decompose the key for address
-        std::vector<std::string> vstr;
-        boost::split(vstr, iter->first, boost::is_any_of("-+"), boost::token_compress_on);
-        const CMPAccept& accept = iter->second;
-        accept.saveAccept(file, shaCtx, vstr[0], vstr[2]);
+    int64_t exodusPrev;
+    uint32_t nextSPID;
+    uint32_t nextTestSPID;
+    std::vector<std::pair<std::string, std::vector<SnapshotRecord> > > balances;
+    OfferMap offers;
+    AcceptMap accepts;
+    CrowdMap crowds;
+    std::vector<CMPMetaDEx> orders;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(exodusPrev);
+        READWRITE(nextSPID);
+        READWRITE(nextTestSPID);
+        READWRITE(balances);
+        READWRITE(offers);
+        READWRITE(accepts);
+        READWRITE(crowds);
+        READWRITE(orders);
     }
+};
 
-    return 0;
-}
-
-static int write_globals_state(std::ofstream& file, SHA256_CTX* shaCtx)
+static fs::path GetSnapshotPath(const uint256& blockHash)
 {
-    AssertLockHeld(cs_tally);
-
-    uint32_t nextSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_MSC);
-    uint32_t nextTestSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_TMSC);
-    std::string lineOut = strprintf("%d,%d,%d",
-            exodus_prev,
-            nextSPID,
-            nextTestSPID);
-
-    // add the line to the hash
-    SHA256_Update(shaCtx, lineOut.c_str(), lineOut.length());
-
-    // write the line
-    file << lineOut << std::endl;
-
-    return 0;
+    return pathStateFiles / strprintf("%s-%s.dat", SNAPSHOT_PREFIX, blockHash.ToString());
 }
 
-static int write_mp_crowdsales(std::ofstream& file, SHA256_CTX* shaCtx)
+/**
+ * Splits a file name of the form "prefix-blockhash.dat".
+ */
+static bool ParseStateFileName(const std::string& fName, std::string& prefix, uint256& blockHash)
 {
-    AssertLockHeld(cs_tally);
-
-    for (CrowdMap::const_iterator it = my_crowds.begin(); it != my_crowds.end(); ++it) {
-        // decompose the key for address
-        const CMPCrowd& crowd = it->second;
-        crowd.saveCrowdSale(file, shaCtx, it->first);
+    std::vector<std::string> vstr;
+    boost::split(vstr, fName, boost::is_any_of("-."), boost::token_compress_on);
+    if (vstr.size() != 3 || !boost::equals(vstr[2], "dat")) {
+        return false;
     }
-
-    return 0;
+    prefix = vstr[0];
+    blockHash.SetHex(vstr[1]);
+    return true;
 }
 
-static int write_mp_metadex(std::ofstream &file, SHA256_CTX* shaCtx)
+static bool is_legacy_state_prefix(std::string const &str)
 {
-    AssertLockHeld(cs_tally);
-
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        md_PricesMap& prices = my_it->second;
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            md_Set& indexes = (it->second);
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                const CMPMetaDEx& meta = *it;
-                meta.saveOffer(file, shaCtx);
-            }
+    for (char const * const prefix : legacyStatePrefix) {
+        if (boost::equals(str, prefix)) {
+            return true;
         }
     }
 
-    return 0;
+    return false;
+}
+
+static fs::path GetLegacyStatePath(int what, const uint256& blockHash)
+{
+    return pathStateFiles / strprintf("%s-%s.dat", legacyStatePrefix[what], blockHash.ToString());
 }
 
 static int input_msc_balances_string(const std::string& s)
@@ -270,7 +269,6 @@ static int input_mp_offers_string(const std::string& s)
     uint8_t blocktimelimit = boost::lexical_cast<unsigned int>(vstr[i++]); // lexical_cast can't handle char!
     uint256 txid = uint256S(vstr[i++]);
 
-    // TODO: should this be here? There are usually no sanity checks..
     if (OMNI_PROPERTY_BTC != prop_desired) return -1;
 
     const std::string combo = STR_SELLOFFER_ADDR_PROP_COMBO(sellerAddr, prop);
@@ -282,57 +280,48 @@ static int input_mp_offers_string(const std::string& s)
     return 0;
 }
 
-// seller-address, property, buyer-address, amount, fee, block
-// 13z1JFtDMGTYQvtMq5gs4LmCztK3rmEZga,1, 148EFCFXbk2LrUhEHDfs9y3A5dJ4tttKVd,100000,11000,299126
-// 13z1JFtDMGTYQvtMq5gs4LmCztK3rmEZga,1,1Md8GwMtWpiobRnjRabMT98EW6Jh4rEUNy,50000000,11000,299132
+// seller-address, property, buyer-address, block, amount remaining, amount, blocktimelimit, offer amount, desired BTC, txid
+// 13z1JFtDMGTYQvtMq5gs4LmCztK3rmEZga,1,148EFCFXbk2LrUhEHDfs9y3A5dJ4tttKVd,299126,100000,100000,6,76375000,6415500,...
 static int input_mp_accepts_string(const std::string& s)
 {
-    int nBlock;
-    unsigned char blocktimelimit;
     std::vector<std::string> vstr;
     boost::split(vstr, s, boost::is_any_of(" ,="), boost::token_compress_on);
-    int64_t amountRemaining, amountOriginal, offerOriginal, btcDesired;
-    unsigned int prop;
-    std::string sellerAddr, buyerAddr, txidStr;
-    int i = 0;
 
     if (10 != vstr.size()) return -1;
 
-    sellerAddr = vstr[i++];
-    prop = boost::lexical_cast<unsigned int>(vstr[i++]);
-    buyerAddr = vstr[i++];
-    nBlock = atoi(vstr[i++]);
-    amountRemaining = boost::lexical_cast<int64_t>(vstr[i++]);
-    amountOriginal = boost::lexical_cast<uint64_t>(vstr[i++]);
-    blocktimelimit = atoi(vstr[i++]);
-    offerOriginal = boost::lexical_cast<int64_t>(vstr[i++]);
-    btcDesired = boost::lexical_cast<int64_t>(vstr[i++]);
-    txidStr = vstr[i++];
+    int i = 0;
+
+    std::string sellerAddr = vstr[i++];
+    uint32_t prop = boost::lexical_cast<uint32_t>(vstr[i++]);
+    std::string buyerAddr = vstr[i++];
+    int nBlock = boost::lexical_cast<int>(vstr[i++]);
+    int64_t amountRemaining = boost::lexical_cast<int64_t>(vstr[i++]);
+    int64_t amountOriginal = boost::lexical_cast<int64_t>(vstr[i++]);
+    uint8_t blocktimelimit = boost::lexical_cast<unsigned int>(vstr[i++]); // lexical_cast can't handle char!
+    int64_t offerOriginal = boost::lexical_cast<int64_t>(vstr[i++]);
+    int64_t btcDesired = boost::lexical_cast<int64_t>(vstr[i++]);
+    uint256 txid = uint256S(vstr[i++]);
 
     AssertLockHeld(cs_tally);
 
     const std::string combo = STR_ACCEPT_ADDR_PROP_ADDR_COMBO(sellerAddr, buyerAddr, prop);
-    CMPAccept newAccept(amountOriginal, amountRemaining, nBlock, blocktimelimit, prop, offerOriginal, btcDesired, uint256S(txidStr));
-    if (my_accepts.insert(std::make_pair(combo, newAccept)).second) {
-        return 0;
-    } else {
-        return -1;
-    }
+    CMPAccept newAccept(amountOriginal, amountRemaining, nBlock, blocktimelimit, prop, offerOriginal, btcDesired, txid);
+    if (!my_accepts.insert(std::make_pair(combo, newAccept)).second) return -1;
+
+    return 0;
 }
 
-// exodus_prev
+// exodus_prev, next SP id, next test SP id
 static int input_globals_state_string(const std::string& s)
 {
-    int64_t exodusPrev;
-    uint32_t nextSPID, nextTestSPID;
     std::vector<std::string> vstr;
     boost::split(vstr, s, boost::is_any_of(" ,="), boost::token_compress_on);
     if (3 != vstr.size()) return -1;
 
     int i = 0;
-    exodusPrev = boost::lexical_cast<int64_t>(vstr[i++]);
-    nextSPID = boost::lexical_cast<uint32_t>(vstr[i++]);
-    nextTestSPID = boost::lexical_cast<uint32_t>(vstr[i++]);
+    int64_t exodusPrev = boost::lexical_cast<int64_t>(vstr[i++]);
+    uint32_t nextSPID = boost::lexical_cast<uint32_t>(vstr[i++]);
+    uint32_t nextTestSPID = boost::lexical_cast<uint32_t>(vstr[i++]);
 
     AssertLockHeld(cs_tally);
 
@@ -341,7 +330,7 @@ static int input_globals_state_string(const std::string& s)
     return 0;
 }
 
-// addr,propertyId,nValue,property_desired,deadline,early_bird,percentage,txid
+// addr,propertyId,nValue,property_desired,deadline,early_bird,percentage,u_created,i_created,txid=values...
 static int input_mp_crowdsale_string(const std::string& s)
 {
     std::vector<std::string> vstr;
@@ -419,61 +408,367 @@ static int input_mp_mdexorder_string(const std::string& s)
     return 0;
 }
 
-static int write_state_file(const CBlockIndex* pBlockIndex, int what)
+/**
+ * Loads a text state file of a previous version into the in-memory state, and verifies its hash.
+ */
+static int RestoreLegacyStateFile(const fs::path& path, int what)
 {
-    fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[what], pBlockIndex->GetBlockHash().ToString());
-    const std::string strFile = path.string();
+    AssertLockHeld(cs_tally);
+
+    int (*inputLineFunc)(const std::string&) = nullptr;
+    switch (what) {
+        case LEGACY_FILETYPE_BALANCES: inputLineFunc = input_msc_balances_string; break;
+        case LEGACY_FILETYPE_OFFERS: inputLineFunc = input_mp_offers_string; break;
+        case LEGACY_FILETYPE_ACCEPTS: inputLineFunc = input_mp_accepts_string; break;
+        case LEGACY_FILETYPE_GLOBALS: inputLineFunc = input_globals_state_string; break;
+        case LEGACY_FILETYPE_CROWDSALES: inputLineFunc = input_mp_crowdsale_string; break;
+        case LEGACY_FILETYPE_MDEXORDERS: inputLineFunc = input_mp_mdexorder_string; break;
+        default: return -1;
+    }
+
+    std::ifstream file;
+    file.open(path.string().c_str());
+    if (!file.is_open()) {
+        if (msc_debug_persistence) PrintToLog("%s(%s): file not found\n", __func__, path.string());
+        return -1;
+    }
 
-    std::ofstream file;
-    file.open(strFile.c_str());
+    // the hash of a file is the double SHA256 of its lines, without the line breaks
+    CHash256 hasher;
+    std::string fileHash;
+    int lines = 0;
+    int res = 0;
+    while (file.good()) {
+        std::string line;
+        std::getline(file, line);
+        if (line.empty() || line[0] == '#') continue;
 
-    SHA256_CTX shaCtx;
-    SHA256_Init(&shaCtx);
+        // remove \r if the file came from Windows
+        line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
 
-    int result = 0;
+        // record and skip hashes in the file
+        if (line[0] == '!') {
+            fileHash = line.substr(1);
+            continue;
+        }
 
-    switch (what) {
-        case FILETYPE_BALANCES:
-            result = write_msc_balances(file, &shaCtx);
+        hasher.Write((const unsigned char*) line.data(), line.size());
+        try {
+            if (inputLineFunc(line) < 0) {
+                res = -1;
+                break;
+            }
+        } catch (const boost::bad_lexical_cast&) {
+            res = -1;
             break;
+        }
+        ++lines;
+    }
+    file.close();
 
-        case FILETYPE_OFFERS:
-            result = write_mp_offers(file, &shaCtx);
-            break;
+    if (res == 0) {
+        uint256 hash;
+        hasher.Finalize(hash.begin());
+        if (false == boost::iequals(hash.ToString(), fileHash)) {
+            PrintToLog("File %s loaded, but failed hash validation!\n", path.string());
+            res = -1;
+        }
+    }
 
-        case FILETYPE_ACCEPTS:
-            result = write_mp_accepts(file, &shaCtx);
-            break;
+    PrintToLog("%s(%s), loaded lines= %d, res= %d\n", __func__, path.string(), lines, res);
 
-        case FILETYPE_GLOBALS:
-            result = write_globals_state(file, &shaCtx);
-            break;
+    return res;
+}
 
-        case FILETYPE_CROWDSALES:
-            result = write_mp_crowdsales(file, &shaCtx);
-            break;
+static bool GetSnapshotRecord(const CMPTally& tally, uint32_t propertyId, SnapshotRecord& record)
+{
+    bool fEmpty = true;
+    record.propertyId = propertyId;
+    for (size_t i = 0; i < NUM_SNAPSHOT_TALLY_TYPES; ++i) {
+        record.amounts[i] = tally.getMoney(propertyId, snapshotTallyTypes[i]);
+        if (record.amounts[i] != 0) fEmpty = false;
+    }
 
-        case FILETYPE_MDEXORDERS:
-            result = write_mp_metadex(file, &shaCtx);
-            break;
+    return !fEmpty;
+}
+
+static void GetBaseBalances(StateSnapshot& snapshot)
+{
+    AssertLockHeld(cs_tally);
+
+    snapshot.balances.reserve(mp_tally_map.size());
+    for (std::unordered_map<std::string, CMPTally>::iterator iter = mp_tally_map.begin(); iter != mp_tally_map.end(); ++iter) {
+        std::vector<SnapshotRecord> records;
+        CMPTally& tally = iter->second;
+        tally.init();
+        uint32_t propertyId = 0;
+        while (0 != (propertyId = tally.next())) {
+            // empty balances are not stored, they match up with the state after a restore this way
+            SnapshotRecord record;
+            if (GetSnapshotRecord(tally, propertyId, record)) {
+                records.push_back(record);
+            }
+        }
+        if (!records.empty()) {
+            snapshot.balances.emplace_back(iter->first, std::move(records));
+        }
     }
+}
 
-    // generate and wite the double hash of all the contents written
-    uint256 hash1;
-    SHA256_Final((unsigned char*) &hash1, &shaCtx);
-    uint256 hash2;
-    SHA256((unsigned char*) &hash1, sizeof (hash1), (unsigned char*) &hash2);
-    file << "!" << hash2.ToString() << std::endl;
+static void GetDeltaBalances(StateSnapshot& snapshot)
+{
+    AssertLockHeld(cs_tally);
 
-    file.flush();
-    file.close();
-    return result;
+    static const CMPTally emptyTally;
+    for (const std::pair<std::string, uint32_t>& key : setChangedBalances) {
+        std::unordered_map<std::string, CMPTally>::const_iterator iter = mp_tally_map.find(key.first);
+        const CMPTally& tally = (iter != mp_tally_map.end()) ? iter->second : emptyTally;
+
+        // the keys are ordered by address, so the records of an address are next to each other
+        if (snapshot.balances.empty() || snapshot.balances.back().first != key.first) {
+            snapshot.balances.emplace_back(key.first, std::vector<SnapshotRecord>());
+        }
+        SnapshotRecord record;
+        GetSnapshotRecord(tally, key.second, record);
+        snapshot.balances.back().second.push_back(record);
+    }
+}
+
+static void GetMetaDExOrders(StateSnapshot& snapshot)
+{
+    AssertLockHeld(cs_tally);
+
+    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        const md_PairsMap& pairs = my_it->second;
+        for (md_PairsMap::const_iterator pair_it = pairs.begin(); pair_it != pairs.end(); ++pair_it) {
+            const md_PricesMap& prices = pair_it->second;
+            for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+                const md_Set& indexes = it->second;
+                snapshot.orders.insert(snapshot.orders.end(), indexes.begin(), indexes.end());
+            }
+        }
+    }
+}
+
+/**
+ * Writes the header, the snapshot and the double SHA256 hash of both, the file is replaced atomically.
+ */
+static bool WriteSnapshotFile(const SnapshotHeader& header, const StateSnapshot& snapshot)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << Params().MessageStart() << header << snapshot;
+    ss << Hash(ss.begin(), ss.end());
+
+    fs::path path = GetSnapshotPath(header.hashBlock);
+    fs::path pathTmp = path;
+    pathTmp += ".new";
+
+    CAutoFile fileout(fsbridge::fopen(pathTmp, "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        return error("%s: Failed to open file %s", __func__, pathTmp.string());
+    }
+    try {
+        fileout.write(ss.data(), ss.size());
+    } catch (const std::exception& e) {
+        fileout.fclose();
+        fs::remove(pathTmp);
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    fileout.fclose();
+
+    if (!RenameOver(pathTmp, path)) {
+        fs::remove(pathTmp);
+        return error("%s: Rename-into-place failed", __func__);
+    }
+
+    return true;
+}
+
+template <typename Stream>
+static bool ReadSnapshotHeader(Stream& stream, SnapshotHeader& header)
+{
+    unsigned char pchMsgTmp[4];
+    stream >> pchMsgTmp;
+    if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
+        return error("%s: Invalid network magic number", __func__);
+    }
+    stream >> header;
+    if (header.nVersion != SNAPSHOT_VERSION) {
+        return error("%s: Unsupported snapshot version %d", __func__, header.nVersion);
+    }
+
+    return true;
+}
+
+/**
+ * Reads the header of the snapshot of the block, without verifying the checksum of the file.
+ */
+static bool ReadSnapshotHeader(const fs::path& path, SnapshotHeader& header)
+{
+    CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return false;
+    }
+    try {
+        return ReadSnapshotHeader(filein, header);
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+}
+
+/**
+ * Reads the snapshot of the block and verifies its checksum.
+ */
+static bool ReadSnapshotFile(const uint256& blockHash, SnapshotHeader& header, StateSnapshot& snapshot)
+{
+    fs::path path = GetSnapshotPath(blockHash);
+    CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        if (msc_debug_persistence) PrintToLog("%s(%s): file not found\n", __func__, path.string());
+        return false;
+    }
+
+    try {
+        CHashVerifier<CAutoFile> verifier(&filein);
+        if (!ReadSnapshotHeader(verifier, header)) {
+            return false;
+        }
+        verifier >> snapshot;
+
+        uint256 hashTmp;
+        filein >> hashTmp;
+        if (hashTmp != verifier.GetHash()) {
+            return error("%s: Checksum mismatch, file %s corrupted", __func__, path.string());
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    if (header.hashBlock != blockHash) {
+        return error("%s: Snapshot %s is not the state of block %s", __func__, path.string(), blockHash.ToString());
+    }
+
+    return true;
+}
+
+/**
+ * Writes the state as of the given block, as a delta of the latest snapshot when possible.
+ */
+static bool write_state_snapshot(const CBlockIndex* pBlockIndex)
+{
+    AssertLockHeld(cs_tally);
+
+    const uint256 blockHash = pBlockIndex->GetBlockHash();
+
+    // a delta is only written on top of an ancestor, and the snapshots kept for long have no parents
+    bool fBase = hashLastSnapshot.IsNull() || hashLastSnapshot == blockHash
+            || nSnapshotDeltas >= MAX_SNAPSHOT_DELTAS || pBlockIndex->nHeight % STORE_EVERY_N_BLOCK == 0;
+    if (!fBase) {
+        CBlockIndex const *lastIndex = GetBlockIndex(hashLastSnapshot);
+        fBase = nullptr == lastIndex || pBlockIndex->GetAncestor(lastIndex->nHeight) != lastIndex
+                || !fs::exists(GetSnapshotPath(hashLastSnapshot));
+    }
+
+    SnapshotHeader header;
+    header.nVersion = SNAPSHOT_VERSION;
+    header.nType = fBase ? SNAPSHOT_BASE : SNAPSHOT_DELTA;
+    header.hashBlock = blockHash;
+    if (!fBase) header.hashParent = hashLastSnapshot;
+
+    StateSnapshot snapshot;
+    snapshot.exodusPrev = exodus_prev;
+    snapshot.nextSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_MSC);
+    snapshot.nextTestSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_TMSC);
+    if (fBase) {
+        GetBaseBalances(snapshot);
+    } else {
+        GetDeltaBalances(snapshot);
+    }
+    snapshot.offers = my_offers;
+    snapshot.accepts = my_accepts;
+    snapshot.crowds = my_crowds;
+    GetMetaDExOrders(snapshot);
+
+    if (!WriteSnapshotFile(header, snapshot)) {
+        // the changes since the latest snapshot are lost, so the next one is a base
+        ResetSnapshotDelta();
+        return false;
+    }
+
+    if (msc_debug_persistence) {
+        PrintToLog("%s(): wrote %s snapshot of block %s with %d addresses\n", __func__,
+                fBase ? "base" : "delta", blockHash.ToString(), snapshot.balances.size());
+    }
+
+    hashLastSnapshot = blockHash;
+    nSnapshotDeltas = fBase ? 0 : nSnapshotDeltas + 1;
+    setChangedBalances.clear();
+
+    return true;
+}
+
+/**
+ * Removes the text state files of previous versions.
+ */
+static void remove_legacy_state_files()
+{
+    std::vector<fs::path> removedFiles;
+    fs::directory_iterator dIter(pathStateFiles);
+    fs::directory_iterator endIter;
+    for (; dIter != endIter; ++dIter) {
+        if (false == fs::is_regular_file(dIter->status()) || dIter->path().empty()) {
+            continue;
+        }
+
+        std::string prefix;
+        uint256 blockHash;
+        if (ParseStateFileName((*--dIter->path().end()).string(), prefix, blockHash) && is_legacy_state_prefix(prefix)) {
+            removedFiles.push_back(dIter->path());
+        }
+    }
+    for (const fs::path& path : removedFiles) {
+        fs::remove(path);
+    }
+}
+
+/**
+ * Loads the state as of the given block from the text files of a previous version, and stores it as a base
+ * snapshot. The text files are only removed once the snapshot is written.
+ */
+static int MigrateLegacyState(const CBlockIndex* pBlockIndex)
+{
+    AssertLockHeld(cs_tally);
+
+    const uint256 blockHash = pBlockIndex->GetBlockHash();
+
+    // clearing the tally map also forgets the latest snapshot, so a base is written
+    clear_tally_map();
+    my_offers.clear();
+    my_accepts.clear();
+    my_crowds.clear();
+    metadex.clear();
+
+    for (int i = 0; i < NUM_LEGACY_FILETYPES; ++i) {
+        if (RestoreLegacyStateFile(GetLegacyStatePath(i, blockHash), i) < 0) {
+            return -1;
+        }
+    }
+
+    if (!write_state_snapshot(pBlockIndex)) {
+        return -1;
+    }
+    remove_legacy_state_files();
+
+    PrintToLog("%s(): migrated the state files of block %s to a snapshot\n", __func__, blockHash.ToString());
+    LogPrintf("%s(): migrated the state files of block %s to a snapshot\n", __func__, blockHash.ToString());
+
+    return 0;
 }
 
 static void prune_state_files(const CBlockIndex* topIndex)
 {
-    // build a set of blockHashes for which we have any state files
-    std::set<uint256> statefulBlockHashes;
+    // the parents of the snapshots, null for the bases
+    std::map<uint256, uint256> snapshotParents;
+    std::vector<fs::path> removedFiles;
 
     fs::directory_iterator dIter(pathStateFiles);
     fs::directory_iterator endIter;
@@ -485,44 +780,63 @@ static void prune_state_files(const CBlockIndex* topIndex)
             continue;
         }
 
-        std::vector<std::string> vstr;
-        boost::split(vstr, fName, boost::is_any_of("-."), boost::token_compress_on);
-        if (vstr.size() == 3 &&
-                is_state_prefix(vstr[0]) &&
-                boost::equals(vstr[2], "dat")) {
-            uint256 blockHash;
-            blockHash.SetHex(vstr[1]);
-            statefulBlockHashes.insert(blockHash);
+        std::string prefix;
+        uint256 blockHash;
+        if (!ParseStateFileName(fName, prefix, blockHash)) {
+            PrintToLog("None state file found in persistence directory : %s\n", fName);
+        } else if (is_legacy_state_prefix(prefix)) {
+            // the usable files were migrated at startup, the files left can't be restored
+            if (msc_debug_persistence) PrintToLog("Removing state file of the previous format : %s\n", fName);
+            removedFiles.push_back(dIter->path());
+        } else if (prefix == SNAPSHOT_PREFIX) {
+            SnapshotHeader header;
+            if (!ReadSnapshotHeader(dIter->path(), header) || header.hashBlock != blockHash) {
+                PrintToLog("Removing unreadable snapshot : %s\n", fName);
+                removedFiles.push_back(dIter->path());
+                continue;
+            }
+            snapshotParents[blockHash] = header.hashParent;
         } else {
             PrintToLog("None state file found in persistence directory : %s\n", fName);
         }
     }
 
-    // for each blockHash in the set, determine the distance from the given block
-    std::set<uint256>::const_iterator iter;
-    for (iter = statefulBlockHashes.begin(); iter != statefulBlockHashes.end(); ++iter) {
+    // for each snapshot, determine the distance from the given block
+    std::set<uint256> keptSnapshots;
+    for (std::map<uint256, uint256>::const_iterator iter = snapshotParents.begin(); iter != snapshotParents.end(); ++iter) {
         // look up the CBlockIndex for height info
-        CBlockIndex const *curIndex = GetBlockIndex(*iter);
+        CBlockIndex const *curIndex = GetBlockIndex(iter->first);
 
         // if we have nothing int the index, or this block is too old..
         if (nullptr == curIndex || (((topIndex->nHeight - curIndex->nHeight) > MAX_STATE_HISTORY)
                 && (curIndex->nHeight % STORE_EVERY_N_BLOCK != 0))) {
             if (msc_debug_persistence) {
                 if (curIndex) {
-                    PrintToLog("State from Block:%s is no longer need, removing files (age-from-tip: %d)\n", (*iter).ToString(), topIndex->nHeight - curIndex->nHeight);
+                    PrintToLog("State from Block:%s is no longer need (age-from-tip: %d)\n", iter->first.ToString(), topIndex->nHeight - curIndex->nHeight);
                 } else {
-                    PrintToLog("State from Block:%s is no longer need, removing files (not in index)\n", (*iter).ToString());
+                    PrintToLog("State from Block:%s is no longer need (not in index)\n", iter->first.ToString());
                 }
             }
+            continue;
+        }
 
-            // destroy the associated files!
-            std::string strBlockHash = iter->ToString();
-            for (int i = 0; i < NUM_FILETYPES; ++i) {
-                fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[i], strBlockHash);
-                fs::remove(path);
-            }
+        // the snapshots a delta is based on are needed to restore it
+        uint256 blockHash = iter->first;
+        while (!blockHash.IsNull() && keptSnapshots.insert(blockHash).second) {
+            std::map<uint256, uint256>::const_iterator parent = snapshotParents.find(blockHash);
+            blockHash = (parent != snapshotParents.end()) ? parent->second : uint256();
+        }
+    }
+
+    // destroy the snapshots no longer needed
+    for (std::map<uint256, uint256>::const_iterator iter = snapshotParents.begin(); iter != snapshotParents.end(); ++iter) {
+        if (keptSnapshots.count(iter->first) == 0) {
+            removedFiles.push_back(GetSnapshotPath(iter->first));
         }
     }
+    for (const fs::path& path : removedFiles) {
+        fs::remove(path);
+    }
 }
 
 /**
@@ -560,142 +874,118 @@ bool IsPersistenceEnabled(int blockHeight)
 }
 
 /**
- * Stores the in-memory state in files.
+ * Marks the balance as changed since the latest snapshot.
  */
-int PersistInMemoryState(const CBlockIndex* pBlockIndex)
+void MarkSnapshotBalanceChanged(const std::string& address, uint32_t propertyId)
 {
-    // write the new state as of the given block
-    write_state_file(pBlockIndex, FILETYPE_BALANCES);
-    write_state_file(pBlockIndex, FILETYPE_OFFERS);
-    write_state_file(pBlockIndex, FILETYPE_ACCEPTS);
-    write_state_file(pBlockIndex, FILETYPE_GLOBALS);
-    write_state_file(pBlockIndex, FILETYPE_CROWDSALES);
-    write_state_file(pBlockIndex, FILETYPE_MDEXORDERS);
-
-    // clean-up the directory
-    prune_state_files(pBlockIndex);
-
     AssertLockHeld(cs_tally);
 
-    pDbSpInfo->setWatermark(pBlockIndex->GetBlockHash());
-
-    return 0;
+    if (!hashLastSnapshot.IsNull()) {
+        setChangedBalances.emplace(address, propertyId);
+    }
 }
 
 /**
- * Loads and retrieves state from a file.
+ * Forgets the latest snapshot, so that the next one is a base.
  */
-int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash)
+void ResetSnapshotDelta()
 {
     AssertLockHeld(cs_tally);
 
-    int lines = 0;
-    int (*inputLineFunc)(const std::string&) = nullptr;
-
-    SHA256_CTX shaCtx;
-    SHA256_Init(&shaCtx);
-
-    switch (what) {
-        case FILETYPE_BALANCES:
-            mp_tally_map.clear();
-            inputLineFunc = input_msc_balances_string;
-            break;
-
-        case FILETYPE_OFFERS:
-            my_offers.clear();
-            inputLineFunc = input_mp_offers_string;
-            break;
-
-        case FILETYPE_ACCEPTS:
-            my_accepts.clear();
-            inputLineFunc = input_mp_accepts_string;
-            break;
-
-        case FILETYPE_GLOBALS:
-            inputLineFunc = input_globals_state_string;
-            break;
-
-        case FILETYPE_CROWDSALES:
-            my_crowds.clear();
-            inputLineFunc = input_mp_crowdsale_string;
-            break;
-
-        case FILETYPE_MDEXORDERS:
-            // FIXME
-            // memory leak ... gotta unallocate inner layers first....
-            // TODO
-            // ...
-            metadex.clear();
-            inputLineFunc = input_mp_mdexorder_string;
-            break;
-
-        default:
-            return -1;
-    }
+    hashLastSnapshot.SetNull();
+    nSnapshotDeltas = 0;
+    setChangedBalances.clear();
+}
 
-    if (msc_debug_persistence) {
-        LogPrintf("Loading %s ... \n", filename);
-        PrintToLog("%s(%s), line %d, file: %s\n", __FUNCTION__, filename, __LINE__, __FILE__);
-    }
+/**
+ * Stores the in-memory state in files.
+ */
+int PersistInMemoryState(const CBlockIndex* pBlockIndex)
+{
+    AssertLockHeld(cs_tally);
 
-    std::ifstream file;
-    file.open(filename.c_str());
-    if (!file.is_open()) {
-        if (msc_debug_persistence) LogPrintf("%s(%s): file not found, line %d, file: %s\n", __FUNCTION__, filename, __LINE__, __FILE__);
+    // write the new state as of the given block
+    if (!write_state_snapshot(pBlockIndex)) {
         return -1;
     }
 
-    int res = 0;
+    // clean-up the directory
+    prune_state_files(pBlockIndex);
 
-    std::string fileHash;
-    while (file.good()) {
-        std::string line;
-        std::getline(file, line);
-        if (line.empty() || line[0] == '#') continue;
+    pDbSpInfo->setWatermark(pBlockIndex->GetBlockHash());
 
-        // remove \r if the file came from Windows
-        line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+    return 0;
+}
 
-        // record and skip hashes in the file
-        if (line[0] == '!') {
-            fileHash = line.substr(1);
-            continue;
-        }
+/**
+ * Loads the state as of the given block, from its snapshot and the snapshots it's based on.
+ */
+int RestoreInMemoryState(const uint256& blockHash)
+{
+    AssertLockHeld(cs_tally);
 
-        // update hash?
-        if (verifyHash) {
-            SHA256_Update(&shaCtx, line.c_str(), line.length());
+    // the snapshots are read from the newest one, so the first amounts read of each balance are the latest
+    std::map<std::pair<std::string, uint32_t>, SnapshotRecord> balances;
+    StateSnapshot latest;
+    int nDeltas = 0;
+    uint256 hash = blockHash;
+    while (true) {
+        SnapshotHeader header;
+        StateSnapshot snapshot;
+        if (!ReadSnapshotFile(hash, header, snapshot)) {
+            return -1;
         }
-
-        if (inputLineFunc) {
-            if (inputLineFunc(line) < 0) {
-                res = -1;
-                break;
+        for (const auto& addressRecords : snapshot.balances) {
+            for (const SnapshotRecord& record : addressRecords.second) {
+                balances.emplace(std::make_pair(addressRecords.first, record.propertyId), record);
             }
         }
-
-        ++lines;
+        if (hash == blockHash) {
+            latest = std::move(snapshot);
+        }
+        if (header.nType == SNAPSHOT_BASE) {
+            break;
+        }
+        if (header.nType != SNAPSHOT_DELTA || ++nDeltas > MAX_SNAPSHOT_DELTAS) {
+            PrintToLog("%s(): invalid chain of snapshots for block %s\n", __func__, blockHash.ToString());
+            return -1;
+        }
+        hash = header.hashParent;
     }
 
-    file.close();
-
-    if (verifyHash && res == 0) {
-        // generate and wite the double hash of all the contents written
-        uint256 hash1;
-        SHA256_Final((unsigned char*) &hash1, &shaCtx);
-        uint256 hash2;
-        SHA256((unsigned char*) &hash1, sizeof (hash1), (unsigned char*) &hash2);
+    clear_tally_map();
+    my_offers.clear();
+    my_accepts.clear();
+    my_crowds.clear();
+    metadex.clear();
 
-        if (false == boost::iequals(hash2.ToString(), fileHash)) {
-            PrintToLog("File %s loaded, but failed hash validation!\n", filename);
-            res = -1;
+    for (const auto& balance : balances) {
+        const SnapshotRecord& record = balance.second;
+        for (size_t i = 0; i < NUM_SNAPSHOT_TALLY_TYPES; ++i) {
+            if (record.amounts[i]) update_tally_map(balance.first.first, record.propertyId, record.amounts[i], snapshotTallyTypes[i]);
         }
     }
+    my_offers = std::move(latest.offers);
+    my_accepts = std::move(latest.accepts);
+    my_crowds = std::move(latest.crowds);
+    for (const CMPMetaDEx& order : latest.orders) {
+        if (!MetaDEx_INSERT(order)) {
+            PrintToLog("%s(): failed to insert MetaDEx order %s\n", __func__, order.getHash().ToString());
+            return -1;
+        }
+    }
+    exodus_prev = latest.exodusPrev;
+    pDbSpInfo->init(latest.nextSPID, latest.nextTestSPID);
 
-    PrintToLog("%s(%s), loaded lines= %d, res= %d\n", __FUNCTION__, filename, lines, res);
-    LogPrintf("%s(): file: %s , loaded lines= %d, res= %d\n", __FUNCTION__, filename, lines, res);
+    // the next snapshot can be a delta of this one
+    ResetSnapshotDelta();
+    hashLastSnapshot = blockHash;
+    nSnapshotDeltas = nDeltas;
 
-    return res;
+    PrintToLog("%s(%s), loaded balances= %d, snapshots= %d\n", __func__, blockHash.ToString(), balances.size(), nDeltas + 1);
+    LogPrintf("%s(): block: %s , loaded balances= %d, snapshots= %d\n", __func__, blockHash.ToString(), balances.size(), nDeltas + 1);
+
+    return 0;
 }
 
 /**
@@ -754,12 +1044,11 @@ int LoadMostRelevantInMemoryState()
             }
 
             std::string fName = (*--dIter->path().end()).string();
-            std::vector<std::string> vstr;
-            boost::split(vstr, fName, boost::is_any_of("-."), boost::token_compress_on);
-            if (vstr.size() == 3 &&
-                    boost::equals(vstr[2], "dat")) {
-                uint256 blockHash;
-                blockHash.SetHex(vstr[1]);
+            std::string prefix;
+            uint256 blockHash;
+            // the text files of previous versions are migrated, when no snapshot is found first
+            if (ParseStateFileName(fName, prefix, blockHash)
+                    && (prefix == SNAPSHOT_PREFIX || prefix == legacyStatePrefix[LEGACY_FILETYPE_BALANCES])) {
                 CBlockIndex *pBlockIndex = GetBlockIndex(blockHash);
                 if (pBlockIndex == nullptr || false == ::ChainActive().Contains(pBlockIndex)) {
                     continue;
@@ -784,16 +1073,15 @@ int LoadMostRelevantInMemoryState()
         while (nullptr != curTip && persistedBlocks.size() > 0 && curTip->nHeight > abortRollBackBlock ) {
             if (persistedBlocks.find(curTip->GetBlockHash()) != persistedBlocks.end()) {
                 int success = -1;
-                for (int i = 0; i < NUM_FILETYPES; ++i) {
-                    fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[i], curTip->GetBlockHash().ToString());
-                    const std::string strFile = path.string();
-                    success = RestoreInMemoryState(strFile, i, true);
-                    if (success < 0) {
-                        PrintToConsole("Found a state inconsistency at block height %d. "
-                                "Reverting up to %d blocks.. this may take a few minutes.\n",
-                                curTip->nHeight, (curTip->nHeight - abortRollBackBlock - 1));
-                        break;
-                    }
+                if (fs::exists(GetSnapshotPath(curTip->GetBlockHash()))) {
+                    success = RestoreInMemoryState(curTip->GetBlockHash());
+                } else {
+                    success = MigrateLegacyState(curTip);
+                }
+                if (success < 0) {
+                    PrintToConsole("Found a state inconsistency at block height %d. "
+                            "Reverting up to %d blocks.. this may take a few minutes.\n",
+                            curTip->nHeight, (curTip->nHeight - abortRollBackBlock - 1));
                 }
 
                 if (success >= 0) {
@@ -3,16 +3,26 @@
 
 #include <boost/filesystem.hpp>
 
+#include <stdint.h>
+#include <string>
+
 class CBlockIndex;
+class uint256;
 
 /** Indicates whether persistence is enabled and the state is stored. */
 bool IsPersistenceEnabled(int blockHeight);
 
+/** Marks the balance as changed since the latest snapshot. */
+void MarkSnapshotBalanceChanged(const std::string& address, uint32_t propertyId);
+
+/** Forgets the latest snapshot, so that the next one is a base. */
+void ResetSnapshotDelta();
+
 /** Stores the in-memory state in files. */
 int PersistInMemoryState(const CBlockIndex* pBlockIndex);
 
-/** Loads and retrieves state from a file. */
-int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash = false);
+/** Loads the state as of the given block, from its snapshot and the snapshots it's based on. */
+int RestoreInMemoryState(const uint256& blockHash);
 
 /** Loads and restores the latest state. Returns -1 if reparse is required. */
 int LoadMostRelevantInMemoryState();
@@ -879,20 +879,14 @@ static UniValue omni_getallbalancesforid(const JSONRPCRequest& request)
 
     LOCK(cs_tally);
 
-    for (std::unordered_map<std::string, CMPTally>::iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-        uint32_t id = 0;
-        bool includeAddress = false;
-        std::string address = it->first;
-        (it->second).init();
-        while (0 != (id = (it->second).next())) {
-            if (id == propertyId) {
-                includeAddress = true;
-                break;
-            }
-        }
-        if (!includeAddress) {
-            continue; // ignore this address, has never transacted in this propertyId
-        }
+    // only the addresses which have transacted in this propertyId
+    const CMPPropertyIndex* index = getPropertyIndex(propertyId);
+    if (!index) {
+        return response;
+    }
+
+    for (std::set<std::string>::const_iterator it = index->addresses.begin(); it != index->addresses.end(); ++it) {
+        const std::string& address = *it;
         UniValue balanceObj(UniValue::VOBJ);
         balanceObj.pushKV("address", address);
         bool nonEmptyBalance = BalanceToJSON(address, propertyId, balanceObj, isDivisible);
@@ -1697,14 +1691,16 @@ static UniValue omni_getorderbook(const JSONRPCRequest& request)
     std::vector<CMPMetaDEx> vecMetaDexObjects;
     {
         LOCK(cs_tally);
-        for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-            const md_PricesMap& prices = my_it->second;
-            for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
-                const md_Set& indexes = it->second;
-                for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                    const CMPMetaDEx& obj = *it;
-                    if (obj.getProperty() != propertyIdForSale) continue;
-                    if (!filterDesired || obj.getDesProperty() == propertyIdDesired) vecMetaDexObjects.push_back(obj);
+        const md_PairsMap* pairs = get_Pairs(propertyIdForSale);
+        if (pairs) {
+            for (md_PairsMap::const_iterator pair_it = pairs->begin(); pair_it != pairs->end(); ++pair_it) {
+                if (filterDesired && pair_it->first != propertyIdDesired) continue;
+                const md_PricesMap& prices = pair_it->second;
+                for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+                    const md_Set& indexes = it->second;
+                    for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                        vecMetaDexObjects.push_back(*it);
+                    }
                 }
             }
         }
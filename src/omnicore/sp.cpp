@@ -53,44 +53,6 @@ void CMPCrowd::print(const std::string& address, FILE* fp) const
     fprintf(fp, "%s\n", toString(address).c_str());
 }
 
-void CMPCrowd::saveCrowdSale(std::ofstream& file, SHA256_CTX* shaCtx, const std::string& addr) const
-{
-    // compose the outputline
-    // addr,propertyId,nValue,property_desired,deadline,early_bird,percentage,created,mined
-    std::string lineOut = strprintf("%s,%d,%d,%d,%d,%d,%d,%d,%d",
-            addr,
-            propertyId,
-            nValue,
-            property_desired,
-            deadline,
-            early_bird,
-            percentage,
-            u_created,
-            i_created);
-
-    // append N pairs of address=nValue;blockTime for the database
-    std::map<uint256, std::vector<int64_t> >::const_iterator iter;
-    for (iter = txFundraiserData.begin(); iter != txFundraiserData.end(); ++iter) {
-        lineOut.append(strprintf(",%s=", (*iter).first.GetHex()));
-        std::vector<int64_t> const &vals = (*iter).second;
-
-        std::vector<int64_t>::const_iterator valIter;
-        for (valIter = vals.begin(); valIter != vals.end(); ++valIter) {
-            if (valIter != vals.begin()) {
-                lineOut.append(";");
-            }
-
-            lineOut.append(strprintf("%d", *valIter));
-        }
-    }
-
-    // add the line to the hash
-    SHA256_Update(shaCtx, lineOut.c_str(), lineOut.length());
-
-    // write the line
-    file << lineOut << std::endl;
-}
-
 CMPCrowd* mastercore::getCrowd(const std::string& address)
 {
     AssertLockHeld(cs_tally);
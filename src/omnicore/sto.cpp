@@ -40,11 +40,14 @@ OwnerAddrType STO_GetReceivers(const std::string& sender, uint32_t property, int
 
     {
         LOCK(cs_tally);
-        std::unordered_map<std::string, CMPTally>::iterator it;
-
-        for (it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-            const std::string& address = it->first;
-            const CMPTally& tally = it->second;
+        const CMPPropertyIndex* index = getPropertyIndex(property);
+        std::set<std::string> noAddresses;
+        const std::set<std::string>& addresses = index ? index->addresses : noAddresses;
+
+        // only the addresses with a balance record of the property can hold tokens
+        for (std::set<std::string>::const_iterator it = addresses.begin(); it != addresses.end(); ++it) {
+            const std::string& address = *it;
+            const CMPTally& tally = *getTally(address);
 
             int64_t tokens = 0;
             tokens += tally.getMoney(property, BALANCE);
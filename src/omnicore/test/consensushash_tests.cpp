@@ -0,0 +1,154 @@
+#include <omnicore/consensushash.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+#include <omnicore/test/utils_tally.h>
+
+#include <random.h>
+#include <sync.h>
+#include <test/setup_common.h>
+#include <uint256.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+using namespace mastercore;
+
+namespace
+{
+const int NUM_ADDRESSES = 300;
+
+/** Hashes the whole tally map again, the cached balance records are dropped and built from scratch. */
+uint256 FullConsensusHash() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    ClearBalancesHashCache();
+    return GetConsensusHash();
+}
+
+void FillTallyMap() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    for (int n = 0; n < NUM_ADDRESSES; ++n) {
+        for (uint32_t propertyId : TALLY_TEST_PROPERTIES) {
+            BOOST_CHECK(update_tally_map(GetTallyTestAddress(n), propertyId, 1 + InsecureRandRange(1000000), BALANCE));
+        }
+    }
+}
+
+struct ConsensusHashTestingSetup : public BasicTestingSetup
+{
+    CMPSPInfo spInfo;
+
+    ConsensusHashTestingSetup() : spInfo(GetDataDir() / "MP_spinfo_test", true)
+    {
+        LOCK(cs_tally);
+        pDbSpInfo = &spInfo;
+        clear_tally_map();
+    }
+
+    ~ConsensusHashTestingSetup()
+    {
+        LOCK(cs_tally);
+        clear_tally_map();
+        pDbSpInfo = nullptr;
+    }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_consensushash_tests, ConsensusHashTestingSetup)
+
+BOOST_AUTO_TEST_CASE(consensus_hash_random_updates)
+{
+    LOCK(cs_tally);
+    FillTallyMap();
+    BOOST_CHECK(GetTallyBalanceKeys().size() > 512);
+
+    uint256 hash = GetConsensusHash();
+    BOOST_CHECK(hash == GetConsensusHash()); // nothing has changed
+    BOOST_CHECK(hash == FullConsensusHash());
+
+    for (int batch = 0; batch < 20; ++batch) {
+        // the second hash of the batch resumes from the states saved by the first one
+        ApplyRandomTallyUpdates(NUM_ADDRESSES, 50);
+        uint256 hashFirst = GetConsensusHash();
+        ApplyRandomTallyUpdates(NUM_ADDRESSES, 50);
+        uint256 hashSecond = GetConsensusHash();
+        BOOST_CHECK(hashSecond == FullConsensusHash());
+
+        // the pending tally isn't hashed
+        BOOST_CHECK(update_tally_map(GetTallyTestAddress(0), 3, 1000, PENDING));
+        BOOST_CHECK(hashSecond == GetConsensusHash());
+        BOOST_CHECK(update_tally_map(GetTallyTestAddress(0), 3, -1000, PENDING));
+        BOOST_CHECK(hashFirst != hashSecond);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(consensus_hash_state_boundaries)
+{
+    LOCK(cs_tally);
+    FillTallyMap();
+    GetConsensusHash();
+
+    // a record in front of the first saved state
+    BOOST_CHECK(update_tally_map("0ConsensusHashTestAddress", 3, 1000, BALANCE));
+    BOOST_CHECK(GetConsensusHash() == FullConsensusHash());
+    // and the first record becomes empty
+    EmptyTallyBalance(GetTallyBalanceKeys().front());
+    BOOST_CHECK(GetConsensusHash() == FullConsensusHash());
+
+    // the records the states are saved at, and their neighbours
+    for (size_t index : {255, 256, 257, 511, 512, 513}) {
+        std::vector<TallyBalanceKey> keys = GetTallyBalanceKeys();
+        BOOST_REQUIRE(index < keys.size());
+        BOOST_CHECK(update_tally_map(keys[index].first, keys[index].second, 7, METADEX_RESERVE));
+        BOOST_CHECK(GetConsensusHash() == FullConsensusHash());
+
+        // a record inserted right before it shifts the following records
+        keys = GetTallyBalanceKeys();
+        BOOST_CHECK(update_tally_map(keys[index].first, 2, 1000, BALANCE));
+        BOOST_CHECK(GetConsensusHash() == FullConsensusHash());
+
+        // the record becomes empty, the saved state may be keyed by the removed record
+        keys = GetTallyBalanceKeys();
+        EmptyTallyBalance(keys[index]);
+        BOOST_CHECK(GetConsensusHash() == FullConsensusHash());
+    }
+
+    // the last record, nothing follows it
+    EmptyTallyBalance(GetTallyBalanceKeys().back());
+    BOOST_CHECK(GetConsensusHash() == FullConsensusHash());
+    BOOST_CHECK(update_tally_map("9ConsensusHashTestAddress", 3, 1000, BALANCE));
+    BOOST_CHECK(GetConsensusHash() == FullConsensusHash());
+
+    // several changes spread over the states at once
+    std::vector<TallyBalanceKey> keys = GetTallyBalanceKeys();
+    for (size_t index = 0; index < keys.size(); index += 97) {
+        BOOST_CHECK(update_tally_map(keys[index].first, keys[index].second, 1, BALANCE));
+    }
+    BOOST_CHECK(GetConsensusHash() == FullConsensusHash());
+}
+
+BOOST_AUTO_TEST_CASE(consensus_hash_clear_tally_map)
+{
+    LOCK(cs_tally);
+    uint256 hashEmpty = FullConsensusHash();
+
+    FillTallyMap();
+    uint256 hashFilled = GetConsensusHash();
+    BOOST_CHECK(hashFilled != hashEmpty);
+
+    // the cache is dropped with the tally map
+    clear_tally_map();
+    BOOST_CHECK(GetConsensusHash() == hashEmpty);
+
+    // and built again by the next hash
+    FillTallyMap();
+    ApplyRandomTallyUpdates(NUM_ADDRESSES, 100);
+    uint256 hash = GetConsensusHash();
+    BOOST_CHECK(hash == FullConsensusHash());
+    ApplyRandomTallyUpdates(NUM_ADDRESSES, 100);
+    BOOST_CHECK(GetConsensusHash() == FullConsensusHash());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,168 @@
+#include <omnicore/consensushash.h>
+#include <omnicore/createpayload.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/test/utils_tally.h>
+
+#include <amount.h>
+#include <index/txindex.h>
+#include <primitives/transaction.h>
+#include <script/interpreter.h>
+#include <script/script.h>
+#include <script/standard.h>
+#include <sync.h>
+#include <test/setup_common.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <util/memory.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+using namespace mastercore;
+
+namespace
+{
+const int NUM_SENDERS = 8;
+
+/** The redeem script of a sender, which can be spent by anyone. */
+CScript GetSenderRedeemScript(int n)
+{
+    return CScript() << n << OP_DROP << OP_TRUE;
+}
+
+CScript GetSenderScript(int n)
+{
+    return GetScriptForDestination(ScriptHash(GetSenderRedeemScript(n)));
+}
+
+CTxOut OpReturn_Payload(const std::vector<unsigned char>& vchPayload)
+{
+    std::vector<unsigned char> vchData = GetOmMarker();
+    vchData.insert(vchData.end(), vchPayload.begin(), vchPayload.end());
+
+    return CTxOut(0, CScript() << OP_RETURN << vchData);
+}
+
+struct InitialScanTestingSetup : public TestChain100Setup
+{
+    InitialScanTestingSetup()
+    {
+        gArgs.ForceSetArg("-omnistartclean", "1");
+        gArgs.ForceSetArg("-omniseedblockfilter", "0");
+
+        g_txindex = MakeUnique<TxIndex>(1 << 20, true);
+        g_txindex->Start();
+    }
+
+    ~InitialScanTestingSetup()
+    {
+        g_txindex->Stop();
+        g_txindex.reset();
+    }
+
+    /** Pays the first mature coinbase to the senders, each of them spends its coins in the following blocks. */
+    void CreateOmniBlocks(int nRounds)
+    {
+        const CTransactionRef& coinbase = m_coinbase_txns[0];
+        const CScript& coinbaseScript = coinbase->vout[0].scriptPubKey;
+        CAmount nValue = coinbase->vout[0].nValue / (NUM_SENDERS + 1);
+
+        CMutableTransaction funding;
+        funding.vin.resize(1);
+        funding.vin[0].prevout = COutPoint(coinbase->GetHash(), 0);
+        for (int n = 0; n < NUM_SENDERS; ++n) {
+            funding.vout.push_back(CTxOut(nValue, GetSenderScript(n)));
+        }
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(coinbaseScript, funding, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        funding.vin[0].scriptSig << vchSig;
+        CreateAndProcessBlock({funding}, coinbaseScript);
+
+        std::vector<COutPoint> prevouts;
+        for (int n = 0; n < NUM_SENDERS; ++n) {
+            prevouts.push_back(COutPoint(funding.GetHash(), n));
+        }
+
+        for (int nRound = 0; nRound < nRounds; ++nRound) {
+            std::vector<CMutableTransaction> txns;
+            nValue -= NUM_SENDERS * CENT;
+            BOOST_REQUIRE(nValue > 0);
+            for (int n = 0; n < NUM_SENDERS; ++n) {
+                CScript redeemScript = GetSenderRedeemScript(n);
+                CMutableTransaction tx;
+                tx.vin.resize(1);
+                tx.vin[0].prevout = prevouts[n];
+                tx.vin[0].scriptSig << std::vector<unsigned char>(redeemScript.begin(), redeemScript.end());
+                if (nRound == 0) {
+                    // Exodus purchase, the amount depends on the sender
+                    tx.vout.push_back(OpReturn_Payload({}));
+                    tx.vout.push_back(CTxOut((n + 1) * CENT, GetScriptForDestination(ExodusAddress())));
+                } else {
+                    // a simple send to the next sender, the senders without enough tokens fail
+                    tx.vout.push_back(OpReturn_Payload(CreatePayload_SimpleSend(OMNI_PROPERTY_MSC, (n + nRound) * COIN)));
+                    tx.vout.push_back(CTxOut((n + 1) * CENT, GetSenderScript((n + 1) % NUM_SENDERS)));
+                }
+                tx.vout.push_back(CTxOut(nValue, GetSenderScript(n)));
+                prevouts[n] = COutPoint(tx.GetHash(), tx.vout.size() - 1);
+                txns.push_back(tx);
+            }
+            CreateAndProcessBlock(txns, coinbaseScript);
+        }
+
+        constexpr int64_t timeout_ms = 10 * 1000;
+        int64_t time_start = GetTimeMillis();
+        while (!g_txindex->BlockUntilSyncedToCurrentChain()) {
+            BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+            MilliSleep(100);
+        }
+    }
+
+    /** Parses the whole chain from scratch with the given number of reader threads. */
+    void Scan(int nThreads, uint256& consensusHash, TallyBalanceMap& balances)
+    {
+        gArgs.ForceSetArg("-omniscanthreads", strprintf("%d", nThreads));
+
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(mastercore_init(), 0);
+        {
+            LOCK(cs_tally);
+            consensusHash = GetConsensusHash();
+            balances = GetTallyBalances();
+        }
+        BOOST_CHECK_EQUAL(mastercore_shutdown(), 0);
+    }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_initial_scan_tests, InitialScanTestingSetup)
+
+BOOST_AUTO_TEST_CASE(initial_scan_reader_threads)
+{
+    CreateOmniBlocks(4);
+
+    // the readers only read ahead, the state is the same as the one of the scan without them
+    uint256 hashThreads, hashInline;
+    TallyBalanceMap balancesThreads, balancesInline;
+    Scan(4, hashThreads, balancesThreads);
+    Scan(0, hashInline, balancesInline);
+
+    BOOST_CHECK(balancesThreads.size() >= NUM_SENDERS);
+    BOOST_CHECK(hashThreads == hashInline);
+    BOOST_CHECK(balancesThreads == balancesInline);
+
+    // the readers wait for the blocks, even if there are more readers than blocks to read
+    uint256 hashMoreThreads;
+    TallyBalanceMap balancesMoreThreads;
+    Scan(16, hashMoreThreads, balancesMoreThreads);
+    BOOST_CHECK(hashMoreThreads == hashInline);
+    BOOST_CHECK(balancesMoreThreads == balancesInline);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,256 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+#include <omnicore/tx.h>
+
+#include <random.h>
+#include <sync.h>
+#include <test/setup_common.h>
+#include <tinyformat.h>
+#include <uint256.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace mastercore;
+
+namespace
+{
+const std::string ADDRESS_A = "1MetaDExCancelTestAddressA";
+const std::string ADDRESS_B = "1MetaDExCancelTestAddressB";
+
+struct MetaDExCancelTestingSetup : public BasicTestingSetup
+{
+    CMPSPInfo spInfo;
+    CMPTxList txList;
+
+    MetaDExCancelTestingSetup()
+      : spInfo(GetDataDir() / "MP_spinfo_test", true),
+        txList(GetDataDir() / "MP_txlist_test", true)
+    {
+        LOCK(cs_tally);
+        pDbSpInfo = &spInfo;
+        pDbTransactionList = &txList;
+        clear_tally_map();
+        metadex.clear();
+    }
+
+    ~MetaDExCancelTestingSetup()
+    {
+        LOCK(cs_tally);
+        clear_tally_map();
+        metadex.clear();
+        pDbTransactionList = nullptr;
+        pDbSpInfo = nullptr;
+    }
+};
+
+/** Puts an order into the book, the amount for sale is moved into the reserve of the address. */
+uint256 AddOrder(const std::string& address, int block, unsigned int idx, uint32_t property, int64_t amount,
+        uint32_t propertyDesired, int64_t amountDesired) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    uint256 txid = InsecureRand256();
+    BOOST_CHECK(MetaDEx_INSERT(CMPMetaDEx(address, block, property, amount, propertyDesired, amountDesired, txid, idx, CMPTransaction::ADD)));
+    BOOST_CHECK(update_tally_map(address, property, amount, METADEX_RESERVE));
+
+    return txid;
+}
+
+/** The cancellations recorded for the cancel transaction, in the order they were recorded. */
+std::vector<std::string> GetCancelRecords(const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    std::vector<std::string> records;
+    int numberOfCancels = pDbTransactionList->getNumberOfMetaDExCancels(txid);
+    for (int refNumber = 1; refNumber <= numberOfCancels; ++refNumber) {
+        records.push_back(pDbTransactionList->getKeyValue(txid.ToString() + "-C" + strprintf("%d", refNumber)));
+    }
+
+    return records;
+}
+
+std::string CancelRecord(const uint256& txidOrder, uint32_t property, int64_t amount)
+{
+    return strprintf("%s:%d:%d", txidOrder.ToString(), property, amount);
+}
+
+size_t CountOrders(uint32_t property, uint32_t propertyDesired) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    size_t nOrders = 0;
+    md_PricesMap* prices = get_Prices(property, propertyDesired);
+    if (prices) {
+        for (md_PricesMap::const_iterator it = prices->begin(); it != prices->end(); ++it) {
+            nOrders += it->second.size();
+        }
+    }
+
+    return nOrders;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_mdex_cancel_tests, MetaDExCancelTestingSetup)
+
+BOOST_AUTO_TEST_CASE(mdex_cancel_at_price)
+{
+    LOCK(cs_tally);
+    uint256 txidFirst = AddOrder(ADDRESS_A, 11, 1, 3, 100, 1, 200);
+    uint256 txidSecond = AddOrder(ADDRESS_A, 10, 2, 3, 50, 1, 100);
+    uint256 txidOther = AddOrder(ADDRESS_A, 10, 3, 3, 100, 1, 100);
+    uint256 txidB = AddOrder(ADDRESS_B, 9, 1, 3, 100, 1, 200);
+
+    // only the orders of the address at the price are cancelled, ordered by block and index
+    uint256 txidCancel = InsecureRand256();
+    BOOST_CHECK_EQUAL(MetaDEx_CANCEL_AT_PRICE(txidCancel, 20, ADDRESS_A, 3, 10, 1, 20), 0);
+    std::vector<std::string> expected = {CancelRecord(txidSecond, 3, 50), CancelRecord(txidFirst, 3, 100)};
+    BOOST_CHECK(GetCancelRecords(txidCancel) == expected);
+
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 3, BALANCE), 150);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 3, METADEX_RESERVE), 100);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_B, 3, METADEX_RESERVE), 100);
+    BOOST_CHECK(MetaDEx_isOpen(txidOther, 3));
+    BOOST_CHECK(MetaDEx_isOpen(txidB, 3));
+    BOOST_CHECK(!MetaDEx_isOpen(txidFirst, 3));
+
+    // the emptied price level is removed, the book of the pair is kept for the order of the other address
+    txidCancel = InsecureRand256();
+    BOOST_CHECK_EQUAL(MetaDEx_CANCEL_AT_PRICE(txidCancel, 21, ADDRESS_A, 3, 100, 1, 100), 0);
+    BOOST_CHECK_EQUAL(GetCancelRecords(txidCancel).size(), 1U);
+    BOOST_REQUIRE(get_Prices(3, 1));
+    BOOST_CHECK(!get_Indexes(get_Prices(3, 1), rational_t(1, 1)));
+    BOOST_CHECK_EQUAL(get_Prices(3, 1)->size(), 1U);
+
+    // nothing left at the price for the address
+    txidCancel = InsecureRand256();
+    BOOST_CHECK(MetaDEx_CANCEL_AT_PRICE(txidCancel, 22, ADDRESS_A, 3, 100, 1, 200) != 0);
+    BOOST_CHECK(GetCancelRecords(txidCancel).empty());
+
+    // the last order empties the book of the pair
+    BOOST_CHECK_EQUAL(MetaDEx_CANCEL_AT_PRICE(InsecureRand256(), 23, ADDRESS_B, 3, 100, 1, 200), 0);
+    BOOST_CHECK(!get_Prices(3, 1));
+    BOOST_CHECK(metadex.empty());
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_B, 3, BALANCE), 100);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_B, 3, METADEX_RESERVE), 0);
+}
+
+BOOST_AUTO_TEST_CASE(mdex_cancel_all_for_pair)
+{
+    LOCK(cs_tally);
+    uint256 txidHigh = AddOrder(ADDRESS_A, 10, 1, 3, 100, 1, 300);
+    uint256 txidLow = AddOrder(ADDRESS_A, 11, 1, 3, 200, 1, 200);
+    uint256 txidMid = AddOrder(ADDRESS_A, 12, 1, 3, 300, 1, 600);
+    uint256 txidOtherPair = AddOrder(ADDRESS_A, 13, 1, 3, 400, 4, 400);
+    uint256 txidB = AddOrder(ADDRESS_B, 14, 1, 4, 500, 3, 500);
+
+    // the orders of the pair are cancelled ordered by price
+    uint256 txidCancel = InsecureRand256();
+    BOOST_CHECK_EQUAL(MetaDEx_CANCEL_ALL_FOR_PAIR(txidCancel, 20, ADDRESS_A, 3, 1), 0);
+    std::vector<std::string> expected = {CancelRecord(txidLow, 3, 200), CancelRecord(txidMid, 3, 300), CancelRecord(txidHigh, 3, 100)};
+    BOOST_CHECK(GetCancelRecords(txidCancel) == expected);
+
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 3, BALANCE), 600);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 3, METADEX_RESERVE), 400);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_B, 4, METADEX_RESERVE), 500);
+
+    // the book of the pair is removed, the other books of the property are kept
+    BOOST_CHECK(!get_Prices(3, 1));
+    BOOST_CHECK(MetaDEx_isOpen(txidOtherPair, 3));
+    BOOST_CHECK(MetaDEx_isOpen(txidB, 4));
+    BOOST_CHECK_EQUAL(metadex.size(), 2U);
+
+    // there is no book for the pair anymore
+    BOOST_CHECK(MetaDEx_CANCEL_ALL_FOR_PAIR(InsecureRand256(), 21, ADDRESS_A, 3, 1) != 0);
+
+    BOOST_CHECK_EQUAL(MetaDEx_CANCEL_ALL_FOR_PAIR(InsecureRand256(), 22, ADDRESS_A, 3, 4), 0);
+    BOOST_CHECK(!get_Pairs(3));
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 3, BALANCE), 1000);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 3, METADEX_RESERVE), 0);
+}
+
+BOOST_AUTO_TEST_CASE(mdex_cancel_everything)
+{
+    LOCK(cs_tally);
+    uint256 txidProperty1 = AddOrder(ADDRESS_A, 30, 1, 1, 100, 3, 500);
+    uint256 txidPair1High = AddOrder(ADDRESS_A, 10, 1, 3, 100, 1, 200);
+    uint256 txidPair4High = AddOrder(ADDRESS_A, 9, 1, 3, 200, 4, 400);
+    uint256 txidPair1Low = AddOrder(ADDRESS_A, 11, 1, 3, 300, 1, 300);
+    uint256 txidPair4Low = AddOrder(ADDRESS_A, 11, 0, 3, 400, 4, 400);
+    uint256 txidB = AddOrder(ADDRESS_B, 8, 1, 3, 100, 1, 300);
+    uint256 txidTest = AddOrder(ADDRESS_A, 12, 1, TEST_ECO_PROPERTY_1, 100, OMNI_PROPERTY_TMSC, 100);
+
+    // the orders of each property are cancelled ordered by price, then by block and index, regardless of the pair
+    uint256 txidCancel = InsecureRand256();
+    BOOST_CHECK_EQUAL(MetaDEx_CANCEL_EVERYTHING(txidCancel, 40, ADDRESS_A, OMNI_PROPERTY_MSC), 0);
+    std::vector<std::string> expected = {
+        CancelRecord(txidProperty1, 1, 100),
+        CancelRecord(txidPair4Low, 3, 400),
+        CancelRecord(txidPair1Low, 3, 300),
+        CancelRecord(txidPair4High, 3, 200),
+        CancelRecord(txidPair1High, 3, 100),
+    };
+    BOOST_CHECK(GetCancelRecords(txidCancel) == expected);
+
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 1, BALANCE), 100);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 1, METADEX_RESERVE), 0);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 3, BALANCE), 1000);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 3, METADEX_RESERVE), 0);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, TEST_ECO_PROPERTY_1, METADEX_RESERVE), 100);
+
+    // the emptied books and properties are removed, the other address and ecosystem are untouched
+    BOOST_CHECK(!get_Pairs(1));
+    BOOST_CHECK(!get_Prices(3, 4));
+    BOOST_CHECK_EQUAL(CountOrders(3, 1), 1U);
+    BOOST_CHECK_EQUAL(get_Prices(3, 1)->size(), 1U);
+    BOOST_CHECK(MetaDEx_isOpen(txidB, 3));
+    BOOST_CHECK(MetaDEx_isOpen(txidTest, TEST_ECO_PROPERTY_1));
+
+    txidCancel = InsecureRand256();
+    BOOST_CHECK_EQUAL(MetaDEx_CANCEL_EVERYTHING(txidCancel, 41, ADDRESS_A, OMNI_PROPERTY_TMSC), 0);
+    expected = {CancelRecord(txidTest, TEST_ECO_PROPERTY_1, 100)};
+    BOOST_CHECK(GetCancelRecords(txidCancel) == expected);
+    BOOST_CHECK(!get_Pairs(TEST_ECO_PROPERTY_1));
+    BOOST_CHECK_EQUAL(metadex.size(), 1U);
+
+    // nothing left for the address
+    txidCancel = InsecureRand256();
+    BOOST_CHECK(MetaDEx_CANCEL_EVERYTHING(txidCancel, 42, ADDRESS_A, OMNI_PROPERTY_MSC) != 0);
+    BOOST_CHECK(GetCancelRecords(txidCancel).empty());
+}
+
+BOOST_AUTO_TEST_CASE(mdex_shutdown_allpair)
+{
+    LOCK(cs_tally);
+    uint256 txidOmni = AddOrder(ADDRESS_A, 10, 1, 3, 100, OMNI_PROPERTY_MSC, 100);
+    uint256 txidToOmni = AddOrder(ADDRESS_B, 10, 2, OMNI_PROPERTY_MSC, 100, 3, 100);
+    uint256 txidTestOmni = AddOrder(ADDRESS_B, 10, 3, TEST_ECO_PROPERTY_1, 100, OMNI_PROPERTY_TMSC, 100);
+    uint256 txidPair = AddOrder(ADDRESS_A, 11, 1, 3, 200, 4, 200);
+    uint256 txidPairOther = AddOrder(ADDRESS_A, 11, 2, 3, 300, 5, 600);
+    uint256 txidInverse = AddOrder(ADDRESS_B, 12, 1, 4, 400, 3, 400);
+
+    // the orders without OMN or TOMN on either side are removed and their reserves are released
+    BOOST_CHECK_EQUAL(MetaDEx_SHUTDOWN_ALLPAIR(), 0);
+    BOOST_CHECK(!MetaDEx_isOpen(txidPair, 3));
+    BOOST_CHECK(!MetaDEx_isOpen(txidPairOther, 3));
+    BOOST_CHECK(!MetaDEx_isOpen(txidInverse, 4));
+    BOOST_CHECK(MetaDEx_isOpen(txidOmni, 3));
+    BOOST_CHECK(MetaDEx_isOpen(txidToOmni, OMNI_PROPERTY_MSC));
+    BOOST_CHECK(MetaDEx_isOpen(txidTestOmni, TEST_ECO_PROPERTY_1));
+
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 3, BALANCE), 500);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_A, 3, METADEX_RESERVE), 100);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_B, 4, BALANCE), 400);
+    BOOST_CHECK_EQUAL(GetTokenBalance(ADDRESS_B, 4, METADEX_RESERVE), 0);
+
+    // the emptied books and properties are removed
+    BOOST_CHECK(!get_Prices(3, 4));
+    BOOST_CHECK(!get_Prices(3, 5));
+    BOOST_CHECK(!get_Pairs(4));
+    BOOST_CHECK_EQUAL(get_Pairs(3)->size(), 1U);
+    BOOST_CHECK_EQUAL(metadex.size(), 3U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
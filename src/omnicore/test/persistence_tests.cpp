@@ -0,0 +1,322 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dex.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/persistence.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+#include <omnicore/test/utils_tally.h>
+#include <omnicore/tx.h>
+
+#include <chain.h>
+#include <fs.h>
+#include <hash.h>
+#include <random.h>
+#include <script/script.h>
+#include <sync.h>
+#include <test/setup_common.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern int64_t exodus_prev;
+extern fs::path pathStateFiles;
+
+using namespace mastercore;
+
+namespace
+{
+const int NUM_ADDRESSES = 40;
+
+CBlockIndex* GetChainBlock(int nHeight)
+{
+    LOCK(cs_main);
+    return ::ChainActive()[nHeight];
+}
+
+fs::path GetSnapshotPath(const CBlockIndex* pBlockIndex)
+{
+    return pathStateFiles / strprintf("snapshot-%s.dat", pBlockIndex->GetBlockHash().ToString());
+}
+
+size_t CountMetaDExOrders() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    size_t nOrders = 0;
+    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        for (md_PairsMap::const_iterator pair_it = my_it->second.begin(); pair_it != my_it->second.end(); ++pair_it) {
+            for (md_PricesMap::const_iterator it = pair_it->second.begin(); it != pair_it->second.end(); ++it) {
+                nOrders += it->second.size();
+            }
+        }
+    }
+    return nOrders;
+}
+
+/** Writes a text state file of the previous versions, with the double SHA256 of its lines. */
+void WriteLegacyFile(const std::string& prefix, const uint256& blockHash, const std::vector<std::string>& lines,
+                     bool fValidHash = true)
+{
+    std::string content;
+    for (const std::string& line : lines) {
+        content += line;
+    }
+    uint256 hash = Hash(content.begin(), content.end());
+    if (!fValidHash) hash = InsecureRand256();
+
+    std::ofstream file((pathStateFiles / strprintf("%s-%s.dat", prefix, blockHash.ToString())).string().c_str());
+    for (const std::string& line : lines) {
+        file << line << std::endl;
+    }
+    file << "!" << hash.ToString() << std::endl;
+}
+
+bool HasLegacyFiles()
+{
+    for (fs::directory_iterator it(pathStateFiles); it != fs::directory_iterator(); ++it) {
+        if (it->path().filename().string().compare(0, 9, "snapshot-") != 0) return true;
+    }
+    return false;
+}
+
+struct PersistenceTestingSetup : public TestChain100Setup
+{
+    CMPSPInfo spInfo;
+
+    PersistenceTestingSetup() : spInfo(GetDataDir() / "MP_spinfo_test", true)
+    {
+        pathStateFiles = GetDataDir() / "MP_persist_test";
+        fs::create_directories(pathStateFiles);
+
+        LOCK(cs_tally);
+        pDbSpInfo = &spInfo;
+        clear_tally_map();
+    }
+
+    ~PersistenceTestingSetup()
+    {
+        LOCK(cs_tally);
+        clear_tally_map();
+        my_offers.clear();
+        my_accepts.clear();
+        my_crowds.clear();
+        metadex.clear();
+        exodus_prev = 0;
+        pDbSpInfo = nullptr;
+    }
+
+    /** Persists the state of the blocks in the range, after random updates, and records the balances of each. */
+    void PersistBlocks(int nFirst, int nLast, std::map<int, TallyBalanceMap>& balances) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+    {
+        for (int nHeight = nFirst; nHeight <= nLast; ++nHeight) {
+            ApplyRandomTallyUpdates(NUM_ADDRESSES, 20);
+            balances[nHeight] = GetTallyBalances();
+            BOOST_REQUIRE(PersistInMemoryState(GetChainBlock(nHeight)) == 0);
+        }
+    }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_persistence_tests, PersistenceTestingSetup)
+
+BOOST_AUTO_TEST_CASE(persistence_base_snapshot)
+{
+    LOCK2(cs_main, cs_tally);
+    ApplyRandomTallyUpdates(NUM_ADDRESSES, 200);
+    TallyBalanceMap balances = GetTallyBalances();
+    uint256 txidOffer = InsecureRand256();
+    my_offers.insert(std::make_pair(STR_SELLOFFER_ADDR_PROP_COMBO(GetTallyTestAddress(1), 3),
+            CMPOffer(10, 5000, 3, 70000, 10000, 6, txidOffer)));
+    BOOST_CHECK(MetaDEx_INSERT(CMPMetaDEx(GetTallyTestAddress(2), 20, 3, 100, 1, 200, InsecureRand256(), 1, CMPTransaction::ADD)));
+    exodus_prev = 12345;
+    spInfo.init(7, TEST_ECO_PROPERTY_1 + 2);
+
+    CBlockIndex* pBlockIndex = GetChainBlock(10);
+    BOOST_CHECK(PersistInMemoryState(pBlockIndex) == 0);
+    BOOST_CHECK(fs::exists(GetSnapshotPath(pBlockIndex)));
+
+    clear_tally_map();
+    my_offers.clear();
+    metadex.clear();
+    exodus_prev = 0;
+    spInfo.init();
+
+    BOOST_CHECK(RestoreInMemoryState(pBlockIndex->GetBlockHash()) == 0);
+    BOOST_CHECK(GetTallyBalances() == balances);
+    BOOST_CHECK_EQUAL(my_offers.size(), 1U);
+    BOOST_CHECK(my_offers.begin()->second.getHash() == txidOffer);
+    BOOST_CHECK_EQUAL(my_offers.begin()->second.getOfferAmountOriginal(), 5000);
+    BOOST_CHECK_EQUAL(CountMetaDExOrders(), 1U);
+    BOOST_CHECK_EQUAL(exodus_prev, 12345);
+    BOOST_CHECK_EQUAL(spInfo.peekNextSPID(OMNI_PROPERTY_MSC), 7U);
+    BOOST_CHECK_EQUAL(spInfo.peekNextSPID(OMNI_PROPERTY_TMSC), TEST_ECO_PROPERTY_1 + 2);
+}
+
+BOOST_AUTO_TEST_CASE(persistence_delta_chain)
+{
+    LOCK2(cs_main, cs_tally);
+    std::map<int, TallyBalanceMap> balances;
+    PersistBlocks(1, 5, balances);
+
+    // a balance is emptied in a delta, it must not come back from the snapshots before
+    BOOST_CHECK(update_tally_map(GetTallyTestAddress(0), 3, 1000, BALANCE));
+    BOOST_CHECK(update_tally_map(GetTallyTestAddress(0), 3, 500, METADEX_RESERVE));
+    balances[6] = GetTallyBalances();
+    BOOST_CHECK(PersistInMemoryState(GetChainBlock(6)) == 0);
+    EmptyTallyBalance(std::make_pair(GetTallyTestAddress(0), 3U));
+    balances[7] = GetTallyBalances();
+    BOOST_CHECK(PersistInMemoryState(GetChainBlock(7)) == 0);
+    PersistBlocks(8, 12, balances);
+    BOOST_CHECK(balances[6].count(std::make_pair(GetTallyTestAddress(0), 3U)));
+    BOOST_CHECK(!balances[7].count(std::make_pair(GetTallyTestAddress(0), 3U)));
+
+    for (int nHeight = 12; nHeight > 0; --nHeight) {
+        BOOST_CHECK(RestoreInMemoryState(GetChainBlock(nHeight)->GetBlockHash()) == 0);
+        BOOST_CHECK(GetTallyBalances() == balances[nHeight]);
+    }
+
+    // the restored state is the parent of the next delta
+    ApplyRandomTallyUpdates(NUM_ADDRESSES, 20);
+    balances[2] = GetTallyBalances();
+    BOOST_CHECK(PersistInMemoryState(GetChainBlock(2)) == 0);
+    clear_tally_map();
+    BOOST_CHECK(RestoreInMemoryState(GetChainBlock(2)->GetBlockHash()) == 0);
+    BOOST_CHECK(GetTallyBalances() == balances[2]);
+}
+
+BOOST_AUTO_TEST_CASE(persistence_rejects_damaged_files)
+{
+    LOCK2(cs_main, cs_tally);
+    std::map<int, TallyBalanceMap> balances;
+    PersistBlocks(1, 3, balances);
+
+    // a flipped byte fails the checksum, and the in-memory state is left as it is
+    fs::path pathBase = GetSnapshotPath(GetChainBlock(1));
+    {
+        std::fstream file(pathBase.string().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(fs::file_size(pathBase) / 2);
+        char ch = file.get();
+        file.seekp(fs::file_size(pathBase) / 2);
+        file.put(ch ^ 0x01);
+    }
+    BOOST_CHECK(RestoreInMemoryState(GetChainBlock(1)->GetBlockHash()) < 0);
+    BOOST_CHECK(RestoreInMemoryState(GetChainBlock(3)->GetBlockHash()) < 0);
+    BOOST_CHECK(GetTallyBalances() == balances[3]);
+
+    // a truncated file
+    fs::path pathDelta = GetSnapshotPath(GetChainBlock(3));
+    fs::resize_file(pathDelta, fs::file_size(pathDelta) - 10);
+    BOOST_CHECK(RestoreInMemoryState(GetChainBlock(3)->GetBlockHash()) < 0);
+
+    // a delta without its base
+    fs::remove(pathBase);
+    BOOST_CHECK(RestoreInMemoryState(GetChainBlock(2)->GetBlockHash()) < 0);
+    BOOST_CHECK(GetTallyBalances() == balances[3]);
+
+    // a snapshot renamed to another block
+    clear_tally_map();
+    PersistBlocks(4, 4, balances);
+    fs::rename(GetSnapshotPath(GetChainBlock(4)), GetSnapshotPath(GetChainBlock(5)));
+    BOOST_CHECK(RestoreInMemoryState(GetChainBlock(5)->GetBlockHash()) < 0);
+}
+
+BOOST_AUTO_TEST_CASE(persistence_delta_rollover)
+{
+    LOCK2(cs_main, cs_tally);
+    std::map<int, TallyBalanceMap> balances;
+    PersistBlocks(0, 60, balances);
+
+    // the genesis snapshot is a base, the 50 following snapshots are deltas and the next one is a base again
+    fs::remove(GetSnapshotPath(GetChainBlock(0)));
+    BOOST_CHECK(RestoreInMemoryState(GetChainBlock(50)->GetBlockHash()) < 0);
+    BOOST_CHECK(RestoreInMemoryState(GetChainBlock(51)->GetBlockHash()) == 0);
+    BOOST_CHECK(GetTallyBalances() == balances[51]);
+    BOOST_CHECK(RestoreInMemoryState(GetChainBlock(60)->GetBlockHash()) == 0);
+    BOOST_CHECK(GetTallyBalances() == balances[60]);
+}
+
+BOOST_AUTO_TEST_CASE(persistence_restore_after_pruning)
+{
+    LOCK2(cs_main, cs_tally);
+    std::map<int, TallyBalanceMap> balances;
+    PersistBlocks(0, 44, balances);
+    // the next snapshot is a base, as after a reorganization
+    ResetSnapshotDelta();
+    PersistBlocks(45, 100, balances);
+
+    // the snapshots older than MAX_STATE_HISTORY blocks are removed, unless a kept delta is based on them
+    BOOST_CHECK(fs::exists(GetSnapshotPath(GetChainBlock(0))));
+    for (int nHeight = 1; nHeight <= 44; ++nHeight) {
+        BOOST_CHECK(!fs::exists(GetSnapshotPath(GetChainBlock(nHeight))));
+    }
+    for (int nHeight = 45; nHeight <= 100; ++nHeight) {
+        BOOST_CHECK(fs::exists(GetSnapshotPath(GetChainBlock(nHeight))));
+    }
+
+    BOOST_CHECK(RestoreInMemoryState(GetChainBlock(30)->GetBlockHash()) < 0);
+    for (int nHeight : {0, 45, 49, 50, 95, 96, 100}) {
+        BOOST_CHECK(RestoreInMemoryState(GetChainBlock(nHeight)->GetBlockHash()) == 0);
+        BOOST_CHECK(GetTallyBalances() == balances[nHeight]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(persistence_legacy_migration)
+{
+    // the state is only loaded above the Omni genesis block of regtest
+    CreateAndProcessBlock({}, CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG);
+
+    LOCK2(cs_main, cs_tally);
+    CBlockIndex* pBlockIndex = ::ChainActive().Tip();
+    const uint256 blockHash = pBlockIndex->GetBlockHash();
+    const uint256 txidOffer = InsecureRand256();
+    const uint256 txidOrder = InsecureRand256();
+
+    WriteLegacyFile("balances", blockHash, {
+            strprintf("%s=1:1000,0,0,0;3:500,20,0,0;", GetTallyTestAddress(1)),
+            strprintf("%s=3:0,0,0,77;", GetTallyTestAddress(2))}, false);
+    WriteLegacyFile("offers", blockHash, {strprintf("%s,90,20,3,1000,0,10000,6,%s", GetTallyTestAddress(1), txidOffer.GetHex())});
+    WriteLegacyFile("accepts", blockHash, {});
+    WriteLegacyFile("globals", blockHash, {strprintf("12345,7,%d", TEST_ECO_PROPERTY_1 + 2)});
+    WriteLegacyFile("crowdsales", blockHash, {});
+    WriteLegacyFile("mdexorders", blockHash, {strprintf("%s,95,77,3,100,1,1,2,%s,77", GetTallyTestAddress(2), txidOrder.GetHex())});
+
+    // a file failing its hash triggers a reparse, and the files are kept
+    spInfo.setWatermark(blockHash);
+    BOOST_CHECK(LoadMostRelevantInMemoryState() < 0);
+    BOOST_CHECK(HasLegacyFiles());
+    BOOST_CHECK(!fs::exists(GetSnapshotPath(pBlockIndex)));
+
+    WriteLegacyFile("balances", blockHash, {
+            strprintf("%s=1:1000,0,0,0;3:500,20,0,0;", GetTallyTestAddress(1)),
+            strprintf("%s=3:0,0,0,77;", GetTallyTestAddress(2))});
+    spInfo.setWatermark(blockHash);
+    BOOST_CHECK_EQUAL(LoadMostRelevantInMemoryState(), pBlockIndex->nHeight);
+
+    TallyBalanceMap balances = GetTallyBalances();
+    BOOST_CHECK_EQUAL(balances.size(), 3U);
+    BOOST_CHECK(balances[std::make_pair(GetTallyTestAddress(1), 1U)] == std::vector<int64_t>({1000, 0, 0, 0}));
+    BOOST_CHECK(balances[std::make_pair(GetTallyTestAddress(1), 3U)] == std::vector<int64_t>({500, 20, 0, 0}));
+    BOOST_CHECK(balances[std::make_pair(GetTallyTestAddress(2), 3U)] == std::vector<int64_t>({0, 0, 0, 77}));
+    BOOST_CHECK_EQUAL(my_offers.size(), 1U);
+    BOOST_CHECK(my_offers.begin()->second.getHash() == txidOffer);
+    BOOST_CHECK_EQUAL(CountMetaDExOrders(), 1U);
+    BOOST_CHECK_EQUAL(exodus_prev, 12345);
+    BOOST_CHECK_EQUAL(spInfo.peekNextSPID(OMNI_PROPERTY_MSC), 7U);
+
+    // the state is stored as a base snapshot, which replaces the text files
+    BOOST_CHECK(fs::exists(GetSnapshotPath(pBlockIndex)));
+    BOOST_CHECK(!HasLegacyFiles());
+    clear_tally_map();
+    BOOST_CHECK(RestoreInMemoryState(blockHash) == 0);
+    BOOST_CHECK(GetTallyBalances() == balances);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
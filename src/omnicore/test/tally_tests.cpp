@@ -1,5 +1,7 @@
+#include <omnicore/omnicore.h>
 #include <omnicore/tally.h>
 
+#include <sync.h>
 #include <test/test_bitcoin.h>
 
 #include <stdint.h>
@@ -318,5 +320,35 @@ BOOST_AUTO_TEST_CASE(tally_overflow)
     BOOST_CHECK_EQUAL(tally.getMoneyReserved(3), int64_t(9223372036854775807LL));
 }
 
+BOOST_AUTO_TEST_CASE(property_index)
+{
+    using namespace mastercore;
+
+    LOCK(cs_tally);
+    clear_tally_map();
+    BOOST_CHECK(getPropertyIndex(3) == nullptr);
+
+    BOOST_CHECK(update_tally_map("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 3, 100, BALANCE));
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", 3, 50, BALANCE));
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", 3, -20, BALANCE));
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", 3, 20, METADEX_RESERVE));
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", 3, -5, PENDING)); // ignored
+    BOOST_CHECK(!update_tally_map("1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", 3, -1, BALANCE)); // insufficient
+
+    const CMPPropertyIndex* index = getPropertyIndex(3);
+    BOOST_REQUIRE(index != nullptr);
+    BOOST_CHECK_EQUAL(index->totalTokens, 150);
+    BOOST_CHECK_EQUAL(index->numHolders, 2);
+    // an empty balance record is created by the failed update
+    BOOST_CHECK_EQUAL(index->addresses.size(), 3U);
+
+    BOOST_CHECK(update_tally_map("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 3, -100, BALANCE));
+    BOOST_CHECK_EQUAL(index->totalTokens, 50);
+    BOOST_CHECK_EQUAL(index->numHolders, 1);
+    BOOST_CHECK(getPropertyIndex(4) == nullptr);
+
+    clear_tally_map();
+    BOOST_CHECK(getPropertyIndex(3) == nullptr);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,37 @@
+#ifndef BITCOIN_OMNICORE_TEST_UTILS_TALLY_H
+#define BITCOIN_OMNICORE_TEST_UTILS_TALLY_H
+
+#include <omnicore/omnicore.h>
+#include <omnicore/sync.h>
+#include <omnicore/tally.h>
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** The properties the random tally updates are spread over. */
+const uint32_t TALLY_TEST_PROPERTIES[] = {1, 3, TEST_ECO_PROPERTY_1};
+
+/** The tally types which are hashed and persisted, the pending amounts are neither. */
+const TallyType TALLY_TEST_TYPES[] = {BALANCE, SELLOFFER_RESERVE, ACCEPT_RESERVE, METADEX_RESERVE};
+
+typedef std::pair<std::string, uint32_t> TallyBalanceKey;
+typedef std::map<TallyBalanceKey, std::vector<int64_t> > TallyBalanceMap;
+
+std::string GetTallyTestAddress(int n);
+
+/** The non-empty balances of the tally map, with the amounts of TALLY_TEST_TYPES. */
+TallyBalanceMap GetTallyBalances() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** The keys of the non-empty balances in the order they are hashed. */
+std::vector<TallyBalanceKey> GetTallyBalanceKeys() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Random credits and debits of all tally types of the first nAddresses addresses, a part of the debits empties the balance. */
+void ApplyRandomTallyUpdates(int nAddresses, int nUpdates) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Empties the balance, all of its tally types but the pending one are taken away. */
+void EmptyTallyBalance(const TallyBalanceKey& key) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+#endif // BITCOIN_OMNICORE_TEST_UTILS_TALLY_H
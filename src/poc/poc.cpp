@@ -26,6 +26,7 @@
 #include <wallet/wallet.h>
 #endif
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 #include <exception>
@@ -36,6 +37,7 @@
 
 #include <event2/thread.h>
 
+#include <chiapos/mined_block_index.h>
 #include <chiapos/post.h>
 #include <chiapos/kernel/calc_diff.h>
 #include <chiapos/kernel/utils.h>
@@ -208,36 +210,41 @@ static constexpr int HASHES_PER_SCOOP = 2;
 static constexpr int SCOOP_SIZE = HASHES_PER_SCOOP * HASH_SIZE; // 2 hashes per scoop
 static constexpr int SCOOPS_PER_PLOT = 4096;
 static constexpr int PLOT_SIZE = SCOOPS_PER_PLOT * SCOOP_SIZE; // 256KB
-static std::unique_ptr<unsigned char> calcDLDataCache(new unsigned char[PLOT_SIZE + 16]); // Global calc cache
 
-//! Thread safe
-static uint64_t CalcDL(int nHeight, const uint256& generationSignature, const uint64_t& nPlotterId, const uint64_t& nNonce, const Consensus::Params& params) {
-    CShabal256 shabal256;
-    uint256 temp;
+//! Each thread has its own calc caches, the nonces are generated into them
+static unsigned char* GetCalcDLDataCache(size_t lane = 0)
+{
+    static thread_local std::unique_ptr<unsigned char[]> calcDLDataCaches[CShabal256Lanes::MAX_LANES];
+    assert(lane < CShabal256Lanes::MAX_LANES);
+    if (!calcDLDataCaches[lane]) {
+        calcDLDataCaches[lane].reset(new unsigned char[PLOT_SIZE + 16]);
+    }
+    return calcDLDataCaches[lane].get();
+}
 
-    // Row data
+//! Row data of the nonce, the hashes are generated from the tail to the head
+static void WriteNonceSeed(unsigned char* data, uint64_t nPlotterId, uint64_t nNonce)
+{
     const uint64_t plotterId_be = htobe64(nPlotterId);
     const uint64_t nonce_be = htobe64(nNonce);
-    unsigned char *const data = calcDLDataCache.get();
     memcpy(data + PLOT_SIZE, (const unsigned char*)&plotterId_be, 8);
     memcpy(data + PLOT_SIZE + 8, (const unsigned char*)&nonce_be, 8);
-    for (int i = PLOT_SIZE; i > 0; i -= HASH_SIZE) {
-        int len = PLOT_SIZE + 16 - i;
-        if (len > SCOOPS_PER_PLOT) {
-            len = SCOOPS_PER_PLOT;
-        }
+}
 
-        shabal256
-            .Write(data + i, len)
-            .Finalize(data + i - HASH_SIZE);
-    }
-    // Final
-    shabal256
-        .Write(data, PLOT_SIZE + 16)
-        .Finalize(temp.begin());
-    for (int i = 0; i < PLOT_SIZE; i++) {
-        data[i] = (unsigned char) (data[i] ^ (temp.begin()[i % HASH_SIZE]));
+static int GetNonceHashLength(int i)
+{
+    int len = PLOT_SIZE + 16 - i;
+    if (len > SCOOPS_PER_PLOT) {
+        len = SCOOPS_PER_PLOT;
     }
+    return len;
+}
+
+//! Pick the scoop from the generated nonce and calculate the deadline, final is the hash of the whole nonce
+static uint64_t CalcScoopDL(int nHeight, const uint256& generationSignature, unsigned char* data, const uint256& final)
+{
+    CShabal256 shabal256;
+    uint256 temp;
 
     // Scoop
     const uint64_t height_be = htobe64(static_cast<uint64_t>(nHeight));
@@ -254,18 +261,88 @@ static uint64_t CalcDL(int nHeight, const uint256& generationSignature, const ui
     // [2] <-> [N-2]
     // [3] <-> [N-3]
     //
-    // Only care hash data of scoop index
-    memcpy(data + scoop * SCOOP_SIZE + HASH_SIZE, data + (SCOOPS_PER_PLOT - scoop) * SCOOP_SIZE - HASH_SIZE, HASH_SIZE);
+    // Only care hash data of scoop index, so only the two hashes are mixed with the final hash
+    unsigned char* const lowHash = data + scoop * SCOOP_SIZE;
+    unsigned char* const highHash = data + (SCOOPS_PER_PLOT - scoop) * SCOOP_SIZE - HASH_SIZE;
+    for (int i = 0; i < HASH_SIZE; i++) {
+        lowHash[i] = (unsigned char) (lowHash[i] ^ final.begin()[i]);
+        highHash[i] = (unsigned char) (highHash[i] ^ final.begin()[i]);
+    }
+    memcpy(lowHash + HASH_SIZE, highHash, HASH_SIZE);
 
     // Result
     shabal256
         .Write(generationSignature.begin(), generationSignature.size())
-        .Write(data + scoop * SCOOP_SIZE, SCOOP_SIZE)
+        .Write(lowHash, SCOOP_SIZE)
         .Finalize(temp.begin());
     return temp.GetUint64(0);
 }
 
-//! Thread unsafe
+uint64_t CalcDL(int nHeight, const uint256& generationSignature, const uint64_t& nPlotterId, const uint64_t& nNonce) {
+    CShabal256 shabal256;
+    uint256 final;
+
+    // Row data
+    unsigned char *const data = GetCalcDLDataCache();
+    WriteNonceSeed(data, nPlotterId, nNonce);
+    for (int i = PLOT_SIZE; i > 0; i -= HASH_SIZE) {
+        shabal256
+            .Write(data + i, GetNonceHashLength(i))
+            .Finalize(data + i - HASH_SIZE);
+    }
+    // Final
+    shabal256
+        .Write(data, PLOT_SIZE + 16)
+        .Finalize(final.begin());
+
+    return CalcScoopDL(nHeight, generationSignature, data, final);
+}
+
+void CalcDLs(const CDeadlineInput* inputs, size_t count, uint64_t* pnUnformattedDeadlines) {
+    for (size_t begin = 0; begin < count; begin += CShabal256Lanes::MAX_LANES) {
+        const size_t lanes = std::min(count - begin, CShabal256Lanes::MAX_LANES);
+        if (lanes == 1) {
+            const CDeadlineInput& input = inputs[begin];
+            pnUnformattedDeadlines[begin] = CalcDL(input.nHeight, input.generationSignature, input.nPlotterId, input.nNonce);
+            continue;
+        }
+
+        // Row data, the nonces are generated on the lanes at the same time
+        CShabal256Lanes shabal256(lanes);
+        unsigned char* data[CShabal256Lanes::MAX_LANES];
+        const unsigned char* in[CShabal256Lanes::MAX_LANES];
+        unsigned char* out[CShabal256Lanes::MAX_LANES];
+        uint256 finals[CShabal256Lanes::MAX_LANES];
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            data[lane] = GetCalcDLDataCache(lane);
+            WriteNonceSeed(data[lane], inputs[begin + lane].nPlotterId, inputs[begin + lane].nNonce);
+        }
+        for (int i = PLOT_SIZE; i > 0; i -= HASH_SIZE) {
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                in[lane] = data[lane] + i;
+                out[lane] = data[lane] + i - HASH_SIZE;
+            }
+            shabal256
+                .Write(in, GetNonceHashLength(i))
+                .Finalize(out);
+        }
+        // Final
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            in[lane] = data[lane];
+            out[lane] = finals[lane].begin();
+        }
+        shabal256
+            .Write(in, PLOT_SIZE + 16)
+            .Finalize(out);
+
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const CDeadlineInput& input = inputs[begin + lane];
+            pnUnformattedDeadlines[begin + lane] = CalcScoopDL(input.nHeight, input.generationSignature, data[lane], finals[lane]);
+        }
+    }
+}
+
+//! Thread safe, it only reads the fields of the previous block index, which are set before it is added to the index
 static uint64_t CalculateUnformattedDeadline(const CBlockIndex& prevBlockIndex, const CBlockHeader& block, const Consensus::Params& params)
 {
     // Fund
@@ -280,10 +357,41 @@ static uint64_t CalculateUnformattedDeadline(const CBlockIndex& prevBlockIndex,
     if (params.fAllowMinDifficultyBlocks)
         return block.nNonce * prevBlockIndex.nBaseTarget;
 
-    return CalcDL(prevBlockIndex.nHeight + 1, prevBlockIndex.GetNextGenerationSignature(), block.nPlotterId, block.nNonce, params);
+    return CalcDL(prevBlockIndex.nHeight + 1, prevBlockIndex.GetNextGenerationSignature(), block.nPlotterId, block.nNonce);
+}
+
+void CDeadlineCheck::Add(int nHeight, const uint256& generationSignature, uint64_t nPlotterId, uint64_t nNonce, uint64_t* pnUnformattedDeadline)
+{
+    m_inputs.push_back(CDeadlineInput{nHeight, generationSignature, nPlotterId, nNonce});
+    m_outputs.push_back(pnUnformattedDeadline);
+}
+
+bool CDeadlineCheck::operator()()
+{
+    std::vector<uint64_t> vDeadlines(m_inputs.size());
+    CalcDLs(m_inputs.data(), m_inputs.size(), vDeadlines.data());
+    for (size_t i = 0; i < m_outputs.size(); ++i) {
+        *m_outputs[i] = vDeadlines[i];
+    }
+    return true;
 }
 
-// Require hold cs_main
+void CDeadlineCheck::swap(CDeadlineCheck& check)
+{
+    m_inputs.swap(check.m_inputs);
+    m_outputs.swap(check.m_outputs);
+}
+
+bool IsDeadlineFromNonce(int nHeight, const CBlockHeader& block, const Consensus::Params& params)
+{
+    if (nHeight <= params.BHDIP001PreMiningEndHeight)
+        return false;
+    if (block.nPlotterId == 0 && nHeight >= params.BHDIP006Height)
+        return false;
+    return !params.fAllowMinDifficultyBlocks;
+}
+
+//! Thread safe, see CalculateUnformattedDeadline(), cs_main is not required
 uint64_t CalculateDeadline(const CBlockIndex& prevBlockIndex, const CBlockHeader& block, const Consensus::Params& params)
 {
     return CalculateUnformattedDeadline(prevBlockIndex, block, params) / prevBlockIndex.nBaseTarget;
@@ -606,33 +714,34 @@ uint64_t AddNonce(uint64_t& bestDeadline, const CBlockIndex& miningBlockIndex,
     return calcDeadline;
 }
 
-CBlockList GetEvalBlocks(int nHeight, bool fAscent, const Consensus::Params& params)
+CBlockList GetEvalBlocks(int nHeight, bool fAscent, const Consensus::Params& params, const CBlockIndex* pindexTip)
 {
-    AssertLockHeld(cs_main);
-    assert(nHeight >= 0 && nHeight <= ::ChainActive().Height());
+    if (pindexTip == nullptr) {
+        AssertLockHeld(cs_main);
+        pindexTip = ::ChainActive().Tip();
+    }
+    assert(nHeight >= 0 && nHeight <= pindexTip->nHeight);
 
     CBlockList vBlocks;
     int nBeginHeight = std::max(nHeight - params.nCapacityEvalWindow + 1, params.BHDIP001PreMiningEndHeight + 1);
     if (nHeight >= nBeginHeight) {
         vBlocks.reserve(nHeight - nBeginHeight + 1);
+        // The ancestors of a block index never change, walk them back from the tip instead of reading the active chain
+        for (const CBlockIndex* pindex = pindexTip->GetAncestor(nHeight); pindex != nullptr && pindex->nHeight >= nBeginHeight; pindex = pindex->pprev) {
+            vBlocks.push_back(std::cref(*pindex));
+        }
         if (fAscent) {
-            for (int height = nBeginHeight; height <= nHeight; height++) {
-                vBlocks.push_back(std::cref(*(::ChainActive()[height])));
-            }
-        } else {
-            for (int height = nHeight; height >= nBeginHeight; height--) {
-                vBlocks.push_back(std::cref(*(::ChainActive()[height])));
-            }
+            std::reverse(vBlocks.begin(), vBlocks.end());
         }
     }
     return vBlocks;
 }
 
-int64_t GetNetCapacity(int nHeight, const Consensus::Params& params)
+int64_t GetNetCapacity(int nHeight, const Consensus::Params& params, const CBlockIndex* pindexTip)
 {
     uint64_t nBaseTarget = 0;
     int nBlockCount = 0;
-    for (const CBlockIndex& block : GetEvalBlocks(nHeight, true, params)) {
+    for (const CBlockIndex& block : GetEvalBlocks(nHeight, true, params, pindexTip)) {
         if (nHeight < params.BHDIP008Height || block.nHeight >= params.BHDIP008Height) {
             nBaseTarget += block.nBaseTarget;
             nBlockCount++;
@@ -650,11 +759,11 @@ int64_t GetNetCapacity(int nHeight, const Consensus::Params& params)
 }
 
 template <uint64_t BT>
-static int64_t EvalNetCapacity(int nHeight, const Consensus::Params& params, std::function<void(const CBlockIndex&)> associateBlock)
+static int64_t EvalNetCapacity(int nHeight, const Consensus::Params& params, std::function<void(const CBlockIndex&)> associateBlock, const CBlockIndex* pindexTip)
 {
     uint64_t nBaseTarget = 0;
     int nBlockCount = 0;
-    for (const CBlockIndex& block : GetEvalBlocks(nHeight, true, params)) {
+    for (const CBlockIndex& block : GetEvalBlocks(nHeight, true, params, pindexTip)) {
         // All blocks
         associateBlock(block);
 
@@ -674,12 +783,12 @@ static int64_t EvalNetCapacity(int nHeight, const Consensus::Params& params, std
     return (int64_t) 1;
 }
 
-int64_t GetNetCapacity(int nHeight, const Consensus::Params& params, std::function<void(const CBlockIndex&)> associateBlock)
+int64_t GetNetCapacity(int nHeight, const Consensus::Params& params, std::function<void(const CBlockIndex&)> associateBlock, const CBlockIndex* pindexTip)
 {
     if (nHeight < params.BHDIP008Height) {
-        return EvalNetCapacity<BHD_BASE_TARGET_300>(nHeight, params, associateBlock);
+        return EvalNetCapacity<BHD_BASE_TARGET_300>(nHeight, params, associateBlock, pindexTip);
     } else {
-        return EvalNetCapacity<BHD_BASE_TARGET_180>(nHeight, params, associateBlock);
+        return EvalNetCapacity<BHD_BASE_TARGET_180>(nHeight, params, associateBlock, pindexTip);
     }
 }
 
@@ -755,19 +864,22 @@ CAmount EvalMiningRatio(int nMiningHeight, int64_t nNetCapacityTB, const Consens
 }
 
 CAmount GetMiningRatio(int nMiningHeight, const Consensus::Params& params, int* pRatioStage,
-    int64_t* pRatioCapacityTB, int *pRatioBeginHeight)
+    int64_t* pRatioCapacityTB, int *pRatioBeginHeight, const CBlockIndex* pindexTip)
 {
-    AssertLockHeld(cs_main);
-    assert(nMiningHeight > 0 && nMiningHeight <= ::ChainActive().Height() + 1);
+    if (pindexTip == nullptr) {
+        AssertLockHeld(cs_main);
+        pindexTip = ::ChainActive().Tip();
+    }
+    assert(nMiningHeight > 0 && nMiningHeight <= pindexTip->nHeight + 1);
 
     int64_t nNetCapacityTB = 0;
     if (nMiningHeight <= params.BHDIP007SmoothEndHeight) {
-        if (pRatioCapacityTB) *pRatioCapacityTB = GetNetCapacity(nMiningHeight - 1, params);
+        if (pRatioCapacityTB) *pRatioCapacityTB = GetNetCapacity(nMiningHeight - 1, params, pindexTip);
         if (pRatioBeginHeight) *pRatioBeginHeight = std::max(nMiningHeight - params.nCapacityEvalWindow, params.BHDIP001PreMiningEndHeight);
     } else {
         int nEndEvalHeight = ((nMiningHeight - 1) / params.nCapacityEvalWindow) * params.nCapacityEvalWindow;
-        int64_t nCurrentNetCapacityTB = GetNetCapacity(nEndEvalHeight, params);
-        int64_t nPrevNetCapacityTB = GetNetCapacity(std::max(nEndEvalHeight - params.nCapacityEvalWindow, 0), params);
+        int64_t nCurrentNetCapacityTB = GetNetCapacity(nEndEvalHeight, params, pindexTip);
+        int64_t nPrevNetCapacityTB = GetNetCapacity(std::max(nEndEvalHeight - params.nCapacityEvalWindow, 0), params, pindexTip);
         nNetCapacityTB = GetRatioNetCapacity(nCurrentNetCapacityTB, nPrevNetCapacityTB, params);
         if (pRatioCapacityTB) *pRatioCapacityTB = nNetCapacityTB;
         if (pRatioBeginHeight) *pRatioBeginHeight = nEndEvalHeight;
@@ -782,33 +894,38 @@ CAmount GetCapacityRequireBalance(int64_t nCapacityTB, CAmount miningRatio)
 }
 
 // Compatible BHD007 before consensus
-static inline CAmount GetCompatiblePledgeRatio(int nMiningHeight, const Consensus::Params& params)
+static inline CAmount GetCompatiblePledgeRatio(int nMiningHeight, const Consensus::Params& params, const CBlockIndex* pindexTip)
 {
-    return nMiningHeight < params.BHDIP007Height ? params.BHDIP001MiningRatio : GetMiningRatio(nMiningHeight, params);
+    return nMiningHeight < params.BHDIP007Height ? params.BHDIP001MiningRatio : GetMiningRatio(nMiningHeight, params, nullptr, nullptr, nullptr, pindexTip);
 }
 
 // Compatible BHD007 before consensus
-static inline int64_t GetCompatibleNetCapacity(int nMiningHeight, const Consensus::Params& params, std::function<void(const CBlockIndex&)> associateBlock)
+static inline int64_t GetCompatibleNetCapacity(int nMiningHeight, const Consensus::Params& params, std::function<void(const CBlockIndex&)> associateBlock, const CBlockIndex* pindexTip)
 {
     if (nMiningHeight < params.BHDIP007Height) {
-        return EvalNetCapacity<BHD_BASE_TARGET_240>(nMiningHeight - 1, params, associateBlock);
+        return EvalNetCapacity<BHD_BASE_TARGET_240>(nMiningHeight - 1, params, associateBlock, pindexTip);
     } else if (nMiningHeight <= params.BHDIP008Height) {
         // BHDIP008 is new genesis block
-        return EvalNetCapacity<BHD_BASE_TARGET_300>(nMiningHeight - 1, params, associateBlock);
+        return EvalNetCapacity<BHD_BASE_TARGET_300>(nMiningHeight - 1, params, associateBlock, pindexTip);
     } else {
-        return EvalNetCapacity<BHD_BASE_TARGET_180>(nMiningHeight - 1, params, associateBlock);
+        return EvalNetCapacity<BHD_BASE_TARGET_180>(nMiningHeight - 1, params, associateBlock, pindexTip);
     }
 }
 
 arith_uint256 CalculateAverageNetworkSpace(CBlockIndex const* pindexCurr, Consensus::Params const& params, int nCountBlocks) {
+    if ((nCountBlocks <= 0 || nCountBlocks == params.BHDIP009DifficultyEvalWindow) && pindexCurr->nChiaWindowBlocks >= 0) {
+        // Read it from the sums of the window
+        if (pindexCurr->nChiaWindowBlocks == 0) {
+            return 0;
+        }
+        return pindexCurr->nChiaNetspaceSum / pindexCurr->nChiaWindowBlocks;
+    }
     CBlockIndex const* pindex = pindexCurr;
     int nCount = nCountBlocks > 0 ? nCountBlocks : params.BHDIP009DifficultyEvalWindow;
     int nActual{0};
     arith_uint256 result;
     while (nCount > 0 && pindex->nHeight >= params.BHDIP009Height) {
-        int nBitsOfFilter = pindex->nHeight < params.BHDIP009PlotIdBitsOfFilterEnableOnHeight ? 0 : params.BHDIP009PlotIdBitsOfFilter;
-        auto netspace = chiapos::CalculateNetworkSpace(chiapos::GetDifficultyForNextIterations(pindex->pprev, params),
-                pindex->chiaposFields.GetTotalIters(), params.BHDIP009DifficultyConstantFactorBits);
+        auto netspace = chiapos::GetBlockNetworkSpace(pindex, params);
         ++nActual;
         result += netspace;
         // Next
@@ -822,11 +939,20 @@ arith_uint256 CalculateAverageNetworkSpace(CBlockIndex const* pindexCurr, Consen
     return result / nActual;
 }
 
-CAmount GetMiningRequireBalance(const CAccountID& generatorAccountID, const CPlotterBindData& bindData, int nMiningHeight, const CCoinsViewCache& view, int64_t* pMinerCapacity, CAmount* pOldMiningRequireBalance, CAmount nBurned, const Consensus::Params& params, int* pnMinedBlocks, int* pnTotalBlocks, int nHeightForCalculatingTotalSupply)
+CAmount GetMiningRequireBalance(const CAccountID& generatorAccountID, const CPlotterBindData& bindData, int nMiningHeight, const CCoinsViewCache& view, int64_t* pMinerCapacity, CAmount* pOldMiningRequireBalance, CAmount nBurned, const Consensus::Params& params, int* pnMinedBlocks, int* pnTotalBlocks, int nHeightForCalculatingTotalSupply, const CBlockIndex* pindexTip)
 {
-    AssertLockHeld(cs_main);
-
-    int nSpendHeight = GetSpendHeight(view);
+    int nSpendHeight;
+    if (pindexTip == nullptr) {
+        AssertLockHeld(cs_main);
+        pindexTip = ::ChainActive().Tip();
+        nSpendHeight = GetSpendHeight(view);
+    } else {
+        // The view is pinned to the tip, it must not be read against another chain
+        if (view.GetBestBlock() != pindexTip->GetBlockHash()) {
+            throw std::runtime_error(tinyformat::format("the best block of the view mismatches the tip %s", pindexTip->GetBlockHash().GetHex()));
+        }
+        nSpendHeight = pindexTip->nHeight + 1;
+    }
     if (nSpendHeight != nMiningHeight) {
         LogPrintf("%s: nSpendHeight(%d) != nMiningHeight(%d)\n", __func__, nSpendHeight, nMiningHeight);
         throw std::runtime_error(tinyformat::format("the height of spend and mining mismatch, nMiningHeight=%ld, nSpendHeight=%ld", nMiningHeight, nSpendHeight));
@@ -835,7 +961,7 @@ CAmount GetMiningRequireBalance(const CAccountID& generatorAccountID, const CPlo
     if (pMinerCapacity != nullptr) *pMinerCapacity = 0;
     if (pOldMiningRequireBalance != nullptr) *pOldMiningRequireBalance = 0;
 
-    const CAmount miningRatio = GetCompatiblePledgeRatio(nMiningHeight, params);
+    const CAmount miningRatio = GetCompatiblePledgeRatio(nMiningHeight, params, pindexTip);
 
     int64_t nNetCapacityTB = 0;
     int nBlockCount = 0, nMinedCount = 0;
@@ -860,7 +986,7 @@ CAmount GetMiningRequireBalance(const CAccountID& generatorAccountID, const CPlo
                         nOldMinedCount++;
                     }
                 }
-            }
+            }, pindexTip
         );
 
         // Old consensus point
@@ -876,39 +1002,35 @@ CAmount GetMiningRequireBalance(const CAccountID& generatorAccountID, const CPlo
     } else if (nMiningHeight < params.BHDIP009Height) {
         // Binded plotter
         const std::set<CPlotterBindData> plotters = view.GetAccountBindPlotters(generatorAccountID, CPlotterBindData::Type::BURST);
+        int nBeginHeight = 0;
         nNetCapacityTB = GetCompatibleNetCapacity(nMiningHeight, params,
-            [&nBlockCount, &nMinedCount, &plotters, &params] (const CBlockIndex &block) {
-                nBlockCount++;
-                for (const CPlotterBindData &plotter : plotters) {
-                    assert(!block.IsChiaBlock());
-                    if (plotter == block.nPlotterId) {
-                        ++nMinedCount;
-                        break;
-                    }
-                }
-            }
+            [&nBlockCount, &nBeginHeight] (const CBlockIndex &block) {
+                assert(!block.IsChiaBlock());
+                if (nBlockCount++ == 0) nBeginHeight = block.nHeight;
+            }, pindexTip
         );
+        if (nBlockCount > 0) {
+            nMinedCount = chiapos::g_mined_block_index.CountMinedBlocks(pindexTip, plotters, nBeginHeight, nMiningHeight - 1);
+        }
         // Remove sugar
         if (nMinedCount < nBlockCount) nMinedCount++;
     } else {
         // Binded farmer-pk
         const std::set<CPlotterBindData> plotters = view.GetAccountBindPlotters(generatorAccountID, CPlotterBindData::Type::CHIA);
+        int nBeginHeight = 0;
         nNetCapacityTB = GetCompatibleNetCapacity(nMiningHeight, params,
-            [&nBlockCount, &nMinedCount, &plotters, &params] (const CBlockIndex &block) {
+            [&nBlockCount, &nBeginHeight, &params] (const CBlockIndex &block) {
                 if (block.nHeight < params.BHDIP009Height) {
                     // skip the block that doesn't belong to chia
                     return;
                 }
-                nBlockCount++;
-                for (const CPlotterBindData &plotter : plotters) {
-                    assert(block.IsChiaBlock());
-                    if (plotter == CChiaFarmerPk(block.chiaposFields.posProof.vchFarmerPk)) {
-                        ++nMinedCount;
-                        break;
-                    }
-                }
-            }
+                assert(block.IsChiaBlock());
+                if (nBlockCount++ == 0) nBeginHeight = block.nHeight;
+            }, pindexTip
         );
+        if (nBlockCount > 0) {
+            nMinedCount = chiapos::g_mined_block_index.CountMinedBlocks(pindexTip, plotters, nBeginHeight, nMiningHeight - 1);
+        }
         // Remove sugar
         if (nMinedCount < nBlockCount) nMinedCount++;
     }
@@ -923,7 +1045,7 @@ CAmount GetMiningRequireBalance(const CAccountID& generatorAccountID, const CPlo
     }
 
     if (nMiningHeight >= params.BHDIP009Height) {
-        CBlockIndex* pindex = ::ChainActive().Tip();
+        const CBlockIndex* pindex = pindexTip;
         CAmount nTotalSupplied = GetTotalSupplyBeforeHeight(nHeightForCalculatingTotalSupply, params) - nBurned + GetTotalSupplyBeforeBHDIP009(params) * (params.BHDIP009TotalAmountUpgradeMultiply - 1);
         auto netspace = poc::CalculateAverageNetworkSpace(pindex, params);
         LogPrint(BCLog::POC, "%s: Average network space %1.6f(Tib), total supplied: %s DePC (burned: %s DePC), params(difficulty=%ld, iters=%ld, DCF(bits)=%ld, Filter(bits)=%ld)\n", __func__,
@@ -959,9 +1081,10 @@ CAmount GetMiningRequireBalance(const CAccountID& generatorAccountID, const CPlo
     }
 }
 
-bool CheckProofOfCapacity(const CBlockIndex& prevBlockIndex, const CBlockHeader& block, const Consensus::Params& params)
+bool CheckProofOfCapacity(const CBlockIndex& prevBlockIndex, const CBlockHeader& block, const Consensus::Params& params, const uint64_t* pnUnformattedDeadline)
 {
-    uint64_t deadline = CalculateDeadline(prevBlockIndex, block, params);
+    uint64_t deadline = pnUnformattedDeadline != nullptr ? *pnUnformattedDeadline / prevBlockIndex.nBaseTarget
+                                                         : CalculateDeadline(prevBlockIndex, block, params);
 
     // Maybe overflow on arithmetic operation
     if (deadline > poc::MAX_TARGET_DEADLINE)
@@ -67,7 +67,7 @@ static const int64_t MAX_TARGET_DEADLINE = std::numeric_limits<uint32_t>::max();
 static const uint64_t INVALID_DEADLINE = std::numeric_limits<uint64_t>::max();
 
 /**
- * Calculate deadline
+ * Calculate deadline, thread safe
  *
  * @param prevBlockIndex    Previous block
  * @param block             Block header
@@ -77,6 +77,67 @@ static const uint64_t INVALID_DEADLINE = std::numeric_limits<uint64_t>::max();
  */
 uint64_t CalculateDeadline(const CBlockIndex& prevBlockIndex, const CBlockHeader& block, const Consensus::Params& params);
 
+/**
+ * Calculate unformatted deadline of the nonce, thread safe
+ *
+ * @param nHeight               Height of the block
+ * @param generationSignature   Generation signature from previous block
+ * @param nPlotterId            Plotter ID
+ * @param nNonce                Nonce
+ *
+ * @return Return unformatted deadline, divide it by base target to get the deadline
+ */
+uint64_t CalcDL(int nHeight, const uint256& generationSignature, const uint64_t& nPlotterId, const uint64_t& nNonce);
+
+/**
+ * Whether the deadline of the block is calculated by CalcDL
+ *
+ * @param nHeight           Height of the block
+ * @param block             Block header
+ * @param params            Consensus params
+ */
+bool IsDeadlineFromNonce(int nHeight, const CBlockHeader& block, const Consensus::Params& params);
+
+/** The nonce and the previous block of a deadline */
+struct CDeadlineInput {
+    int nHeight;
+    uint256 generationSignature;
+    uint64_t nPlotterId;
+    uint64_t nNonce;
+};
+
+/**
+ * Calculate unformatted deadlines of several nonces, thread safe. Up to CShabal256Lanes::MAX_LANES nonces are
+ * generated at the same time on the SIMD lanes of the SHABAL-256 hasher.
+ *
+ * @param inputs                    The nonces
+ * @param count                     Number of the nonces
+ * @param pnUnformattedDeadlines    Receives count unformatted deadlines
+ */
+void CalcDLs(const CDeadlineInput* inputs, size_t count, uint64_t* pnUnformattedDeadlines);
+
+/**
+ * Closure representing the deadlines to calculate. The generation signatures are calculated from the previous
+ * headers, so the deadlines of a batch of headers can be calculated in parallel before they are connected.
+ */
+class CDeadlineCheck
+{
+private:
+    std::vector<CDeadlineInput> m_inputs;
+    std::vector<uint64_t*> m_outputs;
+
+public:
+    CDeadlineCheck() {}
+
+    void Add(int nHeight, const uint256& generationSignature, uint64_t nPlotterId, uint64_t nNonce, uint64_t* pnUnformattedDeadline);
+
+    size_t Size() const { return m_inputs.size(); }
+
+    bool operator()();
+
+    void swap(CDeadlineCheck& check);
+};
+
 /**
  * Calculate base target
  *
@@ -116,8 +177,9 @@ typedef std::vector< std::reference_wrapper<const CBlockIndex> > CBlockList;
  * @param nHeight           The height of net capacity
  * @param fAscent           Ascent or Descent sort blocks
  * @param params            Consensus params
+ * @param pindexTip         The tip of the chain to read, the active chain (cs_main must be held) when it is nullptr
  */
-CBlockList GetEvalBlocks(int nHeight, bool fAscent, const Consensus::Params& params);
+CBlockList GetEvalBlocks(int nHeight, bool fAscent, const Consensus::Params& params, const CBlockIndex* pindexTip = nullptr);
 
 /**
  * Eval mining ratio by capacity
@@ -146,10 +208,11 @@ int64_t GetRatioNetCapacity(int64_t nNetCapacityTB, int64_t nPrevNetCapacityTB,
  *
  * @param nHeight           The height of net capacity
  * @param params            Consensus params
+ * @param pindexTip         The tip of the chain to read, the active chain when it is nullptr
  *
  * @return Return net capacity of TB
  */
-int64_t GetNetCapacity(int nHeight, const Consensus::Params& params);
+int64_t GetNetCapacity(int nHeight, const Consensus::Params& params, const CBlockIndex* pindexTip = nullptr);
 
 /**
  * Get net capacity
@@ -157,10 +220,11 @@ int64_t GetNetCapacity(int nHeight, const Consensus::Params& params);
  * @param nHeight           The height of net capacity
  * @param params            Consensus params
  * @param associateBlock    Associate block callback
+ * @param pindexTip         The tip of the chain to read, the active chain when it is nullptr
  *
  * @return Return net capacity of TB
  */
-int64_t GetNetCapacity(int nHeight, const Consensus::Params& params, std::function<void(const CBlockIndex &block)> associateBlock);
+int64_t GetNetCapacity(int nHeight, const Consensus::Params& params, std::function<void(const CBlockIndex &block)> associateBlock, const CBlockIndex* pindexTip = nullptr);
 
 /**
  * Get mining ratio
@@ -170,11 +234,12 @@ int64_t GetNetCapacity(int nHeight, const Consensus::Params& params, std::functi
  * @param pRatioStage       The stage of current ratio
  * @param pRatioCapacityTB  The net capacity of current stage
  * @param pRatioBeginHeight The begin block height of current stage
+ * @param pindexTip         The tip of the chain to read, the active chain when it is nullptr
  *
  * @return Return mining ratio
  */
 CAmount GetMiningRatio(int nMiningHeight, const Consensus::Params& params, int* pRatioStage = nullptr,
-    int64_t* pRatioCapacityTB = nullptr, int *pRatioBeginHeight = nullptr);
+    int64_t* pRatioCapacityTB = nullptr, int *pRatioBeginHeight = nullptr, const CBlockIndex* pindexTip = nullptr);
 
 /**
  * Get capacity required balance
@@ -198,10 +263,11 @@ CAmount GetCapacityRequireBalance(int64_t nCapacityTB, CAmount miningRatio);
  * @param pOldMiningRequireBalance  Only in BHDIP004. See https://depinc.org/wiki/BHDIP/004#getminingrequire
  * @param nBurned                   The amount of coins are burned, need fix the total supplied amount
  * @param params                    Consensus params
+ * @param pindexTip                 The tip the view is pinned to, cs_main is not required then. The active tip when it is nullptr
  *
  * @return Required balance
  */
-CAmount GetMiningRequireBalance(const CAccountID& generatorAccountID, const CPlotterBindData& bindData, int nMiningHeight, const CCoinsViewCache& view, int64_t* pMinerCapacityTB, CAmount* pOldMiningRequireBalance, CAmount nBurned, const Consensus::Params& params, int* pnMinedBlocks = nullptr, int* pnTotalBlocks = nullptr, int nHeightForCalculatingTotalSupply = 0);
+CAmount GetMiningRequireBalance(const CAccountID& generatorAccountID, const CPlotterBindData& bindData, int nMiningHeight, const CCoinsViewCache& view, int64_t* pMinerCapacityTB, CAmount* pOldMiningRequireBalance, CAmount nBurned, const Consensus::Params& params, int* pnMinedBlocks = nullptr, int* pnTotalBlocks = nullptr, int nHeightForCalculatingTotalSupply = 0, const CBlockIndex* pindexTip = nullptr);
 
 /**
  * Check block work
@@ -209,10 +275,11 @@ CAmount GetMiningRequireBalance(const CAccountID& generatorAccountID, const CPlo
  * @param prevBlockIndex    Previous block
  * @param block             Block header
  * @param params            Consensus params
+ * @param pnUnformattedDeadline The unformatted deadline calculated ahead by CDeadlineCheck, or nullptr
  *
  * @return Return true is poc valid
  */
-bool CheckProofOfCapacity(const CBlockIndex& prevBlockIndex, const CBlockHeader& block, const Consensus::Params& params);
+bool CheckProofOfCapacity(const CBlockIndex& prevBlockIndex, const CBlockHeader& block, const Consensus::Params& params, const uint64_t* pnUnformattedDeadline = nullptr);
 
 /**
  * Add private key for mining signature
@@ -200,6 +200,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "listpledges", 3, "include_invalid" },
     { "getplottermininginfo", 1, "verbose" },
     { "getchaintips", 0, "verbose" },
+    { "queryharvesterqualities", 0, "count" },
+    { "querychallenge", 1, "timeout" },
 
     /* DePINC & Burst mining compatible */
     { "submitNonce", 2, "height" },
@@ -1,5 +1,11 @@
 #include "subsidy_utils.h"
 
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <set>
+#include <tuple>
+
 /**
  * Mutex to guard access to validation specific variables, such as reading
  * or changing the chainstate.
@@ -30,29 +36,88 @@ int CalculateHalvings(int nHeight, Consensus::Params const& consensusParams) {
 
 HalvingMap GenerateBlockSubsidyWithHalvings(CAmount* pnTotalAmount, Consensus::Params const& params) {
     HalvingMap result;
-    int nHeight { 1 };
-    int halvings { 0 };
     CAmount nOldSubsidy { 0 };
     int nOldHeight { 0 };
     *pnTotalAmount = 0;
-    while (halvings < 64) {
-        halvings = CalculateHalvings(nHeight, params);
-        CAmount nSubsidy = GetBlockSubsidy(nHeight, params);
-        if (nSubsidy != nOldSubsidy) {
-            HalvingInfo hi;
-            hi.nAmountPerBlock = nSubsidy;
-            hi.nTotalAmount = (nHeight - nOldHeight) * nOldSubsidy;
-            result[nHeight] = hi;
-            *pnTotalAmount += hi.nTotalAmount;
-            // prepare for next subsidy
-            nOldHeight = nHeight;
-            nOldSubsidy = nSubsidy;
+    auto addHalving = [&](int nHeight, CAmount nSubsidy) {
+        if (nSubsidy == nOldSubsidy) {
+            return;
+        }
+        HalvingInfo hi;
+        hi.nAmountPerBlock = nSubsidy;
+        hi.nTotalAmount = (nHeight - nOldHeight) * nOldSubsidy;
+        result[nHeight] = hi;
+        *pnTotalAmount += hi.nTotalAmount;
+        // prepare for next subsidy
+        nOldHeight = nHeight;
+        nOldSubsidy = nSubsidy;
+    };
+    // The halvings are counted from height 1, the subsidy of the genesis block is ignored
+    addHalving(1, GetBlockSubsidy(1, params));
+    for (auto const& segment : GetSubsidySegments(params)) {
+        if (segment.nBeginHeight > 1) {
+            addHalving(segment.nBeginHeight, segment.nSubsidy);
         }
-        ++nHeight;
     }
     return result;
 }
 
+SubsidySegments GenerateSubsidySegments(Consensus::Params const& params) {
+    // The subsidy only changes on the heights of halvings, upgrades and the change of target spacing
+    std::set<int> setBreakHeights { 0, params.BHDIP008Height, params.BHDIP009Height, params.BHDIP010Height };
+    int64_t nIntervalBefore008 = params.nSubsidyHalvingInterval * 600 / params.BHDIP001TargetSpacing;
+    for (int64_t halvings = 1; halvings <= 64 && halvings * nIntervalBefore008 < params.BHDIP008Height; ++halvings) {
+        setBreakHeights.insert(halvings * nIntervalBefore008);
+    }
+    int64_t nEqualHeight = static_cast<int64_t>(params.BHDIP008Height) * params.BHDIP001TargetSpacing / params.BHDIP008TargetSpacing;
+    int64_t nIntervalAfter008 = params.nSubsidyHalvingInterval * 600 / params.BHDIP008TargetSpacing;
+    for (int64_t halvings = 0; halvings <= 64; ++halvings) {
+        int64_t nHeight = halvings * nIntervalAfter008 + params.BHDIP008Height - nEqualHeight;
+        if (nHeight > std::numeric_limits<int>::max()) {
+            break;
+        }
+        if (nHeight > params.BHDIP008Height) {
+            setBreakHeights.insert(static_cast<int>(nHeight));
+        }
+    }
+
+    SubsidySegments segments;
+    for (int nHeight : setBreakHeights) {
+        if (nHeight < 0) {
+            continue;
+        }
+        CAmount nSubsidy = GetBlockSubsidy(nHeight, params);
+        if (segments.empty()) {
+            segments.push_back({nHeight, nSubsidy, 0});
+            continue;
+        }
+        SubsidySegment const& last = segments.back();
+        if (nSubsidy != last.nSubsidy) {
+            segments.push_back({nHeight, nSubsidy, last.nTotalSupplyBefore + (nHeight - last.nBeginHeight) * last.nSubsidy});
+        }
+    }
+    assert(!segments.empty() && segments.front().nBeginHeight == 0 && segments.back().nSubsidy == 0);
+    return segments;
+}
+
+SubsidySegments const& GetSubsidySegments(Consensus::Params const& params) {
+    using SubsidyParamsKey = std::tuple<int, int, int, int, int, int, int, int>;
+    static Mutex cs_segments;
+    static std::map<SubsidyParamsKey, SubsidySegments> mapSegments GUARDED_BY(cs_segments);
+
+    SubsidyParamsKey key { params.nSubsidyHalvingInterval, params.BHDIP001TargetSpacing,
+                           params.BHDIP008Height, params.BHDIP008TargetSpacing,
+                           params.BHDIP009Height, params.BHDIP009TotalAmountUpgradeMultiply,
+                           params.BHDIP010Height, params.BHDIP010TotalAmountUpgradeMultiply };
+    LOCK(cs_segments);
+    auto it = mapSegments.find(key);
+    if (it == std::end(mapSegments)) {
+        it = mapSegments.emplace(key, GenerateSubsidySegments(params)).first;
+    }
+    // Entries are never erased, the reference stays valid
+    return it->second;
+}
+
 CAmount GetBlockSubsidy(int nHeight, Consensus::Params const& consensusParams) {
     CAmount nSubsidy;
 
@@ -91,12 +156,16 @@ CAmount GetBlockSubsidy(int nHeight, Consensus::Params const& consensusParams) {
 }
 
 CAmount GetTotalSupplyBeforeHeight(int nHeight, Consensus::Params const& params) {
-    CAmount totalReward{0};
-    for (int i = 0; i < nHeight; ++i) {
-        CAmount blockReward = GetBlockSubsidy(i, params);
-        totalReward += blockReward;
+    if (nHeight <= 0) {
+        return 0;
     }
-    return totalReward;
+    SubsidySegments const& segments = GetSubsidySegments(params);
+    // Find the segment which contains the last counted height
+    auto it = std::upper_bound(std::begin(segments), std::end(segments), nHeight - 1,
+            [](int nHeight, SubsidySegment const& segment) { return nHeight < segment.nBeginHeight; });
+    assert(it != std::begin(segments));
+    --it;
+    return it->nTotalSupplyBefore + static_cast<CAmount>(nHeight - it->nBeginHeight) * it->nSubsidy;
 }
 
 CAmount GetTotalSupplyBeforeBHDIP009(Consensus::Params const& params) {
@@ -6,6 +6,9 @@
 #include <threadsafety.h>
 #include <consensus/params.h>
 
+#include <map>
+#include <vector>
+
 extern CCriticalSection cs_main;
 
 struct HalvingInfo {
@@ -17,6 +20,22 @@ using HalvingMap = std::map<int, HalvingInfo>;
 
 HalvingMap GenerateBlockSubsidyWithHalvings(CAmount* pnTotalAmount, Consensus::Params const& params);
 
+/** A range of heights on which every block has the same subsidy */
+struct SubsidySegment {
+    int nBeginHeight;
+    CAmount nSubsidy;
+    CAmount nTotalSupplyBefore; //! The total supply of heights [0, nBeginHeight)
+};
+
+/** Segments ordered by height, the first one begins at height 0 and the last one never ends */
+using SubsidySegments = std::vector<SubsidySegment>;
+
+/** Split the subsidy curve into segments by halvings and upgrade multipliers */
+SubsidySegments GenerateSubsidySegments(Consensus::Params const& params);
+
+/** Get the segments from the cache, they are generated once for each set of consensus params */
+SubsidySegments const& GetSubsidySegments(Consensus::Params const& params);
+
 /** Get block subsidy */
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
@@ -0,0 +1,188 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chainparams.h>
+#include <chiapos/block_submitter.h>
+#include <chiapos/kernel/pos.h>
+#include <chiapos/kernel/utils.h>
+#include <random.h>
+#include <validation.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A valid proof of space from a k25 plot, k25 is only allowed by the testnet
+chiapos::CPosProof MakeValidPosProof()
+{
+    chiapos::CPosProof proof;
+    proof.challenge = uint256S("cc5ac4c68e9228f2487aa3d4a0ca067e150ad19f85934f5d97f4355c8c83fdbd");
+    proof.vchLocalPk = chiapos::BytesFromHex(
+            "b1578afd24055235e1a946108b84bab4c27b42f47e0a1f9562e251462b2f7564bd12991abcb9c23df5b62e77ed1f1ce7");
+    proof.vchFarmerPk = chiapos::BytesFromHex(
+            "8b17c85e49be1a2303588b6fe9a0206dc0722c83db2281bb1aee695ae7e97c098672e1609a50b86786126cca3c9c8639");
+    proof.vchPoolPkOrHash = chiapos::BytesFromHex(
+            "92f7dbd5de62bfe6c752c957d7d17af1114500670819dfb149a055edaafcc77bd376b450d43eb1c3208a424b00abe950");
+    proof.nPlotType = static_cast<uint8_t>(chiapos::PlotPubKeyType::OGPlots);
+    proof.nPlotK = 25;
+    proof.vchProof = chiapos::BytesFromHex(
+            "407f849c3b8fa9265751f34a72b57192cca83a5d7d7d2ce935cfde94e91ffa7567dadbe0cdd36e9da11c5ffd6b790b4acbe64a91d6"
+            "e4c2f87b4e0b3f7d130222a3196fe705bbebf47817062f3deea06ea3c71dec4198ceaaa1f7fdad81e616c465bf4e8506a088ccd3ac"
+            "e16f1c0bdf9a9c73edcddc1cf0dcfacd8ef574809c442c9f8ffbd92defb3f520b27de1ae949201d63f618514af50994014f5a522bd"
+            "5b67f6430fa927bda70c39b751c0a9a4a0a864889ed8202aecb283a708378002c5a6cf5f19fe05b31c");
+    return proof;
+}
+
+chiapos::SubmitProofRequest MakeRequest()
+{
+    chiapos::SubmitProofRequest req;
+    {
+        LOCK(cs_main);
+        req.hashPrevBlock = ::ChainActive().Tip()->GetBlockHash();
+        req.nHeightOfPrevBlock = ::ChainActive().Height();
+    }
+    req.vchFarmerSk = chiapos::MakeBytes(InsecureRand256());
+    req.posProof = MakeValidPosProof();
+    // The VDF proof always fails on the size of y
+    req.vdfProof.challenge = InsecureRand256();
+    req.vdfProof.vchY = chiapos::Bytes(10, 0);
+    req.vdfProof.vchProof = chiapos::Bytes(10, 0);
+    req.vdfProof.nVdfIters = 1000;
+    req.vdfProof.nVdfDuration = 10;
+    return req;
+}
+
+//! Submit the request and return the reason it is rejected for
+std::string SubmitRejected(chiapos::CBlockSubmitter& submitter, chiapos::SubmitProofRequest const& req,
+                           CChainParams const& params, chiapos::SubmitProofTimes& times)
+{
+    try {
+        submitter.Submit(req, params, times);
+    } catch (std::runtime_error const& e) {
+        return e.what();
+    }
+    return "";
+}
+
+bool StartsWith(std::string const& str, std::string const& prefix)
+{
+    return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(block_submitter_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(block_submitter_invalid_proofs)
+{
+    auto params = CreateChainParams(CBaseChainParams::TESTNET);
+    chiapos::CBlockSubmitter submitter(2);
+    submitter.Start();
+
+    // The reason of the invalid PoS proof is surfaced
+    chiapos::SubmitProofRequest req = MakeRequest();
+    req.posProof.challenge.SetNull();
+    chiapos::SubmitProofTimes times;
+    std::string strReason = SubmitRejected(submitter, req, *params, times);
+    BOOST_CHECK_MESSAGE(StartsWith(strReason, "invalid proof of space") && strReason.find("zero challenge") != std::string::npos, strReason);
+
+    // The PoS proof is valid, the VDF proof isn't
+    req = MakeRequest();
+    strReason = SubmitRejected(submitter, req, *params, times);
+    BOOST_CHECK_MESSAGE(StartsWith(strReason, "invalid vdf proof") && strReason.find("invalid vdf.y") != std::string::npos, strReason);
+
+    chiapos::SubmitProofStats stats = submitter.GetStats();
+    BOOST_CHECK_EQUAL(stats.nSubmitted, 2U);
+    BOOST_CHECK_EQUAL(stats.nFailed, 2U);
+    BOOST_CHECK_EQUAL(stats.nReleased, 0U);
+    BOOST_CHECK_EQUAL(stats.last.nTotalMicros, times.nTotalMicros);
+    submitter.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(block_submitter_unknown_prev_block)
+{
+    auto params = CreateChainParams(CBaseChainParams::TESTNET);
+    chiapos::CBlockSubmitter submitter(1);
+    submitter.Start();
+
+    chiapos::SubmitProofRequest req = MakeRequest();
+    req.hashPrevBlock = InsecureRand256();
+    chiapos::SubmitProofTimes times;
+    BOOST_CHECK(!submitter.Submit(req, *params, times));
+
+    chiapos::SubmitProofStats stats = submitter.GetStats();
+    BOOST_CHECK_EQUAL(stats.nSubmitted, 1U);
+    BOOST_CHECK_EQUAL(stats.nFailed, 1U);
+    BOOST_CHECK_EQUAL(stats.nReleased, 0U);
+    submitter.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(block_submitter_inline)
+{
+    // The proofs are verified on the calling thread when the submitter isn't started
+    auto params = CreateChainParams(CBaseChainParams::TESTNET);
+    chiapos::CBlockSubmitter submitter(2);
+    chiapos::SubmitProofRequest req = MakeRequest();
+    req.posProof.challenge = InsecureRand256();
+    chiapos::SubmitProofTimes times;
+    std::string strReason = SubmitRejected(submitter, req, *params, times);
+    BOOST_CHECK_MESSAGE(StartsWith(strReason, "invalid proof of space"), strReason);
+    BOOST_CHECK(times.nVerifyMicros > 0);
+    BOOST_CHECK(times.nTotalMicros >= times.nVerifyMicros);
+
+    req.hashPrevBlock = InsecureRand256();
+    BOOST_CHECK(!submitter.Submit(req, *params, times));
+
+    chiapos::SubmitProofStats stats = submitter.GetStats();
+    BOOST_CHECK_EQUAL(stats.nThreads, 2);
+    BOOST_CHECK_EQUAL(stats.nSubmitted, 2U);
+    BOOST_CHECK_EQUAL(stats.nFailed, 2U);
+    // Stopping a submitter which isn't started does nothing
+    submitter.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(block_submitter_stop_drains_queue)
+{
+    auto params = CreateChainParams(CBaseChainParams::TESTNET);
+    chiapos::CBlockSubmitter submitter(1);
+    submitter.Start();
+
+    // Stop the submitter while the submissions are queued, every one of them still gets its proofs verified
+    const int nSubmissions = 8;
+    std::vector<chiapos::SubmitProofRequest> reqs;
+    for (int i = 0; i < nSubmissions; ++i) {
+        reqs.push_back(MakeRequest());
+        reqs.back().posProof.challenge = InsecureRand256();
+    }
+    std::atomic<int> nRejected{0};
+    std::vector<std::thread> threads;
+    for (auto const& req : reqs) {
+        threads.emplace_back([&]() {
+            chiapos::SubmitProofTimes times;
+            std::string strReason = SubmitRejected(submitter, req, *params, times);
+            if (StartsWith(strReason, "invalid proof of space") && strReason.find("cannot verify proof") != std::string::npos) {
+                ++nRejected;
+            }
+        });
+    }
+    submitter.Stop();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    BOOST_CHECK_EQUAL(nRejected.load(), nSubmissions);
+
+    chiapos::SubmitProofStats stats = submitter.GetStats();
+    BOOST_CHECK_EQUAL(stats.nSubmitted, static_cast<uint64_t>(nSubmissions));
+    BOOST_CHECK_EQUAL(stats.nFailed, static_cast<uint64_t>(nSubmissions));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,127 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <chiapos/post.h>
+#include <crypto/common.h>
+#include <random.h>
+#include <util/strencodings.h>
+#include <util/time.h>
+#include <validation.h>
+#if ENABLE_ZMQ
+#include <zmq/zmqpublishnotifier.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static void SetBestBlock(uint256 const& hash)
+{
+    {
+        LOCK(g_best_block_mutex);
+        g_best_block = hash;
+    }
+    g_best_block_cv.notify_all();
+}
+
+BOOST_FIXTURE_TEST_SUITE(challenge_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(challenge_longpoll_new_tip)
+{
+    uint256 hashWatched = InsecureRand256();
+    uint256 hashNew = InsecureRand256();
+    SetBestBlock(hashWatched);
+
+    // The waiting call is woken up by the new tip long before the deadline
+    auto start = std::chrono::steady_clock::now();
+    std::thread tip([&hashNew] {
+        MilliSleep(50);
+        SetBestBlock(hashNew);
+    });
+    BOOST_CHECK(WaitForBestBlockChange(hashWatched, start + std::chrono::seconds(30), [] { return true; }));
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(30));
+    tip.join();
+    {
+        LOCK(g_best_block_mutex);
+        BOOST_CHECK(g_best_block == hashNew);
+    }
+
+    // The tip has already changed, nothing to wait for
+    BOOST_CHECK(WaitForBestBlockChange(hashWatched, std::chrono::steady_clock::now(), [] { return true; }));
+    SetBestBlock(uint256());
+}
+
+BOOST_AUTO_TEST_CASE(challenge_longpoll_timeout)
+{
+    uint256 hashWatched = InsecureRand256();
+    SetBestBlock(hashWatched);
+
+    auto start = std::chrono::steady_clock::now();
+    BOOST_CHECK(!WaitForBestBlockChange(hashWatched, start + std::chrono::milliseconds(100), [] { return true; }));
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(100));
+
+    // The wait is interrupted on shutdown without a new tip
+    std::atomic<bool> fRunning{true};
+    start = std::chrono::steady_clock::now();
+    std::thread shutdown([&fRunning] {
+        MilliSleep(50);
+        fRunning = false;
+        g_best_block_cv.notify_all();
+    });
+    BOOST_CHECK(WaitForBestBlockChange(hashWatched, start + std::chrono::seconds(30), [&fRunning] { return fRunning.load(); }));
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(30));
+    shutdown.join();
+    SetBestBlock(uint256());
+}
+
+#if ENABLE_ZMQ
+BOOST_AUTO_TEST_CASE(challenge_zmq_body_layout)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    const int nFilterHeight = params.BHDIP009PlotIdBitsOfFilterEnableOnHeight;
+    const uint64_t nDifficulty = 123456789;
+
+    // The first chiapos block and a block with the filter enabled and the difficulty from the window
+    uint256 hashFirst = InsecureRand256();
+    CBlockIndex first;
+    first.nHeight = params.BHDIP009Height - 1;
+    first.phashBlock = &hashFirst;
+
+    uint256 hashFilter = InsecureRand256();
+    CBlockIndex filter;
+    filter.nHeight = nFilterHeight - 1;
+    filter.phashBlock = &hashFilter;
+    filter.nChiaWindowBlocks = 3;
+    filter.nChiaDifficultySum = arith_uint256(nDifficulty) * 3;
+    filter.chiaposFields.vdfProof.vchProof = chiapos::MakeBytes(InsecureRand256());
+    filter.chiaposFields.vdfProof.nVdfIters = 3000000;
+    filter.chiaposFields.vdfProof.nVdfDuration = 30;
+
+    for (const CBlockIndex* pindex : {&first, &filter}) {
+        auto data = CZMQPublishChallengeNotifier::MakeChallengeBody(pindex, params);
+        BOOST_REQUIRE_EQUAL(data.size(), 88U);
+        int nTargetHeight = pindex->nHeight + 1;
+
+        // The hashes are in the same byte order as their hex strings
+        BOOST_CHECK_EQUAL(HexStr(data.begin(), data.begin() + 32), chiapos::MakeChallenge(pindex, params).GetHex());
+        BOOST_CHECK_EQUAL(HexStr(data.begin() + 32, data.begin() + 64), pindex->GetBlockHash().GetHex());
+        BOOST_CHECK_EQUAL(static_cast<int32_t>(ReadLE32(data.data() + 64)), nTargetHeight);
+        BOOST_CHECK_EQUAL(ReadLE64(data.data() + 68), pindex == &first ? params.BHDIP009StartDifficulty : nDifficulty);
+        BOOST_CHECK_EQUAL(ReadLE64(data.data() + 76), static_cast<uint64_t>(chiapos::GetBaseIters(nTargetHeight, params, pindex->chiaposFields.GetItersPerSec())));
+        BOOST_CHECK_EQUAL(static_cast<int32_t>(ReadLE32(data.data() + 84)), pindex == &first ? 0 : params.BHDIP009PlotIdBitsOfFilter);
+    }
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -32,4 +32,35 @@ BOOST_AUTO_TEST_CASE(chiafarmerkey_verify)
     BOOST_CHECK(chiapos::BytesToHex(chiapos::MakeBytes(wallet.GetPoolKey(0).GetPubKey())) == SZ_POOL_PK);
 }
 
+BOOST_AUTO_TEST_CASE(chiafarmerkey_batch_verify)
+{
+    chiapos::CWallet wallet(chiapos::CKey::CreateKeyWithMnemonicWords(SZ_PASSPHRASE, ""));
+    std::vector<chiapos::PubKey> pubkeys;
+    std::vector<chiapos::Signature> signatures;
+    std::vector<chiapos::Bytes> vchMessages;
+    for (uint32_t i = 0; i < 8; ++i) {
+        // Two blocks are signed by each farmer key
+        chiapos::CKey key = wallet.GetFarmerKey(i / 2);
+        chiapos::Bytes vchMessage = chiapos::MakeBytes(InsecureRand256());
+        pubkeys.push_back(key.GetPubKey());
+        signatures.push_back(key.Sign(vchMessage));
+        vchMessages.push_back(std::move(vchMessage));
+    }
+    BOOST_CHECK(chiapos::BatchVerifySignatures(pubkeys, signatures, vchMessages));
+    BOOST_CHECK(chiapos::BatchVerifySignatures({}, {}, {}));
+
+    // The sum of the signatures doesn't change when the signatures of a key are swapped, the random factors catch it
+    std::swap(signatures[0], signatures[1]);
+    BOOST_CHECK(!chiapos::VerifySignature(pubkeys[0], signatures[0], vchMessages[0]));
+    BOOST_CHECK(!chiapos::BatchVerifySignatures(pubkeys, signatures, vchMessages));
+    std::swap(signatures[0], signatures[1]);
+
+    vchMessages.back() = chiapos::MakeBytes(InsecureRand256());
+    BOOST_CHECK(!chiapos::BatchVerifySignatures(pubkeys, signatures, vchMessages));
+
+    // A signature which cannot be decoded fails the batch
+    signatures.back().fill(0xff);
+    BOOST_CHECK(!chiapos::BatchVerifySignatures(pubkeys, signatures, vchMessages));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
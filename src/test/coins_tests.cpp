@@ -3,11 +3,14 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <attributes.h>
+#include <chainparams.h>
 #include <clientversion.h>
 #include <coins.h>
+#include <key_io.h>
 #include <script/standard.h>
 #include <streams.h>
 #include <test/setup_common.h>
+#include <txdb.h>
 #include <uint256.h>
 #include <undo.h>
 #include <util/strencodings.h>
@@ -53,7 +56,7 @@ public:
 
     uint256 GetBestBlock() const override { return hashBestBlock_; }
 
-    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase = true) override
     {
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -64,7 +67,11 @@ public:
                     map_.erase(it->first);
                 }
             }
-            mapCoins.erase(it++);
+            if (erase) {
+                mapCoins.erase(it++);
+            } else {
+                ++it;
+            }
         }
         if (!hashBlock.IsNull())
             hashBestBlock_ = hashBlock;
@@ -861,4 +868,163 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_account_balance)
+{
+    // The balances read from the coin database must be the same before and after the coins are flushed
+    CCoinsViewDB db("coins_account_balance", 1 << 20, true, true);
+    CCoinsViewCache view(&db);
+    const PledgeTerms& terms = Params().GetConsensus().BHDIP009PledgeTerms;
+    const CAccountID sender(std::vector<unsigned char>(20, 0x01));
+    const CAccountID receiver(std::vector<unsigned char>(20, 0x02));
+
+    auto addCoin = [&view](const COutPoint& outpoint, const CAccountID& accountID, CAmount nValue, int nHeight, CDatacarrierPayloadRef extraData) {
+        Coin coin(CTxOut(nValue, GetScriptForDestination(ScriptHash(accountID))), nHeight, false);
+        coin.Refresh();
+        coin.extraData = std::move(extraData);
+        view.AddCoin(outpoint, std::move(coin), false);
+    };
+    auto flush = [&view]() {
+        view.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(view.Flush());
+    };
+
+    const COutPoint pointOutpoint(InsecureRand256(), 0);
+    const COutPoint plainOutpoint(pointOutpoint.hash, 1);
+    const COutPoint receiverOutpoint(InsecureRand256(), 0);
+    const COutPoint retargetOutpoint(InsecureRand256(), 0);
+    const COutPoint bindOutpoint(InsecureRand256(), 0);
+
+    auto point = std::make_shared<PointPayload>(DATACARRIER_TYPE_CHIA_POINT_TERM_1);
+    point->receiverID = receiver;
+    addCoin(pointOutpoint, sender, 1001, 1, point);
+    addCoin(plainOutpoint, sender, 500, 1, nullptr);
+    addCoin(receiverOutpoint, receiver, 333, 5, nullptr);
+    auto retarget = std::make_shared<PointRetargetPayload>();
+    retarget->receiverID = sender;
+    retarget->pointType = DATACARRIER_TYPE_CHIA_POINT;
+    retarget->nPointHeight = 1;
+    addCoin(retargetOutpoint, receiver, 999, 1, retarget);
+    auto bind = std::make_shared<BindPlotterPayload>(DATACARRIER_TYPE_BINDPLOTTER);
+    bind->SetId(CPlotterBindData(12345));
+    addCoin(bindOutpoint, sender, 10, 1, bind);
+
+    const CAmount nPointWeighted = terms[1].nWeightPercent * 1001 / 100;
+    const CAmount nRetargetWeighted = terms[0].nWeightPercent * 999 / 100;
+    for (int i = 0; i < 2; ++i) {
+        CAmount balancePointSend, balancePointReceive;
+        BOOST_CHECK_EQUAL(view.GetAccountBalance(true, sender, nullptr, &balancePointSend, &balancePointReceive, &terms, 100), 1511);
+        BOOST_CHECK_EQUAL(balancePointSend, 1001);
+        BOOST_CHECK_EQUAL(balancePointReceive, nRetargetWeighted);
+        BOOST_CHECK_EQUAL(view.GetAccountBalance(true, receiver, nullptr, &balancePointSend, &balancePointReceive, &terms, 100), 1332);
+        BOOST_CHECK_EQUAL(balancePointSend, nRetargetWeighted);
+        BOOST_CHECK_EQUAL(balancePointReceive, nPointWeighted);
+        // Only the coins up to the height are counted
+        BOOST_CHECK_EQUAL(view.GetAccountBalance(false, receiver, nullptr, nullptr, nullptr, nullptr, 3), 999);
+        flush();
+    }
+    CAmount balanceBindPlotter;
+    BOOST_CHECK_EQUAL(view.GetAccountBalance(true, sender, &balanceBindPlotter), 1511);
+    BOOST_CHECK_EQUAL(balanceBindPlotter, PROTOCOL_BINDPLOTTER_LOCKAMOUNT);
+
+    // Withdraw the pledge and spend the coins of the retarget
+    BOOST_CHECK(view.SpendCoin(pointOutpoint));
+    BOOST_CHECK(view.SpendCoin(retargetOutpoint));
+    for (int i = 0; i < 2; ++i) {
+        CAmount balancePointSend, balancePointReceive;
+        BOOST_CHECK_EQUAL(view.GetAccountBalance(true, sender, nullptr, &balancePointSend, &balancePointReceive, &terms, 100), 510);
+        BOOST_CHECK_EQUAL(balancePointSend, 0);
+        BOOST_CHECK_EQUAL(balancePointReceive, 0);
+        BOOST_CHECK_EQUAL(view.GetAccountBalance(true, receiver, nullptr, nullptr, &balancePointReceive, &terms, 100), 333);
+        BOOST_CHECK_EQUAL(balancePointReceive, 0);
+        flush();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_sync_snapshot)
+{
+    // A snapshot of the database taken after a sync must read the same as the cache, which keeps its unspent coins
+    CCoinsViewDB db("coins_sync_snapshot", 1 << 20, true, true);
+    CCoinsViewCache view(&db);
+    const PledgeTerms& terms = Params().GetConsensus().BHDIP009PledgeTerms;
+    const CAccountID sender(std::vector<unsigned char>(20, 0x01));
+    const CAccountID receiver(std::vector<unsigned char>(20, 0x02));
+
+    auto addCoin = [&view](const COutPoint& outpoint, const CAccountID& accountID, CAmount nValue, CDatacarrierPayloadRef extraData) {
+        Coin coin(CTxOut(nValue, GetScriptForDestination(ScriptHash(accountID))), 1, false);
+        coin.Refresh();
+        coin.extraData = std::move(extraData);
+        view.AddCoin(outpoint, std::move(coin), false);
+    };
+
+    const COutPoint pointOutpoint(InsecureRand256(), 0);
+    const COutPoint plainOutpoint(InsecureRand256(), 0);
+    const COutPoint laterOutpoint(InsecureRand256(), 0);
+    auto point = std::make_shared<PointPayload>(DATACARRIER_TYPE_CHIA_POINT);
+    point->receiverID = receiver;
+    addCoin(pointOutpoint, sender, 1001, point);
+    view.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(view.Flush());
+
+    // Withdraw the pledge and receive a coin, none of them is flushed
+    BOOST_CHECK(view.SpendCoin(pointOutpoint));
+    addCoin(plainOutpoint, sender, 200, nullptr);
+    view.SetBestBlock(InsecureRand256());
+    BOOST_CHECK_EQUAL(view.GetCacheSize(), 2U);
+
+    // The spent coin leaves the cache, the received one stays and is no longer dirty
+    BOOST_CHECK(view.Sync());
+    BOOST_CHECK(db.GetBestBlock() == view.GetBestBlock());
+    BOOST_CHECK_EQUAL(view.GetCacheSize(), 1U);
+    BOOST_CHECK(view.HaveCoinInCache(plainOutpoint));
+    BOOST_CHECK(!view.HaveCoinInCache(pointOutpoint));
+    BOOST_CHECK(db.HaveCoin(plainOutpoint));
+    BOOST_CHECK(!db.HaveCoin(pointOutpoint));
+
+    auto snapshotDB = db.CreateSnapshot();
+    CCoinsViewCache snapshotView(snapshotDB.get());
+    BOOST_CHECK(snapshotView.GetBestBlock() == view.GetBestBlock());
+
+    // The coins connected and flushed afterwards are not seen by the snapshot
+    addCoin(laterOutpoint, sender, 300, nullptr);
+    view.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(view.Flush());
+
+    CAmount balancePointReceive;
+    BOOST_CHECK_EQUAL(snapshotView.GetAccountBalance(true, sender), 200);
+    BOOST_CHECK_EQUAL(snapshotView.GetAccountBalance(true, receiver, nullptr, nullptr, &balancePointReceive, &terms, 100), 0);
+    BOOST_CHECK_EQUAL(balancePointReceive, 0);
+    BOOST_CHECK(snapshotView.AccessCoin(pointOutpoint).IsSpent());
+    BOOST_CHECK(snapshotView.HaveCoin(plainOutpoint));
+    BOOST_CHECK(!snapshotView.HaveCoin(laterOutpoint));
+    BOOST_CHECK_EQUAL(view.GetAccountBalance(true, sender), 500);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_burned_balance)
+{
+    // The burned amount is summed up by the periods of the total supply calculation
+    CCoinsViewDB db("coins_burned_balance", 1 << 20, true, true);
+    CCoinsViewCache view(&db);
+    const Consensus::Params& params = Params().GetConsensus();
+    const int nBeginHeight = params.BHDIP009Height;
+    const int nPeriod = params.BHDIP009CalculateDistributedAmountEveryHeights;
+    const CAccountID burnAccountID = GetBurnToAccountID();
+
+    const std::vector<std::pair<int, CAmount>> burned{{nBeginHeight - 1, 1}, {nBeginHeight + 1, 20}, {nBeginHeight + nPeriod, 300}, {nBeginHeight + nPeriod + 1, 4000}};
+    for (auto const& entry : burned) {
+        Coin coin(CTxOut(entry.second, GetScriptForDestination(ScriptHash(burnAccountID))), entry.first, false);
+        coin.Refresh();
+        view.AddCoin(COutPoint(InsecureRand256(), 0), std::move(coin), false);
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK_EQUAL(view.GetAccountBalance(false, burnAccountID, nullptr, nullptr, nullptr, nullptr, nBeginHeight), 1);
+        BOOST_CHECK_EQUAL(view.GetAccountBalance(false, burnAccountID, nullptr, nullptr, nullptr, nullptr, nBeginHeight + 5), 21);
+        BOOST_CHECK_EQUAL(view.GetAccountBalance(false, burnAccountID, nullptr, nullptr, nullptr, nullptr, nBeginHeight + nPeriod), 321);
+        BOOST_CHECK_EQUAL(view.GetAccountBalance(false, burnAccountID, nullptr, nullptr, nullptr, nullptr, nBeginHeight + nPeriod * 2), 4321);
+        BOOST_CHECK_EQUAL(view.GetAccountBalance(false, burnAccountID), 4321);
+        view.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(view.Flush());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -119,6 +119,48 @@ BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
     }
 }
 
+// Test that a snapshot doesn't see the writes made after it
+BOOST_AUTO_TEST_CASE(dbwrapper_snapshot)
+{
+    // Perform tests both obfuscated and non-obfuscated.
+    for (const bool obfuscate : {false, true}) {
+        fs::path ph = GetDataDir() / (obfuscate ? "dbwrapper_snapshot_obfuscate_true" : "dbwrapper_snapshot_obfuscate_false");
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+
+        char key = 'j';
+        uint256 in = InsecureRand256();
+        BOOST_CHECK(dbw.Write(key, in));
+
+        CDBWrapper snapshot(dbw, CDBWrapper::SnapshotTag{});
+        BOOST_CHECK(snapshot.IsSnapshot());
+        BOOST_CHECK(!dbw.IsSnapshot());
+
+        // Overwrite the key and add another one
+        uint256 in_new = InsecureRand256();
+        BOOST_CHECK(dbw.Write(key, in_new));
+        char key2 = 'k';
+        BOOST_CHECK(dbw.Write(key2, InsecureRand256()));
+
+        uint256 res;
+        BOOST_CHECK(snapshot.Read(key, res));
+        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+        BOOST_CHECK(!snapshot.Exists(key2));
+        BOOST_CHECK(dbw.Read(key, res));
+        BOOST_CHECK_EQUAL(res.ToString(), in_new.ToString());
+
+        // The iterator of the snapshot ends before the new key
+        std::unique_ptr<CDBIterator> it(snapshot.NewIterator());
+        it->Seek(key);
+        char key_res;
+        BOOST_REQUIRE(it->GetKey(key_res));
+        BOOST_CHECK_EQUAL(key_res, key);
+        BOOST_REQUIRE(it->GetValue(res));
+        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+        it->Next();
+        BOOST_CHECK_EQUAL(it->Valid(), false);
+    }
+}
+
 // Test that we do not obfuscation if there is existing data.
 BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate)
 {
@@ -0,0 +1,253 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chiapos/harvester.h>
+#include <chiapos/kernel/calc_diff.h>
+#include <chiapos/kernel/pos.h>
+#include <chiapos/kernel/utils.h>
+#include <random.h>
+#include <util/system.h>
+#include <util/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+
+namespace {
+
+// The qualities of a plot are made up from the challenge, the lookups can be slowed down to measure the latency
+class FakePlot final : public chiapos::CHarvesterPlot {
+public:
+    FakePlot(int nQualities, int64_t nLookupMillis, std::shared_ptr<std::atomic<int>> pnLookups,
+             chiapos::PlotId plotId = InsecureRand256())
+            : m_plotId(plotId), m_nQualities(nQualities), m_nLookupMillis(nLookupMillis),
+              m_pnLookups(std::move(pnLookups)) {}
+
+    std::string GetPath() const override { return "fake-" + m_plotId.GetHex() + ".plot"; }
+
+    chiapos::PlotId GetPlotId() const override { return m_plotId; }
+
+    uint8_t GetK() const override { return 32; }
+
+    bool GetQualityString(uint256 const& challenge, std::vector<chiapos::QualityStringPack>& vPacks) const override {
+        ++*m_pnLookups;
+        if (m_nLookupMillis > 0) {
+            MilliSleep(m_nLookupMillis);
+        }
+        for (int i = 0; i < m_nQualities; ++i) {
+            chiapos::QualityStringPack pack;
+            pack.plot_path = GetPath();
+            pack.quality_str.FromBytes(MakeQuality(challenge, i), 256);
+            pack.k = GetK();
+            pack.index = i;
+            vPacks.push_back(std::move(pack));
+        }
+        return true;
+    }
+
+    bool GetFullProof(uint256 const& challenge, int index, chiapos::Bytes& vchProof) const override { return false; }
+
+    bool ReadMemo(chiapos::PlotMemo& memo) const override { return false; }
+
+    chiapos::Bytes MakeQuality(uint256 const& challenge, int index) const {
+        chiapos::Bytes vchData(challenge.begin(), challenge.end());
+        vchData.insert(vchData.end(), m_plotId.begin(), m_plotId.end());
+        vchData.push_back(static_cast<uint8_t>(index));
+        return chiapos::MakeSHA256(vchData);
+    }
+
+private:
+    chiapos::PlotId m_plotId;
+    int m_nQualities;
+    int64_t m_nLookupMillis;
+    std::shared_ptr<std::atomic<int>> m_pnLookups;
+};
+
+chiapos::HarvesterChallenge MakeChallenge(int nBitsOfFilter)
+{
+    chiapos::HarvesterChallenge challenge;
+    challenge.challenge = InsecureRand256();
+    challenge.nTargetHeight = 100;
+    challenge.nDifficulty = 1000;
+    challenge.nBitsOfFilter = nBitsOfFilter;
+    challenge.nBaseIters = 10;
+    challenge.nDifficultyConstantFactorBits = 30;
+    return challenge;
+}
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(harvester_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(harvester_lookup_without_plots)
+{
+    fs::path dir = GetDataDir() / "plots";
+    fs::create_directories(dir);
+    // Neither of the files can be opened as a plot
+    std::ofstream((dir / "not_a_plot.plot").string()) << "not a plot";
+    std::ofstream((dir / "readme.txt").string()) << "not a plot";
+
+    chiapos::CHarvester harvester(2);
+    BOOST_CHECK_EQUAL(harvester.LoadPlots({dir, dir / "missing"}), 0);
+    harvester.Start();
+
+    chiapos::HarvesterChallenge challenge;
+    std::vector<chiapos::HarvestedQuality> vQualities;
+    BOOST_CHECK(!harvester.GetQualities(challenge, vQualities));
+
+    challenge.challenge = InsecureRand256();
+    challenge.nTargetHeight = 100;
+    harvester.NewChallenge(challenge);
+    BOOST_CHECK(harvester.WaitForLookups(challenge.challenge, 10000));
+
+    chiapos::HarvesterChallenge latest;
+    BOOST_CHECK(harvester.GetQualities(latest, vQualities));
+    BOOST_CHECK(latest.challenge == challenge.challenge);
+    BOOST_CHECK_EQUAL(latest.nTargetHeight, 100);
+    BOOST_CHECK(vQualities.empty());
+
+    chiapos::HarvesterStats stats = harvester.GetStats();
+    BOOST_CHECK_EQUAL(stats.nPlots, 0U);
+    BOOST_CHECK_EQUAL(stats.nChallenges, 1U);
+    BOOST_CHECK_EQUAL(stats.nThreads, 2);
+    BOOST_CHECK(harvester.GetPlotStats().empty());
+
+    harvester.Stop();
+    // Nothing to wait for after the harvester is stopped
+    BOOST_CHECK(!harvester.WaitForLookups(InsecureRand256(), 1));
+}
+
+BOOST_AUTO_TEST_CASE(harvester_plot_filter)
+{
+    // A quarter of the plots pass the filter, only those are read
+    const int nBitsOfFilter = 2;
+    chiapos::CHarvester harvester(4);
+    std::vector<chiapos::PlotId> vPlotIds;
+    std::vector<std::shared_ptr<std::atomic<int>>> vLookups;
+    for (int i = 0; i < 32; ++i) {
+        vLookups.push_back(std::make_shared<std::atomic<int>>(0));
+        std::unique_ptr<FakePlot> plot(new FakePlot(1, 0, vLookups.back()));
+        vPlotIds.push_back(plot->GetPlotId());
+        BOOST_CHECK(harvester.AddPlot(std::move(plot)));
+    }
+    harvester.Start();
+
+    // Make sure there are plots on both sides of the filter
+    chiapos::HarvesterChallenge challenge;
+    int nPassed;
+    do {
+        challenge = MakeChallenge(nBitsOfFilter);
+        nPassed = std::count_if(vPlotIds.begin(), vPlotIds.end(), [&challenge](chiapos::PlotId const& plotId) {
+            return chiapos::PassesFilter(plotId, challenge.challenge, nBitsOfFilter);
+        });
+    } while (nPassed == 0 || nPassed == static_cast<int>(vPlotIds.size()));
+
+    harvester.NewChallenge(challenge);
+    BOOST_CHECK(harvester.WaitForLookups(challenge.challenge, 10000));
+
+    chiapos::HarvesterChallenge latest;
+    std::vector<chiapos::HarvestedQuality> vQualities;
+    BOOST_CHECK(harvester.GetQualities(latest, vQualities));
+    BOOST_CHECK_EQUAL(vQualities.size(), static_cast<std::size_t>(nPassed));
+    for (auto const& quality : vQualities) {
+        BOOST_CHECK(chiapos::PassesFilter(quality.plotId, challenge.challenge, nBitsOfFilter));
+    }
+    auto vPlotStats = harvester.GetPlotStats();
+    BOOST_REQUIRE_EQUAL(vPlotStats.size(), vPlotIds.size());
+    for (std::size_t i = 0; i < vPlotIds.size(); ++i) {
+        bool fPassed = chiapos::PassesFilter(vPlotIds[i], challenge.challenge, nBitsOfFilter);
+        BOOST_CHECK(vPlotStats[i].plotId == vPlotIds[i]);
+        BOOST_CHECK_EQUAL(vLookups[i]->load(), fPassed ? 1 : 0);
+        BOOST_CHECK_EQUAL(vPlotStats[i].nLookups, fPassed ? 1U : 0U);
+        BOOST_CHECK_EQUAL(vPlotStats[i].nQualities, fPassed ? 1U : 0U);
+    }
+
+    // The same plot cannot be added twice
+    harvester.Stop();
+    auto pnLookups = std::make_shared<std::atomic<int>>(0);
+    std::unique_ptr<FakePlot> plot(new FakePlot(1, 0, pnLookups));
+    chiapos::PlotId plotId = plot->GetPlotId();
+    BOOST_CHECK(harvester.AddPlot(std::move(plot)));
+    BOOST_CHECK(!harvester.AddPlot(std::unique_ptr<FakePlot>(new FakePlot(1, 0, pnLookups, plotId))));
+}
+
+BOOST_AUTO_TEST_CASE(harvester_sort_by_iters)
+{
+    chiapos::CHarvester harvester(3);
+    std::vector<FakePlot const*> vPlots;
+    for (int i = 0; i < 8; ++i) {
+        std::unique_ptr<FakePlot> plot(new FakePlot(3, 0, std::make_shared<std::atomic<int>>(0)));
+        vPlots.push_back(plot.get());
+        BOOST_CHECK(harvester.AddPlot(std::move(plot)));
+    }
+    harvester.Start();
+
+    // No filter, all of the qualities from all of the plots are collected
+    chiapos::HarvesterChallenge challenge = MakeChallenge(0);
+    harvester.NewChallenge(challenge);
+    BOOST_CHECK(harvester.WaitForLookups(challenge.challenge, 10000));
+
+    chiapos::HarvesterChallenge latest;
+    std::vector<chiapos::HarvestedQuality> vQualities;
+    BOOST_CHECK(harvester.GetQualities(latest, vQualities));
+    BOOST_CHECK(latest.challenge == challenge.challenge);
+    BOOST_REQUIRE_EQUAL(vQualities.size(), 24U);
+    BOOST_CHECK(std::is_sorted(vQualities.begin(), vQualities.end(),
+                               [](chiapos::HarvestedQuality const& lhs, chiapos::HarvestedQuality const& rhs) {
+                                   return lhs.nIters < rhs.nIters;
+                               }));
+    for (auto const& quality : vQualities) {
+        auto it = std::find_if(vPlots.begin(), vPlots.end(),
+                               [&quality](FakePlot const* plot) { return plot->GetPlotId() == quality.plotId; });
+        BOOST_REQUIRE(it != vPlots.end());
+        uint256 mixedQualityString =
+                chiapos::GetMixedQualityString((*it)->MakeQuality(challenge.challenge, quality.index), challenge.challenge);
+        BOOST_CHECK(quality.mixedQualityString == mixedQualityString);
+        BOOST_CHECK_EQUAL(quality.nIters,
+                          chiapos::CalculateIterationsQuality(mixedQualityString, challenge.nDifficulty,
+                                                              challenge.nBitsOfFilter,
+                                                              challenge.nDifficultyConstantFactorBits, quality.k,
+                                                              challenge.nBaseIters));
+    }
+    harvester.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(harvester_lookup_latency)
+{
+    const int64_t nLookupMillis = 20;
+    chiapos::CHarvester harvester(2);
+    auto pnLookups = std::make_shared<std::atomic<int>>(0);
+    BOOST_CHECK(harvester.AddPlot(std::unique_ptr<FakePlot>(new FakePlot(2, nLookupMillis, pnLookups))));
+    harvester.Start();
+
+    for (int i = 1; i <= 2; ++i) {
+        chiapos::HarvesterChallenge challenge = MakeChallenge(0);
+        harvester.NewChallenge(challenge);
+        BOOST_CHECK(harvester.WaitForLookups(challenge.challenge, 10000));
+
+        auto vPlotStats = harvester.GetPlotStats();
+        BOOST_REQUIRE_EQUAL(vPlotStats.size(), 1U);
+        auto const& stats = vPlotStats[0];
+        BOOST_CHECK_EQUAL(stats.nLookups, static_cast<uint64_t>(i));
+        BOOST_CHECK_EQUAL(stats.nQualities, static_cast<uint64_t>(i * 2));
+        BOOST_CHECK(stats.nLastLookupMicros >= nLookupMillis * 1000);
+        BOOST_CHECK(stats.nMaxLookupMicros >= stats.nLastLookupMicros);
+        BOOST_CHECK(stats.nTotalLookupMicros >= i * nLookupMillis * 1000);
+        BOOST_CHECK(stats.nTotalLookupMicros >= stats.nMaxLookupMicros);
+
+        // The latency of the challenge covers the lookup of the plot
+        chiapos::HarvesterStats harvesterStats = harvester.GetStats();
+        BOOST_CHECK_EQUAL(harvesterStats.nChallenges, static_cast<uint64_t>(i));
+        BOOST_CHECK(harvesterStats.nLastChallengeMicros >= stats.nLastLookupMicros);
+    }
+    BOOST_CHECK_EQUAL(pnLookups->load(), 2);
+    harvester.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
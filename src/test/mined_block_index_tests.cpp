@@ -0,0 +1,141 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <script/script.h>
+#include <test/setup_common.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chiapos/mined_block_index.h>
+
+#include <memory>
+
+static chiapos::Bytes MakeFarmerPk(uint8_t n) {
+    return chiapos::Bytes(chiapos::PK_LEN, n);
+}
+
+/** Append blocks to the chain, the block is mined by a farmer-pk when the id is less than 100, or a plotter-id */
+static void ExtendChain(std::vector<std::unique_ptr<CBlockIndex>>& blocks, CBlockIndex* pprev, std::vector<int> const& ids) {
+    for (int id : ids) {
+        blocks.emplace_back(new CBlockIndex());
+        CBlockIndex* pindex = blocks.back().get();
+        pindex->pprev = pprev;
+        pindex->nHeight = pprev ? pprev->nHeight + 1 : 0;
+        if (id < 100) {
+            pindex->chiaposFields.posProof.vchFarmerPk = MakeFarmerPk(static_cast<uint8_t>(id));
+        } else {
+            pindex->nPlotterId = id;
+        }
+        pindex->BuildSkip();
+        pprev = pindex;
+    }
+}
+
+BOOST_FIXTURE_TEST_SUITE(mined_block_index_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(mined_block_index_count)
+{
+    std::vector<std::unique_ptr<CBlockIndex>> blocks;
+    // Heights 0..4 are burst blocks, 5..11 are chia blocks
+    ExtendChain(blocks, nullptr, {100, 101, 100, 102, 101, 1, 2, 1, 3, 1, 2, 1});
+    CBlockIndex* pindexTip = blocks.back().get();
+
+    chiapos::CMinedBlockIndex index;
+    std::set<CPlotterBindData> farmers{CPlotterBindData(CChiaFarmerPk(MakeFarmerPk(1))), CPlotterBindData(CChiaFarmerPk(MakeFarmerPk(3)))};
+    BOOST_CHECK_EQUAL(index.CountMinedBlocks(pindexTip, farmers, 0, 11), 5);
+    BOOST_CHECK_EQUAL(index.CountMinedBlocks(pindexTip, farmers, 8, 10), 2);
+    BOOST_CHECK(index.GetMinedHeights(pindexTip, farmers, 6, 11) == std::vector<int>({7, 8, 9, 11}));
+
+    std::set<CPlotterBindData> plotters{CPlotterBindData(uint64_t(100)), CPlotterBindData(uint64_t(102))};
+    BOOST_CHECK_EQUAL(index.CountMinedBlocks(pindexTip, plotters, 0, 11), 3);
+    BOOST_CHECK(index.GetMinedHeights(pindexTip, plotters, 1, 4) == std::vector<int>({2, 3}));
+
+    // Nothing is mined by an unknown farmer-pk
+    std::set<CPlotterBindData> unknown{CPlotterBindData(CChiaFarmerPk(MakeFarmerPk(9)))};
+    BOOST_CHECK_EQUAL(index.CountMinedBlocks(pindexTip, unknown, 0, 11), 0);
+
+    auto stats = index.GetStats();
+    BOOST_CHECK_EQUAL(stats.nBlocks, 12U);
+    BOOST_CHECK_EQUAL(stats.nFarmerPks, 3U);
+    BOOST_CHECK_EQUAL(stats.nPlotterIds, 3U);
+    BOOST_CHECK_EQUAL(stats.nTipHeight, 11);
+}
+
+BOOST_AUTO_TEST_CASE(mined_block_index_reorg)
+{
+    std::vector<std::unique_ptr<CBlockIndex>> blocks;
+    ExtendChain(blocks, nullptr, {1, 2, 1, 2, 1});
+    CBlockIndex* pindexFork = blocks[2].get();
+    CBlockIndex* pindexTipA = blocks.back().get();
+    ExtendChain(blocks, pindexFork, {3, 3, 3, 2});
+    CBlockIndex* pindexTipB = blocks.back().get();
+
+    std::set<CPlotterBindData> farmer1{CPlotterBindData(CChiaFarmerPk(MakeFarmerPk(1)))};
+    std::set<CPlotterBindData> farmer3{CPlotterBindData(CChiaFarmerPk(MakeFarmerPk(3)))};
+
+    chiapos::CMinedBlockIndex index;
+    index.SetTip(pindexTipA);
+    BOOST_CHECK_EQUAL(index.CountMinedBlocks(pindexTipA, farmer1, 0, 4), 3);
+    BOOST_CHECK_EQUAL(index.CountMinedBlocks(pindexTipA, farmer3, 0, 4), 0);
+
+    // Switch to the other branch, the blocks after the fork are replaced
+    BOOST_CHECK_EQUAL(index.CountMinedBlocks(pindexTipB, farmer1, 0, 6), 2);
+    BOOST_CHECK(index.GetMinedHeights(pindexTipB, farmer3, 0, 6) == std::vector<int>({3, 4, 5}));
+    BOOST_CHECK_EQUAL(index.GetStats().nTipHeight, 6);
+
+    // Disconnect back to the fork
+    index.SetTip(pindexFork);
+    BOOST_CHECK_EQUAL(index.CountMinedBlocks(pindexFork, farmer3, 0, 2), 0);
+    BOOST_CHECK_EQUAL(index.GetStats().nBlocks, 3U);
+}
+
+BOOST_AUTO_TEST_CASE(mined_block_index_reset)
+{
+    std::set<CPlotterBindData> farmer1{CPlotterBindData(CChiaFarmerPk(MakeFarmerPk(1)))};
+    chiapos::CMinedBlockIndex index;
+    {
+        std::vector<std::unique_ptr<CBlockIndex>> blocks;
+        ExtendChain(blocks, nullptr, {1, 2, 1, 1});
+        BOOST_CHECK_EQUAL(index.CountMinedBlocks(blocks.back().get(), farmer1, 0, 3), 3);
+        index.Reset();
+    }
+    // The freed blocks are not touched, the index starts over on the new chain
+    auto stats = index.GetStats();
+    BOOST_CHECK_EQUAL(stats.nBlocks, 0U);
+    BOOST_CHECK_EQUAL(stats.nTipHeight, -1);
+
+    std::vector<std::unique_ptr<CBlockIndex>> blocks;
+    ExtendChain(blocks, nullptr, {2, 1});
+    BOOST_CHECK_EQUAL(index.CountMinedBlocks(blocks.back().get(), farmer1, 0, 1), 1);
+    BOOST_CHECK_EQUAL(index.GetStats().nBlocks, 2U);
+}
+
+BOOST_FIXTURE_TEST_CASE(mined_block_index_unload_block_index, TestChain100Setup)
+{
+    CChainParams const& chainparams = Params();
+    ::ChainstateActive().ForceFlushStateToDisk();
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chiapos::g_mined_block_index.GetStats().nTipHeight, 100);
+        UnloadBlockIndex();
+        auto stats = chiapos::g_mined_block_index.GetStats();
+        BOOST_CHECK_EQUAL(stats.nBlocks, 0U);
+        BOOST_CHECK_EQUAL(stats.nTipHeight, -1);
+
+        BOOST_REQUIRE(LoadBlockIndex(chainparams));
+        BOOST_REQUIRE(::ChainstateActive().LoadChainTip(chainparams));
+        BOOST_CHECK_EQUAL(::ChainActive().Height(), 100);
+    }
+
+    // The next tip is indexed from the reloaded block indexes
+    CreateAndProcessBlock({}, CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG);
+    auto stats = chiapos::g_mined_block_index.GetStats();
+    BOOST_CHECK_EQUAL(stats.nTipHeight, 101);
+    BOOST_CHECK_EQUAL(stats.nBlocks, 102U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
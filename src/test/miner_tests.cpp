@@ -7,14 +7,18 @@
 #include <consensus/consensus.h>
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
+#include <consensus/validation.h>
+#include <key.h>
 #include <miner.h>
 #include <policy/policy.h>
+#include <script/interpreter.h>
 #include <script/standard.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 #include <util/time.h>
+#include <util/validation.h>
 #include <validation.h>
 
 #include <test/setup_common.h>
@@ -520,4 +524,101 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+
+static CMutableTransaction SpendCoinbase(const CTransactionRef& txCoinbase, const CKey& key, CAmount nFee)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction tx;
+    tx.nVersion = 1;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(txCoinbase->GetHash(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = txCoinbase->vout[0].nValue - nFee;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    return tx;
+}
+
+static bool ToMemPool(const CMutableTransaction& tx)
+{
+    LOCK(cs_main);
+    CValidationState state;
+    return AcceptToMemoryPool(mempool, state, MakeTransactionRef(tx), nullptr /* pfMissingInputs */,
+                              nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */);
+}
+
+BOOST_FIXTURE_TEST_CASE(chia_block_candidate, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // The builder isn't started, so the candidates are only selected by GetChiaBlockCandidate, the tip and mempool
+    // changes are still delivered to it
+    g_chia_candidate_builder = MakeUnique<CChiaBlockCandidateBuilder>(chainparams);
+    RegisterValidationInterface(g_chia_candidate_builder.get());
+
+    std::vector<CMutableTransaction> spends{SpendCoinbase(m_coinbase_txns[0], coinbaseKey, CENT),
+                                            SpendCoinbase(m_coinbase_txns[1], coinbaseKey, 2 * CENT)};
+    BOOST_CHECK(ToMemPool(spends[0]));
+
+    // The candidate is reused on the same tip
+    std::shared_ptr<const CChiaBlockCandidate> candidate;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexTip = ::ChainActive().Tip();
+        candidate = GetChiaBlockCandidate(chainparams, pindexTip);
+        BOOST_CHECK(candidate->hashPrevBlock == pindexTip->GetBlockHash());
+        BOOST_CHECK_EQUAL(candidate->vtx.size(), 1U);
+        BOOST_CHECK_EQUAL(candidate->nFees, CENT);
+        BOOST_CHECK(GetChiaBlockCandidate(chainparams, pindexTip) == candidate);
+        BOOST_CHECK(g_chia_candidate_builder->Get(pindexTip) == candidate);
+    }
+
+    // The candidate is stale after the mempool change, it's still used on the same tip and the block is valid
+    BOOST_CHECK(ToMemPool(spends[1]));
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(g_chia_candidate_builder->GetStats().fStale);
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexTip = ::ChainActive().Tip();
+        BOOST_CHECK(GetChiaBlockCandidate(chainparams, pindexTip) == candidate);
+
+        // Take the coinbase from a template of the current mempool, it pays the fees of the stale candidate only
+        std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(scriptPubKey);
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3U);
+        CBlock block = pblocktemplate->block;
+        CMutableTransaction txCoinbase(*block.vtx[0]);
+        txCoinbase.vout[0].nValue -= -pblocktemplate->vTxFees[0] - candidate->nFees;
+        block.vtx.assign(1, MakeTransactionRef(std::move(txCoinbase)));
+        block.vtx.insert(block.vtx.end(), candidate->vtx.begin(), candidate->vtx.end());
+        block.hashMerkleRoot = BlockMerkleRoot(block);
+        CValidationState state;
+        BOOST_CHECK_MESSAGE(TestBlockValidity(state, chainparams, block, ::ChainActive().Tip(), false, false), FormatStateMessage(state));
+    }
+
+    // The candidate is dropped on a new tip
+    mempool.clear();
+    CreateAndProcessBlock({}, scriptPubKey);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(!g_chia_candidate_builder->GetStats().fReady);
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexTip = ::ChainActive().Tip();
+        BOOST_CHECK(pindexTip->GetBlockHash() != candidate->hashPrevBlock);
+        BOOST_CHECK(g_chia_candidate_builder->Get(pindexTip) == nullptr);
+        std::shared_ptr<const CChiaBlockCandidate> candidateNew = GetChiaBlockCandidate(chainparams, pindexTip);
+        BOOST_CHECK(candidateNew->hashPrevBlock == pindexTip->GetBlockHash());
+        BOOST_CHECK(candidateNew->vtx.empty());
+        BOOST_CHECK(g_chia_candidate_builder->Get(pindexTip) == candidateNew);
+    }
+
+    UnregisterValidationInterface(g_chia_candidate_builder.get());
+    g_chia_candidate_builder.reset();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
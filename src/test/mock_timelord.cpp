@@ -0,0 +1,135 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/mock_timelord.h>
+
+#include <chiapos/kernel/utils.h>
+#include <chiapos/timelord_cli/msg_ids.h>
+
+#include <univalue.h>
+
+#include <deque>
+#include <functional>
+#include <string>
+
+struct MockTimelord::Session : public std::enable_shared_from_this<MockTimelord::Session> {
+    explicit Session(asio::io_context& ioc) : s(ioc) {}
+
+    void Send(UniValue const& msg)
+    {
+        bool do_send = sending_msgs.empty();
+        sending_msgs.push_back(msg.write() + '\0');
+        if (do_send) {
+            DoSendNext();
+        }
+    }
+
+    void DoReadNext()
+    {
+        asio::async_read_until(s, read_buf, '\0', [self = shared_from_this()](error_code const& ec, std::size_t bytes) {
+            if (ec) {
+                return;
+            }
+            std::string str(static_cast<char const*>(self->read_buf.data().data()), bytes - 1);
+            self->read_buf.consume(bytes);
+            self->msg_handler(self, str);
+            self->DoReadNext();
+        });
+    }
+
+    void DoSendNext()
+    {
+        asio::async_write(s, asio::buffer(sending_msgs.front()), [self = shared_from_this()](error_code const& ec, std::size_t) {
+            if (ec) {
+                return;
+            }
+            self->sending_msgs.pop_front();
+            if (!self->sending_msgs.empty()) {
+                self->DoSendNext();
+            }
+        });
+    }
+
+    tcp::socket s;
+    std::function<void(std::shared_ptr<Session>, std::string const&)> msg_handler;
+    asio::streambuf read_buf;
+    std::deque<std::string> sending_msgs;
+};
+
+MockTimelord::MockTimelord(asio::io_context& ioc, uint64_t proof_iters, std::chrono::milliseconds proof_delay, unsigned short port)
+    : ioc_(ioc), acceptor_(ioc, tcp::endpoint(asio::ip::address_v4::loopback(), port)), proof_iters_(proof_iters), proof_delay_(proof_delay)
+{
+    port_ = acceptor_.local_endpoint().port();
+    DoAccept();
+}
+
+MockTimelord::~MockTimelord() {}
+
+void MockTimelord::Close()
+{
+    error_code ignored_ec;
+    acceptor_.close(ignored_ec);
+    for (auto const& wp : sessions_) {
+        auto psession = wp.lock();
+        if (psession) {
+            psession->s.shutdown(tcp::socket::shutdown_both, ignored_ec);
+            psession->s.close(ignored_ec);
+        }
+    }
+    sessions_.clear();
+}
+
+void MockTimelord::DoAccept()
+{
+    auto psession = std::make_shared<Session>(ioc_);
+    acceptor_.async_accept(psession->s, [this, psession](error_code const& ec) {
+        if (ec) {
+            return;
+        }
+        sessions_.push_back(psession);
+        psession->msg_handler = [this](std::shared_ptr<Session> psession, std::string const& str) { HandleMessage(psession, str); };
+        psession->DoReadNext();
+        DoAccept();
+    });
+}
+
+void MockTimelord::HandleMessage(std::shared_ptr<Session> psession, std::string const& str)
+{
+    UniValue msg;
+    if (!msg.read(str)) {
+        return;
+    }
+    int msg_id = msg["id"].get_int();
+    if (msg_id == static_cast<int>(TimelordClientMsgs::PING)) {
+        UniValue pong(UniValue::VOBJ);
+        pong.pushKV("id", static_cast<int>(TimelordMsgs::PONG));
+        psession->Send(pong);
+    } else if (msg_id == static_cast<int>(TimelordClientMsgs::CALC)) {
+        ++num_calcs_;
+        std::string challenge = msg["challenge"].get_str();
+        UniValue reply(UniValue::VOBJ);
+        reply.pushKV("id", static_cast<int>(TimelordMsgs::CALC_REPLY));
+        reply.pushKV("challenge", challenge);
+        reply.pushKV("calculating", true);
+        psession->Send(reply);
+
+        auto ptimer = std::make_shared<asio::steady_timer>(ioc_);
+        ptimer->expires_after(proof_delay_);
+        uint64_t iters = proof_iters_;
+        ptimer->async_wait([psession, ptimer, challenge, iters](error_code const& ec) {
+            if (ec || !psession->s.is_open()) {
+                return;
+            }
+            UniValue proof(UniValue::VOBJ);
+            proof.pushKV("id", static_cast<int>(TimelordMsgs::PROOF));
+            proof.pushKV("challenge", challenge);
+            proof.pushKV("y", chiapos::BytesToHex(Bytes(100, static_cast<uint8_t>(iters))));
+            proof.pushKV("proof", chiapos::BytesToHex(Bytes(100, 0x01)));
+            proof.pushKV("witness_type", 0);
+            proof.pushKV("iters", iters);
+            proof.pushKV("duration", 1);
+            psession->Send(proof);
+        });
+    }
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TEST_MOCK_TIMELORD_H
+#define BITCOIN_TEST_MOCK_TIMELORD_H
+
+#include <chiapos/timelord_cli/timelord_client.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * A local timelord for the tests of the timelord clients. It listens on 127.0.0.1 with the port, or a port picked by
+ * the system when it's 0, answers PING with PONG, and answers CALC with CALC_REPLY and a PROOF of the configured iters after the delay.
+ */
+class MockTimelord {
+public:
+    MockTimelord(asio::io_context& ioc, uint64_t proof_iters, std::chrono::milliseconds proof_delay, unsigned short port = 0);
+
+    ~MockTimelord();
+
+    unsigned short GetPort() const { return port_; }
+
+    int GetNumCalcs() const { return num_calcs_; }
+
+    /** Stop accepting and close the connections, it should be called from the thread of the io_context */
+    void Close();
+
+private:
+    struct Session;
+
+    void DoAccept();
+
+    void HandleMessage(std::shared_ptr<Session> psession, std::string const& str);
+
+    asio::io_context& ioc_;
+    tcp::acceptor acceptor_;
+    unsigned short port_;
+    uint64_t const proof_iters_;
+    std::chrono::milliseconds const proof_delay_;
+    std::atomic<int> num_calcs_{0};
+    std::vector<std::weak_ptr<Session>> sessions_;
+};
+
+#endif // BITCOIN_TEST_MOCK_TIMELORD_H
@@ -0,0 +1,170 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <test/setup_common.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chiapos/mortgage_calculator.h>
+#include <chiapos/mortgage_ledger.h>
+
+#include <memory>
+
+static Consensus::Params MakeParams() {
+    Consensus::Params params = Params().GetConsensus();
+    params.BHDIP009Height = 10;
+    params.BHDIP011Height = 20;
+    params.BHDIP011NumHeightsToCalcDistributionPercentageOfFullMortgage = 8;
+    params.BHDIP011MinFullMortgageBlocksToDistribute = 3;
+    return params;
+}
+
+/** Append random blocks to the chain, about a third of them are not full mortgage blocks */
+static void ExtendChain(std::vector<std::unique_ptr<CBlockIndex>>& blocks, CBlockIndex* pprev, int nCount) {
+    for (int i = 0; i < nCount; ++i) {
+        blocks.emplace_back(new CBlockIndex());
+        CBlockIndex* pindex = blocks.back().get();
+        pindex->pprev = pprev;
+        pindex->nHeight = pprev ? pprev->nHeight + 1 : 0;
+        if (InsecureRandRange(3) == 0) {
+            pindex->nStatus |= BLOCK_UNCONDITIONAL;
+        }
+        pindex->nAccumulateSubsidy = InsecureRandRange(1000 * COIN);
+        pindex->BuildSkip();
+        pprev = pindex;
+    }
+}
+
+static int CountFullMortgageBlocks(CBlockIndex const* pindex, int nBeginHeight, Consensus::Params const& params) {
+    int nCount{0};
+    for (; pindex != nullptr && pindex->nHeight >= nBeginHeight; pindex = pindex->pprev) {
+        if (CMortgageCalculator::IsFullMortgageBlock(pindex, params)) {
+            ++nCount;
+        }
+    }
+    return nCount;
+}
+
+/** Calculate the accumulated amount by walking back through all full mortgage blocks since BHDIP011 */
+static CAmount CalcExpectedAmount(CBlockIndex const* pindexPrev, Consensus::Params const& params,
+                                  std::map<int, CAmount>& mapContributions) {
+    auto calc_distributions = [&params, pindexPrev](int nHeight) {
+        int nCount = CountFullMortgageBlocks(pindexPrev->GetAncestor(nHeight - 1),
+                std::max(params.BHDIP009Height, nHeight - params.BHDIP011NumHeightsToCalcDistributionPercentageOfFullMortgage), params);
+        return std::max(params.BHDIP011MinFullMortgageBlocksToDistribute, nCount);
+    };
+    CAmount nTotal{0};
+    for (auto pindex = pindexPrev; pindex->nHeight >= params.BHDIP011Height; pindex = pindex->pprev) {
+        if (!CMortgageCalculator::IsFullMortgageBlock(pindex, params)) {
+            continue;
+        }
+        int nDistributions = calc_distributions(pindex->nHeight);
+        int nDistributed = CountFullMortgageBlocks(pindexPrev, pindex->nHeight, params);
+        CAmount nAmount = pindex->pprev->nAccumulateSubsidy / nDistributions;
+        if (nDistributed < nDistributions && nAmount > 0) {
+            nTotal += nAmount;
+            mapContributions[pindex->nHeight] = nAmount;
+        }
+    }
+    return nTotal + pindexPrev->nAccumulateSubsidy / calc_distributions(pindexPrev->nHeight + 1);
+}
+
+BOOST_FIXTURE_TEST_SUITE(mortgage_ledger_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(mortgage_ledger_accumulated)
+{
+    LOCK(cs_main);
+    Consensus::Params params = MakeParams();
+    std::vector<std::unique_ptr<CBlockIndex>> blocks;
+    ExtendChain(blocks, nullptr, 100);
+    CBlockIndex* pindexTip = blocks.back().get();
+
+    CMortgageLedger ledger;
+    // The ledger follows the blocks one by one and reads the total from the running sum
+    for (auto const& block : blocks) {
+        ledger.SetTip(block.get(), params);
+        if (block->nHeight + 1 < params.BHDIP011Height) {
+            continue;
+        }
+        std::map<int, CAmount> mapExpected;
+        CAmount nExpected = CalcExpectedAmount(block.get(), params, mapExpected);
+        BOOST_CHECK_EQUAL(ledger.GetAccumulatedAmount(block.get(), block->nHeight + 1, params), nExpected);
+    }
+
+    // The amounts of the previous targets are listed from the entries
+    for (int nTargetHeight = params.BHDIP011Height; nTargetHeight <= pindexTip->nHeight + 1; ++nTargetHeight) {
+        std::map<int, CAmount> mapExpected, mapContributions;
+        CAmount nExpected = CalcExpectedAmount(pindexTip->GetAncestor(nTargetHeight - 1), params, mapExpected);
+        BOOST_CHECK_EQUAL(ledger.GetAccumulatedAmount(pindexTip, nTargetHeight, params, &mapContributions), nExpected);
+        BOOST_CHECK(mapContributions == mapExpected);
+    }
+
+    BOOST_CHECK_EQUAL(ledger.CountFullMortgageBlocks(pindexTip, params.BHDIP009Height, pindexTip->nHeight, params),
+                      CountFullMortgageBlocks(pindexTip, params.BHDIP009Height, params));
+}
+
+BOOST_AUTO_TEST_CASE(mortgage_ledger_reorg)
+{
+    LOCK(cs_main);
+    Consensus::Params params = MakeParams();
+    std::vector<std::unique_ptr<CBlockIndex>> blocks;
+    ExtendChain(blocks, nullptr, 60);
+    CBlockIndex* pindexFork = blocks[40].get();
+    CBlockIndex* pindexTipA = blocks.back().get();
+    ExtendChain(blocks, pindexFork, 30);
+    CBlockIndex* pindexTipB = blocks.back().get();
+
+    CMortgageLedger ledger;
+    for (int i = 0; i < 2; ++i) {
+        for (CBlockIndex* pindexTip : {pindexTipA, pindexTipB, pindexFork}) {
+            ledger.SetTip(pindexTip, params);
+            std::map<int, CAmount> mapExpected;
+            CAmount nExpected = CalcExpectedAmount(pindexTip, params, mapExpected);
+            BOOST_CHECK_EQUAL(ledger.GetAccumulatedAmount(pindexTip, pindexTip->nHeight + 1, params), nExpected);
+        }
+    }
+
+    // The distributions of a full mortgage block are counted on the chain
+    for (auto pindex = pindexTipB; pindex->nHeight >= params.BHDIP011Height; pindex = pindex->pprev) {
+        CMortgageLedger::Distribution distribution;
+        bool fFullMortgage = CMortgageCalculator::IsFullMortgageBlock(pindex, params);
+        BOOST_CHECK_EQUAL(ledger.GetDistribution(pindexTipB, pindex->nHeight, params, distribution), fFullMortgage);
+        if (fFullMortgage) {
+            BOOST_CHECK_EQUAL(distribution.entry.nOriginalAccumulated, pindex->pprev->nAccumulateSubsidy);
+            int nDistributed = std::min(distribution.entry.nDistributions, CountFullMortgageBlocks(pindexTipB, pindex->nHeight, params));
+            BOOST_CHECK_EQUAL(distribution.nDistributed, nDistributed);
+            BOOST_CHECK_EQUAL(distribution.nDistributedAmount + distribution.nRemainingAmount,
+                              distribution.entry.nAmount * distribution.entry.nDistributions);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(mortgage_ledger_reset)
+{
+    LOCK(cs_main);
+    Consensus::Params params = MakeParams();
+    CMortgageLedger ledger;
+    {
+        std::vector<std::unique_ptr<CBlockIndex>> blocks;
+        ExtendChain(blocks, nullptr, 50);
+        ledger.SetTip(blocks.back().get(), params);
+        ledger.Reset();
+    }
+
+    // The freed blocks are not touched, the ledger starts over on the new chain
+    std::vector<std::unique_ptr<CBlockIndex>> blocks;
+    ExtendChain(blocks, nullptr, 60);
+    CBlockIndex* pindexTip = blocks.back().get();
+    ledger.SetTip(pindexTip, params);
+    std::map<int, CAmount> mapExpected;
+    CAmount nExpected = CalcExpectedAmount(pindexTip, params, mapExpected);
+    BOOST_CHECK_EQUAL(ledger.GetAccumulatedAmount(pindexTip, pindexTip->nHeight + 1, params), nExpected);
+    BOOST_CHECK_EQUAL(ledger.CountFullMortgageBlocks(pindexTip, params.BHDIP009Height, pindexTip->nHeight, params),
+                      CountFullMortgageBlocks(pindexTip, params.BHDIP009Height, params));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
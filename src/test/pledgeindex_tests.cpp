@@ -0,0 +1,269 @@
+// Copyright (c) 2017-2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <chainparams.h>
+#include <index/pledgeindex.h>
+#include <script/standard.h>
+#include <test/setup_common.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+namespace {
+
+/** Exposes the block handlers, so that synthetic blocks past BHDIP009 can be indexed without a chain */
+class TestPledgeIndex : public PledgeIndex
+{
+public:
+    TestPledgeIndex() : PledgeIndex(1 << 20, true) {}
+
+    bool Connect(const CBlock& block, const CBlockIndex* pindex) { return WriteBlock(block, pindex, SERIALIZE_BLOCK_CHIAPOS); }
+
+    bool Disconnect(const CBlockIndex* current_tip, const CBlockIndex* new_tip) { return UndoBlocks(current_tip, new_tip); }
+};
+
+CTxDestination MakeDestination(int n)
+{
+    return ScriptHash(CScript() << n);
+}
+
+CMutableTransaction MakeUniformTx(const COutPoint& prevout, const CTxDestination& sender, CAmount nAmount)
+{
+    CMutableTransaction tx;
+    tx.nVersion = CTransaction::UNIFORM_VERSION;
+    tx.vin.emplace_back(prevout);
+    tx.vout.emplace_back(nAmount, GetScriptForDestination(sender));
+    return tx;
+}
+
+CTransactionRef MakePledgeTx(const COutPoint& prevout, const CTxDestination& sender, const CTxDestination& receiver, CAmount nAmount)
+{
+    CMutableTransaction tx = MakeUniformTx(prevout, sender, nAmount);
+    tx.vout.emplace_back(0, GetPointScriptForDestination(receiver, DATACARRIER_TYPE_CHIA_POINT));
+    return MakeTransactionRef(std::move(tx));
+}
+
+CTransactionRef MakeRetargetTx(const CTransactionRef& pledgeTx, const CTxDestination& sender, const CTxDestination& receiver, int nPointHeight)
+{
+    CMutableTransaction tx = MakeUniformTx(COutPoint(pledgeTx->GetHash(), 0), sender, pledgeTx->vout[0].nValue);
+    tx.vout.emplace_back(0, GetPointRetargetScriptForDestination(receiver, DATACARRIER_TYPE_CHIA_POINT, nPointHeight));
+    return MakeTransactionRef(std::move(tx));
+}
+
+CTransactionRef MakeWithdrawTx(const CTransactionRef& pledgeTx, const CTxDestination& sender)
+{
+    return MakeTransactionRef(MakeUniformTx(COutPoint(pledgeTx->GetHash(), 0), sender, pledgeTx->vout[0].nValue));
+}
+
+size_t CountAccountPledges(const PledgeIndex& pledgeindex, const CTxDestination& dest)
+{
+    std::vector<PledgeIndexEntry> entries;
+    BOOST_CHECK(pledgeindex.GetAccountPledges(ExtractAccountID(dest), entries));
+    return entries.size();
+}
+
+size_t CountPledges(const PledgeIndex& pledgeindex)
+{
+    size_t nPledges{0};
+    BOOST_CHECK(pledgeindex.ForEachPledge([&nPledges](const PledgeIndexEntry&) { ++nPledges; return true; }));
+    return nPledges;
+}
+
+std::vector<PledgeIndexEvent> GetEvents(const PledgeIndex& pledgeindex, int nBeginHeight, int nEndHeight)
+{
+    std::vector<PledgeIndexEvent> events;
+    BOOST_CHECK(pledgeindex.GetEvents(nBeginHeight, nEndHeight, events));
+    return events;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(pledgeindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(pledgeindex_initial_sync, TestChain100Setup)
+{
+    PledgeIndex pledgeindex(1 << 20, true);
+
+    // BlockUntilSyncedToCurrentChain should return false before pledgeindex is started.
+    BOOST_CHECK(!pledgeindex.BlockUntilSyncedToCurrentChain());
+
+    pledgeindex.Start();
+
+    // Allow pledge index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!pledgeindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // The chain is below BHDIP009, nothing can be pledged yet.
+    BOOST_REQUIRE(::ChainActive().Height() < Params().GetConsensus().BHDIP009Height);
+    int nPledges{0};
+    BOOST_CHECK(pledgeindex.ForEachPledge([&nPledges](const PledgeIndexEntry&) { ++nPledges; return true; }));
+    BOOST_CHECK_EQUAL(nPledges, 0);
+
+    std::vector<PledgeIndexEntry> entries;
+    CAccountID accountID = ExtractAccountID(coinbaseKey.GetPubKey());
+    BOOST_CHECK(pledgeindex.GetAccountPledges(accountID, entries));
+    BOOST_CHECK(entries.empty());
+
+    std::vector<PledgeIndexEvent> events;
+    BOOST_CHECK(pledgeindex.GetEvents(0, ::ChainActive().Height(), events));
+    BOOST_CHECK(events.empty());
+
+    // New blocks keep the index in sync.
+    for (int i = 0; i < 10; i++) {
+        CScript coinbase_script_pub_key = GetScriptForDestination(PKHash(coinbaseKey.GetPubKey()));
+        std::vector<CMutableTransaction> no_txns;
+        CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+        BOOST_CHECK(pledgeindex.BlockUntilSyncedToCurrentChain());
+    }
+
+    PledgeIndexEntry entry;
+    BOOST_CHECK(!pledgeindex.FindPledge(m_coinbase_txns[0]->GetHash(), entry));
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    pledgeindex.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    // Rest of shutdown sequence and destructors happen in ~TestingSetup()
+}
+
+BOOST_FIXTURE_TEST_CASE(pledgeindex_pledge_retarget_withdraw, BasicTestingSetup)
+{
+    const int nHeight = Params().GetConsensus().BHDIP009Height;
+    const CTxDestination sender = MakeDestination(1);
+    const CTxDestination receiver = MakeDestination(2);
+    const CTxDestination receiver2 = MakeDestination(3);
+    const CAmount nAmount = 10 * COIN;
+
+    // A chain of synthetic block indexes from the block before BHDIP009
+    std::vector<uint256> hashes;
+    for (int i = 0; i < 4; ++i) {
+        hashes.push_back(ArithToUint256(arith_uint256(i + 1)));
+    }
+    std::vector<CBlockIndex> indexes(4);
+    for (int i = 0; i < 4; ++i) {
+        indexes[i].nHeight = nHeight - 1 + i;
+        indexes[i].phashBlock = &hashes[i];
+        indexes[i].pprev = i > 0 ? &indexes[i - 1] : nullptr;
+    }
+
+    TestPledgeIndex pledgeindex;
+
+    // Block 1 makes a pledge
+    CBlock block1;
+    CTransactionRef pledgeTx = MakePledgeTx(COutPoint(InsecureRand256(), 0), sender, receiver, nAmount);
+    block1.vtx.push_back(pledgeTx);
+    BOOST_REQUIRE(pledgeindex.Connect(block1, &indexes[1]));
+
+    PledgeIndexEntry entry;
+    BOOST_REQUIRE(pledgeindex.FindPledge(pledgeTx->GetHash(), entry));
+    BOOST_CHECK(entry.IsAvailable());
+    BOOST_CHECK(entry.blockHash == hashes[1]);
+    BOOST_CHECK_EQUAL(entry.nHeight, nHeight);
+    BOOST_CHECK(entry.sender == ExtractAccountID(sender));
+    BOOST_CHECK(entry.receiver == ExtractAccountID(receiver));
+    BOOST_CHECK_EQUAL(entry.nAmount, nAmount);
+    BOOST_CHECK_EQUAL(entry.pointType, DATACARRIER_TYPE_CHIA_POINT);
+    BOOST_CHECK_EQUAL(CountAccountPledges(pledgeindex, sender), 1U);
+    BOOST_CHECK_EQUAL(CountAccountPledges(pledgeindex, receiver), 1U);
+    std::vector<PledgeIndexEvent> events = GetEvents(pledgeindex, nHeight, nHeight);
+    BOOST_REQUIRE_EQUAL(events.size(), 1U);
+    BOOST_CHECK(events[0].type == PledgeEventType::PLEDGE);
+    BOOST_CHECK(events[0].txid == pledgeTx->GetHash());
+
+    // Block 2 retargets the pledge, and makes and withdraws another pledge
+    CBlock block2;
+    CTransactionRef retargetTx = MakeRetargetTx(pledgeTx, sender, receiver2, nHeight);
+    CTransactionRef shortPledgeTx = MakePledgeTx(COutPoint(InsecureRand256(), 0), sender, receiver, nAmount);
+    CTransactionRef shortWithdrawTx = MakeWithdrawTx(shortPledgeTx, sender);
+    block2.vtx = {retargetTx, shortPledgeTx, shortWithdrawTx};
+    BOOST_REQUIRE(pledgeindex.Connect(block2, &indexes[2]));
+
+    BOOST_REQUIRE(pledgeindex.FindPledge(pledgeTx->GetHash(), entry));
+    BOOST_CHECK(entry.revokedTxid == retargetTx->GetHash());
+    BOOST_CHECK_EQUAL(entry.nRevokedHeight, nHeight + 1);
+    BOOST_REQUIRE(pledgeindex.FindPledge(retargetTx->GetHash(), entry));
+    BOOST_CHECK(entry.IsAvailable());
+    BOOST_CHECK(entry.receiver == ExtractAccountID(receiver2));
+    BOOST_CHECK_EQUAL(entry.nAmount, nAmount);
+    BOOST_CHECK_EQUAL(entry.nPointHeight, nHeight);
+    BOOST_REQUIRE(pledgeindex.FindPledge(shortPledgeTx->GetHash(), entry));
+    BOOST_CHECK(entry.revokedTxid == shortWithdrawTx->GetHash());
+    BOOST_CHECK_EQUAL(CountAccountPledges(pledgeindex, sender), 3U);
+    BOOST_CHECK_EQUAL(CountAccountPledges(pledgeindex, receiver), 2U);
+    BOOST_CHECK_EQUAL(CountAccountPledges(pledgeindex, receiver2), 1U);
+    events = GetEvents(pledgeindex, nHeight + 1, nHeight + 1);
+    BOOST_CHECK_EQUAL(events.size(), 3U);
+
+    // Block 3 withdraws the retargeted pledge
+    CBlock block3;
+    CTransactionRef withdrawTx = MakeWithdrawTx(retargetTx, sender);
+    block3.vtx.push_back(withdrawTx);
+    BOOST_REQUIRE(pledgeindex.Connect(block3, &indexes[3]));
+
+    BOOST_REQUIRE(pledgeindex.FindPledge(retargetTx->GetHash(), entry));
+    BOOST_CHECK(entry.revokedTxid == withdrawTx->GetHash());
+    BOOST_CHECK_EQUAL(entry.nRevokedHeight, nHeight + 2);
+    events = GetEvents(pledgeindex, nHeight + 2, nHeight + 2);
+    BOOST_REQUIRE_EQUAL(events.size(), 1U);
+    BOOST_CHECK(events[0].type == PledgeEventType::WITHDRAW);
+    BOOST_CHECK(events[0].prevTxid == retargetTx->GetHash());
+    BOOST_CHECK_EQUAL(CountPledges(pledgeindex), 3U);
+
+    // Rewinding to block 1 drops the pledges made after it and makes the first pledge available again
+    BOOST_REQUIRE(pledgeindex.Disconnect(&indexes[3], &indexes[1]));
+
+    BOOST_REQUIRE(pledgeindex.FindPledge(pledgeTx->GetHash(), entry));
+    BOOST_CHECK(entry.IsAvailable());
+    BOOST_CHECK_EQUAL(entry.nRevokedHeight, 0);
+    BOOST_CHECK(!pledgeindex.FindPledge(retargetTx->GetHash(), entry));
+    BOOST_CHECK(!pledgeindex.FindPledge(shortPledgeTx->GetHash(), entry));
+    BOOST_CHECK_EQUAL(CountPledges(pledgeindex), 1U);
+    BOOST_CHECK_EQUAL(CountAccountPledges(pledgeindex, sender), 1U);
+    BOOST_CHECK_EQUAL(CountAccountPledges(pledgeindex, receiver), 1U);
+    BOOST_CHECK_EQUAL(CountAccountPledges(pledgeindex, receiver2), 0U);
+    BOOST_CHECK(GetEvents(pledgeindex, nHeight + 1, nHeight + 2).empty());
+    BOOST_CHECK_EQUAL(GetEvents(pledgeindex, nHeight, nHeight).size(), 1U);
+
+    // Connecting block 2 again gives the same records
+    BOOST_REQUIRE(pledgeindex.Connect(block2, &indexes[2]));
+    BOOST_REQUIRE(pledgeindex.FindPledge(pledgeTx->GetHash(), entry));
+    BOOST_CHECK(entry.revokedTxid == retargetTx->GetHash());
+    BOOST_CHECK_EQUAL(CountPledges(pledgeindex), 3U);
+
+    // Rewinding below BHDIP009 leaves nothing behind
+    BOOST_REQUIRE(pledgeindex.Disconnect(&indexes[2], &indexes[0]));
+    BOOST_CHECK_EQUAL(CountPledges(pledgeindex), 0U);
+    BOOST_CHECK_EQUAL(CountAccountPledges(pledgeindex, sender), 0U);
+    BOOST_CHECK_EQUAL(CountAccountPledges(pledgeindex, receiver), 0U);
+    BOOST_CHECK(GetEvents(pledgeindex, 0, nHeight + 2).empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(pledgeindex_below_bhdip009, BasicTestingSetup)
+{
+    const int nHeight = Params().GetConsensus().BHDIP009Height - 1;
+    uint256 hash = InsecureRand256();
+    CBlockIndex index;
+    index.nHeight = nHeight;
+    index.phashBlock = &hash;
+
+    TestPledgeIndex pledgeindex;
+    CBlock block;
+    block.vtx.push_back(MakePledgeTx(COutPoint(InsecureRand256(), 0), MakeDestination(1), MakeDestination(2), 10 * COIN));
+    BOOST_REQUIRE(pledgeindex.Connect(block, &index));
+    BOOST_CHECK_EQUAL(CountPledges(pledgeindex), 0U);
+    BOOST_CHECK(GetEvents(pledgeindex, 0, nHeight).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
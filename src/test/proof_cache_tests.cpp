@@ -0,0 +1,156 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chiapos/kernel/bls_key.h>
+#include <chiapos/kernel/pos.h>
+#include <chiapos/kernel/utils.h>
+#include <chiapos/proof_cache.h>
+#include <random.h>
+#include <util/system.h>
+
+#include <vector>
+
+// A valid proof of space from a k25 plot, the same one is tested by chiautils_tests
+struct PosFixture {
+    uint256 challenge{uint256S("cc5ac4c68e9228f2487aa3d4a0ca067e150ad19f85934f5d97f4355c8c83fdbd")};
+    chiapos::PubKey localPk{chiapos::MakeArray<chiapos::PK_LEN>(chiapos::BytesFromHex(
+            "b1578afd24055235e1a946108b84bab4c27b42f47e0a1f9562e251462b2f7564bd12991abcb9c23df5b62e77ed1f1ce7"))};
+    chiapos::PubKey farmerPk{chiapos::MakeArray<chiapos::PK_LEN>(chiapos::BytesFromHex(
+            "8b17c85e49be1a2303588b6fe9a0206dc0722c83db2281bb1aee695ae7e97c098672e1609a50b86786126cca3c9c8639"))};
+    chiapos::PubKeyOrHash poolPkOrHash{chiapos::MakePubKeyOrHash(
+            chiapos::PlotPubKeyType::OGPlots,
+            chiapos::BytesFromHex("92f7dbd5de62bfe6c752c957d7d17af1114500670819dfb149a055edaafcc77bd376b450d43eb1c3208a424b00abe950"))};
+    uint8_t k{25};
+    chiapos::Bytes vchProof{chiapos::BytesFromHex(
+            "407f849c3b8fa9265751f34a72b57192cca83a5d7d7d2ce935cfde94e91ffa7567dadbe0cdd36e9da11c5ffd6b790b4acbe64a91d6"
+            "e4c2f87b4e0b3f7d130222a3196fe705bbebf47817062f3deea06ea3c71dec4198ceaaa1f7fdad81e616c465bf4e8506a088ccd3ac"
+            "e16f1c0bdf9a9c73edcddc1cf0dcfacd8ef574809c442c9f8ffbd92defb3f520b27de1ae949201d63f618514af50994014f5a522bd"
+            "5b67f6430fa927bda70c39b751c0a9a4a0a864889ed8202aecb283a708378002c5a6cf5f19fe05b31c")};
+
+    bool Verify(uint256* out_mixed_quality_string = nullptr) const
+    {
+        return chiapos::VerifyPosWithCache(challenge, localPk, farmerPk, poolPkOrHash, k, vchProof,
+                                           out_mixed_quality_string, 0);
+    }
+};
+
+struct SignatureFixture {
+    chiapos::PubKey pubkey;
+    chiapos::Signature signature;
+    chiapos::Bytes vchMessage;
+};
+
+static SignatureFixture MakeSignature()
+{
+    chiapos::Bytes vchSeed = chiapos::MakeBytes(InsecureRand256());
+    auto key = chiapos::CKey::CreateKeyWithRandomSeed(vchSeed);
+    SignatureFixture sig;
+    sig.vchMessage = chiapos::MakeBytes(InsecureRand256());
+    sig.pubkey = key.GetPubKey();
+    sig.signature = key.Sign(sig.vchMessage);
+    return sig;
+}
+
+BOOST_FIXTURE_TEST_SUITE(proof_cache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(proof_cache_pos_hit_miss)
+{
+    PosFixture pos;
+    chiapos::ProofCacheStats before = chiapos::GetProofCacheStats();
+
+    uint256 mixed_quality_string;
+    BOOST_CHECK(pos.Verify(&mixed_quality_string));
+    BOOST_CHECK(!mixed_quality_string.IsNull());
+    chiapos::ProofCacheStats stats = chiapos::GetProofCacheStats();
+    BOOST_CHECK_EQUAL(stats.nPosMisses, before.nPosMisses + 1);
+    BOOST_CHECK_EQUAL(stats.nPosHits, before.nPosHits);
+    BOOST_CHECK_EQUAL(stats.nPosEntries, 1U);
+
+    // The second verification is answered by the cache with the same mixed quality string
+    uint256 cached_mixed_quality_string;
+    BOOST_CHECK(pos.Verify(&cached_mixed_quality_string));
+    BOOST_CHECK(cached_mixed_quality_string == mixed_quality_string);
+    stats = chiapos::GetProofCacheStats();
+    BOOST_CHECK_EQUAL(stats.nPosMisses, before.nPosMisses + 1);
+    BOOST_CHECK_EQUAL(stats.nPosHits, before.nPosHits + 1);
+    BOOST_CHECK_EQUAL(stats.nPosEntries, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(proof_cache_failures_not_cached)
+{
+    PosFixture pos;
+    pos.vchProof[0] ^= 0xff;
+    chiapos::ProofCacheStats before = chiapos::GetProofCacheStats();
+    BOOST_CHECK(!pos.Verify());
+    BOOST_CHECK(!pos.Verify());
+    chiapos::ProofCacheStats stats = chiapos::GetProofCacheStats();
+    BOOST_CHECK_EQUAL(stats.nPosMisses, before.nPosMisses + 2);
+    BOOST_CHECK_EQUAL(stats.nPosHits, before.nPosHits);
+    BOOST_CHECK_EQUAL(stats.nPosEntries, 0U);
+
+    SignatureFixture sig = MakeSignature();
+    chiapos::Bytes vchOtherMessage = chiapos::MakeBytes(InsecureRand256());
+    before = chiapos::GetProofCacheStats();
+    BOOST_CHECK(!chiapos::VerifySignatureWithCache(sig.pubkey, sig.signature, vchOtherMessage));
+    BOOST_CHECK(!chiapos::VerifySignatureWithCache(sig.pubkey, sig.signature, vchOtherMessage));
+    stats = chiapos::GetProofCacheStats();
+    BOOST_CHECK_EQUAL(stats.nSigMisses, before.nSigMisses + 2);
+    BOOST_CHECK_EQUAL(stats.nSigHits, before.nSigHits);
+
+    // A batch with an invalid signature only caches the valid ones
+    SignatureFixture valid = MakeSignature();
+    chiapos::CSignatureBatch batch;
+    batch.Add(valid.pubkey, valid.signature, valid.vchMessage);
+    batch.Add(sig.pubkey, sig.signature, vchOtherMessage);
+    BOOST_CHECK(!batch.Verify());
+    BOOST_CHECK_EQUAL(batch.Size(), 0U);
+    before = chiapos::GetProofCacheStats();
+    BOOST_CHECK(chiapos::VerifySignatureWithCache(valid.pubkey, valid.signature, valid.vchMessage));
+    BOOST_CHECK(!chiapos::VerifySignatureWithCache(sig.pubkey, sig.signature, vchOtherMessage));
+    stats = chiapos::GetProofCacheStats();
+    BOOST_CHECK_EQUAL(stats.nSigHits, before.nSigHits + 1);
+    BOOST_CHECK_EQUAL(stats.nSigMisses, before.nSigMisses + 1);
+}
+
+BOOST_AUTO_TEST_CASE(proof_cache_eviction)
+{
+    // The smallest caches, one PoS proof and a couple of signatures
+    gArgs.ForceSetArg("-maxproofcachesize", "0");
+    chiapos::InitProofCache();
+    chiapos::ProofCacheStats stats = chiapos::GetProofCacheStats();
+    BOOST_CHECK_EQUAL(stats.nPosCapacity, 1U);
+
+    std::vector<SignatureFixture> sigs;
+    for (uint32_t i = 0; i < stats.nSigCapacity * 2; ++i) {
+        sigs.push_back(MakeSignature());
+        BOOST_CHECK(chiapos::VerifySignatureWithCache(sigs.back().pubkey, sigs.back().signature, sigs.back().vchMessage));
+    }
+    // The latest signature is always kept, the cache cannot hold more than its capacity
+    chiapos::ProofCacheStats before = chiapos::GetProofCacheStats();
+    BOOST_CHECK(chiapos::VerifySignatureWithCache(sigs.back().pubkey, sigs.back().signature, sigs.back().vchMessage));
+    BOOST_CHECK_EQUAL(chiapos::GetProofCacheStats().nSigHits, before.nSigHits + 1);
+
+    before = chiapos::GetProofCacheStats();
+    for (auto const& sig : sigs) {
+        BOOST_CHECK(chiapos::VerifySignatureWithCache(sig.pubkey, sig.signature, sig.vchMessage));
+    }
+    stats = chiapos::GetProofCacheStats();
+    BOOST_CHECK(stats.nSigHits - before.nSigHits <= stats.nSigCapacity);
+    BOOST_CHECK(stats.nSigMisses > before.nSigMisses);
+
+    // The PoS entries never exceed the capacity
+    PosFixture pos;
+    BOOST_CHECK(pos.Verify());
+    BOOST_CHECK(pos.Verify());
+    BOOST_CHECK_EQUAL(chiapos::GetProofCacheStats().nPosEntries, 1U);
+
+    gArgs.ForceSetArg("-maxproofcachesize", std::to_string(DEFAULT_MAX_PROOF_CACHE_SIZE));
+    chiapos::InitProofCache();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
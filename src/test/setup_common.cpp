@@ -6,10 +6,12 @@
 
 #include <banman.h>
 #include <chainparams.h>
+#include <chiapos/proof_cache.h>
 #include <consensus/consensus.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
 #include <crypto/sha256.h>
+#include <crypto/shabal256.h>
 #include <init.h>
 #include <miner.h>
 #include <net.h>
@@ -50,11 +52,13 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     InitLogging();
     LogInstance().StartLogging();
     SHA256AutoDetect();
+    Shabal256AutoDetect();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
     InitSignatureCache();
     InitScriptExecutionCache();
+    chiapos::InitProofCache();
     fCheckBlockIndex = true;
     static bool noui_connected = false;
     if (!noui_connected) {
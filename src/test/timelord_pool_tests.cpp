@@ -0,0 +1,232 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/mock_timelord.h>
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chiapos/timelord_cli/timelord_pool.h>
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** Run the io_context on a thread until the test is done */
+class IoRunner {
+public:
+    IoRunner() : work_(asio::make_work_guard(ioc)), thread_([this]() { ioc.run(); }) {}
+
+    ~IoRunner() { Stop(); }
+
+    void Stop()
+    {
+        if (!thread_.joinable()) {
+            return;
+        }
+        work_.reset();
+        ioc.stop();
+        thread_.join();
+    }
+
+    /** Run the function on the thread of the io_context and wait for it */
+    void Run(std::function<void()> func)
+    {
+        std::promise<void> done;
+        asio::post(ioc, [&]() {
+            func();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    asio::io_context ioc;
+
+private:
+    asio::executor_work_guard<asio::io_context::executor_type> work_;
+    std::thread thread_;
+};
+
+bool WaitFor(std::function<bool()> pred)
+{
+    for (int i = 0; i < 500; ++i) {
+        if (pred()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return pred();
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(timelord_pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(timelord_pool_best_proof)
+{
+    IoRunner runner;
+    std::unique_ptr<MockTimelord> fast, best, slow;
+    runner.Run([&]() {
+        fast.reset(new MockTimelord(runner.ioc, 2000, std::chrono::milliseconds(20)));
+        best.reset(new MockTimelord(runner.ioc, 1000, std::chrono::milliseconds(200)));
+        slow.reset(new MockTimelord(runner.ioc, 3000, std::chrono::milliseconds(400)));
+    });
+
+    auto pool = TimelordClientPool::CreateTimelordClientPool(runner.ioc, {{"127.0.0.1", fast->GetPort()}, {"127.0.0.1", best->GetPort()}, {"127.0.0.1", slow->GetPort()}});
+    std::mutex mtx;
+    std::vector<uint64_t> received;
+    pool->SetProofReceiver([&](uint256 const& challenge, ProofDetail const& detail) {
+        std::lock_guard<std::mutex> lg(mtx);
+        received.push_back(detail.iters);
+    });
+    pool->Start();
+    uint256 challenge = uint256S("0x01");
+    // The request is kept and sent to the timelords when they are connected
+    pool->Calc(challenge, 100, uint256(), 0, 0);
+
+    BOOST_CHECK(WaitFor([&]() {
+        uint64_t num_proofs{0};
+        for (auto const& stats : pool->GetStats()) {
+            num_proofs += stats.num_proofs;
+        }
+        return num_proofs == 3;
+    }));
+    {
+        // The worse proof of the slow timelord is dropped
+        std::lock_guard<std::mutex> lg(mtx);
+        BOOST_CHECK(received == std::vector<uint64_t>({2000, 1000}));
+    }
+    ProofDetail detail;
+    BOOST_CHECK(pool->GetBestProof(challenge, detail));
+    BOOST_CHECK_EQUAL(detail.iters, 1000);
+    BOOST_CHECK(!pool->GetBestProof(uint256S("0x02"), detail));
+
+    // PING is sent right after the connection is established
+    BOOST_CHECK(WaitFor([&]() {
+        for (auto const& stats : pool->GetStats()) {
+            if (stats.rtt_ms < 0) return false;
+        }
+        return true;
+    }));
+    std::vector<TimelordStats> vStats = pool->GetStats();
+    BOOST_CHECK_EQUAL(vStats.size(), 3);
+    BOOST_CHECK_EQUAL(vStats[0].num_best_proofs, 1);
+    BOOST_CHECK_EQUAL(vStats[1].num_best_proofs, 1);
+    BOOST_CHECK_EQUAL(vStats[2].num_best_proofs, 0);
+    for (auto const& stats : vStats) {
+        BOOST_CHECK(stats.connected);
+        BOOST_CHECK_EQUAL(stats.num_reconnects, 0);
+    }
+    BOOST_CHECK(vStats[2].last_proof_latency_ms >= vStats[0].last_proof_latency_ms);
+
+    runner.Stop();
+    pool->Exit();
+}
+
+BOOST_AUTO_TEST_CASE(timelord_pool_failover)
+{
+    IoRunner runner;
+    std::unique_ptr<MockTimelord> alive, dead;
+    runner.Run([&]() {
+        alive.reset(new MockTimelord(runner.ioc, 1000, std::chrono::milliseconds(20)));
+        dead.reset(new MockTimelord(runner.ioc, 500, std::chrono::milliseconds(20)));
+        // Nothing listens on the port after it's closed, the connections to it are refused
+        dead->Close();
+    });
+
+    auto pool = TimelordClientPool::CreateTimelordClientPool(runner.ioc, {{"127.0.0.1", dead->GetPort()}, {"127.0.0.1", alive->GetPort()}});
+    std::mutex mtx;
+    std::vector<uint64_t> received;
+    pool->SetProofReceiver([&](uint256 const& challenge, ProofDetail const& detail) {
+        std::lock_guard<std::mutex> lg(mtx);
+        received.push_back(detail.iters);
+    });
+    pool->Start();
+    pool->Calc(uint256S("0x01"), 100, uint256(), 0, 0);
+
+    BOOST_CHECK(WaitFor([&]() {
+        std::lock_guard<std::mutex> lg(mtx);
+        return !received.empty();
+    }));
+    BOOST_CHECK(WaitFor([&]() { return pool->GetStats()[0].num_reconnects > 0; }));
+    std::vector<TimelordStats> vStats = pool->GetStats();
+    BOOST_CHECK(!vStats[0].connected);
+    BOOST_CHECK(vStats[0].backoff_secs >= 1);
+    BOOST_CHECK_EQUAL(vStats[0].num_proofs, 0);
+    BOOST_CHECK(vStats[1].connected);
+    BOOST_CHECK_EQUAL(vStats[1].num_proofs, 1);
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        BOOST_CHECK(received == std::vector<uint64_t>({1000}));
+    }
+    BOOST_CHECK_EQUAL(alive->GetNumCalcs(), 1);
+
+    runner.Stop();
+    pool->Exit();
+}
+
+BOOST_AUTO_TEST_CASE(timelord_pool_late_timelord)
+{
+    IoRunner runner;
+    std::unique_ptr<MockTimelord> early, late;
+    unsigned short late_port{0};
+    runner.Run([&]() {
+        early.reset(new MockTimelord(runner.ioc, 1000, std::chrono::milliseconds(20)));
+        // Reserve a port for the timelord which comes up later
+        late.reset(new MockTimelord(runner.ioc, 500, std::chrono::milliseconds(20)));
+        late_port = late->GetPort();
+        late->Close();
+        late.reset();
+    });
+
+    auto pool = TimelordClientPool::CreateTimelordClientPool(runner.ioc, {{"127.0.0.1", late_port}, {"127.0.0.1", early->GetPort()}});
+    std::mutex mtx;
+    std::vector<uint64_t> received;
+    pool->SetProofReceiver([&](uint256 const& challenge, ProofDetail const& detail) {
+        std::lock_guard<std::mutex> lg(mtx);
+        received.push_back(detail.iters);
+    });
+    pool->Start();
+    pool->Calc(uint256S("0x01"), 100, uint256(), 0, 0);
+    BOOST_CHECK(WaitFor([&]() {
+        std::lock_guard<std::mutex> lg(mtx);
+        return received.size() == 1;
+    }));
+
+    // The only running timelord goes away, the next request is made while no timelord is connected
+    runner.Run([&]() { early->Close(); });
+    BOOST_CHECK(WaitFor([&]() { return !pool->GetStats()[1].connected; }));
+    uint256 challenge = uint256S("0x02");
+    pool->Calc(challenge, 100, uint256(), 0, 0);
+
+    // The timelord coming up after the request gets the request without a proof only
+    runner.Run([&]() { late.reset(new MockTimelord(runner.ioc, 500, std::chrono::milliseconds(20), late_port)); });
+    BOOST_CHECK(WaitFor([&]() {
+        std::lock_guard<std::mutex> lg(mtx);
+        return received.size() == 2;
+    }));
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        BOOST_CHECK(received == std::vector<uint64_t>({1000, 500}));
+    }
+    ProofDetail detail;
+    BOOST_CHECK(pool->GetBestProof(challenge, detail));
+    BOOST_CHECK_EQUAL(detail.iters, 500);
+    BOOST_CHECK_EQUAL(early->GetNumCalcs(), 1);
+    BOOST_CHECK_EQUAL(late->GetNumCalcs(), 1);
+    std::vector<TimelordStats> vStats = pool->GetStats();
+    BOOST_CHECK(vStats[0].connected);
+    BOOST_CHECK(vStats[0].num_reconnects > 0);
+    BOOST_CHECK_EQUAL(vStats[0].num_best_proofs, 1);
+
+    runner.Stop();
+    pool->Exit();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
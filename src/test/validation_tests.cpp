@@ -3,7 +3,14 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <chiapos/kernel/bls_key.h>
+#include <chiapos/kernel/utils.h>
+#include <chiapos/proof_cache.h>
+#include <consensus/merkle.h>
+#include <consensus/validation.h>
 #include <net.h>
+#include <poc/poc.h>
+#include <random.h>
 #include <validation.h>
 #include <subsidy_utils.h>
 
@@ -12,6 +19,8 @@
 #include <boost/signals2/signal.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <thread>
+
 BOOST_FIXTURE_TEST_SUITE(validation_tests, TestingSetup)
 
 static void TestBlockSubsidyHalvings(const Consensus::Params& consensusParams)
@@ -59,6 +68,67 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     BOOST_CHECK_EQUAL(nSum, CAmount{2099999997690000});
 }
 
+static void TestTotalSupplyBeforeHeight(const Consensus::Params& consensusParams, int nMaxHeight)
+{
+    CAmount nTotal = 0;
+    for (int nHeight = 0; nHeight <= nMaxHeight; ++nHeight) {
+        BOOST_REQUIRE_EQUAL(GetTotalSupplyBeforeHeight(nHeight, consensusParams), nTotal);
+        nTotal += GetBlockSubsidy(nHeight, consensusParams);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(total_supply_test)
+{
+    const auto mainParams = CreateChainParams(CBaseChainParams::MAIN);
+    TestTotalSupplyBeforeHeight(mainParams->GetConsensus(), 2000000);
+    const auto regtestParams = CreateChainParams(CBaseChainParams::REGTEST);
+    TestTotalSupplyBeforeHeight(regtestParams->GetConsensus(), 50000);
+
+    // The segments should be continuous and end with zero subsidy
+    SubsidySegments const& segments = GetSubsidySegments(mainParams->GetConsensus());
+    BOOST_CHECK_EQUAL(segments.front().nBeginHeight, 0);
+    BOOST_CHECK_EQUAL(segments.back().nSubsidy, 0);
+    for (size_t i = 1; i < segments.size(); ++i) {
+        BOOST_CHECK(segments[i].nBeginHeight > segments[i - 1].nBeginHeight);
+        BOOST_CHECK(segments[i].nSubsidy != segments[i - 1].nSubsidy);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(deadline_check_threads)
+{
+    // The deadlines calculated on the different threads should be the same as the ones calculated one by one
+    const uint256 generationSignature = InsecureRand256();
+    const uint64_t nPlotterId = InsecureRandBits(64);
+    std::vector<uint64_t> vExpected, vDeadlines(8, 0);
+    for (uint64_t nNonce = 0; nNonce < vDeadlines.size(); ++nNonce) {
+        vExpected.push_back(poc::CalcDL(100, generationSignature, nPlotterId, nNonce));
+    }
+    std::vector<std::thread> threads;
+    for (uint64_t nNonce = 0; nNonce < vDeadlines.size(); ++nNonce) {
+        threads.emplace_back([&, nNonce]() {
+            poc::CDeadlineCheck check;
+            check.Add(100, generationSignature, nPlotterId, nNonce, &vDeadlines[nNonce]);
+            check();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    BOOST_CHECK(vDeadlines == vExpected);
+    BOOST_CHECK(vExpected[0] != vExpected[1]);
+
+    // The nonces generated on the lanes should give the same deadlines
+    for (size_t count : {2, 5, 8}) {
+        std::vector<poc::CDeadlineInput> vInputs;
+        for (uint64_t nNonce = 0; nNonce < count; ++nNonce) {
+            vInputs.push_back(poc::CDeadlineInput{100, generationSignature, nPlotterId, nNonce});
+        }
+        std::vector<uint64_t> vBatchDeadlines(count, 0);
+        poc::CalcDLs(vInputs.data(), vInputs.size(), vBatchDeadlines.data());
+        BOOST_CHECK(std::equal(vBatchDeadlines.begin(), vBatchDeadlines.end(), vExpected.begin()));
+    }
+}
+
 static bool ReturnFalse() { return false; }
 static bool ReturnTrue() { return true; }
 
@@ -75,4 +145,70 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+// A chia block with a coinbase only, signed by a random farmer key
+static CBlock MakeFarmerSignedBlock(bool fValidSignature)
+{
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << OP_TRUE << OP_TRUE;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 1;
+    coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+
+    CBlock block;
+    block.nTime = GetTime();
+    block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    block.chiaposFields.nDifficulty = 1;
+
+    auto key = chiapos::CKey::CreateKeyWithRandomSeed(chiapos::MakeBytes(InsecureRand256()));
+    block.chiaposFields.posProof.vchFarmerPk = chiapos::MakeBytes(key.GetPubKey());
+    chiapos::Bytes vchMessage = chiapos::MakeBytes(fValidSignature ? block.GetUnsignaturedHash() : InsecureRand256());
+    block.chiaposFields.vchFarmerSignature = chiapos::MakeBytes(key.Sign(vchMessage));
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(farmer_signatures_batch)
+{
+    LOCK(cs_main);
+    const CChainParams& chainparams = Params();
+    std::vector<CBlock> blocks;
+    std::vector<CBlockHeader> headers;
+    for (int i = 0; i < 3; ++i) {
+        blocks.push_back(MakeFarmerSignedBlock(true));
+        headers.push_back(blocks.back().GetBlockHeader());
+    }
+
+    // The headers arrive first, their signatures are verified in a batch
+    chiapos::ProofCacheStats before = chiapos::GetProofCacheStats();
+    VerifyFarmerSignatures(headers);
+    chiapos::ProofCacheStats stats = chiapos::GetProofCacheStats();
+    BOOST_CHECK_EQUAL(stats.nSigMisses, before.nSigMisses + blocks.size());
+
+    // The blocks are checked before they are stored, the signatures are all found in the cache
+    before = stats;
+    for (const CBlock& block : blocks) {
+        CValidationState state;
+        BOOST_CHECK(CheckBlock(block, state, chainparams, false, true));
+    }
+    stats = chiapos::GetProofCacheStats();
+    BOOST_CHECK_EQUAL(stats.nSigHits, before.nSigHits + blocks.size());
+    BOOST_CHECK_EQUAL(stats.nSigMisses, before.nSigMisses);
+
+    // An invalid signature fails the batch, the valid one next to it is still cached and the invalid block is
+    // rejected before it is stored
+    CBlock validBlock = MakeFarmerSignedBlock(true);
+    CBlock invalidBlock = MakeFarmerSignedBlock(false);
+    VerifyFarmerSignatures({validBlock.GetBlockHeader(), invalidBlock.GetBlockHeader()});
+    before = chiapos::GetProofCacheStats();
+    CValidationState state;
+    BOOST_CHECK(CheckBlock(validBlock, state, chainparams, false, true));
+    BOOST_CHECK(!CheckBlock(invalidBlock, state, chainparams, false, true));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-chia-work");
+    stats = chiapos::GetProofCacheStats();
+    BOOST_CHECK_EQUAL(stats.nSigHits, before.nSigHits + 1);
+    BOOST_CHECK_EQUAL(stats.nSigMisses, before.nSigMisses + 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+// Copyright (c) 2012-2023 The DePINC Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chiapos/vdf_store.h>
+
+static chiapos::CVdfProof MakeVdfProof(uint256 const& challenge, uint64_t nIters) {
+    chiapos::CVdfProof vdfProof;
+    vdfProof.challenge = challenge;
+    vdfProof.vchY = chiapos::Bytes(100, static_cast<uint8_t>(nIters));
+    vdfProof.vchProof = chiapos::Bytes(100, static_cast<uint8_t>(nIters + 1));
+    vdfProof.nWitnessType = 0;
+    vdfProof.nVdfIters = nIters;
+    vdfProof.nVdfDuration = 1;
+    return vdfProof;
+}
+
+BOOST_FIXTURE_TEST_SUITE(vdf_store_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(vdf_store_find_proof)
+{
+    chiapos::CVdfStore store;
+    store.SetTip(100);
+    uint256 challenge = InsecureRand256();
+    BOOST_CHECK(store.AddProof(MakeVdfProof(challenge, 300)));
+    BOOST_CHECK(store.AddProof(MakeVdfProof(challenge, 100)));
+    BOOST_CHECK(store.AddProof(MakeVdfProof(challenge, 200)));
+    BOOST_CHECK(!store.AddProof(MakeVdfProof(challenge, 200)));
+
+    chiapos::CVdfProof vdfProof;
+    BOOST_CHECK(store.FindProof(challenge, 150, &vdfProof));
+    BOOST_CHECK_EQUAL(vdfProof.nVdfIters, 200);
+    BOOST_CHECK(store.FindProof(challenge, 300, &vdfProof));
+    BOOST_CHECK_EQUAL(vdfProof.nVdfIters, 300);
+    BOOST_CHECK(!store.FindProof(challenge, 301));
+    BOOST_CHECK(!store.FindProof(InsecureRand256(), 1));
+
+    std::vector<chiapos::CVdfProof> vProofs = store.QueryProofs(challenge);
+    BOOST_CHECK_EQUAL(vProofs.size(), 3);
+    BOOST_CHECK_EQUAL(vProofs.front().nVdfIters, 100);
+    BOOST_CHECK_EQUAL(vProofs.back().nVdfIters, 300);
+}
+
+BOOST_AUTO_TEST_CASE(vdf_store_expire)
+{
+    chiapos::CVdfStore store(2);
+    store.SetTip(100);
+    uint256 challenge = InsecureRand256();
+    BOOST_CHECK(store.AddRequest(challenge, 1000));
+    BOOST_CHECK(!store.AddRequest(challenge, 1000));
+    BOOST_CHECK(store.AddPeerRequest(1, challenge, 1000));
+    BOOST_CHECK(!store.AddPeerRequest(1, challenge, 1000));
+    BOOST_CHECK(store.AddPeerRequest(2, challenge, 1000));
+    BOOST_CHECK(store.GetStats().nMemoryUsage > 0);
+
+    store.RemovePeer(1);
+    BOOST_CHECK(store.AddPeerRequest(1, challenge, 1000));
+
+    store.SetTip(102);
+    BOOST_CHECK_EQUAL(store.QueryRequests(challenge).size(), 1);
+    store.SetTip(103);
+    BOOST_CHECK(store.QueryRequests(challenge).empty());
+    BOOST_CHECK_EQUAL(store.GetStats().nChallenges, 0);
+    BOOST_CHECK_EQUAL(store.GetStats().nMemoryUsage, 0);
+}
+
+BOOST_AUTO_TEST_CASE(vdf_store_max_proofs)
+{
+    chiapos::CVdfStore store;
+    store.SetTip(100);
+    uint256 challenge = InsecureRand256();
+    for (uint64_t nIters = 1; nIters <= MAX_VDF_PROOFS_PER_CHALLENGE; ++nIters) {
+        BOOST_CHECK(store.AddProof(MakeVdfProof(challenge, nIters)));
+    }
+    BOOST_CHECK(!store.AddProof(MakeVdfProof(challenge, MAX_VDF_PROOFS_PER_CHALLENGE + 1)));
+    BOOST_CHECK(!store.FindProof(challenge, MAX_VDF_PROOFS_PER_CHALLENGE + 1));
+    BOOST_CHECK_EQUAL(store.QueryProofs(challenge).size(), MAX_VDF_PROOFS_PER_CHALLENGE);
+
+    // the other challenges are not limited by the full one
+    BOOST_CHECK(store.AddProof(MakeVdfProof(InsecureRand256(), 1)));
+    BOOST_CHECK_EQUAL(store.GetStats().nProofs, MAX_VDF_PROOFS_PER_CHALLENGE + 1);
+}
+
+BOOST_AUTO_TEST_CASE(vdf_store_max_peer_requests)
+{
+    chiapos::CVdfStore store(2);
+    store.SetTip(100);
+    uint256 challenge = InsecureRand256();
+    for (uint64_t nIters = 1; nIters <= MAX_VDF_REQUESTS_PER_PEER / 2; ++nIters) {
+        BOOST_CHECK(store.AddPeerRequest(1, challenge, nIters));
+    }
+    store.SetTip(101);
+    uint256 challengeNext = InsecureRand256();
+    for (uint64_t nIters = 1; nIters <= MAX_VDF_REQUESTS_PER_PEER / 2; ++nIters) {
+        BOOST_CHECK(store.AddPeerRequest(1, challengeNext, nIters));
+    }
+
+    // the limit is across the challenges, the other peers are not limited by the full one
+    BOOST_CHECK(!store.AddPeerRequest(1, InsecureRand256(), 1));
+    BOOST_CHECK(!store.AddPeerRequest(1, challengeNext, MAX_VDF_REQUESTS_PER_PEER));
+    BOOST_CHECK(store.AddPeerRequest(2, challengeNext, MAX_VDF_REQUESTS_PER_PEER));
+
+    // the requests of the expired challenge are no longer counted
+    store.SetTip(103);
+    uint64_t nIters = MAX_VDF_REQUESTS_PER_PEER;
+    for (; nIters < MAX_VDF_REQUESTS_PER_PEER + MAX_VDF_REQUESTS_PER_PEER / 2; ++nIters) {
+        BOOST_CHECK(store.AddPeerRequest(1, challengeNext, nIters));
+    }
+    BOOST_CHECK(!store.AddPeerRequest(1, challengeNext, nIters));
+
+    store.RemovePeer(1);
+    BOOST_CHECK(store.AddPeerRequest(1, challengeNext, nIters));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 
 #include <chainparams.h>
 #include <hash.h>
+#include <key_io.h>
 #include <random.h>
 #include <shutdown.h>
 #include <ui_interface.h>
@@ -18,6 +19,7 @@
 #include <map>
 #include <set>
 #include <stdexcept>
+#include <tuple>
 #include <unordered_map>
 
 #include <stdint.h>
@@ -55,6 +57,9 @@ static const char DB_COIN_POINT_CHIA_SEND_TERM_1 = '1';
 static const char DB_COIN_POINT_CHIA_SEND_TERM_2 = '2';
 static const char DB_COIN_POINT_CHIA_SEND_TERM_3 = '3';
 static const char DB_COIN_POINT_CHIA_POINT_RETARGET = 'r';
+static const char DB_ACCOUNT_BALANCE = 'a';
+static const char DB_ACCOUNT_BALANCE_PARAMS = 'w';
+static const char DB_BURNED = 'u';
 
 namespace {
 
@@ -298,10 +303,226 @@ DatacarrierType GetChiaPointType(Coin const& pointCoin) {
     return pointCoin.GetExtraDataType();
 }
 
+/**
+ * Identifies the aggregate of an account over one of the indexes above. Point and retarget coins
+ * are aggregated twice, once for the sender and once for the receiver. Retarget coins are further
+ * split by the type of the original point because their weight depends on it.
+ */
+struct AccountBalanceKey {
+    CAccountID accountID;
+    char index;
+    bool fReceiver;
+    uint32_t nPointType;
+
+    AccountBalanceKey(const CAccountID& accountIDIn, char indexIn, bool fReceiverIn = false, uint32_t nPointTypeIn = 0) :
+        accountID(accountIDIn), index(indexIn), fReceiver(fReceiverIn), nPointType(nPointTypeIn) {}
+
+    bool operator<(const AccountBalanceKey& other) const {
+        return std::tie(accountID, index, fReceiver, nPointType) < std::tie(other.accountID, other.index, other.fReceiver, other.nPointType);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << DB_ACCOUNT_BALANCE;
+        s << accountID;
+        s << index;
+        s << fReceiver;
+        s << VARINT(nPointType);
+    }
+};
+
+/** Running totals of the entries of an account in one index, maintained by BatchWrite */
+struct AccountBalance {
+    int64_t nCount{0};
+    CAmount nAmount{0};
+    //! Sum of the pledge amounts after applying the term weight of each coin
+    CAmount nWeighted{0};
+    //! Upper bound of the heights of the coins, reset when the last coin is gone
+    int nMaxHeight{0};
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(VARINT(nCount, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(VARINT(nAmount, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(VARINT(nWeighted, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(VARINT(nMaxHeight, VarIntMode::NONNEGATIVE_SIGNED));
+    }
+
+    void Add(int sign, CAmount amount, CAmount weighted, int nHeight) {
+        nCount += sign;
+        nAmount += sign * amount;
+        nWeighted += sign * weighted;
+        if (sign > 0) {
+            nMaxHeight = std::max(nMaxHeight, nHeight);
+        }
+    }
+
+    void Merge(const AccountBalance& delta) {
+        nCount += delta.nCount;
+        nAmount += delta.nAmount;
+        nWeighted += delta.nWeighted;
+        nMaxHeight = std::max(nMaxHeight, delta.nMaxHeight);
+        if (nCount < 0 || nAmount < 0 || nWeighted < 0) {
+            throw std::runtime_error("account balance underflow, the chainstate database is corrupted");
+        }
+        if (nCount == 0) {
+            *this = AccountBalance();
+        }
+    }
+};
+
+/** Identifies the coins of the burn account that fall into one total supply calculation period */
+struct BurnedKey {
+    //! The last height of the period, see GetHeightForCalculatingTotalSupply()
+    int nHeight;
+
+    explicit BurnedKey(int nHeightIn) : nHeight(nHeightIn) {}
+
+    bool operator<(const BurnedKey& other) const {
+        return nHeight < other.nHeight;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << DB_BURNED;
+        ser_writedata32be(s, nHeight);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        char key;
+        s >> key;
+        if (key != DB_BURNED) {
+            throw std::ios_base::failure("not a burned entry");
+        }
+        nHeight = ser_readdata32be(s);
+    }
+};
+
+struct AccountBalanceDeltas {
+    std::map<AccountBalanceKey, AccountBalance> accounts;
+    std::map<BurnedKey, AccountBalance> burned;
+};
+
+/**
+ * The consensus parameters the account balances depend on: the term weights of the pledges
+ * followed by the first height and the length of the total supply calculation periods.
+ */
+std::vector<int> GetAccountBalanceParams()
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<int> values;
+    for (auto const& term : params.BHDIP009PledgeTerms) {
+        values.push_back(term.nWeightPercent);
+    }
+    values.push_back(params.BHDIP009Height);
+    values.push_back(params.BHDIP009CalculateDistributedAmountEveryHeights);
+    return values;
+}
+
+//! The last height of the total supply calculation period the height belongs to
+int GetBurnedPeriodHeight(int nHeight, std::vector<int> const& balanceParams)
+{
+    const int nBeginHeight = balanceParams[std::tuple_size<PledgeTerms>::value];
+    const int nPeriod = balanceParams[std::tuple_size<PledgeTerms>::value + 1];
+    if (nHeight <= nBeginHeight) {
+        return nBeginHeight;
+    }
+    return nBeginHeight + (nHeight - nBeginHeight + nPeriod - 1) / nPeriod * nPeriod;
+}
+
+CAmount GetWeightedAmount(CAmount amount, DatacarrierType pointType, std::vector<int> const& balanceParams)
+{
+    if (!DatacarrierTypeIsChiaPoint(pointType)) {
+        return amount;
+    }
+    return balanceParams[pointType - DATACARRIER_TYPE_CHIA_POINT] * amount / 100;
+}
+
+/** Apply a coin entering (sign=1) or leaving (sign=-1) the database to the account balances */
+void AddCoinToAccountBalances(AccountBalanceDeltas& balanceDeltas, const COutPoint& outpoint, const Coin& coin, int sign, std::vector<int> const& balanceParams)
+{
+    static const CAccountID burnAccountID = GetBurnToAccountID();
+    if (coin.refOutAccountID.IsNull()) {
+        return;
+    }
+    auto& deltas = balanceDeltas.accounts;
+    deltas[AccountBalanceKey(coin.refOutAccountID, DB_COIN_INDEX)].Add(sign, coin.out.nValue, 0, coin.nHeight);
+    if (coin.refOutAccountID == burnAccountID) {
+        balanceDeltas.burned[BurnedKey(GetBurnedPeriodHeight(coin.nHeight, balanceParams))].Add(sign, coin.out.nValue, 0, coin.nHeight);
+    }
+
+    // Extra indexes. ONLY FOR vout[0]
+    if (outpoint.n != 0) {
+        return;
+    }
+    if (coin.IsBindPlotter()) {
+        char key = GetBindKeyFromPlotterIdType(BindPlotterPayload::As(coin.extraData)->GetId().GetType());
+        deltas[AccountBalanceKey(coin.refOutAccountID, key)].Add(sign, PROTOCOL_BINDPLOTTER_LOCKAMOUNT, 0, coin.nHeight);
+    } else if (coin.IsPoint()) {
+        DatacarrierType type = coin.GetExtraDataType();
+        char key = *KeyFromDatacarrierType(type);
+        CAmount weighted = GetWeightedAmount(coin.out.nValue, type, balanceParams);
+        deltas[AccountBalanceKey(coin.refOutAccountID, key)].Add(sign, coin.out.nValue, weighted, coin.nHeight);
+        deltas[AccountBalanceKey(PointPayload::As(coin.extraData)->GetReceiverID(), key, true)].Add(sign, coin.out.nValue, weighted, coin.nHeight);
+    } else if (coin.IsPointRetarget()) {
+        auto payload = PointRetargetPayload::As(coin.extraData);
+        DatacarrierType pointType = payload->GetPointType();
+        CAmount weighted = GetWeightedAmount(coin.out.nValue, pointType, balanceParams);
+        deltas[AccountBalanceKey(coin.refOutAccountID, DB_COIN_POINT_CHIA_POINT_RETARGET, false, pointType)].Add(sign, coin.out.nValue, weighted, coin.nHeight);
+        deltas[AccountBalanceKey(payload->GetReceiverID(), DB_COIN_POINT_CHIA_POINT_RETARGET, true, pointType)].Add(sign, coin.out.nValue, weighted, coin.nHeight);
+    }
+}
+
+template <typename Key>
+void WriteAccountBalances(CDBWrapper& db, CDBBatch& batch, std::map<Key, AccountBalance>& deltas)
+{
+    for (auto const& delta : deltas) {
+        AccountBalance balance;
+        db.Read(delta.first, balance);
+        balance.Merge(delta.second);
+        if (balance.nCount == 0) {
+            batch.Erase(delta.first);
+        } else {
+            batch.Write(delta.first, balance);
+        }
+    }
+    deltas.clear();
+}
+
+void WriteAccountBalances(CDBWrapper& db, CDBBatch& batch, AccountBalanceDeltas& deltas)
+{
+    WriteAccountBalances(db, batch, deltas.accounts);
+    WriteAccountBalances(db, batch, deltas.burned);
+}
+
+AccountBalance ReadAccountBalance(CDBWrapper& db, const AccountBalanceKey& key)
+{
+    AccountBalance balance;
+    db.Read(key, balance);
+    return balance;
+}
+
 } // namespace
 
 CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe) : db(ldb_path, nCacheSize, fMemory, fWipe, true)
 {
+    if (!db.Exists(DB_ACCOUNT_BALANCE_PARAMS) && GetBestBlock().IsNull() && GetHeadBlocks().empty()) {
+        // Nothing has been written yet, the account balances are complete from the start
+        db.Write(DB_ACCOUNT_BALANCE_PARAMS, GetAccountBalanceParams());
+    }
+    db.Read(DB_ACCOUNT_BALANCE_PARAMS, m_balance_params);
+}
+
+CCoinsViewDB::CCoinsViewDB(const CCoinsViewDB& parent, CDBWrapper::SnapshotTag tag) : db(parent.db, tag), m_balance_params(parent.m_balance_params)
+{
+}
+
+std::unique_ptr<CCoinsViewDB> CCoinsViewDB::CreateSnapshot() const
+{
+    return std::unique_ptr<CCoinsViewDB>(new CCoinsViewDB(*this, CDBWrapper::SnapshotTag{}));
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
@@ -327,7 +548,7 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -352,8 +573,19 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
+    // The account balances are written with the batch that holds the coins they were changed by.
+    // They are left alone until Upgrade() has built them for an older database.
+    AccountBalanceDeltas balanceDeltas;
+    bool fAccountBalances = !m_balance_params.empty();
+
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            if (fAccountBalances && !it->second.coin.refOutAccountID.IsNull()) {
+                int sign = (it->second.coin.IsSpent() ? 0 : 1) - (db.Exists(CoinEntry(&it->first)) ? 1 : 0);
+                if (sign != 0) {
+                    AddCoinToAccountBalances(balanceDeltas, it->first, it->second.coin, sign, m_balance_params);
+                }
+            }
             if (it->second.coin.IsSpent()) {
                 batch.Erase(CoinEntry(&it->first));
                 if (!it->second.coin.refOutAccountID.IsNull())
@@ -430,9 +662,14 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         }
 
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (erase) {
+            CCoinsMap::iterator itOld = it++;
+            mapCoins.erase(itOld);
+        } else {
+            ++it;
+        }
         if (batch.SizeEstimate() > batch_size) {
+            WriteAccountBalances(db, batch, balanceDeltas);
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
             batch.Clear();
@@ -447,6 +684,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     }
 
     // In the last batch, mark the database as consistent with hashBlock again.
+    WriteAccountBalances(db, batch, balanceDeltas);
     batch.Erase(DB_HEAD_BLOCKS);
     batch.Write(DB_BEST_BLOCK, hashBlock);
 
@@ -666,6 +904,10 @@ size_t CCoinsViewDB::EstimateSize() const
 
 CAmount CCoinsViewDB::GetBalance(const CAccountID &accountID, const CCoinsMap &mapChildCoins, CAmount *balanceBindPlotter, CAmount *balancePointSend, CAmount *balancePointReceive, PledgeTerms const* terms, int nHeight, bool includeBurst) const
 {
+    if (m_balance_params.empty()) {
+        throw std::runtime_error("The account balances of the coin database haven't been built, an upgrade is required.");
+    }
+
     if (balanceBindPlotter != nullptr) {
         if (includeBurst) {
             *balanceBindPlotter = GetBalanceBind(CPlotterBindData::Type::BURST, accountID, mapChildCoins);
@@ -938,52 +1180,45 @@ CPointCoins CCoinsViewDB::GetAllPointCoins() const {
     return coins;
 }
 
+bool CCoinsViewDB::HasAggregatedWeights(PledgeTerms const& terms) const {
+    if (m_balance_params.size() < terms.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (m_balance_params[i] != terms[i].nWeightPercent) {
+            return false;
+        }
+    }
+    return true;
+}
+
 CAmount CCoinsViewDB::GetBalanceBind(CPlotterBindData::Type type, CAccountID const& accountID, CCoinsMap const& mapChildCoins) const {
-    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
-    CAmount balanceBindPlotter = 0;
+    char dbKey = GetBindKeyFromPlotterIdType(type);
 
     // Read from database
-    std::set<COutPoint> selected;
-    CAccountID tempAccountID = accountID;
-    COutPoint tempOutpoint(uint256(), 0);
-    CPlotterBindData tempBindData;
-    uint32_t tempHeight = 0;
-    bool tempValid = true;
-    char dbKey = GetBindKeyFromPlotterIdType(type);
-    BindPlotterEntry entry(&tempOutpoint, &tempAccountID, dbKey);
-    BindPlotterValue value(&tempBindData, &tempHeight, &tempValid);
-    pcursor->Seek(entry);
-    while (pcursor->Valid()) {
-        if (pcursor->GetKey(entry) && entry.key == dbKey && *entry.accountID == accountID) {
-            if (dbKey == DB_COIN_BINDPLOTTER) {
-                tempBindData = 0;
-            } else if (dbKey == DB_COIN_BINDCHIAFARMER) {
-                tempBindData = CChiaFarmerPk();
-            } else {
-                assert(false);
-            }
-            if (!pcursor->GetValue(value))
-                throw std::runtime_error("Database read error");
-            if (*value.valid) {
-                balanceBindPlotter += PROTOCOL_BINDPLOTTER_LOCKAMOUNT;
-                selected.insert(*entry.outpoint);
-            }
-        } else {
-            break;
-        }
-        pcursor->Next();
-    }
+    CAmount balanceBindPlotter = ReadAccountBalance(db, AccountBalanceKey(accountID, dbKey)).nAmount;
 
     // Apply modified coin
     for (CCoinsMap::const_iterator it = mapChildCoins.cbegin(); it != mapChildCoins.cend(); it++) {
         if (!(it->second.flags & CCoinsCacheEntry::DIRTY))
             continue;
+        if (it->second.coin.refOutAccountID != accountID)
+            continue;
 
-        if (selected.count(it->first)) {
+        CPlotterBindData tempBindData;
+        if (dbKey == DB_COIN_BINDPLOTTER) {
+            tempBindData = 0;
+        } else {
+            tempBindData = CChiaFarmerPk();
+        }
+        uint32_t tempHeight = 0;
+        bool tempValid = false;
+        BindPlotterValue value(&tempBindData, &tempHeight, &tempValid);
+        if (it->first.n == 0 && db.Read(BindPlotterEntry(&it->first, &accountID, dbKey), value) && tempValid) {
             if (it->second.coin.IsSpent()) {
                 balanceBindPlotter -= PROTOCOL_BINDPLOTTER_LOCKAMOUNT;
             }
-        } else if (it->second.coin.refOutAccountID == accountID && it->second.coin.IsBindPlotter() && !it->second.coin.IsSpent()) {
+        } else if (it->second.coin.IsBindPlotter() && !it->second.coin.IsSpent()) {
             balanceBindPlotter += PROTOCOL_BINDPLOTTER_LOCKAMOUNT;
         }
     }
@@ -993,35 +1228,49 @@ CAmount CCoinsViewDB::GetBalanceBind(CPlotterBindData::Type type, CAccountID con
 }
 
 CAmount CCoinsViewDB::GetCoinBalance(const CAccountID &accountID, const CCoinsMap &mapChildCoins, int nHeight) const {
-    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
     CAmount availableBalance = 0;
-    CAmount tempAmount = 0;
-    COutPoint tempOutpoint(uint256(), 0);
-    CAccountID tempAccountID = accountID;
-    CoinIndexEntry entry(&tempOutpoint, &tempAccountID);
 
-    // Read from database
-    pcursor->Seek(entry);
-    while (pcursor->Valid()) {
-        if (pcursor->GetKey(entry) && entry.key == DB_COIN_INDEX && *entry.accountID == accountID) {
-            if (!pcursor->GetValue(REF(VARINT(tempAmount, VarIntMode::NONNEGATIVE_SIGNED))))
+    // Read from database, the coins only need to be visited when some of them may be too new
+    AccountBalance aggregate = ReadAccountBalance(db, AccountBalanceKey(accountID, DB_COIN_INDEX));
+    if (nHeight == 0 || aggregate.nMaxHeight <= nHeight) {
+        availableBalance = aggregate.nAmount;
+    } else if (accountID == GetBurnToAccountID() && GetBurnedPeriodHeight(nHeight, m_balance_params) == nHeight) {
+        // The burned coins are summed up by the periods of the total supply calculation
+        std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+        BurnedKey key(0);
+        AccountBalance burned;
+        for (pcursor->Seek(key); pcursor->Valid(); pcursor->Next()) {
+            if (!pcursor->GetKey(key) || key.nHeight > nHeight)
+                break;
+            if (!pcursor->GetValue(burned))
                 throw std::runtime_error("Database read error");
-            if (nHeight != 0) {
+            availableBalance += burned.nAmount;
+        }
+    } else {
+        std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+        CAmount tempAmount = 0;
+        COutPoint tempOutpoint(uint256(), 0);
+        CAccountID tempAccountID = accountID;
+        CoinIndexEntry entry(&tempOutpoint, &tempAccountID);
+
+        pcursor->Seek(entry);
+        while (pcursor->Valid()) {
+            if (pcursor->GetKey(entry) && entry.key == DB_COIN_INDEX && *entry.accountID == accountID) {
+                if (!pcursor->GetValue(REF(VARINT(tempAmount, VarIntMode::NONNEGATIVE_SIGNED))))
+                    throw std::runtime_error("Database read error");
                 // need to find the height of the coin
                 Coin coin;
                 if (!GetCoin(*entry.outpoint, coin)) {
                     throw std::runtime_error("Read coin error");
                 }
-                if (coin.nHeight > nHeight) {
-                    pcursor->Next();
-                    continue;
+                if (coin.nHeight <= nHeight) {
+                    availableBalance += tempAmount;
                 }
+            } else {
+                break;
             }
-            availableBalance += tempAmount;
-        } else {
-            break;
+            pcursor->Next();
         }
-        pcursor->Next();
     }
 
     // Apply modified coin
@@ -1047,42 +1296,25 @@ CAmount CCoinsViewDB::GetCoinBalance(const CAccountID &accountID, const CCoinsMa
 }
 
 CAmount CCoinsViewDB::GetBalancePointSend(DatacarrierType type, CAccountID const& accountID, CCoinsMap const& mapChildCoins) const {
-    CAmount balancePointSend{0};
     auto key = KeyFromDatacarrierType(type);
     if (!key.has_value()) {
         throw std::runtime_error("The key cannot be retrieved cause the wrong datacarrier type.");
     }
-    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
 
     // Read from database
-    std::map<COutPoint, CAmount> selected;
-    CAccountID tempAccountID = accountID;
-    COutPoint tempOutpoint(uint256(), 0);
-    Coin coin;
-    PointEntry entry(&tempOutpoint, &tempAccountID, *key);
-    pcursor->Seek(entry);
-    while (pcursor->Valid()) {
-        if (pcursor->GetKey(entry) && (entry.key == *key) && *entry.accountID == accountID) {
-            if (!db.Read(CoinEntry(entry.outpoint), coin))
-                throw std::runtime_error("Database read error");
-            balancePointSend += coin.out.nValue;
-            selected[*entry.outpoint] = coin.out.nValue;
-        } else {
-            break;
-        }
-        pcursor->Next();
-    }
+    CAmount balancePointSend = ReadAccountBalance(db, AccountBalanceKey(accountID, *key)).nAmount;
 
     // Apply modified coin
     for (CCoinsMap::const_iterator it = mapChildCoins.cbegin(); it != mapChildCoins.cend(); it++) {
         if (!(it->second.flags & CCoinsCacheEntry::DIRTY))
             continue;
-        auto itSelected = selected.find(it->first);
-        if (itSelected != selected.cend()) {
+        if (it->second.coin.refOutAccountID != accountID)
+            continue;
+        if (it->first.n == 0 && db.Exists(PointEntry(&it->first, &accountID, *key))) {
             if (it->second.coin.IsSpent()) {
-                balancePointSend -= itSelected->second;
+                balancePointSend -= it->second.coin.out.nValue;
             }
-        } else if (it->second.coin.GetExtraDataType() == type && it->second.coin.refOutAccountID == accountID && !it->second.coin.IsSpent()) {
+        } else if (it->second.coin.GetExtraDataType() == type && !it->second.coin.IsSpent()) {
             balancePointSend += it->second.coin.out.nValue;
         }
     }
@@ -1121,39 +1353,37 @@ CAmount CCoinsViewDB::GetBalancePointReceive(DatacarrierType type, CAccountID co
         throw std::runtime_error("The key cannot be retrieved accord the wrong datacarrier type.");
     }
 
-    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
-
-    // Read from database
-    std::map<COutPoint, CAmount> selected;
-    CAccountID tempDebitAccountID;
-    CAccountID tempAccountID;
-    COutPoint tempOutpoint(uint256(), 0);
-    Coin pointCoin;
-
-    PointEntry entry(&tempOutpoint, &tempAccountID, *key);
-    pcursor->Seek(entry);
-    while (pcursor->Valid()) {
-        if (pcursor->GetKey(entry) && entry.key == *key) {
-            if (!pcursor->GetValue(tempDebitAccountID))
-                throw std::runtime_error("Database read error");
-            if (tempDebitAccountID == accountID) {
-                if (!db.Read(CoinEntry(entry.outpoint), pointCoin)) {
+    // Read from database. The aggregate can be used when the amount of each pledge doesn't depend on its age
+    AccountBalance aggregate = ReadAccountBalance(db, AccountBalanceKey(accountID, *key, true));
+    if (!terms) {
+        balancePointReceive = aggregate.nAmount;
+    } else if (term.nWeightPercent == fallbackTerm.nWeightPercent && HasAggregatedWeights(*terms)) {
+        balancePointReceive = aggregate.nWeighted;
+    } else {
+        std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+        CAccountID tempDebitAccountID;
+        CAccountID tempAccountID;
+        COutPoint tempOutpoint(uint256(), 0);
+        Coin pointCoin;
+
+        PointEntry entry(&tempOutpoint, &tempAccountID, *key);
+        pcursor->Seek(entry);
+        while (pcursor->Valid()) {
+            if (pcursor->GetKey(entry) && entry.key == *key) {
+                if (!pcursor->GetValue(tempDebitAccountID))
                     throw std::runtime_error("Database read error");
+                if (tempDebitAccountID == accountID) {
+                    if (!db.Read(CoinEntry(entry.outpoint), pointCoin)) {
+                        throw std::runtime_error("Database read error");
+                    }
+                    // Calculate the actual amount of the pledge
+                    balancePointReceive += CalculateTermAmount(pointCoin.out.nValue, term, fallbackTerm, pointCoin.nHeight, nHeight);
                 }
-                // Calculate the actual amount of the pledge
-                CAmount nActual;
-                if (terms) {
-                    nActual = CalculateTermAmount(pointCoin.out.nValue, term, fallbackTerm, pointCoin.nHeight, nHeight);
-                } else {
-                    nActual = pointCoin.out.nValue;
-                }
-                balancePointReceive += nActual;
-                selected[*entry.outpoint] = nActual;
+            } else {
+                break;
             }
-        } else {
-            break;
+            pcursor->Next();
         }
-        pcursor->Next();
     }
 
     // Apply modified coin
@@ -1161,18 +1391,23 @@ CAmount CCoinsViewDB::GetBalancePointReceive(DatacarrierType type, CAccountID co
         if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) {
             continue;
         }
+        const Coin& coin = it->second.coin;
+        if (coin.GetExtraDataType() != type || PointPayload::As(coin.extraData)->GetReceiverID() != accountID) {
+            continue;
+        }
 
-        auto itSelected = selected.find(it->first);
-        if (itSelected != selected.cend()) {
-            if (it->second.coin.IsSpent()) {
-                balancePointReceive -= itSelected->second; // Reverse the coin value
-            }
-        } else if (it->second.coin.GetExtraDataType() == type && PointPayload::As(it->second.coin.extraData)->GetReceiverID() == accountID && !it->second.coin.IsSpent()) {
-            if (terms) {
-                balancePointReceive += CalculateTermAmount(it->second.coin.out.nValue, term, fallbackTerm, it->second.coin.nHeight, nHeight);
-            } else {
-                balancePointReceive += it->second.coin.out.nValue;
+        CAmount nActual;
+        if (terms) {
+            nActual = CalculateTermAmount(coin.out.nValue, term, fallbackTerm, coin.nHeight, nHeight);
+        } else {
+            nActual = coin.out.nValue;
+        }
+        if (it->first.n == 0 && !coin.refOutAccountID.IsNull() && db.Exists(PointEntry(&it->first, &coin.refOutAccountID, *key))) {
+            if (coin.IsSpent()) {
+                balancePointReceive -= nActual; // Reverse the coin value
             }
+        } else if (!coin.IsSpent()) {
+            balancePointReceive += nActual;
         }
     }
 
@@ -1189,10 +1424,22 @@ CAmount CCoinsViewDB::CalculatePledgeAmountFromRetargetCoin(CAmount pointAmount,
     return CalculateTermAmount(pointAmount, term, fallbackTerm, nPointHeight, nHeight);
 }
 
-CAmount CCoinsViewDB::GetBalancePointRetargetSend(CAccountID const& accountID, CCoinsMap const& mapChildCoins, PledgeTerms const* terms, int nHeight) const {
-    assert(terms != nullptr);
+CAmount CCoinsViewDB::GetBalancePointRetargetFromDB(CAccountID const& accountID, bool fReceiver, PledgeTerms const& terms, int nHeight) const {
+    CAmount balance{0};
+    if (HasAggregatedWeights(terms)) {
+        bool fAggregated = true;
+        for (uint32_t pointType = DATACARRIER_TYPE_CHIA_POINT; pointType <= DATACARRIER_TYPE_CHIA_POINT_TERM_3; ++pointType) {
+            PledgeTerm term, fallbackTerm;
+            GetTerm(terms, static_cast<DatacarrierType>(pointType), term, fallbackTerm);
+            fAggregated = fAggregated && term.nWeightPercent == fallbackTerm.nWeightPercent;
+            balance += ReadAccountBalance(db, AccountBalanceKey(accountID, DB_COIN_POINT_CHIA_POINT_RETARGET, fReceiver, pointType)).nWeighted;
+        }
+        if (fAggregated) {
+            return balance;
+        }
+        balance = 0;
+    }
 
-    CAmount balanceRevoke{0};
     std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
     COutPoint outpoint;
     CAccountID tempAccountID;
@@ -1205,11 +1452,6 @@ CAmount CCoinsViewDB::GetBalancePointRetargetSend(CAccountID const& accountID, C
         if (retargetEntry.key != DB_COIN_POINT_CHIA_POINT_RETARGET) {
             break;
         }
-        // Because of the RETARGET tx is pointed to a RETARGET or a POINT, but the amount of the pledge should be the same,
-        Coin coin;
-        if (!GetCoin(outpoint, coin)) {
-            throw std::runtime_error("failed to read db");
-        }
         CAccountID receiverID;
         DatacarrierType pointType;
         int nPointHeight;
@@ -1217,12 +1459,24 @@ CAmount CCoinsViewDB::GetBalancePointRetargetSend(CAccountID const& accountID, C
         if (!pcursor->GetValue(value)) {
             throw std::runtime_error("failed to get coin from database");
         }
-        if (tempAccountID == accountID) {
-            balanceRevoke += CalculatePledgeAmountFromRetargetCoin(coin.out.nValue, pointType, nPointHeight, *terms, nHeight);
+        if ((fReceiver ? receiverID : tempAccountID) == accountID) {
+            // Because of the RETARGET tx is pointed to a RETARGET or a POINT, but the amount of the pledge should be the same,
+            Coin coin;
+            if (!GetCoin(outpoint, coin)) {
+                throw std::runtime_error("failed to read retargetCoin from database");
+            }
+            balance += CalculatePledgeAmountFromRetargetCoin(coin.out.nValue, pointType, nPointHeight, terms, nHeight);
         }
         // Next
         pcursor->Next();
     }
+    return balance;
+}
+
+CAmount CCoinsViewDB::GetBalancePointRetargetSend(CAccountID const& accountID, CCoinsMap const& mapChildCoins, PledgeTerms const* terms, int nHeight) const {
+    assert(terms != nullptr);
+
+    CAmount balanceRevoke = GetBalancePointRetargetFromDB(accountID, false, *terms, nHeight);
     // Apply cached coins
     for (auto const& entry : mapChildCoins) {
         if ((entry.second.flags & CCoinsCacheEntry::DIRTY) == 0) {
@@ -1242,60 +1496,29 @@ CAmount CCoinsViewDB::GetBalancePointRetargetSend(CAccountID const& accountID, C
 CAmount CCoinsViewDB::GetBalancePointRetargetReceive(CAccountID const& accountID, CCoinsMap const& mapChildCoins, PledgeTerms const* terms, int nHeight) const {
     assert(terms != nullptr);
 
-    CAmount balanceReceive{0};
-    std::map<COutPoint, CAmount> selected; // Coins are related to the accountID
-    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
-    COutPoint outpoint;
-    CAccountID tempAccountID;
-    PointRetargetEntry retargetEntry(&outpoint, &tempAccountID);
-    pcursor->Seek(retargetEntry);
-    while (pcursor->Valid()) {
-        if (!pcursor->GetKey(retargetEntry)) {
-            throw std::runtime_error("failed to read data from database");
-        }
-        if (retargetEntry.key != DB_COIN_POINT_CHIA_POINT_RETARGET) {
-            break;
-        }
-        CAccountID receiverID;
-        DatacarrierType pointType;
-        int nPointHeight;
-        PointRetargetValue value(&receiverID, &pointType, &nPointHeight);
-        if (!pcursor->GetValue(value)) {
-            throw std::runtime_error("failed to read receiver-id from database");
-        }
-        if (receiverID == accountID) {
-            Coin coin;
-            if (!GetCoin(outpoint, coin)) {
-                throw std::runtime_error("failed to read retargetCoin from database");
-            }
-            CAmount nActual = CalculatePledgeAmountFromRetargetCoin(coin.out.nValue, pointType, nPointHeight, *terms, nHeight);
-            balanceReceive += nActual;
-            selected[outpoint] = nActual;
-        }
-        // Next
-        pcursor->Next();
-    }
+    CAmount balanceReceive = GetBalancePointRetargetFromDB(accountID, true, *terms, nHeight);
     // Apply cached coins
     for (auto const& entry : mapChildCoins) {
         if ((entry.second.flags & CCoinsCacheEntry::DIRTY) == 0) {
             continue;
         }
-        auto it = selected.find(entry.first);
-        if (it != std::end(selected)) {
+        if (!entry.second.coin.IsPointRetarget()) {
+            continue;
+        }
+        auto retargetPayload = PointRetargetPayload::As(entry.second.coin.extraData);
+        if (retargetPayload->GetReceiverID() != accountID) {
+            continue;
+        }
+        CAmount nActual = CalculatePledgeAmountFromRetargetCoin(entry.second.coin.out.nValue, retargetPayload->GetPointType(), retargetPayload->GetPointHeight(), *terms, nHeight);
+        if (entry.first.n == 0 && !entry.second.coin.refOutAccountID.IsNull() && db.Exists(PointRetargetEntry(&entry.first, &entry.second.coin.refOutAccountID))) {
             // The coin exists and it has received amount
             if (entry.second.coin.IsSpent()) {
-                balanceReceive -= it->second;
-            }
-        } else {
-            // The coin doesn't exist before, we are trying to find out if it is not spent and also the accountID is matched
-            if (!entry.second.coin.IsSpent() && entry.second.coin.IsPointRetarget()) {
-                auto retargetPayload = PointRetargetPayload::As(entry.second.coin.extraData);
-                if (retargetPayload->GetReceiverID() == accountID) {
-                    balanceReceive += CalculatePledgeAmountFromRetargetCoin(entry.second.coin.out.nValue, retargetPayload->GetPointType(), retargetPayload->GetPointHeight(), *terms, nHeight);
-                }
+                balanceReceive -= nActual;
             }
+        } else if (!entry.second.coin.IsSpent()) {
+            // The coin doesn't exist before and it is still available
+            balanceReceive += nActual;
         }
-
     }
     assert(balanceReceive >= 0);
     return balanceReceive;
@@ -1440,7 +1663,7 @@ bool CCoinsViewDB::Upgrade(bool &fUpgraded) {
     // Check coin database version
     uint32_t coinDbVersion = 0;
     if (db.Read(DB_COIN_VERSION, REF(VARINT(coinDbVersion))) && coinDbVersion == DB_VERSION)
-        return true;
+        return UpgradeAccountBalances();
     db.Erase(DB_COIN_VERSION);
     fUpgraded = true;
 
@@ -1532,5 +1755,72 @@ bool CCoinsViewDB::Upgrade(bool &fUpgraded) {
     uiInterface.ShowProgress("", 100, false);
     LogPrintf("[%s]. remove utxo %d, add utxo %d\n", ShutdownRequested() ? "CANCELLED" : "DONE", remove, add);
 
-    return !ShutdownRequested();
+    return !ShutdownRequested() && UpgradeAccountBalances();
+}
+
+bool CCoinsViewDB::UpgradeAccountBalances() {
+    std::vector<int> balanceParams = GetAccountBalanceParams();
+    if (m_balance_params == balanceParams)
+        return true;
+
+    // Build the balances of all accounts from the coins
+    uiInterface.ShowProgress(_("Upgrading UTXO database").translated, 0, true);
+    LogPrintf("Building account balances of UTXO database...\n");
+
+    size_t batch_size = (size_t) gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    m_balance_params.clear();
+    if (!db.Erase(DB_ACCOUNT_BALANCE_PARAMS, true))
+        return error("%s: cannot erase account balance parameters", __func__);
+
+    // Clear old data
+    CDBBatch batch(db);
+    for (char prefix : {DB_ACCOUNT_BALANCE, DB_BURNED}) {
+        for (pcursor->Seek(prefix); pcursor->Valid(); pcursor->Next()) {
+            const leveldb::Slice key = pcursor->GetKey();
+            if (key.size() == 0 || key[0] != prefix)
+                break;
+            batch.EraseSlice(key);
+            if (batch.SizeEstimate() > batch_size) {
+                db.WriteBatch(batch);
+                batch.Clear();
+            }
+        }
+    }
+    db.WriteBatch(batch);
+    batch.Clear();
+
+    AccountBalanceDeltas balances;
+    size_t nCoins = 0;
+    COutPoint outpoint;
+    CoinEntry entry(&outpoint);
+    for (pcursor->Seek(DB_COIN); pcursor->Valid(); pcursor->Next()) {
+        if (!pcursor->GetKey(entry) || entry.key != DB_COIN)
+            break;
+        Coin coin;
+        if (!pcursor->GetValue(coin))
+            return error("%s: cannot parse coin record", __func__);
+        AddCoinToAccountBalances(balances, outpoint, coin, 1, balanceParams);
+        if (++nCoins % 100000 == 0 && ShutdownRequested())
+            return false;
+    }
+
+    for (auto const& balance : balances.accounts) {
+        batch.Write(balance.first, balance.second);
+        if (batch.SizeEstimate() > batch_size) {
+            db.WriteBatch(batch);
+            batch.Clear();
+        }
+    }
+    for (auto const& burned : balances.burned) {
+        batch.Write(burned.first, burned.second);
+    }
+    batch.Write(DB_ACCOUNT_BALANCE_PARAMS, balanceParams);
+    if (!db.WriteBatch(batch, true))
+        return error("%s: cannot write account balances", __func__);
+    m_balance_params = balanceParams;
+
+    uiInterface.ShowProgress("", 100, false);
+    LogPrintf("Built %u account balances from %u coins\n", balances.accounts.size(), nCoins);
+    return true;
 }
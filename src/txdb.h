@@ -38,6 +38,8 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxTxIndexCache = 1024;
 //! Max memory allocated to all block filter index caches combined in MiB.
 static const int64_t max_filter_index_cache = 1024;
+//! Max memory allocated to pledge index DB specific cache (MiB)
+static const int64_t nMaxPledgeIndexCache = 64;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
@@ -46,17 +48,25 @@ class CCoinsViewDB final : public CCoinsView
 {
 protected:
     mutable CDBWrapper db;
+    //! Consensus parameters the account balances were built with, empty until they are built
+    std::vector<int> m_balance_params;
 public:
     /**
      * @param[in] ldb_path    Location in the filesystem where leveldb data will be stored.
      */
     explicit CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe);
 
+    /**
+     * Create a read-only view pinned to the current state of the database. The view is not affected by the flushes
+     * made afterwards, so it can be read without holding cs_main. This view must outlive the snapshot.
+     */
+    std::unique_ptr<CCoinsViewDB> CreateSnapshot() const;
+
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase = true) override;
     CCoinsViewCursorRef Cursor() const override;
     CCoinsViewCursorRef Cursor(const CAccountID &accountID) const override;
     CCoinsViewCursorRef PointSendCursor(const CAccountID &accountID, PointType pt) const override;
@@ -95,6 +105,14 @@ public:
     CPointCoins GetAllPointCoins() const override;
 
 private:
+    CCoinsViewDB(const CCoinsViewDB& parent, CDBWrapper::SnapshotTag tag);
+
+    //! Build the per-account balance records when they are missing or have been built with other parameters
+    bool UpgradeAccountBalances();
+
+    //! Whether the aggregated pledge amounts have been weighted with these terms
+    bool HasAggregatedWeights(PledgeTerms const& terms) const;
+
     CAmount GetBalanceBind(CPlotterBindData::Type type, CAccountID const& accountID, CCoinsMap const& mapChildCoins) const;
 
     CAmount GetCoinBalance(const CAccountID &accountID, const CCoinsMap &mapChildCoins, int nHeight) const;
@@ -107,6 +125,8 @@ private:
 
     CAmount CalculatePledgeAmountFromRetargetCoin(CAmount pointAmount, DatacarrierType pointType, int nPointHeight, PledgeTerms const& terms, int nHeight) const;
 
+    CAmount GetBalancePointRetargetFromDB(CAccountID const& accountID, bool fReceiver, PledgeTerms const& terms, int nHeight) const;
+
     CAmount GetBalancePointRetargetSend(CAccountID const& accountID, CCoinsMap const& mapChildCoins, PledgeTerms const* terms, int nHeight) const;
 
     CAmount GetBalancePointRetargetReceive(CAccountID const& accountID, CCoinsMap const& mapChildCoins, PledgeTerms const* terms, int nHeight) const;
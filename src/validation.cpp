@@ -14,6 +14,7 @@
 #include <consensus/tx_check.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/shabal256.h>
 #include <cuckoocache.h>
 #include <flatfile.h>
 #include <hash.h>
@@ -50,7 +51,9 @@
 #include <amount.h>
 #include <coins.h>
 #include <logging.h>
+#include <chiapos/mined_block_index.h>
 #include <chiapos/post.h>
+#include <chiapos/proof_cache.h>
 
 #include <chiapos/kernel/bls_key.h>
 #include <chiapos/mortgage_calculator.h>
@@ -114,6 +117,14 @@ CBlockIndex *pindexBestHeader = nullptr;
 Mutex g_best_block_mutex;
 std::condition_variable g_best_block_cv;
 uint256 g_best_block;
+
+bool WaitForBestBlockChange(const uint256& hashWatched, std::chrono::steady_clock::time_point deadline, const std::function<bool()>& fnRunning)
+{
+    WAIT_LOCK(g_best_block_mutex, lock);
+    return g_best_block_cv.wait_until(lock, deadline, [&]() EXCLUSIVE_LOCKS_REQUIRED(g_best_block_mutex) {
+        return g_best_block != hashWatched || !fnRunning();
+    });
+}
 int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
@@ -1271,14 +1282,26 @@ void GetBlockAccumulateByBlockIndex(CBlockIndex const* pindex, Consensus::Params
     }
 }
 
-CAmount GetBlockAccumulateSubsidy(const CBlockIndex* pindexPrev, const Consensus::Params& consensusParams)
+void UpdateBlockAccumulateSubsidy(CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     AssertLockHeld(cs_main);
-    CAmount accumulate = 0;
-    for (const CBlockIndex* pindex = pindexPrev; (pindex != nullptr) && (pindex->nStatus & BLOCK_UNCONDITIONAL) && (pindex->nHeight >= consensusParams.BHDIP008Height); pindex = pindex->pprev) {
+    if ((pindex->nStatus & BLOCK_UNCONDITIONAL) && (pindex->nHeight >= consensusParams.BHDIP008Height)) {
+        CAmount accumulate = pindex->pprev ? pindex->pprev->nAccumulateSubsidy : 0;
         GetBlockAccumulateByBlockIndex(pindex, consensusParams, accumulate);
+        pindex->nAccumulateSubsidy = accumulate;
+    } else {
+        pindex->nAccumulateSubsidy = 0;
     }
-    return accumulate;
+}
+
+CAmount GetBlockAccumulateSubsidy(const CBlockIndex* pindexPrev, const Consensus::Params& consensusParams)
+{
+    AssertLockHeld(cs_main);
+    if (pindexPrev == nullptr) {
+        return 0;
+    }
+    // The running value is maintained by UpdateBlockAccumulateSubsidy() on block connecting and on loading block index
+    return pindexPrev->nAccumulateSubsidy;
 }
 
 CAmount GetTotalReward(BlockReward const& reward) {
@@ -1390,7 +1413,7 @@ BlockReward GetBlockReward(const CBlockIndex* pindexPrev, const CAmount& nFees,
             if (nTargetHeight >= consensusParams.BHDIP011Height) {
                 // the distribution for accumulate amount is changed
                 CMortgageCalculator calculator(pindexPrev, consensusParams);
-                std::tie(reward.accumulate, std::ignore) = calculator.CalcAccumulatedAmount(nTargetHeight);
+                reward.accumulate = calculator.CalcAccumulatedTotal(nTargetHeight);
             } else {
                 reward.accumulate = GetBlockAccumulateSubsidy(pindexPrev, consensusParams);
             }
@@ -1453,7 +1476,7 @@ BlockReward GetFullMortgageBlockReward(CBlockIndex* pindexPrev, const Consensus:
     } else {
         reward.fund = 0;
         CMortgageCalculator calculator(pindexPrev, consensusParams);
-        std::tie(reward.accumulate, std::ignore) = calculator.CalcAccumulatedAmount(nTargetHeight);
+        reward.accumulate = calculator.CalcAccumulatedTotal(nTargetHeight);
     }
 
     reward.miner = nSubsidy - reward.fund - reward.miner0;
@@ -2110,6 +2133,22 @@ void ThreadScriptCheck(int worker_num) {
     scriptcheckqueue.Thread();
 }
 
+//! The proofs of a header are expensive, one check for each batch is enough
+static CCheckQueue<chiapos::CHeaderProofsCheck> headerproofscheckqueue(1);
+
+void ThreadHeaderProofsCheck(int worker_num) {
+    util::ThreadRename(strprintf("headerch.%i", worker_num));
+    headerproofscheckqueue.Thread();
+}
+
+//! Each check regenerates up to CShabal256Lanes::MAX_LANES nonces, one check for each batch is enough
+static CCheckQueue<poc::CDeadlineCheck> deadlinecheckqueue(1);
+
+void ThreadDeadlineCheck(int worker_num) {
+    util::ThreadRename(strprintf("deadlinech.%i", worker_num));
+    deadlinecheckqueue.Thread();
+}
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
@@ -2791,6 +2830,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             setDirtyBlockIndex.insert(pindex);
         }
     }
+    UpdateBlockAccumulateSubsidy(pindex, chainparams.GetConsensus());
 
     assert(pindex->phashBlock);
     // add this block to the view's block chain
@@ -2861,8 +2901,10 @@ bool CChainState::FlushStateToDisk(
         bool fPeriodicFlush = mode == FlushStateMode::PERIODIC && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
         // Combine all conditions that result in a full cache flush.
         fDoFullFlush = (mode == FlushStateMode::ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
+        // The coins are written without emptying the cache, the flush is still due when the cache is too large.
+        bool fDoSync = mode == FlushStateMode::SYNC && !fDoFullFlush;
         // Write blocks and block index to disk.
-        if (fDoFullFlush || fPeriodicWrite) {
+        if (fDoFullFlush || fDoSync || fPeriodicWrite) {
             // Depend on nMinDiskSpace to ensure we can write block index
             if (!CheckDiskSpace(GetBlocksDir())) {
                 return AbortNode(state, "Disk space is too low!", _("Error: Disk space is too low!").translated, CClientUIInterface::MSG_NOPREFIX);
@@ -2893,7 +2935,7 @@ bool CChainState::FlushStateToDisk(
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
-        if (fDoFullFlush && !CoinsTip().GetBestBlock().IsNull()) {
+        if ((fDoFullFlush || fDoSync) && !CoinsTip().GetBestBlock().IsNull()) {
             // Typical Coin structures on disk are around 48 bytes in size.
             // Pushing a new one to the database can cause it to be written
             // twice (once in the log, and once in the tables). This is already
@@ -2903,9 +2945,14 @@ bool CChainState::FlushStateToDisk(
                 return AbortNode(state, "Disk space is too low!", _("Error: Disk space is too low!").translated, CClientUIInterface::MSG_NOPREFIX);
             }
             // Flush the chainstate (which may refer to block index entries).
-            if (!CoinsTip().Flush())
-                return AbortNode(state, "Failed to write to coin database");
-            nLastFlush = nNow;
+            if (fDoSync) {
+                if (!CoinsTip().Sync())
+                    return AbortNode(state, "Failed to write to coin database");
+            } else {
+                if (!CoinsTip().Flush())
+                    return AbortNode(state, "Failed to write to coin database");
+                nLastFlush = nNow;
+            }
             full_flush_completed = true;
         }
     }
@@ -2967,6 +3014,9 @@ void static UpdateTip(const CBlockIndex* pindexNew, const CChainParams& chainPar
         g_best_block_cv.notify_all();
     }
 
+    chiapos::g_mined_block_index.SetTip(pindexNew);
+    g_mortgage_ledger.SetTip(pindexNew, chainParams.GetConsensus());
+
     std::string warningMessages;
     if (!::ChainstateActive().IsInitialBlockDownload())
     {
@@ -3314,6 +3364,28 @@ void CChainState::PruneBlockIndexCandidates() {
     assert(!setBlockIndexCandidates.empty());
 }
 
+void VerifyFarmerSignatures(const std::vector<CBlockHeader>& headers)
+{
+    int64_t nTimeStart = GetTimeMicros();
+    chiapos::CSignatureBatch batch;
+    for (const CBlockHeader& header : headers) {
+        if (!header.IsChiaBlock() || header.chiaposFields.vchFarmerSignature.size() != chiapos::SIG_LEN ||
+            header.chiaposFields.posProof.vchFarmerPk.size() != chiapos::PK_LEN) {
+            continue;
+        }
+        batch.Add(chiapos::MakeArray<chiapos::PK_LEN>(header.chiaposFields.posProof.vchFarmerPk),
+                  chiapos::MakeArray<chiapos::SIG_LEN>(header.chiaposFields.vchFarmerSignature),
+                  chiapos::MakeBytes(header.GetUnsignaturedHash()));
+    }
+    std::size_t nSignatures = batch.Size();
+    if (nSignatures < 2) {
+        // Nothing to gain from a batch, CheckBlock verifies it
+        return;
+    }
+    bool fValid = batch.Verify();
+    LogPrint(BCLog::BENCH, "  - Verify %u farmer signatures: %.2fms%s\n", (unsigned int) nSignatures, 0.001 * (GetTimeMicros() - nTimeStart), fValid ? "" : " (invalid signature found)");
+}
+
 /**
  * Try to make some progress towards making pindexMostWork the active block.
  * pblock is either nullptr or a pointer to a CBlock corresponding to pindexMostWork.
@@ -3799,6 +3871,7 @@ CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block)
     if (!pindexNew->vchPubKey.empty())
         pindexNew->nStatus |= BLOCK_HAVE_SIGNATURE;
     pindexNew->Update(Params().GetConsensus());
+    chiapos::UpdateWindowSums(pindexNew, Params().GetConsensus());
 
     setDirtyBlockIndex.insert(pindexNew);
 
@@ -3924,7 +3997,7 @@ static bool FindUndoPos(CValidationState &state, int nFile, FlatFilePos &pos, un
     return true;
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, bool fCheckWork = true)
+static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, bool fCheckWork = true, const chiapos::CVerifiedProofs* pverifiedProofs = nullptr)
 {
     AssertLockHeld(cs_main);
 
@@ -4002,13 +4075,17 @@ static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state,
 
     if (pindexPrev->nHeight + 1 >= chainparams.GetConsensus().BHDIP009Height) {
         LogPrint(BCLog::POC, "%s: difficulty=%ld, k=%d\n", __func__, block.chiaposFields.nDifficulty, block.chiaposFields.posProof.nPlotK);
-        if (!chiapos::CheckBlockFields(block.chiaposFields, block.nTime, pindexPrev, state, chainparams.GetConsensus())) {
+        if (!chiapos::CheckBlockFields(block.chiaposFields, block.nTime, pindexPrev, state, chainparams.GetConsensus(), pverifiedProofs)) {
             return false;
         }
     } else {
         if (!chainparams.GetConsensus().BHDIP009SkipTestChainChecks) {
             LogPrint(BCLog::POC, "%s: checking burst fields...\n", __func__);
-            if (!poc::CheckProofOfCapacity(*pindexPrev, block, chainparams.GetConsensus())) {
+            const uint64_t* pnUnformattedDeadline = nullptr;
+            if (pverifiedProofs != nullptr && pverifiedProofs->fDeadlineCalculated && pverifiedProofs->generationSignature == pindexPrev->GetNextGenerationSignature()) {
+                pnUnformattedDeadline = &pverifiedProofs->nUnformattedDeadline;
+            }
+            if (!poc::CheckProofOfCapacity(*pindexPrev, block, chainparams.GetConsensus(), pnUnformattedDeadline)) {
                 return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, "bad-work", "check work failed");
             }
         }
@@ -4094,9 +4171,9 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const CChainParams
             return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, "bad-chia-farmerpk", "farmer public-key is empty");
         }
         LogPrint(BCLog::NET, "%s: verifying signature hash: %s, farmer-pk: %s\n", __func__, block.GetUnsignaturedHash().GetHex(), chiapos::BytesToHex(block.chiaposFields.posProof.vchFarmerPk));
-        if (!chiapos::VerifySignature(chiapos::MakeArray<chiapos::PK_LEN>(block.chiaposFields.posProof.vchFarmerPk),
-                                      chiapos::MakeArray<chiapos::SIG_LEN>(block.chiaposFields.vchFarmerSignature),
-                                      chiapos::MakeBytes(block.GetUnsignaturedHash()))) {
+        if (!chiapos::VerifySignatureWithCache(chiapos::MakeArray<chiapos::PK_LEN>(block.chiaposFields.posProof.vchFarmerPk),
+                                               chiapos::MakeArray<chiapos::SIG_LEN>(block.chiaposFields.vchFarmerSignature),
+                                               chiapos::MakeBytes(block.GetUnsignaturedHash()))) {
             return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, "bad-chia-work",
                                  "cannot verify farmer signature");
         }
@@ -4324,7 +4401,7 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckWork)
+bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckWork, const chiapos::CVerifiedProofs* pverifiedProofs)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -4342,7 +4419,7 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, CValidationState
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams, fCheckWork))
+        if (!CheckBlockHeader(block, state, chainparams, fCheckWork, pverifiedProofs))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -4403,6 +4480,125 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, CValidationState
     return true;
 }
 
+/**
+ * Verify the PoS and VDF proofs of the headers after BHDIP009 on the workers of headerproofscheckqueue. The proofs only
+ * depend on the challenges from the headers, the challenges and other rules are checked later by AcceptBlockHeader.
+ */
+static void VerifyHeaderProofs(const std::vector<CBlockHeader>& headers, std::size_t beginCheckWorkIndex, const Consensus::Params& params, std::vector<chiapos::CVerifiedProofs>& vVerifiedProofs) LOCKS_EXCLUDED(cs_main)
+{
+    int nFirstHeight;
+    std::vector<bool> vKnown(headers.size(), false);
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexPrev = LookupBlockIndex(headers[0].hashPrevBlock);
+        if (pindexPrev == nullptr || pindexPrev->nHeight + (int) headers.size() < params.BHDIP009Height) {
+            return;
+        }
+        nFirstHeight = pindexPrev->nHeight + 1;
+        for (std::size_t index = beginCheckWorkIndex; index < headers.size(); ++index) {
+            vKnown[index] = LookupBlockIndex(headers[index].GetHash()) != nullptr;
+        }
+    }
+
+    std::vector<chiapos::CHeaderProofsCheck> vChecks;
+    for (std::size_t index = beginCheckWorkIndex; index < headers.size(); ++index) {
+        int nTargetHeight = nFirstHeight + (int) index;
+        if (nTargetHeight < params.BHDIP009Height || vKnown[index]) {
+            continue;
+        }
+        vChecks.emplace_back(headers[index].chiaposFields, nTargetHeight, params, &vVerifiedProofs[index]);
+    }
+    if (vChecks.empty()) {
+        return;
+    }
+
+    int64_t nTimeStart = GetTimeMicros();
+    std::size_t nChecks = vChecks.size();
+    if (nScriptCheckThreads) {
+        CCheckQueueControl<chiapos::CHeaderProofsCheck> control(&headerproofscheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    } else {
+        for (auto& check : vChecks) {
+            if (!check()) {
+                break;
+            }
+        }
+    }
+    LogPrint(BCLog::BENCH, "  - Verify proofs of %u headers: %.2fms\n", (unsigned int) nChecks, 0.001 * (GetTimeMicros() - nTimeStart));
+}
+
+/**
+ * Calculate the deadlines of the headers before BHDIP009 on the workers of deadlinecheckqueue. The generation
+ * signatures are chained from the previous headers, CheckBlockHeader only uses a deadline when the generation
+ * signature of the connected previous block matches.
+ */
+static void CalculateHeaderDeadlines(const std::vector<CBlockHeader>& headers, std::size_t beginCheckWorkIndex, const Consensus::Params& params, std::vector<chiapos::CVerifiedProofs>& vVerifiedProofs) LOCKS_EXCLUDED(cs_main)
+{
+    if (params.BHDIP009SkipTestChainChecks) {
+        return;
+    }
+
+    int nFirstHeight;
+    uint256 generationSignature;
+    std::vector<bool> vKnown(headers.size(), false);
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexPrev = LookupBlockIndex(headers[0].hashPrevBlock);
+        if (pindexPrev == nullptr || pindexPrev->nHeight + 1 >= params.BHDIP009Height) {
+            return;
+        }
+        nFirstHeight = pindexPrev->nHeight + 1;
+        generationSignature = pindexPrev->GetNextGenerationSignature();
+        for (std::size_t index = beginCheckWorkIndex; index < headers.size(); ++index) {
+            vKnown[index] = LookupBlockIndex(headers[index].GetHash()) != nullptr;
+        }
+    }
+
+    std::vector<poc::CDeadlineCheck> vChecks;
+    std::size_t nDeadlines = 0;
+    for (std::size_t index = 0; index < headers.size(); ++index) {
+        int nTargetHeight = nFirstHeight + (int) index;
+        if (nTargetHeight >= params.BHDIP009Height) {
+            break;
+        }
+        const CBlockHeader& header = headers[index];
+        if (index >= beginCheckWorkIndex && !vKnown[index] && poc::IsDeadlineFromNonce(nTargetHeight, header, params)) {
+            chiapos::CVerifiedProofs& verified = vVerifiedProofs[index];
+            verified.fDeadlineCalculated = true;
+            verified.generationSignature = generationSignature;
+            if (vChecks.empty() || vChecks.back().Size() == CShabal256Lanes::MAX_LANES) {
+                vChecks.emplace_back();
+            }
+            vChecks.back().Add(nTargetHeight, generationSignature, header.nPlotterId, header.nNonce, &verified.nUnformattedDeadline);
+            ++nDeadlines;
+        }
+        if (index + 1 < headers.size() && headers[index + 1].hashPrevBlock != header.GetHash()) {
+            // The headers aren't continuous, AcceptBlockHeader will reject them
+            break;
+        }
+        if (nTargetHeight >= params.BHDIP007Height && generationSignature.IsNull()) {
+            break;
+        }
+        generationSignature = CalculateNextGenerationSignature(nTargetHeight, generationSignature, header.hashMerkleRoot, header.nPlotterId, params);
+    }
+    if (vChecks.empty()) {
+        return;
+    }
+
+    int64_t nTimeStart = GetTimeMicros();
+    if (nScriptCheckThreads) {
+        CCheckQueueControl<poc::CDeadlineCheck> control(&deadlinecheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    } else {
+        for (auto& check : vChecks) {
+            check();
+        }
+    }
+    LogPrint(BCLog::BENCH, "  - Calculate deadlines of %u headers: %.2fms\n", (unsigned int) nDeadlines, 0.001 * (GetTimeMicros() - nTimeStart));
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
@@ -4469,10 +4665,17 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
         LogPrint(BCLog::POC, "%s: %s-%s, Verify work [%d,%d)\n", __func__, headers.begin()->GetHash().ToString(), headers.rbegin()->GetHash().ToString(), nLastKnownBlockIndex + 1, (int) headers.size());
     }
 
+    // Verify the proofs of chia headers and the deadlines of burst headers in parallel without holding cs_main
+    std::size_t beginCheckWorkIndex = (std::size_t) (nLastKnownBlockIndex + 1);
+    std::vector<chiapos::CVerifiedProofs> vVerifiedProofs(headers.size());
+    VerifyHeaderProofs(headers, beginCheckWorkIndex, chainparams.GetConsensus(), vVerifiedProofs);
+    CalculateHeaderDeadlines(headers, beginCheckWorkIndex, chainparams.GetConsensus(), vVerifiedProofs);
+    // The blocks of the headers are downloaded next, CheckBlock finds their farmer signatures in the proof cache
+    VerifyFarmerSignatures(headers);
+
     // Connect block
     {
         // Don't hold cs_main too long time
-        std::size_t beginCheckWorkIndex = (std::size_t) (nLastKnownBlockIndex + 1);
         for (std::size_t index = 0; index < headers.size();) {
             if (index > 0) { // Let's other thread hold cs_main
                 NotifyHeaderTip();
@@ -4486,7 +4689,7 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
                 for (int processed = 0; index < headers.size(); index++, processed++) {
                     const CBlockHeader& header = headers[index];
                     CBlockIndex *pindex = nullptr;
-                    bool accepted = g_blockman.AcceptBlockHeader(header, state, chainparams, &pindex, (index >= beginCheckWorkIndex));
+                    bool accepted = g_blockman.AcceptBlockHeader(header, state, chainparams, &pindex, (index >= beginCheckWorkIndex), &vVerifiedProofs[index]);
                     ::ChainstateActive().CheckBlockIndex(chainparams.GetConsensus());
 
                     if (!accepted) {
@@ -4947,6 +5150,8 @@ bool BlockManager::LoadBlockIndex(
 
         // Update by height ascent
         pindex->Update(consensus_params);
+        chiapos::UpdateWindowSums(pindex, consensus_params);
+        UpdateBlockAccumulateSubsidy(pindex, consensus_params);
     }
 
     return true;
@@ -5404,6 +5609,9 @@ void UnloadBlockIndex()
 {
     LOCK(cs_main);
     ::ChainActive().SetTip(nullptr);
+    // The index and the ledger point to the block indexes which are going to be freed
+    chiapos::g_mined_block_index.Reset();
+    g_mortgage_ledger.Reset();
     g_blockman.Unload();
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
@@ -23,7 +23,9 @@
 #include <versionbits.h>
 
 #include <atomic>
+#include <chrono>
 #include <exception>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -50,6 +52,10 @@ struct DisconnectedBlockTransactions;
 struct PrecomputedTransactionData;
 struct LockPoints;
 
+namespace chiapos {
+struct CVerifiedProofs;
+} // namespace chiapos
+
 /** Default for -minrelaytxfee, minimum relay fee for transactions */
 static const unsigned int DEFAULT_MIN_RELAY_TX_FEE = 1000;
 /** Default for -limitancestorcount, max number of in-mempool ancestors */
@@ -155,6 +161,11 @@ typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern Mutex g_best_block_mutex;
 extern std::condition_variable g_best_block_cv;
 extern uint256 g_best_block;
+/**
+ * Wait on g_best_block_cv until g_best_block is different from hashWatched or fnRunning returns false. Returns false
+ * when the deadline is reached first.
+ */
+bool WaitForBestBlockChange(const uint256& hashWatched, std::chrono::steady_clock::time_point deadline, const std::function<bool()>& fnRunning);
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
@@ -253,6 +264,10 @@ bool LoadBlockIndex(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck(int worker_num);
+/** Run an instance of the header proofs checking thread */
+void ThreadHeaderProofsCheck(int worker_num);
+/** Run an instance of the deadline checking thread */
+void ThreadDeadlineCheck(int worker_num);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransactionRef& tx, const Consensus::Params& params, uint256& hashBlock, const CBlockIndex* const blockIndex = nullptr);
 /**
@@ -277,6 +292,8 @@ BlockReward GetFullMortgageBlockReward(CBlockIndex* pindex, const Consensus::Par
 BlockReward GetLowMortgageBlockReward(int nHeight, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 int GetFullMortgageFundRoyaltyRatio(int nHeight, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 int GetLowMortgageFundRoyaltyRatio(int nHeight, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+/** Recalculate the running accumulated subsidy of the block from its predecessor, the predecessor must be up to date */
+void UpdateBlockAccumulateSubsidy(CBlockIndex* pindex, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 CAmount GetBlockAccumulateSubsidy(const CBlockIndex* pindexPrev, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 /** Guess verification progress (as a fraction between 0.0=genesis and 1.0=current tip). */
@@ -404,6 +421,13 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, CValidationState& state, const CChainParams& chainparams, bool fCheckWork = true, bool fCheckMerkleRoot = true);
 
+/**
+ * Verify the farmer signatures of a run of headers in one batch, the signatures passed the verification are stored in
+ * the proof cache and CheckBlock won't verify them again when the blocks arrive. The invalid ones are left to
+ * CheckBlock, which rejects the block before it is stored.
+ */
+void VerifyFarmerSignatures(const std::vector<CBlockHeader>& headers);
+
 /** Check a block is completely valid from start to finish (only works on top of our current best block) */
 bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckWork = true, bool fCheckMerkleRoot = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
@@ -450,7 +474,8 @@ enum class FlushStateMode {
     NONE,
     IF_NEEDED,
     PERIODIC,
-    ALWAYS
+    ALWAYS,
+    SYNC //!< Write the block index and the coins like ALWAYS, but keep the coins cache warm
 };
 
 struct CBlockIndexWorkComparator
@@ -525,7 +550,8 @@ public:
         CValidationState& state,
         const CChainParams& chainparams,
         CBlockIndex** ppindex,
-        bool fCheckWork = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+        bool fCheckWork = true,
+        const chiapos::CVerifiedProofs* pverifiedProofs = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 };
 
 /**
@@ -20,3 +20,8 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyChallenge(const CBlockIndex * /*CBlockIndex*/)
+{
+    return true;
+}
@@ -42,6 +42,7 @@ public:
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    virtual bool NotifyChallenge(const CBlockIndex *pindex);
 
 protected:
     void *psocket;
@@ -9,6 +9,8 @@
 #include <validation.h>
 #include <util/system.h>
 #include <rpc/server.h>
+#include <chiapos/post.h>
+#include <crypto/common.h>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -16,6 +18,7 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_CHALLENGE = "challenge";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -207,3 +210,35 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+std::array<unsigned char, CZMQPublishChallengeNotifier::CHALLENGE_BODY_SIZE> CZMQPublishChallengeNotifier::MakeChallengeBody(const CBlockIndex *pindex, const Consensus::Params& params)
+{
+    int nTargetHeight = pindex->nHeight + 1;
+    uint256 challenge = chiapos::MakeChallenge(pindex, params);
+    uint256 hash = pindex->GetBlockHash();
+
+    // challenge (32) | prev block hash (32) | target height (4) | difficulty (8) | base iters (8) | filter bits (4)
+    std::array<unsigned char, CHALLENGE_BODY_SIZE> data;
+    for (unsigned int i = 0; i < 32; i++) {
+        data[31 - i] = challenge.begin()[i];
+        data[63 - i] = hash.begin()[i];
+    }
+    WriteLE32(data.data() + 64, nTargetHeight);
+    WriteLE64(data.data() + 68, chiapos::GetDifficultyForNextIterations(pindex, params));
+    WriteLE64(data.data() + 76, chiapos::GetBaseIters(nTargetHeight, params, pindex->chiaposFields.GetItersPerSec()));
+    WriteLE32(data.data() + 84, chiapos::GetBitsOfFilter(nTargetHeight, params));
+    return data;
+}
+
+bool CZMQPublishChallengeNotifier::NotifyChallenge(const CBlockIndex *pindex)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    int nTargetHeight = pindex->nHeight + 1;
+    if (nTargetHeight < params.BHDIP009Height) {
+        // Nothing to farm before chiapos is activated
+        return true;
+    }
+    LogPrint(BCLog::ZMQ, "zmq: Publish challenge %s (height=%d)\n", chiapos::MakeChallenge(pindex, params).GetHex(), nTargetHeight);
+    auto data = MakeChallengeBody(pindex, params);
+    return SendMessage(MSG_CHALLENGE, data.data(), data.size());
+}
@@ -7,7 +7,10 @@
 
 #include <zmq/zmqabstractnotifier.h>
 
+#include <array>
+
 class CBlockIndex;
+namespace Consensus { struct Params; }
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
@@ -52,4 +55,15 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+class CZMQPublishChallengeNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    //! The size of the body of the challenge message, the layout is documented in doc/zmq.md
+    static const size_t CHALLENGE_BODY_SIZE = 88;
+
+    static std::array<unsigned char, CHALLENGE_BODY_SIZE> MakeChallengeBody(const CBlockIndex *pindex, const Consensus::Params& params);
+
+    bool NotifyChallenge(const CBlockIndex *pindex) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H